@@ -92,6 +92,41 @@ int main (int argc, char** argv)
 		return 1;
 	}
 
+	string evaluate_in_process = "binary_tree/algorithm/evaluate_in_process";
+	if (cl (evaluate_in_process, 0))
+	{
+		try
+		{
+			refiner->EvaluateInProcess();
+		}
+		catch (exception& ex)
+		{
+			cerr << "Solver process not available, the functor will be evaluated locally" << endl;
+			cerr << ex.what() << endl;
+		}
+	}
+
+	string batch_evaluations = "binary_tree/algorithm/batch_evaluations";
+	refiner->BatchEvaluations (cl (batch_evaluations, 0));
+
+	string sample_cache = "binary_tree/algorithm/sample_cache";
+	string cache_filename = cl (sample_cache, "");
+
+	if (cache_filename != "")
+	{
+		string sample_cache_megabytes = "binary_tree/algorithm/sample_cache_megabytes";
+		size_t cache_bytes = static_cast<size_t> (cl (sample_cache_megabytes, 1024)) << 20;
+		try
+		{
+			refiner->CacheSamples (cache_filename, cache_bytes);
+		}
+		catch (exception& ex)
+		{
+			cerr << "Samples cache not available, the functor will be evaluated" << endl;
+			cerr << ex.what() << endl;
+		}
+	}
+
 	string input_mesh = "binary_tree/algorithm/input_mesh";
 	string mesh_filename = cl (input_mesh, "");
 
@@ -131,6 +166,21 @@ int main (int argc, char** argv)
 
 	refiner->ExportMesh (output_filename);
 
+	if (cache_filename != "")
+	{
+		try
+		{
+			auto stats = refiner->CacheStatistics();
+			cerr << "Samples cache: " << stats.hits << " hits, "
+				 << stats.misses << " misses, "
+				 << stats.hit_samples << " samples read, "
+				 << stats.stored_samples << " samples stored, "
+				 << stats.evicted_blocks << " blocks evicted" << endl;
+		}
+		catch (logic_error&)
+		{}
+	}
+
 	cerr << "Example 1 ended" << endl;
 
 	return 0;
@@ -0,0 +1,330 @@
+#ifndef __COMPILED_FUNCTOR_H
+#define __COMPILED_FUNCTOR_H
+
+#include "Functors.h"
+#include "Plugin.h"
+#include "BinaryTreeHelper.h" //MakeUnique
+
+#include <memory> //std::shared_ptr, std::unique_ptr
+#include <iostream>
+#include <cmath>
+
+/**
+	Name of the function evaluating the compiled expression at one point
+**/
+#define JIT_SCALAR_SYMBOL "binary_adapt_jit_eval"
+/**
+	Name of the function evaluating the compiled expression at a batch of points
+**/
+#define JIT_BATCH_SYMBOL "binary_adapt_jit_eval_batch"
+
+namespace Functions
+{
+	/**
+		Translate a muParser expression into an equivalent C++ expression.
+		Input parameters:
+			- the muParser expression
+			- the names of the variables, the i-th one is translated into p[i]
+		Operators, constants (_pi, _e) and the built-in functions of muParser are supported;
+		comparisons and logical operators give 1.0 or 0.0 as muParser does.
+		It raises a runtime_error exception if the expression contains something else.
+	**/
+	std::string TranslateExpression (const std::string&, const std::vector<std::string>&);
+
+	/**
+		C++ source of a shared object evaluating a translated expression.
+		Input parameters:
+			- the C++ expression, as returned by TranslateExpression()
+			- the number of variables
+			- the original expression, written in a comment
+		The shared object exports the C functions JIT_SCALAR_SYMBOL and JIT_BATCH_SYMBOL.
+	**/
+	std::string JitSource (const std::string&, size_t, const std::string&);
+
+	/**
+		Compiler of generated sources into shared objects.
+		Shared objects are cached in a directory,
+		with a file name given by the hash of the source, the compiler and the flags:
+		the same expression is compiled only once, also across different runs.
+		The cache directory must be owned by the user and not writable by the others,
+		as the cached shared objects, since they are loaded without being compiled again.
+	**/
+	class JitCompiler
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the compiler command
+				- the compiler flags, split at white spaces
+				- the directory where shared objects are cached
+			The compiler is run directly, not through a shell.
+			If the directory is empty, DefaultCacheDirectory() is used;
+			if it cannot be used, a temporary directory is created for the process.
+		**/
+		JitCompiler (const std::string& compiler = "c++",
+					 const std::string& flags = "-O3 -march=native",
+					 const std::string& cache_dir = "");
+
+		/**
+			Path of the shared object compiled from input source.
+			If it is not cached, the source is compiled.
+			It raises a runtime_error exception if the compilation fails,
+			e.g. if no compiler is available,
+			or if the cache directory or the cached shared object
+			are not owned by the user or are writable by the others.
+		**/
+		std::string SharedObject (const std::string&) const;
+
+		/**
+			The per-user cache directory: $XDG_CACHE_HOME/binary_adapt_jit,
+			or $HOME/.cache/binary_adapt_jit; empty if neither variable is set.
+		**/
+		static std::string DefaultCacheDirectory();
+
+		/**
+			Hash of input source, together with the compiler and its flags
+		**/
+		std::string Hash (const std::string&) const;
+
+	  protected:
+		/**
+			The directory where shared objects are cached, created with permissions 0700.
+			It raises a runtime_error exception if it is not private to the user.
+		**/
+		std::string CacheDirectory() const;
+
+	  protected:
+		/**
+			compiler command
+		**/
+		std::string _compiler;
+		/**
+			compiler flags
+		**/
+		std::string _flags;
+		/**
+			directory where shared objects are cached, empty for the default one
+		**/
+		std::string _cache_dir;
+	};
+
+	/**
+		Functor for mathematical expression compiled into a shared object.
+		The muParser expression is translated into C++ source,
+		which is compiled and loaded at runtime,
+		so the evaluation is not interpreted.
+		It is an opt-in alternative to ParserFunctor:
+		set jit_compile = 1 in the interpolating_functions.conf configuration file.
+		The separability is detected by ParserFunctor, which also evaluates the factors:
+		separable expressions keep the separable projection.
+	**/
+	template <size_t dim>
+	class CompiledFunctor : public BinaryTree::SeparableFunctor<dim>
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the muParser expression
+				- the compiler object
+			The compiled function is checked against muParser at some points.
+			It raises an exception if the expression cannot be translated or compiled,
+			or if the check fails.
+		**/
+		CompiledFunctor (const std::string&, const JitCompiler& = JitCompiler());
+
+		/**
+			default destructor
+		**/
+		virtual ~CompiledFunctor();
+
+		virtual double operator() (const Geometry::Point<dim>&) const override;
+
+		/**
+			Batched evaluation through the compiled batch evaluator
+		**/
+		virtual void Evaluate (const double*, double*, size_t) const override;
+
+		virtual std::string Formula() const override;
+
+		virtual std::string ID() const override;
+
+		/**
+			Factor of the expression, evaluated by the parsed expression.
+			It raises an exception if the expression is not separable.
+		**/
+		virtual double Factor (size_t, double) const override;
+
+		/**
+			Tell if the parsed expression has been detected as separable
+		**/
+		virtual bool IsSeparable() const override;
+
+	  protected:
+		/**
+			Compare the compiled evaluator with muParser.
+			It raises a runtime_error exception if they differ.
+		**/
+		void CheckAgainstParser() const;
+
+	  protected:
+		/**
+			The muParser expression
+		**/
+		std::string _expr;
+		/**
+			The parsed expression, which detects and evaluates the factors
+		**/
+		ParserFunctor<dim> _parsed;
+		/**
+			The loaded shared object
+		**/
+		std::shared_ptr<PluginLoading::Plugin> _plugin;
+		/**
+			Compiled scalar evaluator
+		**/
+		double (*_scalar) (const double*);
+		/**
+			Compiled batch evaluator
+		**/
+		void (*_batch) (const double*, double*, unsigned long);
+	};
+
+	/**
+		Builder registered in the factory under mu_parser_expr key.
+		If jit_compile is set in the configuration file, it tries to build a CompiledFunctor;
+		if it fails, e.g. if no compiler is available, it falls back to ParserFunctor.
+		Otherwise it builds a ParserFunctor.
+	**/
+	template <size_t dim>
+	std::unique_ptr<BinaryTree::Functor<dim>> BuildParsedFunctor();
+
+
+	template <size_t dim>
+	CompiledFunctor<dim>::CompiledFunctor (const std::string& expr,
+										   const JitCompiler& compiler) :
+		_expr (expr),
+		_parsed (expr),
+		_plugin (nullptr),
+		_scalar (nullptr),
+		_batch (nullptr)
+	{
+		auto variables = MuParserInterface<dim>().Variables();
+		auto source = JitSource (TranslateExpression (expr, variables), dim, expr);
+
+		this->_plugin = std::make_shared<PluginLoading::Plugin> (compiler.SharedObject (source),
+																 RTLD_NOW | RTLD_LOCAL);
+		void* handle = this->_plugin->Open();
+
+		this->_scalar = reinterpret_cast<double (*) (const double*)> (dlsym (handle, JIT_SCALAR_SYMBOL));
+		this->_batch = reinterpret_cast<void (*) (const double*, double*, unsigned long)>
+					   (dlsym (handle, JIT_BATCH_SYMBOL));
+
+		if (!this->_scalar || !this->_batch)
+			throw std::runtime_error ("CompiledFunctor: evaluators not found in " + this->_plugin->File());
+
+		CheckAgainstParser();
+	}
+
+	template <size_t dim>
+	CompiledFunctor<dim>::~CompiledFunctor()
+	{}
+
+	template <size_t dim>
+	double CompiledFunctor<dim>::operator() (const Geometry::Point<dim>& p) const
+	{
+		auto values = static_cast<std::array<double, dim>> (p);
+		return this->_scalar (values.data());
+	}
+
+	template <size_t dim>
+	void CompiledFunctor<dim>::Evaluate (const double* points, double* values, size_t n) const
+	{
+		this->_batch (points, values, n);
+	}
+
+	template <size_t dim>
+	std::string CompiledFunctor<dim>::Formula() const
+	{
+		return this->_expr;
+	}
+
+	template <size_t dim>
+	std::string CompiledFunctor<dim>::ID() const
+	{
+		return "RENAME_ME_parsed_functor";
+	}
+
+	template <size_t dim>
+	double CompiledFunctor<dim>::Factor (size_t i, double x) const
+	{
+		return this->_parsed.Factor (i, x);
+	}
+
+	template <size_t dim>
+	bool CompiledFunctor<dim>::IsSeparable() const
+	{
+		return this->_parsed.IsSeparable();
+	}
+
+	template <size_t dim>
+	void CompiledFunctor<dim>::CheckAgainstParser() const
+	{
+		MuParserInterface<dim> parser (this->_expr);
+		const double tol = 1E-12;
+
+		//points scattered in the unit box, where the functions are usually interpolated
+		for (size_t q = 0; q < 16; ++q)
+		{
+			std::array<double, dim> p;
+			for (size_t i = 0; i < dim; ++i)
+				p[i] = std::fmod (0.0625 + 0.618034 * q + 0.414214 * i, 1.0);
+
+			double expected = parser (p);
+			double computed = this->_scalar (p.data());
+
+			bool same = std::isnan (expected) ? std::isnan (computed)
+						: std::abs (computed - expected) <= tol * (1 + std::abs (expected));
+			if (!same)
+				throw std::runtime_error ("CompiledFunctor: compiled expression "
+										  + this->_expr
+										  + " gives "
+										  + std::to_string (computed)
+										  + " instead of "
+										  + std::to_string (expected));
+		}
+	}
+
+	template <size_t dim>
+	std::unique_ptr<BinaryTree::Functor<dim>> BuildParsedFunctor()
+	{
+		std::string thisfile = __FILE__;
+		std::string conf_file = thisfile.substr (0, thisfile.find_last_of ('/'))
+						 + "/interpolating_functions.conf";
+
+		Helpers::Cfgfile cl (conf_file);
+		std::string section = std::to_string (dim) + "D/";
+		std::string expr = cl (section + "mu_parser_expr", "");
+
+		if (!cl (section + "jit_compile", 0) || expr == "")
+			return Helpers::MakeUnique<ParserFunctor<dim>>();
+
+		JitCompiler compiler (cl ("jit/compiler", "c++"),
+							  cl ("jit/flags", "-O3 -march=native"),
+							  cl ("jit/cache_dir", ""));
+		try
+		{
+			return Helpers::MakeUnique<CompiledFunctor<dim>> (expr, compiler);
+		}
+		catch (std::exception& e)
+		{
+			std::clog << "Warning: cannot compile " << expr
+					  << ", muParser will be used. " << e.what() << std::endl;
+		}
+		return Helpers::MakeUnique<ParserFunctor<dim>> (expr);
+	}
+
+} //namespace Functions
+
+#endif //__COMPILED_FUNCTOR_H
@@ -5,16 +5,31 @@
 #include "MuParserInterface.h"
 #include "HelpFile.h" //Cfgfile
 
+#include <vector>
+
 /**
 	It contains implementation of functor objects that can be interpolated by the binary tree algorithm
 **/
 namespace Functions
 {
+	/**
+		Split a mathematical expression into the factors of its outermost product.
+		It returns an empty vector if the expression is not a product,
+		i.e. if an operator with lower precedence than * and /
+		(as +, binary -, comparisons, logical operators) is found outside parentheses.
+		Unary - at the beginning of a factor is allowed.
+		The check is conservative: e.g. also 1e-3 makes it fail.
+	**/
+	std::vector<std::string> SplitProduct (const std::string&);
+
 	/**
 		Functor for mathematical expression parsed from file.
+		If the expression is a product of factors each depending on a single variable,
+		e.g. sqrt(x)*sqrt(y), it is detected as separable
+		and the factors can be evaluated separately.
 	**/
 	template <size_t dim>
-	class ParserFunctor : public BinaryTree::Functor<dim>
+	class ParserFunctor : public BinaryTree::SeparableFunctor<dim>
 	{
 	  public:
 		/**
@@ -44,6 +59,18 @@ namespace Functions
 
 		virtual std::string ID() const override;
 
+		/**
+			Evaluate the product of the factors depending only on input coordinate.
+			Factors without variables are assigned to the first coordinate.
+			It raises an exception if the expression is not separable.
+		**/
+		virtual double Factor (size_t, double) const override;
+
+		/**
+			Tell if the expression has been detected as separable
+		**/
+		virtual bool IsSeparable() const override;
+
 	  protected:
 		/**
 			Check the semantic validity of the mu parser expression.
@@ -51,11 +78,27 @@ namespace Functions
 		**/
 		void CheckExpressionValidity();
 
+		/**
+			Check if the expression is separable, then build the parsers of the factors.
+		**/
+		void DetectFactors();
+
 	  protected:
 		/**
 			The muParser wrapper object
 		**/
 		MuParserInterface<dim> _parser;
+
+		/**
+			Flag telling if the expression is separable
+		**/
+		bool _separable;
+
+		/**
+			Parsers of the product of the factors depending on each coordinate,
+			filled only if the expression is separable
+		**/
+		std::vector<MuParserInterface<dim>> _factors;
 	};
 
 
@@ -213,6 +256,7 @@ namespace Functions
 			every time I call ParserFunctor::operator()
 			I do it once here */
 		CheckExpressionValidity();
+		DetectFactors();
 	}
 
 	template <size_t dim>
@@ -223,6 +267,7 @@ namespace Functions
 	ParserFunctor<dim>::ParserFunctor (const std::string& s) : _parser (s)
 	{
 		CheckExpressionValidity();
+		DetectFactors();
 	}
 
 	template <size_t dim>
@@ -244,6 +289,63 @@ namespace Functions
 	}
 
 
+	template <size_t dim>
+	double ParserFunctor<dim>::Factor (size_t i, double x) const
+	{
+		if (!this->_separable)
+			throw std::logic_error ("Factor requested to a not separable ParserFunctor");
+
+		//the factor depends only on i-th variable, the other ones are not used
+		std::array<double, dim> values;
+		values.fill (x);
+		return (this->_factors[i]) (values);
+	}
+
+	template <size_t dim>
+	bool ParserFunctor<dim>::IsSeparable() const
+	{
+		return this->_separable;
+	}
+
+	template <size_t dim>
+	void ParserFunctor<dim>::DetectFactors()
+	{
+		this->_separable = false;
+		this->_factors.clear();
+
+		auto factors = SplitProduct (this->_parser.Expression());
+		if (factors.empty())
+			return;
+
+		//product of the factors depending on each variable
+		std::vector<std::string> products (dim);
+		for (auto& f : factors)
+		{
+			MuParserInterface<dim> factor_parser (f);
+			std::vector<size_t> variables;
+			try
+			{
+				variables = factor_parser.UsedVariables();
+			}
+			catch (mu::Parser::exception_type&)
+			{
+				return;
+			}
+
+			if (variables.size() > 1)
+				return;
+
+			size_t i = variables.empty() ? 0 : variables[0];
+			products[i] += (products[i].empty() ? "(" : "*(") + f + ")";
+		}
+
+		this->_factors.reserve (dim);
+		for (auto& p : products)
+			this->_factors.emplace_back (p.empty() ? "1" : p);
+
+		this->_separable = true;
+	}
+
 	template <size_t dim>
 	void ParserFunctor<dim>::CheckExpressionValidity()
 	{
@@ -0,0 +1,508 @@
+#ifndef __GRID_FUNCTOR_H
+#define __GRID_FUNCTOR_H
+
+#include "Functor.h"
+#include "BinaryTreeHelper.h" //MakeUnique
+#include "LibraryInit.h" //ConfigurationFile
+#include "HelpFile.h" //Cfgfile
+
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream> //std::ifstream
+#include <memory> //std::shared_ptr, std::unique_ptr
+#include <cstring> //std::memcpy
+#include <cstdint> //uint64_t, uint32_t
+#include <cmath> //std::floor
+#include <algorithm> //std::min, std::max
+
+namespace Functions
+{
+	/**
+		Read only memory mapping of a file.
+		Pages are loaded by the operating system when they are accessed,
+		so the file is never loaded as a whole in memory.
+	**/
+	class MappedFile
+	{
+	  public:
+		/**
+			constructor.
+			It maps the whole file, advising the kernel of a random access pattern.
+			It raises a runtime_error exception if the file cannot be mapped.
+		**/
+		MappedFile (const std::string&);
+		/**
+			destructor.
+			It unmaps the file.
+		**/
+		~MappedFile();
+
+		/**
+			Pointer to the first byte of the file
+		**/
+		const char* Data() const;
+		/**
+			Size in bytes of the file
+		**/
+		size_t Size() const;
+		/**
+			Advise the kernel that input bytes range will be accessed soon.
+			Input parameters:
+				- the offset of the first byte
+				- the number of bytes
+		**/
+		void Prefetch (size_t, size_t) const;
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		MappedFile (const MappedFile&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		MappedFile& operator = (const MappedFile&) = delete;
+
+	  private:
+		/**
+			file descriptor
+		**/
+		int _fd;
+		/**
+			mapped memory
+		**/
+		char* _data;
+		/**
+			size of the mapping
+		**/
+		size_t _size;
+	};
+
+	/**
+		Grid files layout.
+		All the fields are little-endian.
+
+			char[8]		"BAGRID01"
+			uint32		dim
+			uint32		bytes of a value, 4 for float or 8 for double
+			dim times:
+				uint64	number of samples along the direction, at least 2
+				double	lower bound of the direction
+				double	upper bound of the direction
+			values		float or double, the first direction is the fastest
+
+		Samples are equispaced and include the bounds,
+		i.e. value (i_0, ..., i_dim-1) is sampled at
+			lower_d + i_d * (upper_d - lower_d) / (n_d - 1).
+	**/
+	struct GridLayout
+	{
+		/**
+			number of samples along each direction
+		**/
+		std::vector<uint64_t> n;
+		/**
+			lower bounds
+		**/
+		std::vector<double> lower;
+		/**
+			upper bounds
+		**/
+		std::vector<double> upper;
+		/**
+			bytes of a value
+		**/
+		uint32_t value_bytes;
+		/**
+			offset of the first value from the beginning of the file
+		**/
+		size_t data_offset;
+	};
+
+	/**
+		Read the header of a mapped grid file.
+		It raises a runtime_error exception if the header is not valid,
+		or if the file is shorter than the values it declares.
+	**/
+	GridLayout ReadGridLayout (const MappedFile&);
+
+	/**
+		Write a grid file.
+		Input parameters:
+			- the file name
+			- the layout, data_offset is ignored
+			- the values, the first direction is the fastest
+	**/
+	void WriteGridFile (const std::string&, const GridLayout&, const std::vector<double>&);
+
+	/**
+		Interpolation schemes for grid data
+	**/
+	enum GridInterpolation
+	{
+		LinearInterpolation,
+		CubicInterpolation
+	};
+
+	/**
+		Functor interpolating sampled data stored in a grid file.
+		The file is memory mapped, so datasets larger than the memory can be used.
+		The value at a point is computed by multilinear interpolation
+		or by cubic (Catmull-Rom) interpolation, with quadratic extrapolation beyond the boundary samples.
+		Points outside the grid box are clamped to the box.
+	**/
+	template <size_t dim>
+	class GridFunctor : public BinaryTree::Functor<dim>
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the grid file, with the layout described in GridLayout
+				- the interpolation scheme
+			It raises a runtime_error exception if the file is not a valid dim-dimensional grid.
+		**/
+		GridFunctor (const std::string&, GridInterpolation = LinearInterpolation);
+
+		/**
+			default destructor
+		**/
+		virtual ~GridFunctor();
+
+		virtual double operator() (const Geometry::Point<dim>&) const override;
+
+		/**
+			Batched evaluation.
+			The bounding box of the points is prefetched before the interpolation,
+			so the elements, whose quadrature nodes are close, fault their pages together.
+		**/
+		virtual void Evaluate (const double*, double*, size_t) const override;
+
+		virtual std::string Formula() const override;
+
+		virtual std::string ID() const override;
+
+	  protected:
+		/**
+			Value of the sample with input linear index
+		**/
+		double Sample (size_t) const;
+
+		/**
+			Index of the grid cell containing input coordinate along direction d
+			and position of the coordinate inside the cell, in [0, 1]
+		**/
+		size_t Cell (size_t d, double x, double& t) const;
+
+		/**
+			Interpolated value at input coordinates
+		**/
+		double Interpolate (const double*) const;
+
+	  protected:
+		/**
+			The grid file name
+		**/
+		std::string _file_name;
+		/**
+			The mapped file
+		**/
+		std::shared_ptr<MappedFile> _file;
+		/**
+			The grid layout
+		**/
+		GridLayout _layout;
+		/**
+			Pointer to the first value
+		**/
+		const char* _values;
+		/**
+			Distance between consecutive samples along each direction, in number of values
+		**/
+		std::array<size_t, dim> _stride;
+		/**
+			Grid spacing along each direction
+		**/
+		std::array<double, dim> _h;
+		/**
+			The interpolation scheme
+		**/
+		GridInterpolation _interpolation;
+	};
+
+	/**
+		Builder registered in the factory under grid_data key.
+		It reads from the configuration file passed to BinaryTree::Init():
+			binary_tree/functions/grid/file				the grid file
+			binary_tree/functions/grid/interpolation	linear or cubic
+	**/
+	template <size_t dim>
+	std::unique_ptr<BinaryTree::Functor<dim>> BuildGridFunctor();
+
+
+	template <size_t dim>
+	GridFunctor<dim>::GridFunctor (const std::string& file_name,
+								   GridInterpolation interpolation) :
+		_file_name (file_name),
+		_file (std::make_shared<MappedFile> (file_name)),
+		_layout (ReadGridLayout (*_file)),
+		_values (_file->Data() + _layout.data_offset),
+		_interpolation (interpolation)
+	{
+		if (this->_layout.n.size() != dim)
+			throw std::runtime_error ("GridFunctor: "
+									  + file_name
+									  + " stores a grid of dimension "
+									  + std::to_string (this->_layout.n.size())
+									  + " instead of "
+									  + std::to_string (dim));
+
+		size_t stride = 1;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			this->_stride[d] = stride;
+			stride *= this->_layout.n[d];
+			this->_h[d] = (this->_layout.upper[d] - this->_layout.lower[d]) / (this->_layout.n[d] - 1);
+		}
+	}
+
+	template <size_t dim>
+	GridFunctor<dim>::~GridFunctor()
+	{}
+
+	template <size_t dim>
+	double GridFunctor<dim>::operator() (const Geometry::Point<dim>& p) const
+	{
+		auto coordinates = static_cast<std::array<double, dim>> (p);
+		return Interpolate (coordinates.data());
+	}
+
+	template <size_t dim>
+	void GridFunctor<dim>::Evaluate (const double* points, double* values, size_t n) const
+	{
+		if (!n)
+			return;
+
+		std::array<size_t, dim> first, last;
+		first.fill (static_cast<size_t> (-1));
+		last.fill (0);
+
+		double t;
+		for (size_t q = 0; q < n; ++q)
+			for (size_t d = 0; d < dim; ++d)
+			{
+				size_t i = Cell (d, points[q * dim + d], t);
+				first[d] = std::min (first[d], i);
+				last[d] = std::max (last[d], i);
+			}
+
+		//the cubic stencil needs one more sample on each side
+		size_t halo = this->_interpolation == CubicInterpolation ? 1 : 0;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			first[d] -= std::min (first[d], halo);
+			last[d] = std::min<size_t> (last[d] + 1 + halo, this->_layout.n[d] - 1);
+		}
+
+		/*	Samples along the first direction are contiguous:
+			each row of the bounding box is prefetched,
+			if they are not too many to be worth the system calls */
+		size_t rows = 1;
+		for (size_t d = 1; d < dim; ++d)
+			rows *= last[d] - first[d] + 1;
+
+		if (rows <= 1024)
+		{
+			size_t row_bytes = (last[0] - first[0] + 1) * this->_layout.value_bytes;
+			std::array<size_t, dim> row = first;
+			for (size_t r = 0; r < rows; ++r)
+			{
+				size_t offset = 0;
+				for (size_t d = 0; d < dim; ++d)
+					offset += row[d] * this->_stride[d];
+
+				this->_file->Prefetch (this->_layout.data_offset + offset * this->_layout.value_bytes,
+									   row_bytes);
+
+				for (size_t d = 1; d < dim; ++d)
+				{
+					if (++row[d] <= last[d])
+						break;
+					row[d] = first[d];
+				}
+			}
+		}
+
+		for (size_t q = 0; q < n; ++q)
+			values[q] = Interpolate (points + q * dim);
+	}
+
+	template <size_t dim>
+	std::string GridFunctor<dim>::Formula() const
+	{
+		return std::string (this->_interpolation == CubicInterpolation ? "cubic" : "linear")
+			   + " interpolation of " + this->_file_name;
+	}
+
+	template <size_t dim>
+	std::string GridFunctor<dim>::ID() const
+	{
+		return "grid_data";
+	}
+
+	template <size_t dim>
+	double GridFunctor<dim>::Sample (size_t index) const
+	{
+		const char* ptr = this->_values + index * this->_layout.value_bytes;
+		unsigned char bytes[8];
+		std::memcpy (bytes, ptr, this->_layout.value_bytes);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+		std::reverse (bytes, bytes + this->_layout.value_bytes);
+#endif
+		if (this->_layout.value_bytes == 4)
+		{
+			float value;
+			std::memcpy (&value, bytes, 4);
+			return value;
+		}
+		double value;
+		std::memcpy (&value, bytes, 8);
+		return value;
+	}
+
+	template <size_t dim>
+	size_t GridFunctor<dim>::Cell (size_t d, double x, double& t) const
+	{
+		double position = (x - this->_layout.lower[d]) / this->_h[d];
+		size_t last_cell = this->_layout.n[d] - 2;
+
+		position = std::min (std::max (position, 0.0), static_cast<double> (last_cell + 1));
+		size_t i = std::min (static_cast<size_t> (std::floor (position)), last_cell);
+		t = position - i;
+		return i;
+	}
+
+	template <size_t dim>
+	double GridFunctor<dim>::Interpolate (const double* x) const
+	{
+		//one dimensional stencils: at most 4 samples for each direction
+		std::array<std::array<size_t, 4>, dim> indexes;
+		std::array<std::array<double, 4>, dim> weights;
+		size_t size = this->_interpolation == CubicInterpolation ? 4 : 2;
+
+		for (size_t d = 0; d < dim; ++d)
+		{
+			double t;
+			size_t i = Cell (d, x[d], t);
+			auto& ind = indexes[d];
+			auto& w = weights[d];
+
+			if (this->_interpolation == LinearInterpolation)
+			{
+				ind[0] = i;
+				ind[1] = i + 1;
+				w[0] = 1 - t;
+				w[1] = t;
+				continue;
+			}
+
+			//Catmull-Rom weights of samples i - 1, i, i + 1, i + 2
+			double t2 = t * t, t3 = t2 * t;
+			double w_m = 0.5 * (-t3 + 2 * t2 - t);
+			double w_0 = 0.5 * (3 * t3 - 5 * t2 + 2);
+			double w_1 = 0.5 * (-3 * t3 + 4 * t2 + t);
+			double w_2 = 0.5 * (t3 - t2);
+
+			/*	Slots k = 0, ..., 3 store sample i - 1 + k.
+				Samples beyond the boundary are extrapolated by the quadratic
+				through the three nearest ones, f(-1) = 3 f(0) - 3 f(1) + f(2),
+				so their weight is moved to the inner slots;
+				with only two samples the extrapolation is linear */
+			size_t n = this->_layout.n[d];
+			w = {w_m, w_0, w_1, w_2};
+			for (size_t k = 0; k < 4; ++k)
+				ind[k] = i + k - 1;
+
+			if (i == 0)
+			{
+				if (n > 2)
+				{
+					w[1] += 3 * w[0];
+					w[2] -= 3 * w[0];
+					w[3] += w[0];
+				}
+				else
+				{
+					w[1] += 2 * w[0];
+					w[2] -= w[0];
+				}
+				w[0] = 0;
+				ind[0] = i;
+			}
+			if (i + 2 == n)
+			{
+				if (n > 2)
+				{
+					w[2] += 3 * w[3];
+					w[1] -= 3 * w[3];
+					w[0] += w[3];
+				}
+				else
+				{
+					w[2] += 2 * w[3];
+					w[1] -= w[3];
+				}
+				w[3] = 0;
+				ind[3] = i;
+			}
+		}
+
+		//tensor product of the stencils
+		size_t combinations = 1;
+		for (size_t d = 0; d < dim; ++d)
+			combinations *= size;
+
+		double result = 0;
+		for (size_t c = 0; c < combinations; ++c)
+		{
+			size_t offset = 0;
+			double weight = 1;
+			for (size_t d = 0, k = c; d < dim; ++d, k /= size)
+			{
+				offset += indexes[d][k % size] * this->_stride[d];
+				weight *= weights[d][k % size];
+			}
+			if (weight != 0)
+				result += weight * Sample (offset);
+		}
+
+		return result;
+	}
+
+	template <size_t dim>
+	std::unique_ptr<BinaryTree::Functor<dim>> BuildGridFunctor()
+	{
+		Helpers::Cfgfile cl (BinaryTree::ConfigurationFile());
+
+		std::string file = cl ("binary_tree/functions/grid/file", "");
+		if (file == "")
+			throw std::runtime_error ("GridFunctor: no grid file, set binary_tree/functions/grid/file in "
+									  + BinaryTree::ConfigurationFile());
+
+		if (!std::ifstream (file))
+			throw std::runtime_error ("GridFunctor: the grid file " + file
+									  + " given by binary_tree/functions/grid/file in "
+									  + BinaryTree::ConfigurationFile() + " does not exist or cannot be read");
+
+		std::string interpolation = cl ("binary_tree/functions/grid/interpolation", "linear");
+		if (interpolation != "linear" && interpolation != "cubic")
+			throw std::runtime_error ("GridFunctor: unknown interpolation " + interpolation);
+
+		return Helpers::MakeUnique<GridFunctor<dim>> (file,
+				interpolation == "cubic" ? CubicInterpolation : LinearInterpolation);
+	}
+
+} //namespace Functions
+
+#endif //__GRID_FUNCTOR_H
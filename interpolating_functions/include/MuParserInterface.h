@@ -3,6 +3,7 @@
 
 #include <string>
 #include <array>
+#include <vector>
 
 #include "muParser.h"
 
@@ -61,6 +62,15 @@ namespace Functions
 			evaluate the mathematical expression at input values
 		**/
 		double operator() (const std::array<double, dim>&) const;
+		/**
+			Indexes of the variables used by the mathematical expression.
+			It raises a mu::Parser::exception_type exception if the expression is not valid.
+		**/
+		std::vector<size_t> UsedVariables() const;
+		/**
+			Names of the variables, sorted by index
+		**/
+		std::vector<std::string> Variables() const;
 
 	  protected:
 		/**
@@ -147,6 +157,27 @@ namespace Functions
 		return this->_parser.Eval();
 	};
 
+	template <size_t dim>
+	std::vector<size_t> MuParserInterface<dim>::UsedVariables() const
+	{
+		std::vector<size_t> result;
+		//variables are identified by the address they are stored in
+		for (auto& var : this->_parser.GetUsedVar())
+			result.push_back (static_cast<size_t> (var.second - this->_variables.data()));
+
+		return result;
+	};
+
+	template <size_t dim>
+	std::vector<std::string> MuParserInterface<dim>::Variables() const
+	{
+		std::vector<std::string> result (dim);
+		for (auto& var : this->_parser.GetVar())
+			result[static_cast<size_t> (var.second - this->_variables.data())] = var.first;
+
+		return result;
+	};
+
 	/**
 		By default variables are called xi, with i = 1:dim
 	**/
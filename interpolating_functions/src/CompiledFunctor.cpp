@@ -0,0 +1,560 @@
+#include "CompiledFunctor.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip> //std::setprecision, std::hex
+#include <map>
+#include <cctype> //std::isdigit, std::isalpha
+#include <cstdint> //uint64_t
+#include <cstdlib> //std::getenv
+#include <cstdio> //std::rename
+#include <cerrno> //errno
+#include <sys/stat.h> //mkdir, lstat, chmod
+#include <sys/wait.h> //waitpid
+#include <fcntl.h> //open
+#include <unistd.h> //getpid, geteuid, fork, execvp
+
+using namespace std;
+
+namespace Functions
+{
+	/**
+		Recursive descent translator of muParser expressions.
+		Operators precedence, from the lowest:
+			?: || && comparisons + - * / unary + - ^
+		Each rule returns a fully parenthesized C++ expression.
+	**/
+	class ExpressionTranslator
+	{
+	  public:
+		ExpressionTranslator (const string& expr, const vector<string>& variables) :
+			_expr (expr), _pos (0), _variables (variables)
+		{}
+
+		string Translate()
+		{
+			string result = Ternary();
+			SkipSpaces();
+			if (this->_pos != this->_expr.size())
+				Error ("unexpected character");
+			return result;
+		}
+
+	  private:
+		void Error (const string& msg) const
+		{
+			throw runtime_error ("Cannot translate " + this->_expr
+								 + ": " + msg + " at position " + to_string (this->_pos));
+		}
+
+		void SkipSpaces()
+		{
+			while (this->_pos < this->_expr.size() && isspace (this->_expr[this->_pos]))
+				++this->_pos;
+		}
+
+		/*	If the next token is input string, it is consumed */
+		bool Accept (const string& token)
+		{
+			SkipSpaces();
+			if (this->_expr.compare (this->_pos, token.size(), token) != 0)
+				return false;
+			this->_pos += token.size();
+			return true;
+		}
+
+		void Expect (const string& token)
+		{
+			if (!Accept (token))
+				Error ("expected " + token);
+		}
+
+		static string Boolean (const string& condition)
+		{
+			return "(" + condition + " ? 1.0 : 0.0)";
+		}
+
+		string Ternary()
+		{
+			string condition = Or();
+			if (!Accept ("?"))
+				return condition;
+
+			string if_true = Ternary();
+			Expect (":");
+			string if_false = Ternary();
+			return "((" + condition + ") != 0 ? " + if_true + " : " + if_false + ")";
+		}
+
+		string Or()
+		{
+			string result = And();
+			while (Accept ("||"))
+				result = Boolean (result + " != 0 || " + And() + " != 0");
+			return result;
+		}
+
+		string And()
+		{
+			string result = Comparison();
+			while (Accept ("&&"))
+				result = Boolean (result + " != 0 && " + Comparison() + " != 0");
+			return result;
+		}
+
+		string Comparison()
+		{
+			string result = Sum();
+			//two characters operators first
+			for (;;)
+			{
+				string op;
+				for (auto candidate : {"<=", ">=", "==", "!=", "<", ">"})
+					if (Accept (candidate))
+					{
+						op = candidate;
+						break;
+					}
+				if (op.empty())
+					return result;
+
+				result = Boolean (result + " " + op + " " + Sum());
+			}
+		}
+
+		string Sum()
+		{
+			string result = Product();
+			for (;;)
+			{
+				if (Accept ("+"))
+					result = "(" + result + " + " + Product() + ")";
+				else if (Accept ("-"))
+					result = "(" + result + " - " + Product() + ")";
+				else
+					return result;
+			}
+		}
+
+		string Product()
+		{
+			string result = Unary();
+			for (;;)
+			{
+				if (Accept ("*"))
+					result = "(" + result + " * " + Unary() + ")";
+				else if (Accept ("/"))
+					result = "(" + result + " / " + Unary() + ")";
+				else
+					return result;
+			}
+		}
+
+		string Unary()
+		{
+			if (Accept ("-"))
+				return "(-" + Unary() + ")";
+			if (Accept ("+"))
+				return Unary();
+			return Power();
+		}
+
+		/*	^ is right associative and it binds tighter than unary minus: -x^2 = -(x^2) */
+		string Power()
+		{
+			string base = Primary();
+			if (!Accept ("^"))
+				return base;
+			return "std::pow (" + base + ", " + Unary() + ")";
+		}
+
+		string Primary()
+		{
+			SkipSpaces();
+			if (this->_pos == this->_expr.size())
+				Error ("unexpected end of expression");
+
+			if (Accept ("("))
+			{
+				string result = Ternary();
+				Expect (")");
+				return "(" + result + ")";
+			}
+
+			char c = this->_expr[this->_pos];
+			if (isdigit (c) || c == '.')
+				return Number();
+
+			if (isalpha (c) || c == '_')
+			{
+				string name = Identifier();
+				SkipSpaces();
+				if (this->_pos < this->_expr.size() && this->_expr[this->_pos] == '(')
+					return Function (name);
+				return Name (name);
+			}
+
+			Error ("unexpected character");
+			return "";
+		}
+
+		string Number()
+		{
+			size_t begin = this->_pos;
+			auto digits = [&]()
+			{
+				while (this->_pos < this->_expr.size() && isdigit (this->_expr[this->_pos]))
+					++this->_pos;
+			};
+
+			digits();
+			if (this->_pos < this->_expr.size() && this->_expr[this->_pos] == '.')
+			{
+				++this->_pos;
+				digits();
+			}
+			if (this->_pos < this->_expr.size()
+					&& (this->_expr[this->_pos] == 'e' || this->_expr[this->_pos] == 'E'))
+			{
+				++this->_pos;
+				if (this->_pos < this->_expr.size()
+						&& (this->_expr[this->_pos] == '+' || this->_expr[this->_pos] == '-'))
+					++this->_pos;
+				digits();
+			}
+
+			string number = this->_expr.substr (begin, this->_pos - begin);
+			//the literal has to be a double, not an integer
+			if (number.find_first_of (".eE") == string::npos)
+				number += ".0";
+			if (number[0] == '.')
+				number = "0" + number;
+			return number;
+		}
+
+		string Identifier()
+		{
+			size_t begin = this->_pos;
+			while (this->_pos < this->_expr.size()
+					&& (isalnum (this->_expr[this->_pos]) || this->_expr[this->_pos] == '_'))
+				++this->_pos;
+			return this->_expr.substr (begin, this->_pos - begin);
+		}
+
+		string Name (const string& name)
+		{
+			for (size_t i = 0; i < this->_variables.size(); ++i)
+				if (this->_variables[i] == name)
+					return "p[" + to_string (i) + "]";
+
+			if (name == "_pi")
+				return "3.141592653589793238462643";
+			if (name == "_e")
+				return "2.718281828459045235360287";
+
+			Error ("unknown variable " + name);
+			return "";
+		}
+
+		string Function (const string& name)
+		{
+			static const map<string, string> unary_functions =
+			{
+				{"sin", "std::sin"}, {"cos", "std::cos"}, {"tan", "std::tan"},
+				{"asin", "std::asin"}, {"acos", "std::acos"}, {"atan", "std::atan"},
+				{"sinh", "std::sinh"}, {"cosh", "std::cosh"}, {"tanh", "std::tanh"},
+				{"asinh", "std::asinh"}, {"acosh", "std::acosh"}, {"atanh", "std::atanh"},
+				{"log2", "std::log2"}, {"log10", "std::log10"},
+				{"log", "std::log"}, {"ln", "std::log"},
+				{"exp", "std::exp"}, {"sqrt", "std::sqrt"},
+				{"abs", "std::fabs"}, {"rint", "std::rint"}, {"sign", "jit_sign"}
+			};
+
+			vector<string> args;
+			Expect ("(");
+			if (!Accept (")"))
+			{
+				do
+					args.push_back (Ternary());
+				while (Accept (","));
+				Expect (")");
+			}
+
+			auto it = unary_functions.find (name);
+			if (it != unary_functions.end())
+			{
+				if (args.size() != 1)
+					Error ("function " + name + " takes one argument");
+				return it->second + " (" + args[0] + ")";
+			}
+
+			if (args.empty())
+				Error ("function " + name + " needs arguments");
+
+			if (name == "min" || name == "max")
+			{
+				string result = args[0];
+				for (size_t i = 1; i < args.size(); ++i)
+					result = (name == "min" ? "std::fmin (" : "std::fmax (")
+							 + result + ", " + args[i] + ")";
+				return result;
+			}
+
+			if (name == "sum" || name == "avg")
+			{
+				string result = args[0];
+				for (size_t i = 1; i < args.size(); ++i)
+					result += " + " + args[i];
+				if (name == "avg")
+					return "((" + result + ") / " + to_string (args.size()) + ".0)";
+				return "(" + result + ")";
+			}
+
+			Error ("unknown function " + name);
+			return "";
+		}
+
+	  private:
+		const string& _expr;
+		size_t _pos;
+		const vector<string>& _variables;
+	};
+
+	string TranslateExpression (const string& expr, const vector<string>& variables)
+	{
+		ExpressionTranslator translator (expr, variables);
+		return translator.Translate();
+	}
+
+	string JitSource (const string& cpp_expr, size_t dim, const string& expr)
+	{
+		string comment = expr;
+		for (auto& c : comment)
+			if (c == '\n' || c == '\r')
+				c = ' ';
+
+		ostringstream source;
+		source	<< "// generated by binary_adapt from: " << comment << "\n"
+				<< "#include <cmath>\n"
+				<< "\n"
+				<< "static inline double jit_sign (double v)\n"
+				<< "{\n"
+				<< "\treturn (v > 0) - (v < 0);\n"
+				<< "}\n"
+				<< "\n"
+				<< "extern \"C\" double " JIT_SCALAR_SYMBOL " (const double* p)\n"
+				<< "{\n"
+				<< "\treturn " << cpp_expr << ";\n"
+				<< "}\n"
+				<< "\n"
+				<< "extern \"C\" void " JIT_BATCH_SYMBOL " (const double* p, double* values, unsigned long n)\n"
+				<< "{\n"
+				<< "\tfor (unsigned long q = 0; q < n; ++q, p += " << dim << ")\n"
+				<< "\t\tvalues[q] = " JIT_SCALAR_SYMBOL " (p);\n"
+				<< "}\n";
+		return source.str();
+	}
+
+	/*	Tell if input path is owned by the user and not writable by the others.
+		The path is not followed if it is a symbolic link. */
+	static bool IsPrivate (const string& path, bool directory)
+	{
+		struct stat buffer;
+		if (lstat (path.c_str(), &buffer) != 0)
+			return false;
+
+		if (directory ? !S_ISDIR (buffer.st_mode) : !S_ISREG (buffer.st_mode))
+			return false;
+
+		return buffer.st_uid == geteuid() && ! (buffer.st_mode & (S_IWGRP | S_IWOTH));
+	}
+
+	/*	Create input directory, one level at a time, with permissions 0700.
+		It raises a runtime_error exception if the directory is not private. */
+	static void MakePrivateDirectory (const string& dir)
+	{
+		for (size_t pos = dir.find ('/', 1); ; pos = dir.find ('/', pos + 1))
+		{
+			mkdir (dir.substr (0, pos).c_str(), S_IRWXU);
+			if (pos == string::npos)
+				break;
+		}
+
+		if (!IsPrivate (dir, true))
+			throw runtime_error ("JitCompiler: " + dir
+								 + " is not a directory owned by the user and not writable by the others");
+	}
+
+	/*	Run input command, without a shell, with the output written on input file.
+		It returns the exit status of the command, -1 if it has not terminated normally. */
+	static int Execute (const vector<string>& command, const string& output_file)
+	{
+		//built before the fork, the child only calls async-signal-safe functions
+		vector<char*> argv;
+		for (auto& arg : command)
+			argv.push_back (const_cast<char*> (arg.c_str()));
+		argv.push_back (nullptr);
+
+		pid_t pid = fork();
+		if (pid < 0)
+			throw runtime_error ("JitCompiler: cannot start " + command[0]);
+
+		if (pid == 0)
+		{
+			int fd = open (output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+			if (fd >= 0)
+			{
+				dup2 (fd, STDOUT_FILENO);
+				dup2 (fd, STDERR_FILENO);
+				close (fd);
+			}
+			execvp (argv[0], argv.data());
+			_exit (127);
+		}
+
+		int status;
+		while (waitpid (pid, &status, 0) < 0)
+			if (errno != EINTR)
+				return -1;
+
+		return WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+	}
+
+	JitCompiler::JitCompiler (const string& compiler,
+							  const string& flags,
+							  const string& cache_dir) :
+		_compiler (compiler),
+		_flags (flags),
+		_cache_dir (cache_dir)
+	{}
+
+	string JitCompiler::Hash (const string& source) const
+	{
+		//64 bit FNV-1a, stable across runs and platforms
+		uint64_t hash = 14695981039346656037ULL;
+		for (auto c : this->_compiler + '\n' + this->_flags + '\n' + source)
+		{
+			hash ^= static_cast<unsigned char> (c);
+			hash *= 1099511628211ULL;
+		}
+
+		ostringstream result;
+		result << hex << setw (16) << setfill ('0') << hash;
+		return result.str();
+	}
+
+	string JitCompiler::DefaultCacheDirectory()
+	{
+		const char* cache_home = getenv ("XDG_CACHE_HOME");
+		if (cache_home && cache_home[0] == '/')
+			return string (cache_home) + "/binary_adapt_jit";
+
+		const char* home = getenv ("HOME");
+		if (home && home[0] == '/')
+			return string (home) + "/.cache/binary_adapt_jit";
+
+		return "";
+	}
+
+	string JitCompiler::CacheDirectory() const
+	{
+		if (!this->_cache_dir.empty())
+		{
+			MakePrivateDirectory (this->_cache_dir);
+			return this->_cache_dir;
+		}
+
+		string dir = DefaultCacheDirectory();
+		if (!dir.empty())
+		{
+			try
+			{
+				MakePrivateDirectory (dir);
+				return dir;
+			}
+			catch (runtime_error& e)
+			{
+				clog << "Warning: " << e.what() << ", a temporary directory will be used" << endl;
+			}
+		}
+
+		//created once by each process, the compiled objects are not kept across runs
+		static const string temporary_dir = [] ()
+		{
+			string name = "/tmp/binary_adapt_jit.XXXXXX";
+			if (!mkdtemp (&name[0]))
+				return string();
+			return name;
+		}();
+
+		if (temporary_dir.empty())
+			throw runtime_error ("JitCompiler: cannot create a temporary directory");
+
+		return temporary_dir;
+	}
+
+	string JitCompiler::SharedObject (const string& source) const
+	{
+		string dir = CacheDirectory();
+		string base = dir + "/" + Hash (source);
+		string so_file = base + ".so";
+
+		//a shared object which others can write could have been replaced, it is not loaded
+		struct stat buffer;
+		if (lstat (so_file.c_str(), &buffer) == 0)
+		{
+			if (!IsPrivate (so_file, false))
+				throw runtime_error ("JitCompiler: " + so_file
+									 + " is not a file owned by the user and not writable by the others");
+			return so_file;
+		}
+
+		/*	Files are written with a process dependent name, then renamed:
+			concurrent runs compiling the same expression do not see partial files */
+		string pid = to_string (getpid());
+		string src_file = base + "." + pid + ".cpp";
+		string tmp_file = base + "." + pid + ".so";
+		string log_file = base + ".log";
+
+		ofstream ofs (src_file);
+		if (!ofs)
+			throw runtime_error ("JitCompiler: cannot write " + src_file);
+		ofs << source;
+		ofs.close();
+
+		//the compiler and the flags are split at white spaces, no shell is involved
+		vector<string> command;
+		istringstream words (this->_compiler + " " + this->_flags);
+		for (string word; words >> word; )
+			command.push_back (word);
+		if (command.empty())
+			throw runtime_error ("JitCompiler: no compiler");
+
+		for (string arg : {"-shared", "-fPIC", "-o"})
+			command.push_back (arg);
+		command.push_back (tmp_file);
+		command.push_back (src_file);
+#ifdef DEBUG
+		cerr << "JitCompiler:";
+		for (auto& arg : command)
+			cerr << " " << arg;
+		cerr << endl;
+#endif //DEBUG
+		int status = Execute (command, log_file);
+		remove (src_file.c_str());
+
+		if (status != 0 || stat (tmp_file.c_str(), &buffer) != 0
+				|| chmod (tmp_file.c_str(), S_IRWXU) != 0)
+		{
+			remove (tmp_file.c_str());
+			throw runtime_error ("JitCompiler: compilation failed, see " + log_file);
+		}
+
+		if (rename (tmp_file.c_str(), so_file.c_str()) != 0)
+			throw runtime_error ("JitCompiler: cannot create " + so_file);
+
+		remove (log_file.c_str());
+		return so_file;
+	}
+
+} //namespace Functions
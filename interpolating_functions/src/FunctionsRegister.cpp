@@ -1,4 +1,6 @@
 #include "Functors.h"
+#include "CompiledFunctor.h"
+#include "GridFunctor.h"
 
 #include "BinaryTreeHelper.h"
 
@@ -23,10 +25,8 @@ namespace Functions
 		auto& f_one_d_factory (BinaryTree::FunctionsFactory<1>::Instance());
 		auto& f_two_d_factory (BinaryTree::FunctionsFactory<2>::Instance());
 
-		f_one_d_factory.add ("mu_parser_expr",
-							 &Helpers::Builders <ParserFunctor<1>,
-												 BinaryTree::Functor<1>
-												>::BuildObject);
+		f_one_d_factory.add ("mu_parser_expr", &BuildParsedFunctor<1>);
+		f_one_d_factory.add ("grid_data", &BuildGridFunctor<1>);
 		f_one_d_factory.add ("x_squared",
 							 &Helpers::Builders <XSquared,
 												 BinaryTree::Functor<1>
@@ -68,10 +68,8 @@ namespace Functions
 												 BinaryTree::Functor<1>
 												>::BuildObject);
 
-		f_two_d_factory.add ("mu_parser_expr",
-							 &Helpers::Builders <ParserFunctor<2>,
-												 BinaryTree::Functor<2>
-												>::BuildObject);
+		f_two_d_factory.add ("mu_parser_expr", &BuildParsedFunctor<2>);
+		f_two_d_factory.add ("grid_data", &BuildGridFunctor<2>);
 		f_two_d_factory.add ("x_squared_plus_y_squared",
 							 &Helpers::Builders <X2PlusY2,
 												 BinaryTree::Functor<2>
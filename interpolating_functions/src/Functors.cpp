@@ -6,6 +6,42 @@ using namespace std;
 
 namespace Functions
 {
+	vector<string> SplitProduct (const string& expr)
+	{
+		vector<string> factors (1);
+		int depth = 0;
+
+		for (auto c : expr)
+		{
+			if (c == '(')
+				++depth;
+			if (c == ')')
+				--depth;
+
+			if (depth == 0 && c == '*')
+			{
+				factors.push_back ("");
+				continue;
+			}
+
+			if (depth == 0 && string ("+-<>=!&|?:,").find (c) != string::npos)
+			{
+				//unary minus at the beginning of the factor
+				bool leading = factors.back().find_first_not_of (" \t") == string::npos;
+				if (c != '-' || !leading)
+					return vector<string>();
+			}
+
+			factors.back() += c;
+		}
+
+		for (auto& f : factors)
+			if (f.find_first_not_of (" \t") == string::npos)
+				return vector<string>();
+
+		return factors;
+	}
+
 	SqrtX::SqrtX() {}
 	SqrtX::~SqrtX() {}
 
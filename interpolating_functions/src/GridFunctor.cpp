@@ -0,0 +1,169 @@
+#include "GridFunctor.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h> //mmap, madvise
+#include <sys/stat.h> //fstat
+#include <fcntl.h> //open
+#include <unistd.h> //close, sysconf
+
+using namespace std;
+
+namespace Functions
+{
+	MappedFile::MappedFile (const string& file_name) : _fd (-1), _data (nullptr), _size (0)
+	{
+		this->_fd = open (file_name.c_str(), O_RDONLY);
+		if (this->_fd < 0)
+			throw runtime_error ("MappedFile: cannot open " + file_name);
+
+		struct stat info;
+		if (fstat (this->_fd, &info) != 0 || info.st_size == 0)
+		{
+			close (this->_fd);
+			throw runtime_error ("MappedFile: cannot read the size of " + file_name);
+		}
+		this->_size = static_cast<size_t> (info.st_size);
+
+		void* data = mmap (nullptr, this->_size, PROT_READ, MAP_SHARED, this->_fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close (this->_fd);
+			throw runtime_error ("MappedFile: cannot map " + file_name);
+		}
+		this->_data = static_cast<char*> (data);
+
+		//quadrature nodes are scattered: the default readahead would load unused pages
+		madvise (this->_data, this->_size, MADV_RANDOM);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		munmap (this->_data, this->_size);
+		close (this->_fd);
+	}
+
+	const char* MappedFile::Data() const
+	{
+		return this->_data;
+	}
+
+	size_t MappedFile::Size() const
+	{
+		return this->_size;
+	}
+
+	void MappedFile::Prefetch (size_t offset, size_t length) const
+	{
+		if (offset >= this->_size)
+			return;
+
+		static const size_t page = static_cast<size_t> (sysconf (_SC_PAGESIZE));
+		size_t begin = offset - offset % page;
+		size_t end = min (offset + length, this->_size);
+
+		madvise (this->_data + begin, end - begin, MADV_WILLNEED);
+	}
+
+	/*	Little-endian encoding helpers */
+	template <typename T>
+	static T ReadLittleEndian (const char* ptr)
+	{
+		unsigned char bytes[sizeof (T)];
+		memcpy (bytes, ptr, sizeof (T));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+		reverse (bytes, bytes + sizeof (T));
+#endif
+		T value;
+		memcpy (&value, bytes, sizeof (T));
+		return value;
+	}
+
+	template <typename T>
+	static void WriteLittleEndian (ostream& os, T value)
+	{
+		char bytes[sizeof (T)];
+		memcpy (bytes, &value, sizeof (T));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+		reverse (bytes, bytes + sizeof (T));
+#endif
+		os.write (bytes, sizeof (T));
+	}
+
+	static const string grid_magic = "BAGRID01";
+
+	GridLayout ReadGridLayout (const MappedFile& file)
+	{
+		const char* data = file.Data();
+		size_t size = file.Size();
+
+		if (size < 16 || string (data, 8) != grid_magic)
+			throw runtime_error ("ReadGridLayout: not a grid file");
+
+		GridLayout layout;
+		uint32_t dim = ReadLittleEndian<uint32_t> (data + 8);
+		layout.value_bytes = ReadLittleEndian<uint32_t> (data + 12);
+
+		if (layout.value_bytes != 4 && layout.value_bytes != 8)
+			throw runtime_error ("ReadGridLayout: values must be float or double");
+
+		layout.data_offset = 16 + 24 * static_cast<size_t> (dim);
+		if (!dim || size < layout.data_offset)
+			throw runtime_error ("ReadGridLayout: truncated header");
+
+		size_t values = 1;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			const char* ptr = data + 16 + 24 * d;
+			layout.n.push_back (ReadLittleEndian<uint64_t> (ptr));
+			layout.lower.push_back (ReadLittleEndian<double> (ptr + 8));
+			layout.upper.push_back (ReadLittleEndian<double> (ptr + 16));
+
+			if (layout.n.back() < 2 || !(layout.upper.back() > layout.lower.back()))
+				throw runtime_error ("ReadGridLayout: each direction needs at least two samples and a non empty range");
+			values *= layout.n.back();
+		}
+
+		if (size < layout.data_offset + values * layout.value_bytes)
+			throw runtime_error ("ReadGridLayout: the file is shorter than the values it declares");
+
+		return layout;
+	}
+
+	void WriteGridFile (const string& file_name, const GridLayout& layout, const vector<double>& values)
+	{
+		size_t dim = layout.n.size();
+		size_t size = 1;
+		for (auto n : layout.n)
+			size *= n;
+
+		if (layout.lower.size() != dim || layout.upper.size() != dim || values.size() != size)
+			throw length_error ("WriteGridFile: layout and values sizes do not match");
+		if (layout.value_bytes != 4 && layout.value_bytes != 8)
+			throw runtime_error ("WriteGridFile: values must be float or double");
+
+		ofstream ofs (file_name, ios::binary);
+		if (!ofs)
+			throw runtime_error ("WriteGridFile: cannot open " + file_name);
+
+		ofs.write (grid_magic.data(), 8);
+		WriteLittleEndian<uint32_t> (ofs, static_cast<uint32_t> (dim));
+		WriteLittleEndian<uint32_t> (ofs, layout.value_bytes);
+		for (size_t d = 0; d < dim; ++d)
+		{
+			WriteLittleEndian<uint64_t> (ofs, layout.n[d]);
+			WriteLittleEndian<double> (ofs, layout.lower[d]);
+			WriteLittleEndian<double> (ofs, layout.upper[d]);
+		}
+
+		for (auto v : values)
+			if (layout.value_bytes == 4)
+				WriteLittleEndian<float> (ofs, static_cast<float> (v));
+			else
+				WriteLittleEndian<double> (ofs, v);
+
+		if (!ofs)
+			throw runtime_error ("WriteGridFile: error writing " + file_name);
+	}
+
+} //namespace Functions
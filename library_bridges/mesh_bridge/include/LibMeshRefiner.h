@@ -83,6 +83,14 @@ namespace LibmeshBinary
 		**/
 		void Init (std::string);
 
+		/**
+			Overloaded version of previous Init method for several functors,
+			see BinaryTree::MeshRefiner::Init().
+		**/
+		void Init (const std::vector<std::string>&,
+				   const std::vector<double>& weights = {},
+				   BinaryTree::ErrorCombination = BinaryTree::SumOfSquares);
+
 		/**
 			Implementation of mesh export on file.
 			Declared pure virtual in base class.
@@ -206,6 +214,15 @@ namespace LibmeshBinary
 			std::move (f_factory.create (functor_id)));
 	}
 
+	template <size_t dim>
+	void LibmeshRefiner<dim>::Init (const std::vector<std::string>& functor_ids,
+									const std::vector<double>& weights,
+									BinaryTree::ErrorCombination combination)
+	{
+		BinaryTree::MeshRefiner<dim>::Init (
+			this->CreateFunctorSet (functor_ids, weights, combination));
+	}
+
 	template <size_t dim>
 	void LibmeshRefiner<dim>::SetMesh (std::shared_ptr<libMesh::MeshBase> mesh_ptr)
 	{
@@ -214,8 +231,11 @@ namespace LibmeshBinary
 		this->_mesh_refinement_ptr =
 			Helpers::MakeUnique<libMesh::MeshRefinement> (*(this->_mesh_ptr));
 
-		BinarityMap::MakeBinary<dim> (* (this->_mesh_refinement_ptr),
-									  this->_objective_function);
+		this->BatchedInit ([this] ()
+		{
+			BinarityMap::MakeBinary<dim> (* (this->_mesh_refinement_ptr),
+										  this->_objective_function);
+		});
 		InitializeGodfather();
 		this->_mesh_initialized = true;
 	}
@@ -42,6 +42,7 @@ namespace PluginLoading
 		 	Add shared object to plugin list.
 			File name passed as absolute path.
 		 	The loading sequence will reflect the order of the add invocation.
+			A shared object already added is skipped.
 		**/
 		void Add (const std::string&, int mode = RTLD_LAZY);
 
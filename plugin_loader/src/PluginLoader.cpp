@@ -27,13 +27,16 @@ namespace PluginLoading
 
 	void PluginLoader::Add (const std::string& full_path_so_file, int mode)
 	{
+		//a plugin already added is not added again, so it is loaded once
+		for (auto& p_ptr : this->_plugins)
+			if (p_ptr->File() == full_path_so_file)
+				return;
+
 		if (this->_loaded)
 			cerr << "Warning: "
 				 << "adding a plugin, but the Load() has already been called"
 				 << endl;
 
-		//TODO: add the check that this plugin has not already been added;
-
 		_plugins.push_back (
 			Helpers::MakeUnique<Plugin> (full_path_so_file, mode));
 
@@ -2,6 +2,8 @@
 
 #include "BinaryTreeHelper.h"
 
+#include <algorithm> //std::find
+
 using namespace std;
 
 namespace LibmeshBinary
@@ -32,10 +34,14 @@ namespace LibmeshBinary
 												 Geometry::QuadratureRuleInterface<2>
 												>::BuildObject);
 
-		q_two_d_factory.add (Geometry::TriangleType,
-							 &Helpers::Builders <ModifiedTriangleRule,
-												 Geometry::QuadratureRuleInterface<2>
-												>::BuildObject);
+		/*	The triangle rule of the library chosen for triangles, loaded first
+			by BinaryTree::Init(), is not overwritten by the ipercube library */
+		auto triangle_rules = q_two_d_factory.registered();
+		if (find (triangle_rules.begin(), triangle_rules.end(), Geometry::TriangleType) == triangle_rules.end())
+			q_two_d_factory.add (Geometry::TriangleType,
+								 &Helpers::Builders <ModifiedTriangleRule,
+													 Geometry::QuadratureRuleInterface<2>
+													>::BuildObject);
 
 	}
 } //namespace LibmeshBinary
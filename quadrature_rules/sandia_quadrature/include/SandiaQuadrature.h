@@ -4,8 +4,13 @@
 #include "sandia_rules.hpp" //jacobi_compute
 
 #include "Quadrature.h" //ElementType
+#include "Maps.h" //StdTriMap
 #include "HelpFile.h" //Cfgfile
 
+#include <map>
+#include <array>
+#include <algorithm> //stable_sort
+
 /**
 	Quadrature rule implementation based on sandia_rules library
 **/
@@ -29,11 +34,112 @@ namespace SandiaQuadrature
 	Geometry::QuadWeightVec
 	TensorizeWeights (const Geometry::QuadWeightVec&);
 
+	/**
+		Path of sandia_quadrature/include/sandia_quadrature.conf configuration file.
+		It is defined here, so __FILE__ refers to this header location.
+	**/
+	inline string ConfigurationFile()
+	{
+		string thisfile = __FILE__;
+		return thisfile.substr (0, thisfile.find_last_of ('/'))
+			   + "/sandia_quadrature.conf";
+	}
+
+	/**
+		Read the order of exactness from the configuration file.
+	**/
+	size_t ConfiguredOrder();
+
+	/**
+		Grids of nodes available for the ipercube rule
+	**/
+	enum NodesGrid
+	{
+		TensorNodes,
+		SparseNodes,
+		NestedNodes
+	};
+
+	/**
+		Read from the configuration file the grid of nodes
+		of the ipercube rule.
+	**/
+	NodesGrid ConfiguredGrid();
+
+	/**
+		Number of nodes of a 1D Gaussian (or Gauss-Jacobi) rule exact up to input order
+	**/
+	size_t GaussNodesNumber (size_t order);
+
+	/**
+		Nodes and weights of the smallest Kronrod-Patterson rule
+		with exactness order not lower than input one.
+		Kronrod-Patterson rules have 1, 3, 7, ..., 511 nodes
+		and each of them contains the nodes of the previous ones.
+	**/
+	void PattersonRule (size_t order,
+						Geometry::QuadPointVec<1>&,
+						Geometry::QuadWeightVec&);
+
+	/**
+		Order of exactness of the Kronrod-Patterson rule with input number of nodes
+	**/
+	size_t PattersonOrder (size_t n);
+
+	/**
+		Binomial coefficient
+	**/
+	size_t Binomial (size_t n, size_t k);
+
+	/**
+		Compute the Smolyak sparse grid of @p dim dimensionality
+		exact for polynomials with total degree not higher than input order,
+		that is the space spanned by a TensorialBasis of the same degree.
+		The grid is computed by the combination technique:
+		if 1D rules of level i are exact until degree 2i - 1, the rule
+			sum over q - dim < |l| <= q of (-1)^(q - |l|) binomial(dim - 1, q - |l|) U_l1 x ... x U_ldim
+		with q = dim + k - 1 is exact until total degree 2k - 1.
+		1D rules are Kronrod-Patterson ones, so most of the nodes are shared
+		by different tensor products and they are merged.
+		Some weights may be negative.
+	**/
+	template <size_t dim>
+	void SparseGrid (size_t order,
+					 Geometry::QuadPointVec<dim>&,
+					 Geometry::QuadWeightVec&);
+
+
+	/**
+		Compute the nested family of tensorial grids of @p dim dimensionality
+		obtained from Kronrod-Patterson rules of 1, 3, 7, ... nodes,
+		until the first one exact for input order.
+		Nodes are sorted by the level they first appear in,
+		so the grid of level l is given by the first level_sizes[l] nodes;
+		the grid of level l is exact until degree level_orders[l] in each variable.
+		The weights of the last level are stored in @p weights,
+		the ones of the previous levels in @p level_weights.
+	**/
+	template <size_t dim>
+	void NestedGrid (size_t order,
+					 Geometry::QuadPointVec<dim>& points,
+					 Geometry::QuadWeightVec& weights,
+					 vector<size_t>& level_sizes,
+					 vector<size_t>& level_orders,
+					 vector<Geometry::QuadWeightVec>& level_weights);
+
 
 	//TODO: implement other possible nodes other than gaussian
 	/**
 		Quadrature rule class for the ipercube of @p dim dimensionality.
-		Nodes are Gaussian.
+		Nodes are Gaussian, obtained by tensorization of 1D counterparts;
+		alternatively, if "grid = sparse" is set in the configuration file,
+		nodes are the ones of the Smolyak sparse grid given by SparseGrid().
+		The sparse grid needs less nodes from dim = 3 on,
+		while in 2D, at the same order, it has as many nodes as the tensorial grid or more.
+		If "grid = nested" is set, nodes are the ones of the nested
+		Kronrod-Patterson grids given by NestedGrid(): they are more than the Gaussian ones,
+		but a projection can be computed on a coarse level and refined
+		by evaluating the function only on the nodes added by the next one.
 		Nodes and weights computation is based on external library
 		<a href="https://people.sc.fsu.edu/~jburkardt/cpp_src/sandia_rules/sandia_rules.html">link text</a>.
 	**/
@@ -49,9 +155,9 @@ namespace SandiaQuadrature
 		**/
 		SandiaQuadratureRule();
 		/**
-			constructor with needed exactness order
+			constructor with needed exactness order and grid of nodes
 		**/
-		SandiaQuadratureRule (size_t);
+		SandiaQuadratureRule (size_t, NodesGrid grid = TensorNodes);
 		/**
 			default destructor
 		**/
@@ -66,6 +172,37 @@ namespace SandiaQuadrature
 		**/
 		virtual Geometry::QuadWeightVec GetWeights() const override;
 
+		/**
+			Nodes are obtained by tensorization,
+			so the rule is tensorial, unless the sparse or the nested grid is used.
+		**/
+		virtual bool IsTensorial() const override;
+		/**
+			Get the gaussian nodes the rule is obtained from
+		**/
+		virtual Geometry::QuadPointVec<1> OneDPoints() const override;
+		/**
+			Get the gaussian weights the rule is obtained from
+		**/
+		virtual Geometry::QuadWeightVec OneDWeights() const override;
+
+		/**
+			The rule is nested if the nested grid is used
+		**/
+		virtual bool IsNested() const override;
+		/**
+			Get the number of nodes of each level of the nested grid
+		**/
+		virtual vector<size_t> LevelSizes() const override;
+		/**
+			Get the order of exactness of each level of the nested grid
+		**/
+		virtual vector<size_t> LevelOrders() const override;
+		/**
+			Get the weights of input level of the nested grid
+		**/
+		virtual Geometry::QuadWeightVec LevelWeights (size_t) const override;
+
 	  protected:
 		/**
 			Compute nodes and weights
@@ -78,6 +215,10 @@ namespace SandiaQuadrature
 		virtual size_t NodesNumber (size_t);
 
 	  private:
+		/**
+			The grid of nodes
+		**/
+		NodesGrid _grid;
 		/**
 			The number of nodes
 		**/
@@ -90,33 +231,120 @@ namespace SandiaQuadrature
 			The vector of quadrature weights
 		**/
 		Geometry::QuadWeightVec _weights;
+		/**
+			The 1D nodes the tensorial ones are obtained from
+		**/
+		Geometry::QuadPointVec<1> _one_d_points;
+		/**
+			The 1D weights the tensorial ones are obtained from
+		**/
+		Geometry::QuadWeightVec _one_d_weights;
+		/**
+			Number of nodes of each level of the nested grid
+		**/
+		vector<size_t> _level_sizes;
+		/**
+			Order of exactness of each level of the nested grid
+		**/
+		vector<size_t> _level_orders;
+		/**
+			Weights of each level of the nested grid but the last one
+		**/
+		vector<Geometry::QuadWeightVec> _level_weights;
+	};
+
+	/**
+		Quadrature rule class for the standard triangle co{(-1,-1),(1,-1),(-1,1)}.
+		It is obtained collapsing a tensorial rule on the standard square
+		through Geometry::StdTriMap (Duffy transformation):
+		nodes are Gaussian in the first direction,
+		while in the collapsed one they are Gauss-Jacobi nodes with weight (1 - y),
+		which absorbs the jacobian of the map.
+		Since nodes and weights are computed by sandia_rules library, any order is available.
+		The tensor structure is kept: if n is the number of 1D nodes,
+		the node of index i * n + j is the image through Geometry::StdTriMap
+		of the square node (GaussPoints()[i], JacobiPoints()[j]).
+	**/
+	class SandiaTriangleRule : public Geometry::QuadratureRuleInterface<2>
+	{
+	  public:
+		/**
+			constructor.
+			It gets the order from the same configuration file of SandiaQuadratureRule.
+		**/
+		SandiaTriangleRule();
+		/**
+			constructor with needed exactness order
+		**/
+		SandiaTriangleRule (size_t);
+		/**
+			default destructor
+		**/
+		virtual ~SandiaTriangleRule();
+
+		/**
+			Get quadrature nodes
+		**/
+		virtual Geometry::QuadPointVec<2> GetPoints() const override;
+		/**
+			Get quadrature weigths
+		**/
+		virtual Geometry::QuadWeightVec GetWeights() const override;
+
+		/**
+			Gaussian nodes in the not collapsed direction
+		**/
+		Geometry::QuadPointVec<1> GaussPoints() const;
+		/**
+			Gauss-Jacobi nodes in the collapsed direction
+		**/
+		Geometry::QuadPointVec<1> JacobiPoints() const;
+		/**
+			The tensorial nodes on the standard square, before the collapse
+		**/
+		Geometry::QuadPointVec<2> CollapsedPoints() const;
+
+	  protected:
+		/**
+			Compute nodes and weights
+		**/
+		virtual void Init();
+
+	  private:
+		/**
+			The number of 1D nodes
+		**/
+		size_t _n;
+		/**
+			The vector of quadrature nodes
+		**/
+		Geometry::QuadPointVec<2> _points;
+		/**
+			The vector of quadrature weights
+		**/
+		Geometry::QuadWeightVec _weights;
+		/**
+			Nodes of the not collapsed direction
+		**/
+		Geometry::QuadPointVec<1> _gauss_points;
+		/**
+			Nodes of the collapsed direction
+		**/
+		Geometry::QuadPointVec<1> _jacobi_points;
 	};
 
 	template <size_t dim>
-	SandiaQuadratureRule<dim>::SandiaQuadratureRule()
+	SandiaQuadratureRule<dim>::SandiaQuadratureRule() :
+		_grid (ConfiguredGrid())
 	{
-		string thisfile = __FILE__;
-		string conf_file = thisfile.substr (0, thisfile.find_last_of ('/'))
-						 + "/sandia_quadrature.conf";
-#ifdef DEBUG
-		cerr << "SandiaQuadratureRule: opening configuration file "
-			 << conf_file
-			 << endl;
-#endif //DEBUG
-
-		Helpers::Cfgfile cl(conf_file);
-		string order = "order";
-
-		this->_order = cl (order, 0);
-		if (!this->_order)
-			throw runtime_error (
-				"Unable to read the configuration file in SandiaQuadratureRule");
+		this->_order = ConfiguredOrder();
 
 		Init();
 	}
 
 	template <size_t dim>
-	SandiaQuadratureRule<dim>::SandiaQuadratureRule (size_t order)
+	SandiaQuadratureRule<dim>::SandiaQuadratureRule (size_t order, NodesGrid grid) :
+		_grid (grid)
 	{
 		this->_order = order;
 		Init();
@@ -138,9 +366,78 @@ namespace SandiaQuadrature
 		return this->_weights;
 	}
 
+	template <size_t dim>
+	bool SandiaQuadratureRule<dim>::IsTensorial() const
+	{
+		return this->_grid == TensorNodes;
+	}
+
+	template <size_t dim>
+	Geometry::QuadPointVec<1> SandiaQuadratureRule<dim>::OneDPoints() const
+	{
+		return this->_one_d_points;
+	}
+
+	template <size_t dim>
+	Geometry::QuadWeightVec SandiaQuadratureRule<dim>::OneDWeights() const
+	{
+		return this->_one_d_weights;
+	}
+
+	template <size_t dim>
+	bool SandiaQuadratureRule<dim>::IsNested() const
+	{
+		return this->_grid == NestedNodes;
+	}
+
+	template <size_t dim>
+	vector<size_t> SandiaQuadratureRule<dim>::LevelSizes() const
+	{
+		if (!IsNested())
+			return Geometry::QuadratureRuleInterface<dim>::LevelSizes();
+
+		return this->_level_sizes;
+	}
+
+	template <size_t dim>
+	vector<size_t> SandiaQuadratureRule<dim>::LevelOrders() const
+	{
+		if (!IsNested())
+			return Geometry::QuadratureRuleInterface<dim>::LevelOrders();
+
+		return this->_level_orders;
+	}
+
+	template <size_t dim>
+	Geometry::QuadWeightVec SandiaQuadratureRule<dim>::LevelWeights (size_t level) const
+	{
+		if (!IsNested())
+			return Geometry::QuadratureRuleInterface<dim>::LevelWeights (level);
+
+		if (level + 1 == this->_level_sizes.size())
+			return this->_weights;
+
+		return this->_level_weights.at (level);
+	}
+
 	template <size_t dim>
 	void SandiaQuadratureRule<dim>::Init()
 	{
+		if (this->_grid == SparseNodes)
+		{
+			SparseGrid<dim> (this->_order, this->_points, this->_weights);
+			_n = this->_points.Size();
+			return;
+		}
+
+		if (this->_grid == NestedNodes)
+		{
+			NestedGrid<dim> (this->_order, this->_points, this->_weights,
+							 this->_level_sizes, this->_level_orders, this->_level_weights);
+			_n = this->_points.Size();
+			return;
+		}
+
 		_n = NodesNumber (this->_order);
 
 		double* x = new double[_n];
@@ -160,6 +457,8 @@ namespace SandiaQuadrature
 		//I tensorize to get a dim-dimensional quadrature rule
 		_points = TensorizePoints<dim> (one_d_points);
 		_weights = TensorizeWeights<dim> (one_d_weights);
+		_one_d_points = one_d_points;
+		_one_d_weights = one_d_weights;
 
 		delete[] x;
 		delete[] w;
@@ -168,7 +467,7 @@ namespace SandiaQuadrature
 	template <size_t dim>
 	size_t SandiaQuadratureRule<dim>::NodesNumber (size_t order)
 	{
-		return ceil ((static_cast<double> (order) + 1) / 2);
+		return GaussNodesNumber (order);
 	}
 
 	template <size_t dim>
@@ -221,6 +520,206 @@ namespace SandiaQuadrature
 	Geometry::QuadWeightVec
 	TensorizeWeights<1> (const Geometry::QuadWeightVec& one_d_w);
 
+	template <size_t dim>
+	void SparseGrid (size_t order,
+					 Geometry::QuadPointVec<dim>& points,
+					 Geometry::QuadWeightVec& weights)
+	{
+		size_t k = GaussNodesNumber (order);
+		size_t q = dim + k - 1;
+
+		//1D rules: the one of level i is exact until degree 2i - 1
+		vector<Geometry::QuadPointVec<1>> level_points (k + 1);
+		vector<Geometry::QuadWeightVec> level_weights (k + 1);
+		for (size_t i = 1; i <= k; ++i)
+			PattersonRule (2 * i - 1, level_points[i], level_weights[i]);
+
+		/*	Nodes shared by different tensor products are merged,
+			so they are identified by their coordinates rounded to 1E-12 */
+		using Key = array<long long, dim>;
+		map<Key, pair<Geometry::Point<dim>, double>> grid;
+
+		//levels of each direction, from (1, ..., 1) to (k, ..., k)
+		array<size_t, dim> levels;
+		levels.fill (1);
+		bool levels_end = false;
+		while (!levels_end)
+		{
+			size_t sum = 0;
+			for (auto l : levels)
+				sum += l;
+
+			if (sum + dim > q && sum <= q)
+			{
+				double coeff = static_cast<double> (Binomial (dim - 1, q - sum));
+				if ((q - sum) % 2)
+					coeff = -coeff;
+
+				//nodes of the tensor product of the 1D rules with these levels
+				array<size_t, dim> ind;
+				ind.fill (0);
+				bool ind_end = false;
+				while (!ind_end)
+				{
+					Geometry::Point<dim> p;
+					Key key;
+					double w = coeff;
+					for (size_t j = 0; j < dim; ++j)
+					{
+						p[j] = level_points[levels[j]][ind[j]][0];
+						key[j] = llround (p[j] * 1E12);
+						w *= level_weights[levels[j]][ind[j]];
+					}
+
+					auto inserted = grid.insert (make_pair (key, make_pair (p, w)));
+					if (!inserted.second)
+						inserted.first->second.second += w;
+
+					ind_end = true;
+					for (size_t j = dim; j-- > 0 && ind_end;)
+						if (++ind[j] < level_points[levels[j]].Size())
+							ind_end = false;
+						else
+							ind[j] = 0;
+				}
+			}
+
+			levels_end = true;
+			for (size_t j = dim; j-- > 0 && levels_end;)
+				if (++levels[j] <= k)
+					levels_end = false;
+				else
+					levels[j] = 1;
+		}
+
+		//weights of merged nodes may cancel out
+		size_t n = 0;
+		for (auto& node : grid)
+			if (abs (node.second.second) > 1E-14)
+				++n;
+
+		points = Geometry::QuadPointVec<dim> (n);
+		weights = Geometry::QuadWeightVec (n);
+		size_t cont = 0;
+		for (auto& node : grid)
+			if (abs (node.second.second) > 1E-14)
+			{
+				points.Insert (cont, node.second.first);
+				weights[cont++] = node.second.second;
+			}
+	}
+
+	template <size_t dim>
+	void NestedGrid (size_t order,
+					 Geometry::QuadPointVec<dim>& points,
+					 Geometry::QuadWeightVec& weights,
+					 vector<size_t>& level_sizes,
+					 vector<size_t>& level_orders,
+					 vector<Geometry::QuadWeightVec>& level_weights)
+	{
+		//1D rules, from 1 node until the first one exact for order
+		vector<Geometry::QuadPointVec<1>> one_d_points;
+		vector<Geometry::QuadWeightVec> one_d_weights;
+		level_orders.clear();
+		do
+		{
+			one_d_points.emplace_back();
+			one_d_weights.emplace_back();
+			size_t level_order = level_orders.empty() ? 1 : 2 * level_orders.back() + 1;
+			PattersonRule (level_order, one_d_points.back(), one_d_weights.back());
+			level_orders.push_back (PattersonOrder (one_d_points.back().Size()));
+		}
+		while (level_orders.back() < order);
+
+		size_t levels = level_orders.size();
+		auto& top_points = one_d_points.back();
+		size_t n = top_points.Size();
+
+		/*	For each node of the last 1D rule, the level it first appears in
+			and its position in the rules of that level and of the following ones */
+		vector<size_t> first_level (n, levels - 1);
+		vector<vector<size_t>> position (levels, vector<size_t> (n, 0));
+		for (size_t l = 0; l < levels; ++l)
+		{
+			map<long long, size_t> level_nodes;
+			for (size_t i = 0; i < one_d_points[l].Size(); ++i)
+				level_nodes[llround (one_d_points[l][i][0] * 1E12)] = i;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				auto found = level_nodes.find (llround (top_points[i][0] * 1E12));
+				if (found == level_nodes.end())
+					continue;
+
+				position[l][i] = found->second;
+				if (first_level[i] > l)
+					first_level[i] = l;
+			}
+		}
+
+		//tensorial indexes of dim-dimensional nodes, sorted by level
+		size_t total = 1;
+		for (size_t j = 0; j < dim; ++j)
+			total *= n;
+
+		vector<array<size_t, dim>> nodes (total);
+		vector<size_t> node_level (total, 0);
+		for (size_t k = 0; k < total; ++k)
+		{
+			size_t rest = k;
+			for (size_t j = dim; j-- > 0;)
+			{
+				nodes[k][j] = rest % n;
+				rest /= n;
+				node_level[k] = max (node_level[k], first_level[nodes[k][j]]);
+			}
+		}
+
+		vector<size_t> sorted (total);
+		for (size_t k = 0; k < total; ++k)
+			sorted[k] = k;
+		stable_sort (sorted.begin(), sorted.end(),
+					 [&node_level] (size_t a, size_t b)
+		{
+			return node_level[a] < node_level[b];
+		});
+
+		level_sizes.assign (levels, 0);
+		for (size_t l = 0; l < levels; ++l)
+		{
+			level_sizes[l] = 1;
+			for (size_t j = 0; j < dim; ++j)
+				level_sizes[l] *= one_d_points[l].Size();
+		}
+
+		points = Geometry::QuadPointVec<dim> (total);
+		for (size_t k = 0; k < total; ++k)
+		{
+			Geometry::Point<dim> p;
+			for (size_t j = 0; j < dim; ++j)
+				p[j] = top_points[nodes[sorted[k]][j]][0];
+			points.Insert (k, p);
+		}
+
+		//weights of each level are products of the 1D weights of that level
+		level_weights.clear();
+		for (size_t l = 0; l < levels; ++l)
+		{
+			Geometry::QuadWeightVec w (level_sizes[l]);
+			for (size_t k = 0; k < level_sizes[l]; ++k)
+			{
+				w[k] = 1;
+				for (size_t j = 0; j < dim; ++j)
+					w[k] *= one_d_weights[l][position[l][nodes[sorted[k]][j]]];
+			}
+
+			if (l + 1 < levels)
+				level_weights.push_back (w);
+			else
+				weights = w;
+		}
+	}
+
 } //namespace SandiaQuadrature
 
 #endif //__SANDIA_QUADRATURE_H
@@ -15,4 +15,177 @@ namespace SandiaQuadrature
 	{
 		return one_d_w;
 	}
+
+	size_t ConfiguredOrder()
+	{
+		string conf_file = ConfigurationFile();
+#ifdef DEBUG
+		cerr << "SandiaQuadrature: opening configuration file "
+			 << conf_file
+			 << endl;
+#endif //DEBUG
+
+		Helpers::Cfgfile cl(conf_file);
+		string order = "order";
+
+		size_t result = cl (order, 0);
+		if (!result)
+			throw runtime_error (
+				"Unable to read the configuration file in SandiaQuadrature");
+
+		return result;
+	}
+
+	NodesGrid ConfiguredGrid()
+	{
+		Helpers::Cfgfile cl(ConfigurationFile());
+		string grid = cl ("grid", string ("tensor"));
+
+		if (grid == "tensor")
+			return TensorNodes;
+		if (grid == "sparse")
+			return SparseNodes;
+		if (grid == "nested")
+			return NestedNodes;
+
+		throw invalid_argument (
+			"Unknown grid " + grid + " in the configuration file of SandiaQuadrature");
+	}
+
+	size_t GaussNodesNumber (size_t order)
+	{
+		return ceil ((static_cast<double> (order) + 1) / 2);
+	}
+
+	void PattersonRule (size_t order,
+						Geometry::QuadPointVec<1>& points,
+						Geometry::QuadWeightVec& weights)
+	{
+		//a rule with n > 1 nodes is exact until degree (3n + 1) / 2
+		size_t n = 1;
+		while (PattersonOrder (n) < order)
+		{
+			n = 2 * n + 1;
+			if (n > 511)
+				throw range_error (
+					"Kronrod-Patterson rules are available until order 767");
+		}
+
+		unique_ptr<double[]> x (new double[n]);
+		unique_ptr<double[]> w (new double[n]);
+		webbur::patterson_lookup (n, x.get(), w.get());
+
+		points = Geometry::QuadPointVec<1> (n);
+		weights = Geometry::QuadWeightVec (n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			points.Insert (i, x[i]);
+			weights[i] = w[i];
+		}
+	}
+
+	size_t PattersonOrder (size_t n)
+	{
+		return n > 1 ? (3 * n + 1) / 2 : 1;
+	}
+
+	size_t Binomial (size_t n, size_t k)
+	{
+		if (k > n)
+			return 0;
+
+		size_t result = 1;
+		for (size_t i = 1; i <= k; ++i)
+			result = result * (n - k + i) / i;
+
+		return result;
+	}
+
+	SandiaTriangleRule::SandiaTriangleRule()
+	{
+		this->_order = ConfiguredOrder();
+		Init();
+	}
+
+	SandiaTriangleRule::SandiaTriangleRule (size_t order)
+	{
+		this->_order = order;
+		Init();
+	}
+
+	SandiaTriangleRule::~SandiaTriangleRule()
+	{}
+
+	Geometry::QuadPointVec<2> SandiaTriangleRule::GetPoints() const
+	{
+		return this->_points;
+	}
+
+	Geometry::QuadWeightVec SandiaTriangleRule::GetWeights() const
+	{
+		return this->_weights;
+	}
+
+	Geometry::QuadPointVec<1> SandiaTriangleRule::GaussPoints() const
+	{
+		return this->_gauss_points;
+	}
+
+	Geometry::QuadPointVec<1> SandiaTriangleRule::JacobiPoints() const
+	{
+		return this->_jacobi_points;
+	}
+
+	Geometry::QuadPointVec<2> SandiaTriangleRule::CollapsedPoints() const
+	{
+		Geometry::QuadPointVec<2> result (this->_n * this->_n);
+
+		size_t cont = 0;
+		for (size_t i = 0; i < this->_n; ++i)
+			for (size_t j = 0; j < this->_n; ++j)
+				result.Insert (cont++, this->_gauss_points[i].Tensor (this->_jacobi_points[j]));
+
+		return result;
+	}
+
+	void SandiaTriangleRule::Init()
+	{
+		_n = GaussNodesNumber (this->_order);
+
+		unique_ptr<double[]> x (new double[_n]);
+		unique_ptr<double[]> w (new double[_n]);
+		unique_ptr<double[]> y (new double[_n]);
+		unique_ptr<double[]> v (new double[_n]);
+
+		//Gauss-Legendre nodes in the first direction
+		webbur::jacobi_compute (_n, 0.0, 0.0, x.get(), w.get());
+		//Gauss-Jacobi nodes with weight (1 - y) in the collapsed one
+		webbur::jacobi_compute (_n, 1.0, 0.0, y.get(), v.get());
+
+		this->_gauss_points = Geometry::QuadPointVec<1> (_n);
+		this->_jacobi_points = Geometry::QuadPointVec<1> (_n);
+		for (size_t i = 0; i < _n; ++i)
+		{
+			this->_gauss_points.Insert (i, x[i]);
+			this->_jacobi_points.Insert (i, y[i]);
+		}
+
+		/*
+			The jacobian of StdTriMap is (1 - y) / 2:
+			the factor (1 - y) is in Gauss-Jacobi weights,
+			so only 1/2 is left.
+		*/
+		Geometry::StdTriMap collapse;
+		auto square_points = CollapsedPoints();
+
+		this->_points = Geometry::QuadPointVec<2> (_n * _n);
+		this->_weights = Geometry::QuadWeightVec (_n * _n);
+		for (size_t i = 0; i < _n; ++i)
+			for (size_t j = 0; j < _n; ++j)
+			{
+				size_t k = i * _n + j;
+				this->_points.Insert (k, collapse.Evaluate (square_points[k]));
+				this->_weights[k] = w[i] * v[j] / 2;
+			}
+	}
 } //namespace SandiaQuadrature
@@ -2,6 +2,8 @@
 
 #include "BinaryTreeHelper.h"
 
+#include <algorithm> //std::find
+
 using namespace std;
 
 namespace SandiaQuadrature
@@ -21,6 +23,7 @@ namespace SandiaQuadrature
 	{
 		auto& q_one_d_factory (Geometry::QuadratureFactory<1>::Instance());
 		auto& q_two_d_factory (Geometry::QuadratureFactory<2>::Instance());
+		auto& q_three_d_factory (Geometry::QuadratureFactory<3>::Instance());
 
 		q_one_d_factory.add (Geometry::IntervalType,
 							 &Helpers::Builders <SandiaQuadratureRule<1>,
@@ -30,6 +33,19 @@ namespace SandiaQuadrature
 							 &Helpers::Builders <SandiaQuadratureRule<2>,
 												 Geometry::QuadratureRuleInterface<2>
 												>::BuildObject);
+
+		/*	The triangle rule of the library chosen for triangles, loaded first
+			by BinaryTree::Init(), is not overwritten by the ipercube library */
+		auto triangle_rules = q_two_d_factory.registered();
+		if (find (triangle_rules.begin(), triangle_rules.end(), Geometry::TriangleType) == triangle_rules.end())
+			q_two_d_factory.add (Geometry::TriangleType,
+								 &Helpers::Builders <SandiaTriangleRule,
+													 Geometry::QuadratureRuleInterface<2>
+													>::BuildObject);
+		q_three_d_factory.add (Geometry::CubeType,
+							   &Helpers::Builders <SandiaQuadratureRule<3>,
+												   Geometry::QuadratureRuleInterface<3>
+												  >::BuildObject);
 	}
 } //namespace LibmeshBinary
 
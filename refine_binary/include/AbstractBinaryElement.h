@@ -2,8 +2,15 @@
 #define __ABSTRACT_BINARY_ELEMENT_H
 
 #include "BinaryNode.h"
+#include "FunctorSet.h"
 
 #include <limits> //numeric_limits::max()
+#include <cmath> //sqrt
+#include <vector>
+#include <functional> //std::function
+#include <algorithm> //std::copy
+#include <stdexcept> //std::out_of_range
+#include <string> //std::to_string
 
 namespace BinaryTree
 {
@@ -20,7 +27,11 @@ namespace BinaryTree
 	{
 	  public:
 
-		using CoeffVector = Geometry::ColumnVector;
+		/**
+			Up to 16 coefficients (p <= 15 in 1D, p <= 4 in 2D) are stored inside the object,
+			so no heap allocation is needed by elements with low p level.
+		**/
+		using CoeffVector = Geometry::SmallVector<16>;
 
 		/**
 			constructor
@@ -37,6 +48,11 @@ namespace BinaryTree
 		    It sets the e, e~, E, E~, q, S
 			parameters to their default values,
 		    i.e. the ones assumed by leaves.
+			If a SampleBatch is collecting, the samples needed by the projection
+			are requested to the batch, and the initialization
+			is completed when the batch is scattered.
+			If the projections are deferred, see DeferredProjections,
+			only the finite element is initialized.
 		**/
 		virtual void Init();
 
@@ -45,6 +61,62 @@ namespace BinaryTree
 		**/
 		virtual double ProjectionError();
 
+		/**
+			Add to input batch the quadrature points where _f has to be sampled
+			by the next projection error update, if they have not been sampled yet.
+			When the batch is scattered, the node stores the samples
+			and updates the projection error.
+			It returns false if no sample is needed, e.g. if the projection is separable,
+			and if _f is a FunctorSet, whose functions are evaluated together.
+		**/
+		virtual bool RequestSamples (SampleBatch<dim>&) override;
+
+		/**
+			Change _f.
+			Coefficients and samples are released, and the projection error
+			is marked as not updated, so it is computed when ProjectionError() is called.
+			The e~, E, E~, q parameters are left unchanged, see
+			DimensionedGodFather::RebuildParameters() to compute them again.
+		**/
+		virtual void SetFunctor (const FunctionPtr<dim>&) override;
+
+		/**
+			Estimate of the quadrature error on the squared projection error.
+			With a nested quadrature rule it is the difference between
+			the squared errors computed on the last two levels used,
+			as in Gauss-Kronrod rules; otherwise it is 0.
+		**/
+		double QuadratureErrorIndicator() const;
+
+		/**
+			Set the relative tolerance on QuadratureErrorIndicator().
+			With a nested quadrature rule, the projection error is computed
+			on coarser levels first and the following ones are used
+			only if the indicator is higher than this tolerance.
+			Default is 1E-3.
+		**/
+		static void QuadratureTolerance (double);
+
+		/**
+			Set the composite projection mode of the node.
+			If true, the projection on a node with children is computed
+			by the composite rule given by the quadrature rules of the children,
+			reusing the samples of _f they have already computed,
+			so raising the p level of an ancestor does not evaluate _f again.
+			Each node then keeps the samples of _f at its own quadrature points,
+			until it is compacted.
+			The children take the mode of their father when they are initialized,
+			so it is usually set on the whole tree by the refiner,
+			see MeshRefiner::CompositeProjections().
+			By default it is false.
+		**/
+		virtual void CompositeProjections (bool) override;
+
+		/**
+			Composite projection mode of the node
+		**/
+		virtual bool CompositeProjections() const override;
+
 		/**
 			Print the projection coefficients to standard output.
 		**/
@@ -69,6 +141,85 @@ namespace BinaryTree
 		**/
 		virtual Geometry::NodesVector<dim> Nodes() const override;
 
+		/**
+			Get the type of underlying geometry.
+		**/
+		virtual Geometry::ElementType GetType() const override;
+
+		/**
+			Get the basis type of underlying finite element.
+		**/
+		virtual BasisType GetFeType() const override;
+
+		/**
+			Get the projection coefficients, computing them if needed.
+		**/
+		virtual Geometry::VectorView ProjectionCoefficients() const override;
+
+		/**
+			Tell if the projection coefficients are stored, see DimensionedNode::StoresCoefficients().
+		**/
+		virtual bool StoresCoefficients() const override;
+
+		/**
+			Get the number of basis functions at input p level.
+		**/
+		virtual size_t BasisSize (size_t) const override;
+
+		/**
+			Get the projection errors at the p levels not higher than the current one,
+			see DimensionedNode::LowerProjectionErrors().
+			The projection coefficients are computed if needed.
+			If _f is a FunctorSet, the lower errors of the functions are combined
+			as the projection error.
+		**/
+		virtual std::vector<double> LowerProjectionErrors() override;
+
+		/**
+			Get the projection errors of the functions of _f, if it is a FunctorSet,
+			see DimensionedNode::FieldProjectionErrors().
+		**/
+		virtual std::vector<double> FieldProjectionErrors() override;
+
+		/**
+			Get the projection coefficients of the function of _f with input index, if it is a FunctorSet;
+			the ones of index 0 are ProjectionCoefficients().
+			They are computed again if the node has been compacted.
+			It raises an out_of_range exception if the index is not lower than the number of functions.
+		**/
+		Geometry::VectorView FieldCoefficients (size_t);
+
+		/**
+			Release the projection coefficients and the finite element map.
+			The projection error at current p level is kept,
+			so the node can still be used by the algorithm;
+			the released data are rebuilt on demand.
+			The coefficients are not updated incrementally then: when the p level is raised,
+			as for the ancestors of a bisected node, the map is initialized again
+			and all the coefficients are computed from the samples of _f,
+			not only the ones of the new basis functions;
+			the samples of a nested or composite rule are evaluated again too.
+			The node keeps the rebuilt data until it is compacted again, see Rebuilds().
+		**/
+		virtual void Compact() override;
+
+		/**
+			Number of times the node has been restored after Compact()
+		**/
+		virtual size_t Rebuilds() const override;
+
+		/**
+			Bytes of memory owned by the node, the underlying geometry excluded.
+		**/
+		virtual size_t ResidentBytes() const override;
+
+		/**
+			Set the projection error and the coefficients, see BinaryNode::RestoreProjection().
+			The coefficients are taken as computed without quadrature points,
+			so they are computed again if the projection error is updated.
+		**/
+		virtual void RestoreProjection (double, const Geometry::VectorView&) override;
+
 	  protected:
 		/**
 			Set the projection error.
@@ -77,9 +228,88 @@ namespace BinaryTree
 
 		/**
 			Compute the projection error in L^2 norm.
+			If the quadrature rule is nested, the error is computed starting
+			from the coarsest level exact for the squared basis functions,
+			then on the following levels, until the difference between
+			the last two errors is within the tolerance;
+			samples of _f on previous levels are reused.
 		**/
 		virtual void UpdateProjectionError();
 
+		/**
+			Compute the projection error when _f is a FunctorSet.
+			The quadrature points are mapped once and all the functions are evaluated on them;
+			each function is projected, and the projection error combines their errors.
+			The node stores the coefficients and the error of every function,
+			the ones of the first function as the ones of a single function,
+			and it keeps the samples as UpdateProjectionError() does.
+			With a nested quadrature rule the level is chosen as in UpdateProjectionError(),
+			looking at the combined error.
+		**/
+		void UpdateFieldsProjectionError (const FunctorSet<dim>&);
+
+		/**
+			Squared L2 distance between a function and its projection,
+			given the values of the function at the first quadrature points of a level
+			and the projection coefficients.
+			If the last parameter is not null, it stores there the integral of the squared function.
+		**/
+		double SquaredProjectionError (const Geometry::VectorView&,
+									   const Geometry::VectorView&,
+									   double* f_squared_integral = nullptr) const;
+
+		/**
+			As the public overload; the input function is called
+			after the projection error has been updated.
+		**/
+		bool RequestSamples (SampleBatch<dim>&, const std::function<void()>&);
+
+		/**
+			Set the e~, E, E~, q parameters from the projection error,
+			as the ones of a leaf.
+		**/
+		void InitLeafParameters();
+
+		/**
+			Coarsest level of the quadrature rule exact for the squared basis functions
+		**/
+		size_t FirstQuadLevel() const;
+
+		/**
+			Compute the projection coefficients and error through the composite rule
+			given by the children quadrature rules, as described in CompositeProjections().
+			It returns false, doing nothing, if the node has no children
+			or the composite mode is not set.
+		**/
+		bool UpdateCompositeProjectionError();
+
+		/**
+			Compute the projection coefficients and error from the 1D projections
+			of the factors of _f, see FiniteElements::AbstractFElement::SeparableProjection().
+			It returns false, doing nothing, if _f is not a separable functor
+			or the element does not support the separable projection.
+		**/
+		bool UpdateSeparableProjectionError();
+
+		/**
+			Compute the projection coefficients as UpdateSeparableProjectionError(),
+			without changing the projection error.
+			It returns the squared projection error,
+			or a negative value if the separable projection is not available.
+		**/
+		double ComputeSeparableCoefficients() const;
+
+		/**
+			_f as a separable functor, if the separable projection can be used,
+			otherwise nullptr.
+		**/
+		const SeparableFunctor<dim>* Separable() const;
+
+		/**
+			_f as a FunctorSet, if it has more than one function, otherwise nullptr.
+		**/
+		const FunctorSet<dim>* Fields() const;
+
 		/**
 		    Evaluate the interpolated function.
 		**/
@@ -90,6 +320,30 @@ namespace BinaryTree
 		    TODO: it assumes that the basis is orthogonal
 		**/
 		void ComputeCoefficients() const;
+		/**
+			Compute the coefficients of the projection,
+			given the values of _f at the quadrature points of the element.
+			If the values are less than the quadrature points,
+			the level of the rule with as many nodes is used.
+		**/
+		void ComputeCoefficients (const Geometry::VectorView&) const;
+
+		/**
+			Initialize the finite element again if it has been released by Compact().
+		**/
+		void Restore() const;
+
+		/**
+			Tell if the samples of _f have to be kept by the node,
+			i.e. if the quadrature rule is nested or the composite mode is set.
+		**/
+		bool KeepSamples() const;
+
+		/**
+			Values of _f at the quadrature points used by the last UpdateProjectionError().
+			They are stored by the node, so _f is evaluated only if they have been released.
+		**/
+		Geometry::VectorView Samples() const;
 
 	  protected:
 		/**
@@ -131,8 +385,71 @@ namespace BinaryTree
 			so it is labeled mutable.
 		**/
 		mutable CoeffVector _coeff;
+		/**
+			Number of quadrature points the coefficients have been computed with.
+			If the quadrature level changes, coefficients are computed again.
+		**/
+		mutable size_t _coeff_points;
+		/**
+			Quadrature level used by the last UpdateProjectionError().
+			Before the first one it is higher than any level, that is the whole rule is used.
+		**/
+		size_t _quad_level;
+		/**
+			Values of _f at the quadrature points, stored only if the rule is nested,
+			so raising the quadrature level only the added points are evaluated.
+		**/
+		mutable vector<double> _samples;
+		/**
+			The last computed QuadratureErrorIndicator()
+		**/
+		double _quadrature_indicator;
+		/**
+			Relative tolerance on the quadrature error indicator
+		**/
+		static double _quadrature_tolerance;
+		/**
+			Flag telling if the composite mode is set
+		**/
+		bool _composite_projections;
+		/**
+			Flag telling if the data have been released by Compact() and not rebuilt yet
+		**/
+		mutable bool _compacted;
+		/**
+			Number of times the data released by Compact() have been rebuilt
+		**/
+		mutable size_t _rebuilds;
+		/**
+			Data of the functions of _f, if it is a FunctorSet
+		**/
+		struct FieldsData
+		{
+			/**
+				values at the quadrature points of the functions after the first one,
+				function after function, each one at as many points as _samples
+			**/
+			vector<double> samples;
+			/**
+				projection coefficients of the functions after the first one,
+				function after function, each one with as many coefficients as the basis functions
+			**/
+			vector<double> coeff;
+			/**
+				projection errors of the functions
+			**/
+			vector<double> errors;
+		};
+		/**
+			Data of the functions of _f, allocated only if it is a FunctorSet,
+			so the other nodes pay a pointer
+		**/
+		unique_ptr<FieldsData> _fields;
 	};
 
+	template <size_t dim, BasisType FeType>
+	double AbstractBinaryElement<dim, FeType>::_quadrature_tolerance = 1E-3;
+
 	template <size_t dim, BasisType FeType>
 	AbstractBinaryElement<dim, FeType>
 	::AbstractBinaryElement (FunctionPtr<dim> f,
@@ -142,7 +459,15 @@ namespace BinaryTree
 		_f_element (el_ptr),
 		_projection_error (numeric_limits<double>::max()),
 		_error_updated (false),
-		_coeff ()
+		_coeff (),
+		_coeff_points (0),
+		_quad_level (numeric_limits<size_t>::max()),
+		_samples (),
+		_quadrature_indicator (0),
+		_composite_projections (false),
+		_compacted (false),
+		_rebuilds (0),
+		_fields()
 	{}
 
 	template <size_t dim, BasisType FeType>
@@ -154,8 +479,26 @@ namespace BinaryTree
 	{
 		_f_element->Init();
 
+		//the children are initialized after the bisection of their father
+		auto daddy = dynamic_cast<const DimensionedNode<dim>*> (this->Dad());
+		if (daddy)
+			this->_composite_projections = daddy->CompositeProjections();
+
+		if (DeferredProjections::Active())
+			return;
+
+		auto batch = SampleBatch<dim>::Collecting();
+		auto init_parameters = [this] () {InitLeafParameters();};
+		if (batch && RequestSamples (*batch, init_parameters))
+			return;
+
 		UpdateProjectionError();
+		InitLeafParameters();
+	}
 
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::InitLeafParameters()
+	{
 		BinaryNode* daddy = this->Dad();
 		daddy == nullptr ?
 		this->_tilde_error = this->_projection_error :							// *NOPAD*
@@ -177,6 +520,84 @@ namespace BinaryTree
 		return this->_projection_error;
 	}
 
+	template <size_t dim, BasisType FeType>
+	bool AbstractBinaryElement<dim, FeType>::RequestSamples (SampleBatch<dim>& batch)
+	{
+		return RequestSamples (batch, std::function<void()>());
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractBinaryElement<dim, FeType>::RequestSamples (SampleBatch<dim>& batch,
+															 const std::function<void()>& then)
+	{
+		if (Separable() || Fields())
+			return false;
+
+		//the composite projection uses the samples of the children
+		if (this->_composite_projections && this->Left() && this->Right())
+			return false;
+
+		Restore();
+
+		size_t sampled = this->_samples.size();
+		size_t n = this->_f_element->QuadLevelSize (FirstQuadLevel());
+		if (sampled >= n)
+			return false;
+
+		batch.Add (this->_f_element->QuadPointsCoordinates (sampled, n),
+				   [this, sampled, n, then] (const double* values)
+		{
+			//samples computed meanwhile are not overwritten
+			if (this->_samples.size() == sampled)
+				this->_samples.insert (this->_samples.end(), values, values + n - sampled);
+
+			UpdateProjectionError();
+			if (then)
+				then();
+		});
+
+		return true;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::SetFunctor (const FunctionPtr<dim>& f)
+	{
+		this->_f = f;
+		this->_error_updated = false;
+
+		//assigning an empty vector the memory is freed
+		this->_coeff = CoeffVector();
+		this->_coeff_points = 0;
+		vector<double>().swap (this->_samples);
+		this->_fields.reset();
+		this->_quad_level = numeric_limits<size_t>::max();
+		this->_quadrature_indicator = 0;
+	}
+
+	template <size_t dim, BasisType FeType>
+	double AbstractBinaryElement<dim, FeType>::QuadratureErrorIndicator() const
+	{
+		return this->_quadrature_indicator;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::QuadratureTolerance (double tol)
+	{
+		_quadrature_tolerance = tol;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::CompositeProjections (bool flag)
+	{
+		this->_composite_projections = flag;
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractBinaryElement<dim, FeType>::CompositeProjections() const
+	{
+		return this->_composite_projections;
+	}
+
 	template <size_t dim, BasisType FeType>
 	void AbstractBinaryElement<dim, FeType>::PrintCoefficients() const
 	{
@@ -203,6 +624,7 @@ namespace BinaryTree
 	const AbstractFElement<dim, FeType>&
 	AbstractBinaryElement<dim, FeType>::GetFElement()const
 	{
+		Restore();
 		return * (this->_f_element);
 	}
 
@@ -212,6 +634,157 @@ namespace BinaryTree
 		return this->_f_element->GetNodes();
 	}
 
+	template <size_t dim, BasisType FeType>
+	Geometry::ElementType AbstractBinaryElement<dim, FeType>::GetType() const
+	{
+		return this->_f_element->GetType();
+	}
+
+	template <size_t dim, BasisType FeType>
+	BasisType AbstractBinaryElement<dim, FeType>::GetFeType() const
+	{
+		return this->_f_element->GetFeType();
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::VectorView AbstractBinaryElement<dim, FeType>::ProjectionCoefficients() const
+	{
+		ComputeCoefficients();
+
+		//more coefficients than needed may be stored
+		return (this->_coeff).Head (this->_f_element->BasisSize());
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractBinaryElement<dim, FeType>::StoresCoefficients() const
+	{
+		//the coefficients are released with the finite element map
+		if (! (this->_coeff).Size())
+			return false;
+
+		Restore();
+		return (this->_coeff).Size() >= this->_f_element->BasisSize();
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractBinaryElement<dim, FeType>::BasisSize (size_t p) const
+	{
+		return this->_f_element->BasisSize (p);
+	}
+
+	template <size_t dim, BasisType FeType>
+	std::vector<double> AbstractBinaryElement<dim, FeType>::LowerProjectionErrors()
+	{
+		size_t p = PLevel();
+		auto fields = Fields();
+		size_t m = fields ? fields->Size() : 1;
+		auto errors = fields ? FieldProjectionErrors() : std::vector<double> (1, ProjectionError());
+
+		std::vector<std::vector<double>> squared_errors (p + 1, std::vector<double> (m));
+		for (size_t k = 0; k < m; ++k)
+		{
+			auto coeff = k ? FieldCoefficients (k) : ProjectionCoefficients();
+
+			//the terms dropped by each lower level are added to the squared error
+			double err_squared = errors[k] * errors[k];
+			size_t i = coeff.Size();
+			for (size_t level = p; ; --level)
+			{
+				squared_errors[level][k] = err_squared;
+				if (!level)
+					break;
+
+				for (size_t end = this->_f_element->BasisSize (level - 1); i > end; --i)
+					err_squared += coeff[i - 1] * coeff[i - 1] * this->_f_element->BasisNormSquared (i - 1);
+			}
+		}
+
+		std::vector<double> result (p + 1);
+		for (size_t level = 0; level <= p; ++level)
+			result[level] = sqrt (fields ? fields->CombineSquaredErrors (squared_errors[level])
+								  : squared_errors[level][0]);
+
+		return result;
+	}
+
+	template <size_t dim, BasisType FeType>
+	std::vector<double> AbstractBinaryElement<dim, FeType>::FieldProjectionErrors()
+	{
+		auto fields = Fields();
+		if (!fields)
+			return std::vector<double> (1, ProjectionError());
+
+		//the errors of the functions are not checkpointed, see RestoreProjection()
+		if (!this->_error_updated || !this->_fields || this->_fields->errors.size() != fields->Size())
+			UpdateFieldsProjectionError (*fields);
+
+		return this->_fields->errors;
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::VectorView AbstractBinaryElement<dim, FeType>::FieldCoefficients (size_t k)
+	{
+		auto fields = Fields();
+		if (k >= (fields ? fields->Size() : 1))
+			throw std::out_of_range ("No function with index " + std::to_string (k) + " projected on the node");
+
+		if (!k)
+			return ProjectionCoefficients();
+
+		Restore();
+		size_t basis_size = this->_f_element->BasisSize();
+		if (!this->_error_updated || !this->_fields || this->_fields->coeff.size() != (fields->Size() - 1) * basis_size)
+			UpdateFieldsProjectionError (*fields);
+
+		return Geometry::VectorView (this->_fields->coeff.data() + (k - 1) * basis_size, basis_size);
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::Compact()
+	{
+		//assigning an empty vector the coefficients memory is freed
+		this->_coeff = CoeffVector();
+		vector<double>().swap (this->_samples);
+		if (this->_fields)
+		{
+			//the errors are kept as the projection error
+			vector<double>().swap (this->_fields->samples);
+			vector<double>().swap (this->_fields->coeff);
+		}
+		this->_f_element->Release();
+		this->_compacted = true;
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractBinaryElement<dim, FeType>::ResidentBytes() const
+	{
+		return sizeof (AbstractBinaryElement<dim, FeType>)
+			   + this->_f_element->ResidentBytes()
+			   + (this->_coeff).HeapBytes()
+			   + (this->_samples).capacity() * sizeof (double)
+			   + (this->_fields ? sizeof (FieldsData)
+				  + (this->_fields->samples.capacity() + this->_fields->coeff.capacity()
+					 + this->_fields->errors.capacity()) * sizeof (double) : 0);
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::RestoreProjection (double error,
+																const Geometry::VectorView& coeff)
+	{
+		this->ProjectionError (error);
+		this->_error_updated = true;
+
+		this->_coeff = CoeffVector();
+		this->_coeff_points = 0;
+		this->_fields.reset();
+		if (coeff.Size())
+		{
+			(this->_coeff).Resize (coeff.Size());
+			for (size_t i = 0; i < coeff.Size(); ++i)
+				(this->_coeff)[i] = coeff[i];
+		}
+	}
+
 	template <size_t dim, BasisType FeType>
 	void AbstractBinaryElement<dim, FeType>::ProjectionError (const double& val)
 	{
@@ -221,44 +794,404 @@ namespace BinaryTree
 	template <size_t dim, BasisType FeType>
 	void AbstractBinaryElement<dim, FeType>::UpdateProjectionError()
 	{
+		if (UpdateSeparableProjectionError())
+			return;
+
+		if (auto fields = Fields())
+		{
+			UpdateFieldsProjectionError (*fields);
+			return;
+		}
+
+		if (UpdateCompositeProjectionError())
+			return;
+
+		Restore();
+
 		//TODO: let the error norm to be modifiable, maybe to be choosable at runtime
 		/*
-		    L2 norm of the interpolation error
+		    L2 norm of the interpolation error.
+		    _f is sampled only once at the quadrature points, the same samples
+		    are used to compute the coefficients and the error
 		*/
-//*INDENT-OFF*
+		size_t levels = this->_f_element->QuadLevels();
+		bool nested = levels > 1;
+
+		size_t first_level = FirstQuadLevel();
+
+		/*	samples are kept by the element only if they can be reused;
+			the ones received from a batch are used once otherwise */
+		bool keep = KeepSamples();
+		vector<double> local_samples;
+		auto& samples = keep || !this->_samples.empty() ? this->_samples : local_samples;
 
-		double err = this->_f_element->L2Norm
-					 (
-						 [&] (const Geometry::Point<dim>& p)
-						 {return (* (this->_f)) (p) - Projection (p);}
-					 );
-//*INDENT-ON*
+		size_t basis_size = this->_f_element->BasisSize();
+		double err_squared = 0;
+		double previous_err_squared = 0;
+		this->_quadrature_indicator = 0;
 
-		this->ProjectionError (err);
+		for (size_t level = first_level; ; ++level)
+		{
+			size_t n = this->_f_element->QuadLevelSize (level);
+			this->_f_element->SampleAtQuadPoints (* (this->_f), samples, n);
+			Geometry::VectorView f_values (samples.data(), n);
+
+			this->_quad_level = level;
+			ComputeCoefficients (f_values);
+
+			double f_squared_integral = 0;
+			err_squared = SquaredProjectionError (f_values, (this->_coeff).Head (basis_size),
+												  nested ? &f_squared_integral : nullptr);
+			if (!nested)
+				break;
+
+			/*	Kronrod-like estimate: the error on the previous level
+				is compared to the one on the current level, which contains its nodes.
+				Both are needed, since on the first level the projection
+				may interpolate _f and give a null error. */
+			if (level > first_level)
+			{
+				this->_quadrature_indicator = abs (err_squared - previous_err_squared);
+
+				double threshold = _quadrature_tolerance * err_squared
+								   + numeric_limits<double>::epsilon() * f_squared_integral;
+
+				if (this->_quadrature_indicator <= threshold)
+					break;
+			}
+
+			if (level + 1 == levels)
+				break;
+
+			previous_err_squared = err_squared;
+		}
+
+		if (!keep)
+			vector<double>().swap (this->_samples);
+
+		this->ProjectionError (sqrt (err_squared));
+		this->_error_updated = true;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::UpdateFieldsProjectionError (const FunctorSet<dim>& fields)
+	{
+		Restore();
+
+		size_t levels = this->_f_element->QuadLevels();
+		bool nested = levels > 1;
+		size_t first_level = FirstQuadLevel();
+
+		size_t m = fields.Size();
+		size_t basis_size = this->_f_element->BasisSize();
+
+		/*	the samples of the first function are stored as the ones of a single function,
+			the others at the same points function after function, see FieldsData;
+			they are kept by the element as in UpdateProjectionError() */
+		if (!this->_fields)
+			this->_fields.reset (new FieldsData());
+
+		bool keep = KeepSamples();
+		vector<double> local_samples, local_field_samples;
+		auto& samples = keep ? this->_samples : local_samples;
+		auto& field_samples = keep ? this->_fields->samples : local_field_samples;
+		if (field_samples.size() != (m - 1) * samples.size())
+		{
+			samples.clear();
+			field_samples.clear();
+		}
+
+		auto& fields_coeff = this->_fields->coeff;
+		fields_coeff.assign ((m - 1) * basis_size, 0);
+		vector<double> squared_errors (m);
+		double err_squared = 0;
+		double previous_err_squared = 0;
+		this->_quadrature_indicator = 0;
+
+		for (size_t level = first_level; ; ++level)
+		{
+			size_t n = this->_f_element->QuadLevelSize (level);
+			size_t sampled = samples.size();
+			if (n > sampled)
+			{
+				auto coordinates = this->_f_element->QuadPointsCoordinates (sampled, n);
+				vector<double> added ((n - sampled) * m);
+				fields.EvaluateAll (coordinates.data(), added.data(), n - sampled);
+
+				samples.insert (samples.end(), added.begin(), added.begin() + (n - sampled));
+
+				vector<double> all ((m - 1) * n);
+				for (size_t k = 1; k < m; ++k)
+				{
+					std::copy (field_samples.begin() + (k - 1) * sampled, field_samples.begin() + k * sampled,
+							   all.begin() + (k - 1) * n);
+					std::copy (added.begin() + k * (n - sampled), added.begin() + (k + 1) * (n - sampled),
+							   all.begin() + (k - 1) * n + sampled);
+				}
+				field_samples.swap (all);
+			}
+			size_t stride = samples.size();
+
+			double f_squared_integral = 0;
+			for (size_t k = 0; k < m; ++k)
+			{
+				Geometry::VectorView f_values (k ? field_samples.data() + (k - 1) * stride : samples.data(), n);
+
+				Geometry::VectorView coeff (nullptr, 0);
+				if (k == 0)
+				{
+					//the coefficients of the first function are the ones of a single function
+					this->_quad_level = level;
+					ComputeCoefficients (f_values);
+					coeff = (this->_coeff).Head (basis_size);
+				}
+				else
+				{
+					double* field_coeff = fields_coeff.data() + (k - 1) * basis_size;
+					auto prods = this->_f_element->L2ProdsWithBasis (f_values, 0, basis_size);
+					for (size_t i = 0; i < basis_size; ++i)
+						field_coeff[i] = prods[i] / this->_f_element->BasisNormSquared (i);
+					coeff = Geometry::VectorView (field_coeff, basis_size);
+				}
+
+				double f_squared = 0;
+				squared_errors[k] = SquaredProjectionError (f_values, coeff, nested ? &f_squared : nullptr);
+				f_squared_integral = std::max (f_squared_integral, f_squared);
+			}
+
+			err_squared = fields.CombineSquaredErrors (squared_errors);
+			if (!nested)
+				break;
+
+			//Kronrod-like estimate on the combined error, see UpdateProjectionError()
+			if (level > first_level)
+			{
+				this->_quadrature_indicator = abs (err_squared - previous_err_squared);
+
+				double threshold = _quadrature_tolerance * err_squared
+								   + numeric_limits<double>::epsilon() * f_squared_integral;
+
+				if (this->_quadrature_indicator <= threshold)
+					break;
+			}
+
+			if (level + 1 == levels)
+				break;
+
+			previous_err_squared = err_squared;
+		}
+
+		this->_fields->errors.resize (m);
+		for (size_t k = 0; k < m; ++k)
+			this->_fields->errors[k] = sqrt (squared_errors[k]);
+
+		this->ProjectionError (sqrt (err_squared));
 		this->_error_updated = true;
 	}
 
+	template <size_t dim, BasisType FeType>
+	double AbstractBinaryElement<dim, FeType>::SquaredProjectionError (const Geometry::VectorView& f_values,
+																	   const Geometry::VectorView& coeff,
+																	   double* f_squared_integral) const
+	{
+		size_t n = f_values.Size();
+		auto projection = this->_f_element->CombineBasisAtQuadPoints (coeff, n);
+
+		for (size_t q = 0; q < n; ++q)
+		{
+			double diff = f_values[q] - projection[q];
+			projection[q] = diff * diff;
+		}
+
+		if (f_squared_integral)
+		{
+			Geometry::ColumnVector f_squared (n);
+			for (size_t q = 0; q < n; ++q)
+				f_squared[q] = f_values[q] * f_values[q];
+
+			*f_squared_integral = this->_f_element->IntegrateQuadValues (f_squared.View());
+		}
+
+		return this->_f_element->IntegrateQuadValues (projection.View());
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractBinaryElement<dim, FeType>::FirstQuadLevel() const
+	{
+		size_t levels = this->_f_element->QuadLevels();
+
+		//the first level must be exact for the squared basis functions
+		size_t first_level = 0;
+		while (first_level + 1 < levels
+				&& this->_f_element->QuadLevelOrder (first_level) < 2 * this->PLevel())
+			++first_level;
+
+		return first_level;
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractBinaryElement<dim, FeType>::UpdateSeparableProjectionError()
+	{
+		double err_squared = ComputeSeparableCoefficients();
+		if (err_squared < 0)
+			return false;
+
+		this->_quadrature_indicator = 0;
+		this->ProjectionError (sqrt (err_squared));
+		this->_error_updated = true;
+
+		return true;
+	}
+
+	template <size_t dim, BasisType FeType>
+	double AbstractBinaryElement<dim, FeType>::ComputeSeparableCoefficients() const
+	{
+		auto separable = Separable();
+		if (!separable)
+			return -1;
+
+		Geometry::ColumnVector coeff (0);
+		double err_squared = this->_f_element->SeparableProjection (
+								 [separable] (size_t d, double x)
+		{
+			return separable->Factor (d, x);
+		}, coeff);
+
+		//all the coefficients are computed again, no quadrature points are used
+		size_t s = coeff.Size();
+		(this->_coeff).Resize (s);
+		this->_coeff_points = 0;
+		for (size_t i = 0; i < s; ++i)
+			(this->_coeff)[i] = coeff[i];
+
+		return err_squared;
+	}
+
+	template <size_t dim, BasisType FeType>
+	const SeparableFunctor<dim>* AbstractBinaryElement<dim, FeType>::Separable() const
+	{
+		auto separable = dynamic_cast<const SeparableFunctor<dim>*> (this->_f.get());
+		if (!separable || !separable->IsSeparable())
+			return nullptr;
+
+		Restore();
+		if (!this->_f_element->SeparableProjectionAvailable())
+			return nullptr;
+
+		return separable;
+	}
+
+	template <size_t dim, BasisType FeType>
+	const FunctorSet<dim>* AbstractBinaryElement<dim, FeType>::Fields() const
+	{
+		auto fields = dynamic_cast<const FunctorSet<dim>*> (this->_f.get());
+		if (!fields || fields->Size() < 2)
+			return nullptr;
+
+		return fields;
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractBinaryElement<dim, FeType>::UpdateCompositeProjectionError()
+	{
+		if (!this->_composite_projections)
+			return false;
+
+		using Element = AbstractBinaryElement<dim, FeType>;
+		Element* children[2] = {dynamic_cast<Element*> (this->Left()),
+								dynamic_cast<Element*> (this->Right())
+							   };
+
+		if (!children[0] || !children[1])
+			return false;
+
+		Restore();
+
+		size_t s = this->_f_element->BasisSize();
+		Geometry::ColumnVector prods (s);
+		for (size_t i = 0; i < s; ++i)
+			prods[i] = 0;
+
+		//the basis at the points of the children is shared by the products and the distance
+		vector<double> basis[2];
+		size_t n_points = 0;
+		for (size_t c = 0; c < 2; ++c)
+		{
+			auto samples = children[c]->Samples();
+			basis[c] = this->_f_element->BasisOnSubElement (children[c]->GetFElement(), samples.Size());
+			this->_f_element->AddL2ProdsOnSubElement (children[c]->GetFElement(), samples, basis[c], prods);
+			n_points += samples.Size();
+		}
+
+		//all the coefficients are computed again, with the composite rule points
+		(this->_coeff).Resize (s);
+		this->_coeff_points = n_points;
+		for (size_t i = 0; i < s; ++i)
+			(this->_coeff)[i] = prods[i] / this->_f_element->BasisNormSquared (i);
+
+		double err_squared = 0;
+		for (size_t c = 0; c < 2; ++c)
+			err_squared += this->_f_element->SquaredDistanceOnSubElement
+						   (children[c]->GetFElement(), children[c]->Samples(), basis[c], (this->_coeff).Head (s));
+
+		this->_quadrature_indicator = 0;
+		this->ProjectionError (sqrt (err_squared));
+		this->_error_updated = true;
+
+		return true;
+	}
+
 	template <size_t dim, BasisType FeType>
 	double AbstractBinaryElement<dim, FeType>::Projection
 	(const Geometry::Point<dim>& point) const
 	{
 		ComputeCoefficients();
 
-		CoeffVector basis_evaluation = this->_f_element->EvaluateBasis (point);
+		Geometry::Vector basis_evaluation = this->_f_element->EvaluateBasis (point);
 
 		size_t basis_size = basis_evaluation.Size();
 
 		//It may happen that I've stored more coefficients than needed
 		//so I take the "head" of the coeff vector
 		//i.e. the first basis_size coefficients
-		auto needed_coeff = (this->_coeff).Head (basis_size);
-
-		return basis_evaluation.Dot (needed_coeff);
+		return basis_evaluation.Dot ((this->_coeff).Head (basis_size));
 	}
 
 	template <size_t dim, BasisType FeType>
 	void AbstractBinaryElement<dim, FeType>::ComputeCoefficients() const
 	{
+		Restore();
+
+		if ((this->_coeff).Size() >= this->_f_element->BasisSize())
+			//Coefficients already computed
+			return;
+
+		if (ComputeSeparableCoefficients() >= 0)
+			return;
+
+		if (KeepSamples())
+		{
+			ComputeCoefficients (Samples());
+			return;
+		}
+
+		auto f_values = this->_f_element->EvaluateAtQuadPoints (* (this->_f));
+		ComputeCoefficients (f_values.View());
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::ComputeCoefficients
+	(const Geometry::VectorView& f_values) const
+	{
+		Restore();
+
+		//coefficients computed with a different quadrature level are discarded
+		if (this->_coeff_points != f_values.Size())
+		{
+			this->_coeff = CoeffVector();
+			this->_coeff_points = f_values.Size();
+		}
+
 		//I remember how many coefficients have been already computed
 		size_t cursor = (this->_coeff).Size();
 		//New number of coefficients
@@ -272,22 +1205,52 @@ namespace BinaryTree
 		(this->_coeff).Resize (s);
 
 		//I don't recompute already stored coefficients
-		for (; cursor < s; ++cursor)
+		auto prods = this->_f_element->L2ProdsWithBasis (f_values, cursor, s);
+
+		for (size_t i = cursor; i < s; ++i)
+		{
+			double norm_squared = this->_f_element->BasisNormSquared (i);
+
+			(this->_coeff)[i] = prods[i - cursor] / norm_squared;
+		}
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractBinaryElement<dim, FeType>::Restore() const
+	{
+		if (this->_compacted)
 		{
-			//*INDENT-OFF*
-			(this->_coeff)[cursor] = this->_f_element->L2Prod
-									 (
-										* (this->_f),
-										[this, cursor]
-										(const Geometry::Point<dim>& p)
-										{ return this->_f_element->EvaluateBasisFunction (cursor, p);}
-									 );
-			//*INDENT-ON*
-
-			double norm_squared = this->_f_element->BasisNormSquared (cursor);
-
-			(this->_coeff)[cursor] /= norm_squared;
+			this->_compacted = false;
+			++this->_rebuilds;
 		}
+
+		//it does nothing if the element is already initialized
+		this->_f_element->Init();
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractBinaryElement<dim, FeType>::Rebuilds() const
+	{
+		return this->_rebuilds;
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractBinaryElement<dim, FeType>::KeepSamples() const
+	{
+		Restore();
+		return this->_composite_projections || this->_f_element->QuadLevels() > 1;
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::VectorView AbstractBinaryElement<dim, FeType>::Samples() const
+	{
+		Restore();
+
+		size_t level = min (this->_quad_level, this->_f_element->QuadLevels() - 1);
+		size_t n = this->_f_element->QuadLevelSize (level);
+		this->_f_element->SampleAtQuadPoints (* (this->_f), this->_samples, n);
+
+		return Geometry::VectorView (this->_samples.data(), n);
 	}
 
 } //namespace BinaryTree
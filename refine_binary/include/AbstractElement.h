@@ -35,6 +35,7 @@ namespace Geometry
 			The quadrature nodes.
 			Method declared pure virtual, since quadrature nodes
 			depend on the ElementType of the object, which is unknown at this level.
+			They are returned by value, since mapped elements compute them.
 		**/
 		virtual QuadPointVec<dim> GetQuadPoints() const = 0;
 
@@ -109,7 +110,6 @@ namespace Geometry
 	const
 	{
 		QuadWeightVec weights = GetQuadWeights();
-		QuadWeightVec fval (weights.Size());
 		QuadPointVec<dim> nodes = GetQuadPoints();
 
 		//quadrature nodes and weights must have the same length
@@ -117,14 +117,19 @@ namespace Geometry
 			throw std::length_error
 			("Trying to integrate with different number of nodes and weights!");
 
+		/*	GetQuadPoints() and GetQuadWeights() return new vectors:
+			mapped elements compute them, standard elements copy their rule,
+			whose views are given by StdElement::QuadPointsView() and QuadWeightsView().
+			The loop reads them through views, without further copies */
+		auto w = weights.View();
+		auto x = nodes.View();
+
 		//TODO: can be optimized using weights simmetry
-		for (size_t i = 0; i < nodes.Size(); ++i)
-		{
-			auto p = nodes[i];
-			fval[i] = f (p);
-		}
+		double result = 0;
+		for (size_t i = 0; i < x.Size(); ++i)
+			result += w[i] * f (x[i]);
 
-		return fval.Dot (weights);
+		return result;
 	}
 
 	template <size_t dim>
@@ -139,20 +144,18 @@ namespace Geometry
 			throw std::length_error
 			("Trying to integrate with different number of nodes and weights!");
 
-		ColumnVector first_values = multi_f (nodes[0]);
+		auto x = nodes.View();
+
+		ColumnVector first_values = multi_f (x[0]);
 		size_t r = first_values.Size();
-		size_t c = nodes.Size();
+		size_t c = x.Size();
 		DynamicMatrix multi_fval (r, c);
 
 		multi_fval.SetCol (0, first_values);
 
 		//TODO: can be optimized using weights simmetry
 		for (size_t i = 1; i < c; ++i)
-		{
-			auto p = nodes[i];
-			ColumnVector values = multi_f (p);
-			multi_fval.SetCol (i, values);
-		}
+			multi_fval.SetCol (i, multi_f (x[i]));
 
 		return (multi_fval * weights);
 	}
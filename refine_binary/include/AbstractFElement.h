@@ -3,9 +3,12 @@
 
 #include "ConcreteFactories.h"
 #include "AbstractSpace.h"
+#include "Functor.h"
 
 #include <memory> //std::shared_ptr, std::unique_ptr
 #include <utility> //std::move
+#include <array>
+#include <cmath> //abs
 
 namespace FiniteElements
 {
@@ -51,6 +54,19 @@ namespace FiniteElements
 		**/
 		virtual void Init();
 
+		/**
+			Release the map and the reference element.
+			The element goes back to the uninitialized state,
+			so a new call to Init() rebuilds them.
+		**/
+		virtual void Release();
+
+		/**
+			Bytes of memory owned by the element,
+			the underlying geometry excluded.
+		**/
+		virtual size_t ResidentBytes() const;
+
 		/**
 			Get the basis type identifier
 		**/
@@ -131,6 +147,159 @@ namespace FiniteElements
 		**/
 		virtual double BasisNormSquared (size_t) const;
 
+		/*	Integration in reference coordinates.
+			Functions are sampled at the quadrature points of the element,
+			the basis is evaluated at the reference quadrature points
+			and weights are rescaled by the constant jacobian of the affine map,
+			so no inverse mapping is needed. */
+
+		/**
+			Evaluate input function at the quadrature points of the element.
+			Reference quadrature points are mapped forward one by one,
+			so no temporary vector of points is created.
+		**/
+		template <typename F>
+		Geometry::ColumnVector EvaluateAtQuadPoints (const F&) const;
+
+		/**
+			Evaluate input function at the first quadrature points of the element.
+			Input parameters:
+				- the function
+				- the vector of samples, it is enlarged to the number of points if shorter
+				- the number of points
+			Samples already in the vector are kept, only the new points are evaluated:
+			with a nested quadrature rule the samples of a level
+			are reused by the following ones.
+		**/
+		template <typename F>
+		void SampleAtQuadPoints (const F&, vector<double>& samples, size_t) const;
+
+		/**
+			As the template version, but the new points are evaluated
+			through the batched evaluation of the functor.
+		**/
+		void SampleAtQuadPoints (const BinaryTree::Functor<dim>&, vector<double>& samples, size_t) const;
+
+		/**
+			Coordinates of the quadrature points of the element with index in [first, last),
+			stored point after point, as needed by the batched evaluation of a functor.
+		**/
+		vector<double> QuadPointsCoordinates (size_t first, size_t last) const;
+
+		/**
+			Number of levels of the quadrature rule, 1 if it is not nested
+		**/
+		size_t QuadLevels() const;
+
+		/**
+			Number of quadrature nodes of input level
+		**/
+		size_t QuadLevelSize (size_t) const;
+
+		/**
+			Order of exactness of input quadrature level
+		**/
+		size_t QuadLevelOrder (size_t) const;
+
+		/**
+			Integral of a function given by its values at the quadrature points of the element.
+			If the values are less than the quadrature points,
+			the level of the rule with as many nodes is used.
+		**/
+		double IntegrateQuadValues (const Geometry::VectorView&) const;
+
+		/**
+			L2 scalar product between the basis function with input index
+			and a function given by its values at the quadrature points of the element.
+		**/
+		double L2ProdWithBasisFunction (size_t,
+										const Geometry::VectorView&) const;
+
+		/**
+			As L2ProdWithBasisFunction(), but for all basis functions with index in [first, last).
+			The computation is delegated to the reference element,
+			which may use a kernel optimized for its geometry and basis.
+		**/
+		Geometry::ColumnVector L2ProdsWithBasis (const Geometry::VectorView&,
+												 size_t first,
+												 size_t last) const;
+
+		/**
+			Values at the quadrature points of the element of the linear combination
+			of the first basis functions, with input vector as coefficients.
+			If the number of points is given, only the first ones are computed.
+		**/
+		Geometry::ColumnVector
+		CombineBasisAtQuadPoints (const Geometry::VectorView&, size_t n_points = 0) const;
+
+		/*	Integration on a sub-element, i.e. an element lying inside this one,
+			as the children of a node of the binary tree.
+			Integrals are computed by the quadrature rule of the sub-element,
+			with the basis of this element evaluated at its quadrature points,
+			so a function already sampled on the sub-elements
+			does not need to be evaluated again. */
+
+		/**
+			Values of the basis functions of this element at the first input number
+			of quadrature points of a sub-element:
+			the ones at point q are stored in [q * BasisSize(), (q + 1) * BasisSize()).
+			The reference quadrature points of the sub-element are moved to the reference element
+			of this one by the affine map between the two reference elements,
+			computed once from the maps of the elements,
+			so no point is mapped to the element and back.
+		**/
+		vector<double> BasisOnSubElement (const AbstractFElement<dim, FeType>&, size_t) const;
+
+		/**
+			Add to the output vector the L2 scalar products on a sub-element
+			between the basis functions of this element
+			and a function given by its values at the quadrature points of the sub-element.
+			Input parameters:
+				- the sub-element
+				- the function values, possibly on a level of the sub-element rule
+				- the values of the basis at the same points, given by BasisOnSubElement()
+				- the vector of products, one for each basis function
+			Calling it for each element of a partition gives a composite rule.
+		**/
+		void AddL2ProdsOnSubElement (const AbstractFElement<dim, FeType>&,
+									 const Geometry::VectorView&,
+									 const vector<double>&,
+									 Geometry::ColumnVector&) const;
+
+		/**
+			Squared L2 distance on a sub-element between a function
+			given by its values at the quadrature points of the sub-element
+			and the combination of the basis functions of this element
+			with input coefficients;
+			the values of the basis at the same points are given by BasisOnSubElement().
+		**/
+		double SquaredDistanceOnSubElement (const AbstractFElement<dim, FeType>&,
+											const Geometry::VectorView& values,
+											const vector<double>& basis,
+											const Geometry::VectorView& coeff) const;
+
+		/**
+			Tell if the projection of separable functions can be computed
+			from the 1D projections of their factors,
+			i.e. if the reference element is sum factorizable
+			and the element is a box with sides parallel to the axes.
+		**/
+		bool SeparableProjectionAvailable() const;
+
+		/**
+			Projection of a separable function on the element basis,
+			available if SeparableProjectionAvailable().
+			Input parameters:
+				- the function factors, called as factor(d, x)
+				  to get the factor depending on coordinate d at value x
+				- the vector where the projection coefficients are stored
+			It returns the squared L2 norm of the projection error.
+			Factors are evaluated only at the 1D quadrature nodes,
+			i.e. dim * n times instead of n^dim.
+		**/
+		template <typename F>
+		double SeparableProjection (const F&, Geometry::ColumnVector&) const;
+
 	  protected:
 		/**
 			Get the map.
@@ -138,6 +307,13 @@ namespace FiniteElements
 		**/
 		const Geometry::AffineMap<dim>& UseMap() const;
 
+		/**
+			Tell if the map is a scaling of each coordinate plus a translation,
+			i.e. if reference coordinate t_d is mapped to scale[d] * t_d + shift[d].
+			In this case scale and shift are stored in the input arrays.
+		**/
+		bool AxisAlignedMap (array<double, dim>& scale, array<double, dim>& shift) const;
+
 		/**
 			Raise an exception if the element has not been initialized.
 			Method to be called by every other method of the class before trying to use class attributes.
@@ -199,6 +375,24 @@ namespace FiniteElements
 		}
 	}
 
+	template <size_t dim, BasisType FeType>
+	void AbstractFElement<dim, FeType>::Release()
+	{
+		this->_map.reset();
+		this->_ref_felement.reset();
+		this->_initialized = false;
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractFElement<dim, FeType>::ResidentBytes() const
+	{
+		size_t bytes = sizeof (AbstractFElement<dim, FeType>);
+		if (this->_map)
+			bytes += sizeof (Geometry::AffineMap<dim>);
+
+		return bytes;
+	}
+
 	template <size_t dim, BasisType FeType>
 	BasisType AbstractFElement<dim, FeType>::GetFeType() const
 	{
@@ -229,9 +423,7 @@ namespace FiniteElements
 			so it has an evaluateJacobian() method
 			not dependent on the point of evaluation
 		*/
-		auto jac = _map->Jacobian();
-		for (size_t i = 0; i < weights.Size(); ++i)
-			weights[i] *= jac;
+		weights *= _map->Jacobian();
 
 		return weights;
 	}
@@ -297,6 +489,296 @@ namespace FiniteElements
 		return std_norm * J;
 	}
 
+	template <size_t dim, BasisType FeType>
+	template <typename F>
+	Geometry::ColumnVector AbstractFElement<dim, FeType>
+	::EvaluateAtQuadPoints (const F& f) const
+	{
+		CheckInitialization();
+
+		auto points = this->_ref_felement->QuadPointsView();
+		Geometry::ColumnVector result (points.Size());
+
+		for (size_t q = 0; q < points.Size(); ++q)
+			result[q] = f (this->_map->Evaluate (points[q]));
+
+		return result;
+	}
+
+	template <size_t dim, BasisType FeType>
+	template <typename F>
+	void AbstractFElement<dim, FeType>
+	::SampleAtQuadPoints (const F& f, vector<double>& samples, size_t n_points) const
+	{
+		CheckInitialization();
+
+		auto points = this->_ref_felement->QuadPointsView();
+		size_t sampled = samples.size();
+		if (sampled >= n_points)
+			return;
+
+		samples.resize (n_points);
+
+		for (size_t q = sampled; q < n_points; ++q)
+			samples[q] = f (this->_map->Evaluate (points[q]));
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractFElement<dim, FeType>
+	::SampleAtQuadPoints (const BinaryTree::Functor<dim>& f, vector<double>& samples, size_t n_points) const
+	{
+		CheckInitialization();
+
+		size_t sampled = samples.size();
+		if (sampled >= n_points)
+			return;
+
+		samples.resize (n_points);
+
+		auto coordinates = QuadPointsCoordinates (sampled, n_points);
+		f.Evaluate (coordinates.data(), samples.data() + sampled, n_points - sampled);
+	}
+
+	template <size_t dim, BasisType FeType>
+	vector<double> AbstractFElement<dim, FeType>
+	::QuadPointsCoordinates (size_t first, size_t last) const
+	{
+		CheckInitialization();
+
+		auto points = this->_ref_felement->QuadPointsView();
+
+		vector<double> coordinates ((last - first) * dim);
+		auto c = coordinates.begin();
+		for (size_t q = first; q < last; ++q)
+		{
+			auto p = this->_map->Evaluate (points[q]);
+			for (size_t i = 0; i < dim; ++i, ++c)
+				*c = p[i];
+		}
+
+		return coordinates;
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractFElement<dim, FeType>::QuadLevels() const
+	{
+		CheckInitialization();
+
+		return this->_ref_felement->QuadLevels();
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractFElement<dim, FeType>::QuadLevelSize (size_t level) const
+	{
+		CheckInitialization();
+
+		return this->_ref_felement->LevelSize (level);
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AbstractFElement<dim, FeType>::QuadLevelOrder (size_t level) const
+	{
+		CheckInitialization();
+
+		return this->_ref_felement->LevelOrder (level);
+	}
+
+	template <size_t dim, BasisType FeType>
+	double AbstractFElement<dim, FeType>
+	::IntegrateQuadValues (const Geometry::VectorView& values) const
+	{
+		CheckInitialization();
+
+		auto weights = this->_ref_felement->QuadWeightsOfSize (values.Size());
+		return weights.Dot (values) * this->_map->Jacobian();
+	}
+
+	template <size_t dim, BasisType FeType>
+	double AbstractFElement<dim, FeType>
+	::L2ProdWithBasisFunction (size_t ind,
+							   const Geometry::VectorView& values) const
+	{
+		CheckInitialization();
+
+		auto weights = this->_ref_felement->QuadWeightsView();
+		auto basis = this->_ref_felement->BasisAtQuadPoints (ind);
+
+		double result = 0;
+		for (size_t q = 0; q < weights.Size(); ++q)
+			result += weights[q] * values[q] * basis[q];
+
+		return result * this->_map->Jacobian();
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::ColumnVector AbstractFElement<dim, FeType>
+	::CombineBasisAtQuadPoints (const Geometry::VectorView& coeff, size_t n_points) const
+	{
+		CheckInitialization();
+
+		return this->_ref_felement->CombineBasis (coeff, n_points);
+	}
+
+	template <size_t dim, BasisType FeType>
+	vector<double> AbstractFElement<dim, FeType>
+	::BasisOnSubElement (const AbstractFElement<dim, FeType>& sub, size_t n_points) const
+	{
+		CheckInitialization();
+		sub.CheckInitialization();
+
+		//affine map from the reference element of sub to the one of this element
+		auto origin = this->_map->ComputeInverse (sub._map->Evaluate (Geometry::Point<dim>()));
+		array<Geometry::Point<dim>, dim> columns;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			Geometry::Point<dim> unit;
+			unit[d] = 1;
+			columns[d] = this->_map->ComputeInverse (sub._map->Evaluate (unit)) - origin;
+		}
+
+		auto points = sub._ref_felement->QuadPointsView();
+		size_t s = this->BasisSize();
+
+		vector<double> result (n_points * s);
+		for (size_t q = 0; q < n_points; ++q)
+		{
+			auto point = origin;
+			for (size_t d = 0; d < dim; ++d)
+				point = point + columns[d] * points[q][d];
+
+			auto basis = this->_ref_felement->EvaluateBasis (this->_p_level, point);
+			for (size_t i = 0; i < s; ++i)
+				result[q * s + i] = basis[i];
+		}
+
+		return result;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AbstractFElement<dim, FeType>
+	::AddL2ProdsOnSubElement (const AbstractFElement<dim, FeType>& sub,
+							  const Geometry::VectorView& values,
+							  const vector<double>& basis,
+							  Geometry::ColumnVector& prods) const
+	{
+		CheckInitialization();
+		sub.CheckInitialization();
+
+		auto weights = sub._ref_felement->QuadWeightsOfSize (values.Size());
+		double J = sub._map->Jacobian();
+		size_t s = this->BasisSize();
+
+		for (size_t q = 0; q < values.Size(); ++q)
+		{
+			double w = weights[q] * values[q] * J;
+			const double* basis_q = basis.data() + q * s;
+
+			for (size_t i = 0; i < prods.Size(); ++i)
+				prods[i] += w * basis_q[i];
+		}
+	}
+
+	template <size_t dim, BasisType FeType>
+	double AbstractFElement<dim, FeType>
+	::SquaredDistanceOnSubElement (const AbstractFElement<dim, FeType>& sub,
+								   const Geometry::VectorView& values,
+								   const vector<double>& basis,
+								   const Geometry::VectorView& coeff) const
+	{
+		CheckInitialization();
+		sub.CheckInitialization();
+
+		auto weights = sub._ref_felement->QuadWeightsOfSize (values.Size());
+		size_t s = this->BasisSize();
+
+		double result = 0;
+		for (size_t q = 0; q < values.Size(); ++q)
+		{
+			const double* basis_q = basis.data() + q * s;
+
+			double diff = values[q];
+			for (size_t i = 0; i < coeff.Size(); ++i)
+				diff -= coeff[i] * basis_q[i];
+
+			result += weights[q] * diff * diff;
+		}
+
+		return result * sub._map->Jacobian();
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractFElement<dim, FeType>::SeparableProjectionAvailable() const
+	{
+		CheckInitialization();
+
+		array<double, dim> scale, shift;
+		return this->_ref_felement->SumFactorizable() && AxisAlignedMap (scale, shift);
+	}
+
+	template <size_t dim, BasisType FeType>
+	template <typename F>
+	double AbstractFElement<dim, FeType>
+	::SeparableProjection (const F& factor, Geometry::ColumnVector& coeff) const
+	{
+		CheckInitialization();
+
+		array<double, dim> scale, shift;
+		if (!AxisAlignedMap (scale, shift))
+			throw logic_error ("Separable projection requested to an element not aligned to the axes");
+
+		auto points = this->_ref_felement->OneDQuadPointsView();
+		size_t n = points.Size();
+
+		vector<double> factors (dim * n);
+		for (size_t d = 0; d < dim; ++d)
+			for (size_t i = 0; i < n; ++i)
+				factors[d * n + i] = factor (d, scale[d] * points[i][0] + shift[d]);
+
+		/*	Coefficients do not depend on the map,
+			since both L2 products and norms are scaled by the jacobian */
+		double err_squared = this->_ref_felement->SeparableProjection
+							 (factors, this->BasisSize(), coeff);
+
+		return err_squared * this->_map->Jacobian();
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::ColumnVector AbstractFElement<dim, FeType>
+	::L2ProdsWithBasis (const Geometry::VectorView& values,
+						size_t first,
+						size_t last) const
+	{
+		CheckInitialization();
+
+		auto result = this->_ref_felement->BasisL2Prods (values, first, last);
+		result *= this->_map->Jacobian();
+
+		return result;
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AbstractFElement<dim, FeType>
+	::AxisAlignedMap (array<double, dim>& scale, array<double, dim>& shift) const
+	{
+		auto origin = this->_map->Evaluate (Geometry::Point<dim>());
+		for (size_t d = 0; d < dim; ++d)
+			shift[d] = origin[d];
+
+		for (size_t d = 0; d < dim; ++d)
+		{
+			Geometry::Point<dim> unit;
+			unit[d] = 1;
+			auto column = this->_map->Evaluate (unit);
+
+			scale[d] = column[d] - origin[d];
+			for (size_t j = 0; j < dim; ++j)
+				if (j != d && abs (column[j] - origin[j]) > 1E-14 * abs (scale[d]))
+					return false;
+		}
+
+		return true;
+	}
+
 	template <size_t dim, BasisType FeType>
 	const Geometry::AffineMap<dim>& AbstractFElement<dim, FeType>::UseMap() const
 	{
@@ -0,0 +1,265 @@
+#ifndef __APPROXIMATION_ARCHIVE_H
+#define __APPROXIMATION_ARCHIVE_H
+
+#include "ArchiveFile.h"
+#include "ApproximationSnapshot.h"
+
+#include <string>
+#include <memory> //std::shared_ptr
+#include <cstdint> //uint64_t, uint32_t
+#include <stdexcept> //std::runtime_error
+
+namespace BinaryTree
+{
+	/**
+		Approximation archive mapped in memory.
+		The columns are read in place, through the pointers returned by the accessors,
+		e.g. to pass the mesh and the coefficients to another code;
+		Snapshot() builds an ApproximationSnapshot to evaluate the approximation,
+		see also PointEvaluator.
+	**/
+	template <size_t dim>
+	class MappedArchive : public ArchiveMapping
+	{
+	  public:
+		/**
+			constructor.
+			It raises a runtime_error exception if the file is not an archive,
+			or if the dimension of the archived mesh is not dim.
+		**/
+		MappedArchive (const std::string&);
+
+		/**
+			default destructor
+		**/
+		virtual ~MappedArchive() {};
+
+		/**
+			Number of active elements
+		**/
+		size_t Size() const;
+
+		/**
+			Number of vertices
+		**/
+		size_t VerticesNumber() const;
+
+		/**
+			Number of nodes of the tree, zero if it has not been stored
+		**/
+		size_t TreeSize() const;
+
+		/**
+			Number of iterations performed by the refiner
+		**/
+		size_t Iteration() const;
+
+		/**
+			Projection error of the refiner
+		**/
+		double Error() const;
+
+		/**
+			Pointers to the columns, see ArchiveColumn
+		**/
+		const double* Vertices() const;
+		const uint32_t* ElementTypes() const;
+		const uint32_t* BasisTypes() const;
+		const uint64_t* NodeIDs() const;
+		const uint32_t* PLevels() const;
+		const double* LocalErrors() const;
+		const uint64_t* ConnectivityOffsets() const;
+		const uint64_t* Connectivity() const;
+		const uint64_t* CoefficientOffsets() const;
+		const double* Coefficients() const;
+		const uint64_t* TreeIDs() const;
+		const uint64_t* TreeParents() const;
+		const uint32_t* TreePLevels() const;
+		const uint64_t* TreeElements() const;
+
+		/**
+			Vertices of the active element with input index
+		**/
+		Geometry::NodesVector<dim> ElementVertices (size_t) const;
+
+		/**
+			Projection coefficients of the active element with input index.
+			The view is valid as long as the archive is mapped.
+		**/
+		Geometry::VectorView ElementCoefficients (size_t) const;
+
+		/**
+			Snapshot of the archived approximation, with input version.
+			It does not refer to the archive, which can be released.
+		**/
+		std::shared_ptr<const ApproximationSnapshot<dim>> Snapshot (size_t version = 0) const;
+	};
+
+
+	template <size_t dim>
+	MappedArchive<dim>::MappedArchive (const std::string& file_name) :
+		ArchiveMapping (file_name)
+	{
+		if (Header().dim != dim)
+			throw std::runtime_error ("MappedArchive: " + file_name + " stores a mesh of dimension "
+									  + std::to_string (Header().dim));
+	}
+
+	template <size_t dim>
+	size_t MappedArchive<dim>::Size() const
+	{
+		return Header().elements;
+	}
+
+	template <size_t dim>
+	size_t MappedArchive<dim>::VerticesNumber() const
+	{
+		return Header().vertices;
+	}
+
+	template <size_t dim>
+	size_t MappedArchive<dim>::TreeSize() const
+	{
+		return Header().tree_nodes;
+	}
+
+	template <size_t dim>
+	size_t MappedArchive<dim>::Iteration() const
+	{
+		return Header().iteration;
+	}
+
+	template <size_t dim>
+	double MappedArchive<dim>::Error() const
+	{
+		return Header().error;
+	}
+
+	template <size_t dim>
+	const double* MappedArchive<dim>::Vertices() const
+	{
+		return Column<double> (VerticesColumn);
+	}
+
+	template <size_t dim>
+	const uint32_t* MappedArchive<dim>::ElementTypes() const
+	{
+		return Column<uint32_t> (ElementTypesColumn);
+	}
+
+	template <size_t dim>
+	const uint32_t* MappedArchive<dim>::BasisTypes() const
+	{
+		return Column<uint32_t> (BasisTypesColumn);
+	}
+
+	template <size_t dim>
+	const uint64_t* MappedArchive<dim>::NodeIDs() const
+	{
+		return Column<uint64_t> (NodeIDsColumn);
+	}
+
+	template <size_t dim>
+	const uint32_t* MappedArchive<dim>::PLevels() const
+	{
+		return Column<uint32_t> (PLevelsColumn);
+	}
+
+	template <size_t dim>
+	const double* MappedArchive<dim>::LocalErrors() const
+	{
+		return Column<double> (LocalErrorsColumn);
+	}
+
+	template <size_t dim>
+	const uint64_t* MappedArchive<dim>::ConnectivityOffsets() const
+	{
+		return Column<uint64_t> (ConnectivityOffsetsColumn);
+	}
+
+	template <size_t dim>
+	const uint64_t* MappedArchive<dim>::Connectivity() const
+	{
+		return Column<uint64_t> (ConnectivityColumn);
+	}
+
+	template <size_t dim>
+	const uint64_t* MappedArchive<dim>::CoefficientOffsets() const
+	{
+		return Column<uint64_t> (CoefficientOffsetsColumn);
+	}
+
+	template <size_t dim>
+	const double* MappedArchive<dim>::Coefficients() const
+	{
+		return Column<double> (CoefficientsColumn);
+	}
+
+	template <size_t dim>
+	const uint64_t* MappedArchive<dim>::TreeIDs() const
+	{
+		return Column<uint64_t> (TreeIDsColumn);
+	}
+
+	template <size_t dim>
+	const uint64_t* MappedArchive<dim>::TreeParents() const
+	{
+		return Column<uint64_t> (TreeParentsColumn);
+	}
+
+	template <size_t dim>
+	const uint32_t* MappedArchive<dim>::TreePLevels() const
+	{
+		return Column<uint32_t> (TreePLevelsColumn);
+	}
+
+	template <size_t dim>
+	const uint64_t* MappedArchive<dim>::TreeElements() const
+	{
+		return Column<uint64_t> (TreeElementsColumn);
+	}
+
+	template <size_t dim>
+	Geometry::NodesVector<dim> MappedArchive<dim>::ElementVertices (size_t i) const
+	{
+		auto offsets = ConnectivityOffsets();
+		auto connectivity = Connectivity();
+		auto vertices = Vertices();
+
+		Geometry::NodesVector<dim> result (offsets[i + 1] - offsets[i]);
+		for (size_t v = offsets[i]; v < offsets[i + 1]; ++v)
+		{
+			Geometry::Point<dim> p;
+			for (size_t d = 0; d < dim; ++d)
+				p[d] = vertices[connectivity[v] * dim + d];
+			result.Insert (v - offsets[i], p);
+		}
+
+		return result;
+	}
+
+	template <size_t dim>
+	Geometry::VectorView MappedArchive<dim>::ElementCoefficients (size_t i) const
+	{
+		auto offsets = CoefficientOffsets();
+		return Geometry::VectorView (Coefficients() + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+
+	template <size_t dim>
+	std::shared_ptr<const ApproximationSnapshot<dim>> MappedArchive<dim>::Snapshot (size_t version) const
+	{
+		std::shared_ptr<ApproximationSnapshot<dim>> result (new ApproximationSnapshot<dim> (version, Iteration(), Error()));
+
+		for (size_t i = 0; i < Size(); ++i)
+			result->Add (NodeIDs()[i], PLevels()[i], LocalErrors()[i],
+						 static_cast<Geometry::ElementType> (ElementTypes()[i]),
+						 static_cast<FiniteElements::BasisType> (BasisTypes()[i]),
+						 ElementVertices (i), ElementCoefficients (i));
+
+		result->PrepareBases();
+		return result;
+	}
+
+} //namespace BinaryTree
+
+#endif //__APPROXIMATION_ARCHIVE_H
@@ -0,0 +1,621 @@
+#ifndef __APPROXIMATION_SNAPSHOT_H
+#define __APPROXIMATION_SNAPSHOT_H
+
+#include "MeshRefiner.h"
+#include "ConcreteFactories.h"
+#include "Basis.h"
+#include "Maps.h"
+
+#include <vector>
+#include <memory> //std::unique_ptr
+#include <algorithm> //std::max
+#include <stdexcept> //std::out_of_range
+
+namespace BinaryTree
+{
+	template <size_t dim>
+	class MappedArchive;
+
+	template <size_t dim>
+	class MultiResolution;
+
+	template <size_t dim>
+	class SnapshotStreamPlayer;
+
+	/**
+		Immutable copy of the approximation computed by a MeshRefiner.
+		It stores, for each active element, its node identifier, p level, local error,
+		vertices, the inverse of its affine map and the coefficients of the projection;
+		data are stored column by column, i.e. one vector for each attribute.
+		The snapshot does not refer to the tree nor to the mesh,
+		so it can be read while the refiner goes on modifying them.
+		The basis functions are evaluated by basis objects owned by the snapshot,
+		whose tables are filled when it is built:
+		evaluations only read the snapshot, so any number of threads can do them at the same time.
+		See SnapshotPublisher to share the latest snapshot with reader threads,
+		MappedArchive to build a snapshot from a file,
+		MultiResolution to build snapshots of coarser meshes from the same tree,
+		and SnapshotStreamPlayer to build the snapshots recorded by a SnapshotStream.
+	**/
+	template <size_t dim>
+	class ApproximationSnapshot
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the refiner, with the mesh loaded
+				- the version of the snapshot
+			The coefficients of the projection are computed on the elements which have not stored them,
+			so the objective function may be evaluated;
+			it has to be called by the thread refining the mesh.
+		**/
+		ApproximationSnapshot (MeshRefiner<dim>&, size_t);
+
+		/**
+			Version of the snapshot, given by its publisher
+		**/
+		size_t Version() const;
+
+		/**
+			Number of iterations performed by the refiner when the snapshot has been taken
+		**/
+		size_t Iteration() const;
+
+		/**
+			Projection error of the refiner when the snapshot has been taken
+		**/
+		double Error() const;
+
+		/**
+			Number of active elements
+		**/
+		size_t Size() const;
+
+		/**
+			Maximum p level of the active elements
+		**/
+		size_t MaxPLevel() const;
+
+		/**
+			Identifier of the node of the element with input index
+		**/
+		size_t NodeID (size_t) const;
+
+		/**
+			p level of the element with input index
+		**/
+		size_t PLevel (size_t) const;
+
+		/**
+			Projection error on the element with input index
+		**/
+		double LocalError (size_t) const;
+
+		/**
+			Geometry type of the element with input index
+		**/
+		Geometry::ElementType GetType (size_t) const;
+
+		/**
+			Basis type of the element with input index
+		**/
+		FiniteElements::BasisType GetFeType (size_t) const;
+
+		/**
+			Vertices of the element with input index
+		**/
+		Geometry::NodesVector<dim> Vertices (size_t) const;
+
+		/**
+			Projection coefficients of the element with input index.
+			The view is valid as long as the snapshot.
+		**/
+		Geometry::VectorView Coefficients (size_t) const;
+
+		/**
+			Matrix of the inverse affine map of the element with input index,
+			stored row by row: the reference point of x is InverseMatrix() * x + InverseShift()
+		**/
+		Geometry::VectorView InverseMatrix (size_t) const;
+
+		/**
+			Translation of the inverse affine map of the element with input index
+		**/
+		Geometry::VectorView InverseShift (size_t) const;
+
+		/**
+			Input point mapped to the reference element of the element with input index
+		**/
+		Geometry::Point<dim> ReferencePoint (size_t, const Geometry::Point<dim>&) const;
+
+		/**
+			Tell if input point lies in the element with input index
+		**/
+		bool Contains (size_t, const Geometry::Point<dim>&) const;
+
+		/**
+			Index of the element containing input point, Size() if there is none.
+			Elements are scanned one by one.
+		**/
+		size_t Locate (const Geometry::Point<dim>&) const;
+
+		/**
+			Projection on the element with input index, evaluated at input point
+		**/
+		double Evaluate (size_t, const Geometry::Point<dim>&) const;
+
+		/**
+			Projection evaluated at input point.
+			It raises an out_of_range exception if the point does not lie in the mesh.
+		**/
+		double Evaluate (const Geometry::Point<dim>&) const;
+
+	  private:
+		friend class MappedArchive<dim>;
+		friend class MultiResolution<dim>;
+		friend class SnapshotStreamPlayer<dim>;
+
+		/**
+			Basis evaluating the functions of the elements with the same geometry and basis type
+		**/
+		struct ReferenceBasis
+		{
+			/**
+				geometry type
+			**/
+			Geometry::ElementType type;
+			/**
+				basis type
+			**/
+			FiniteElements::BasisType fe_type;
+			/**
+				the basis, with the tables filled until the maximum p level of the elements
+			**/
+			std::unique_ptr<FiniteElements::TensorialBasis<dim>> basis;
+			/**
+				map from the reference element to the domain of the basis,
+				nullptr if they are the same, as for ipercubes
+			**/
+			std::unique_ptr<Geometry::Map<dim>> std_map;
+			/**
+				maximum p level of the elements
+			**/
+			size_t max_p_level;
+		};
+
+		/**
+			Functor adding the active elements to the snapshot
+		**/
+		class Collector : public DimOperator<dim>
+		{
+		  public:
+			Collector (ApproximationSnapshot<dim>& snapshot) : _snapshot (snapshot) {};
+
+			virtual void operator() (DimensionedNode<dim>* node) override
+			{
+				this->_snapshot.Add (node);
+			};
+
+		  private:
+			ApproximationSnapshot<dim>& _snapshot;
+		};
+
+		/**
+			constructor of an empty snapshot, whose elements are added by Add().
+			Input parameters: the version, the iteration and the projection error.
+			PrepareBases() has to be called when all the elements have been added.
+		**/
+		ApproximationSnapshot (size_t, size_t, double);
+
+		/**
+			Store the data of an active element
+		**/
+		void Add (DimensionedNode<dim>*);
+
+		/**
+			Store the data of an element.
+			Input parameters:
+				- the node identifier
+				- the p level
+				- the local error
+				- the geometry type
+				- the basis type
+				- the vertices
+				- the projection coefficients
+		**/
+		void Add (size_t, size_t, double,
+				  Geometry::ElementType, FiniteElements::BasisType,
+				  const Geometry::NodesVector<dim>&, const Geometry::VectorView&);
+
+		/**
+			Fill the tables of the reference bases until the maximum p level of their elements
+		**/
+		void PrepareBases();
+
+		/**
+			Index of the reference basis for input geometry and basis type,
+			which is created if not present
+		**/
+		size_t FindBasis (Geometry::ElementType, FiniteElements::BasisType);
+
+		/**
+			Tell if a point in reference coordinates lies in the reference element of input type
+		**/
+		static bool InReferenceElement (Geometry::ElementType, const Geometry::Point<dim>&);
+
+		/**
+			deleted copy constructor
+		**/
+		ApproximationSnapshot (const ApproximationSnapshot&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		ApproximationSnapshot& operator = (const ApproximationSnapshot&) = delete;
+
+	  private:
+		/**
+			Version of the snapshot
+		**/
+		size_t _version;
+		/**
+			Number of iterations of the refiner
+		**/
+		size_t _iteration;
+		/**
+			Projection error of the refiner
+		**/
+		double _error;
+		/**
+			Node identifiers
+		**/
+		std::vector<size_t> _node_ids;
+		/**
+			p levels
+		**/
+		std::vector<size_t> _p_levels;
+		/**
+			Local projection errors
+		**/
+		std::vector<double> _local_errors;
+		/**
+			Index of the reference basis of each element
+		**/
+		std::vector<size_t> _basis_indexes;
+		/**
+			Coordinates of the vertices, vertex after vertex
+		**/
+		std::vector<double> _vertices;
+		/**
+			Index in _vertices of the first vertex of each element, plus the end of the last one
+		**/
+		std::vector<size_t> _vertex_offsets;
+		/**
+			Inverse affine maps: the dim x dim matrix, row by row, of each element
+		**/
+		std::vector<double> _inverse_maps;
+		/**
+			Inverse affine maps: the translation of each element
+		**/
+		std::vector<double> _shifts;
+		/**
+			Projection coefficients
+		**/
+		std::vector<double> _coefficients;
+		/**
+			Index in _coefficients of the first coefficient of each element, plus the end of the last one
+		**/
+		std::vector<size_t> _coeff_offsets;
+		/**
+			The reference bases
+		**/
+		std::vector<ReferenceBasis> _bases;
+	};
+
+
+	template <size_t dim>
+	ApproximationSnapshot<dim>::ApproximationSnapshot (MeshRefiner<dim>& refiner, size_t version) :
+		ApproximationSnapshot (version, refiner.Iterations(), refiner.GlobalError())
+	{
+		Collector collector (*this);
+		refiner.IterateActiveNodes (collector);
+
+		PrepareBases();
+	}
+
+	template <size_t dim>
+	ApproximationSnapshot<dim>::ApproximationSnapshot (size_t version, size_t iteration, double error) :
+		_version (version),
+		_iteration (iteration),
+		_error (error),
+		_vertex_offsets (1, 0),
+		_coeff_offsets (1, 0)
+	{}
+
+	template <size_t dim>
+	void ApproximationSnapshot<dim>::PrepareBases()
+	{
+		/*	The tables of the bases are filled here,
+			so the evaluations of the readers do not modify them */
+		for (auto& b : this->_bases)
+			b.basis->EvaluateBasis (b.max_p_level, Geometry::Point<dim>());
+	}
+
+	template <size_t dim>
+	void ApproximationSnapshot<dim>::Add (DimensionedNode<dim>* node)
+	{
+		Add (node->NodeID(), node->PLevel(), node->ProjectionError(),
+			 node->GetType(), node->GetFeType(),
+			 node->Nodes(), node->ProjectionCoefficients());
+	}
+
+	template <size_t dim>
+	void ApproximationSnapshot<dim>::Add (size_t node_id,
+										  size_t p_level,
+										  double local_error,
+										  Geometry::ElementType type,
+										  FiniteElements::BasisType fe_type,
+										  const Geometry::NodesVector<dim>& nodes,
+										  const Geometry::VectorView& coeff)
+	{
+		this->_node_ids.push_back (node_id);
+		this->_p_levels.push_back (p_level);
+		this->_local_errors.push_back (local_error);
+
+		size_t b = FindBasis (type, fe_type);
+		this->_basis_indexes.push_back (b);
+		this->_bases[b].max_p_level = std::max (this->_bases[b].max_p_level, p_level);
+
+		for (size_t v = 0; v < nodes.Size(); ++v)
+		{
+			auto vertex = nodes[v];
+			for (size_t d = 0; d < dim; ++d)
+				this->_vertices.push_back (vertex[d]);
+		}
+		this->_vertex_offsets.push_back (this->_vertices.size());
+
+		/*	The inverse map is x -> M x + c, with c = inverse(0)
+			and the j-th column of M given by inverse(e_j) - c */
+		auto& map_factory (GenericFactory::AffineMapFactory<dim>::Instance());
+		auto map = map_factory.create (type);
+		map->Init (nodes);
+
+		auto shift = map->ComputeInverse (Geometry::Point<dim>());
+		std::vector<double> matrix (dim * dim);
+		for (size_t j = 0; j < dim; ++j)
+		{
+			Geometry::Point<dim> unit;
+			unit[j] = 1;
+			auto column = map->ComputeInverse (unit);
+			for (size_t i = 0; i < dim; ++i)
+				matrix[i * dim + j] = column[i] - shift[i];
+		}
+		this->_inverse_maps.insert (this->_inverse_maps.end(), matrix.begin(), matrix.end());
+		for (size_t i = 0; i < dim; ++i)
+			this->_shifts.push_back (shift[i]);
+
+		this->_coefficients.insert (this->_coefficients.end(), coeff.Data(), coeff.Data() + coeff.Size());
+		this->_coeff_offsets.push_back (this->_coefficients.size());
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::FindBasis (Geometry::ElementType type,
+												  FiniteElements::BasisType fe_type)
+	{
+		for (size_t b = 0; b < this->_bases.size(); ++b)
+			if (this->_bases[b].type == type && this->_bases[b].fe_type == fe_type)
+				return b;
+
+		ReferenceBasis result;
+		result.type = type;
+		result.fe_type = fe_type;
+		result.max_p_level = 0;
+
+		auto& basis_factory (GenericFactory::TensorialBasisFactory<dim>::Instance());
+		result.basis = basis_factory.create (fe_type);
+
+		//as in StdFElement, the map is registered only for the geometries which are not ipercubes
+		auto& std_map_factory (GenericFactory::StdMapFactory<dim>::Instance());
+		for (auto t : std_map_factory.registered())
+			if (t == type)
+				result.std_map = std_map_factory.create (type);
+
+		this->_bases.push_back (std::move (result));
+		return this->_bases.size() - 1;
+	}
+
+	template <size_t dim>
+	bool ApproximationSnapshot<dim>::InReferenceElement (Geometry::ElementType type,
+														 const Geometry::Point<dim>& p)
+	{
+		const double tol = 1E-12;
+
+		for (size_t d = 0; d < dim; ++d)
+			if (p[d] < -1 - tol)
+				return false;
+
+		//reference triangle has vertices (-1,-1), (1,-1), (-1,1)
+		if (type == Geometry::TriangleType)
+			return p[0] + p[1] <= tol;
+
+		for (size_t d = 0; d < dim; ++d)
+			if (p[d] > 1 + tol)
+				return false;
+
+		return true;
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::Version() const
+	{
+		return this->_version;
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::Iteration() const
+	{
+		return this->_iteration;
+	}
+
+	template <size_t dim>
+	double ApproximationSnapshot<dim>::Error() const
+	{
+		return this->_error;
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::Size() const
+	{
+		return this->_p_levels.size();
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::MaxPLevel() const
+	{
+		size_t result = 0;
+		for (auto& b : this->_bases)
+			result = std::max (result, b.max_p_level);
+
+		return result;
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::NodeID (size_t i) const
+	{
+		return this->_node_ids[i];
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::PLevel (size_t i) const
+	{
+		return this->_p_levels[i];
+	}
+
+	template <size_t dim>
+	double ApproximationSnapshot<dim>::LocalError (size_t i) const
+	{
+		return this->_local_errors[i];
+	}
+
+	template <size_t dim>
+	Geometry::ElementType ApproximationSnapshot<dim>::GetType (size_t i) const
+	{
+		return this->_bases[this->_basis_indexes[i]].type;
+	}
+
+	template <size_t dim>
+	FiniteElements::BasisType ApproximationSnapshot<dim>::GetFeType (size_t i) const
+	{
+		return this->_bases[this->_basis_indexes[i]].fe_type;
+	}
+
+	template <size_t dim>
+	Geometry::NodesVector<dim> ApproximationSnapshot<dim>::Vertices (size_t i) const
+	{
+		size_t first = this->_vertex_offsets[i] / dim;
+		size_t last = this->_vertex_offsets[i + 1] / dim;
+
+		Geometry::NodesVector<dim> result (last - first);
+		for (size_t v = first; v < last; ++v)
+		{
+			Geometry::Point<dim> vertex;
+			for (size_t d = 0; d < dim; ++d)
+				vertex[d] = this->_vertices[v * dim + d];
+			result.Insert (v - first, vertex);
+		}
+
+		return result;
+	}
+
+	template <size_t dim>
+	Geometry::VectorView ApproximationSnapshot<dim>::Coefficients (size_t i) const
+	{
+		return Geometry::VectorView (this->_coefficients.data() + this->_coeff_offsets[i],
+									 this->_coeff_offsets[i + 1] - this->_coeff_offsets[i]);
+	}
+
+	template <size_t dim>
+	Geometry::VectorView ApproximationSnapshot<dim>::InverseMatrix (size_t i) const
+	{
+		return Geometry::VectorView (this->_inverse_maps.data() + i * dim * dim, dim * dim);
+	}
+
+	template <size_t dim>
+	Geometry::VectorView ApproximationSnapshot<dim>::InverseShift (size_t i) const
+	{
+		return Geometry::VectorView (this->_shifts.data() + i * dim, dim);
+	}
+
+	template <size_t dim>
+	Geometry::Point<dim> ApproximationSnapshot<dim>::ReferencePoint (size_t i,
+																	 const Geometry::Point<dim>& p) const
+	{
+		const double* matrix = this->_inverse_maps.data() + i * dim * dim;
+		const double* shift = this->_shifts.data() + i * dim;
+
+		Geometry::Point<dim> result;
+		for (size_t r = 0; r < dim; ++r)
+		{
+			result[r] = shift[r];
+			for (size_t c = 0; c < dim; ++c)
+				result[r] += matrix[r * dim + c] * p[c];
+		}
+
+		return result;
+	}
+
+	template <size_t dim>
+	bool ApproximationSnapshot<dim>::Contains (size_t i, const Geometry::Point<dim>& p) const
+	{
+		return InReferenceElement (GetType (i), ReferencePoint (i, p));
+	}
+
+	template <size_t dim>
+	size_t ApproximationSnapshot<dim>::Locate (const Geometry::Point<dim>& p) const
+	{
+		for (size_t i = 0; i < Size(); ++i)
+			if (Contains (i, p))
+				return i;
+
+		return Size();
+	}
+
+	template <size_t dim>
+	double ApproximationSnapshot<dim>::Evaluate (size_t i, const Geometry::Point<dim>& p) const
+	{
+		auto& b = this->_bases[this->_basis_indexes[i]];
+
+		auto point = ReferencePoint (i, p);
+		if (b.std_map)
+		{
+			/*	The top vertex of the reference triangle is the image of a whole side of the square,
+				where the basis functions do not depend on the first coordinate,
+				while the inverse map is singular there */
+			if (b.type == Geometry::TriangleType && point[1] >= 1 - 1E-12)
+			{
+				point[0] = -1;
+				point[1] = 1;
+			}
+			else
+				point = b.std_map->ComputeInverse (point);
+		}
+
+		//the tables of the basis are already filled until this degree, so they are only read
+		auto basis_evaluation = b.basis->EvaluateBasis (PLevel (i), point);
+
+		return basis_evaluation.Dot (Coefficients (i));
+	}
+
+	template <size_t dim>
+	double ApproximationSnapshot<dim>::Evaluate (const Geometry::Point<dim>& p) const
+	{
+		size_t i = Locate (p);
+		if (i == Size())
+			throw std::out_of_range ("Snapshot evaluation at a point outside the mesh");
+
+		return Evaluate (i, p);
+	}
+
+} //namespace BinaryTree
+
+#endif //__APPROXIMATION_SNAPSHOT_H
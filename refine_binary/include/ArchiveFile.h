@@ -0,0 +1,749 @@
+#ifndef __ARCHIVE_FILE_H
+#define __ARCHIVE_FILE_H
+
+#include "BinaryNode.h"
+#include "MeshRefinerFunctors.h"
+#include "SampleCache.h" //SampleCache::Hash
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstdint> //uint64_t, uint32_t
+#include <limits> //std::numeric_limits
+#include <type_traits> //std::is_trivially_copyable
+#include <stdexcept> //std::runtime_error
+#include <deque>
+#include <utility> //std::pair
+#include <thread> //std::thread
+#include <mutex> //std::mutex, std::unique_lock
+#include <condition_variable>
+#include <exception> //std::exception_ptr
+
+namespace BinaryTree
+{
+	template <size_t dim>
+	class MeshRefiner;
+
+	/**
+		Columns of an approximation archive, in the order they are stored in the file.
+		Each column is an array of fixed size entries:
+			- VerticesColumn:				double, dim coordinates for each vertex of the mesh
+			- ElementTypesColumn:			uint32, Geometry::ElementType of each active element
+			- BasisTypesColumn:				uint32, FiniteElements::BasisType of each active element
+			- NodeIDsColumn:				uint64, node identifier of each active element
+			- PLevelsColumn:				uint32, p level of each active element
+			- LocalErrorsColumn:			double, projection error of each active element
+			- ConnectivityOffsetsColumn:	uint64, index in ConnectivityColumn of the first vertex
+											of each active element, plus the end of the last one
+			- ConnectivityColumn:			uint64, indexes in VerticesColumn of the vertices of the elements
+			- CoefficientOffsetsColumn:		uint64, index in CoefficientsColumn of the first coefficient
+											of each active element, plus the end of the last one
+			- CoefficientsColumn:			double, projection coefficients of the elements
+			- TreeIDsColumn:				uint64, node identifier of each node of the tree
+			- TreeParentsColumn:			uint64, index of the parent in the tree columns
+			- TreePLevelsColumn:			uint32, p level of each node of the tree
+			- TreeElementsColumn:			uint64, index of the active element, if the node is active
+			- StateErrorsColumn:			double, projection error e of each node of the tree
+			- StateEColumn:					double, E parameter of each node of the tree
+			- StateETildeColumn:			double, E~ parameter of each node of the tree
+			- StateQColumn:					double, q parameter of each node of the tree
+			- StateTildeErrorsColumn:		double, e~ parameter of each node of the tree
+			- StateSColumn:					uint64, node identifier of the s parameter of each node of the tree
+		The tree columns are empty if the tree has not been stored,
+		the state columns if the parameters of the algorithm have not been stored;
+		the nodes of the tree are stored each one before its children, the left child before the right one.
+	**/
+	enum ArchiveColumn
+	{
+		VerticesColumn = 0,
+		ElementTypesColumn,
+		BasisTypesColumn,
+		NodeIDsColumn,
+		PLevelsColumn,
+		LocalErrorsColumn,
+		ConnectivityOffsetsColumn,
+		ConnectivityColumn,
+		CoefficientOffsetsColumn,
+		CoefficientsColumn,
+		TreeIDsColumn,
+		TreeParentsColumn,
+		TreePLevelsColumn,
+		TreeElementsColumn,
+		StateErrorsColumn,
+		StateEColumn,
+		StateETildeColumn,
+		StateQColumn,
+		StateTildeErrorsColumn,
+		StateSColumn,
+
+		ArchiveColumnsNumber
+	};
+
+	/**
+		Value of the missing indexes of the tree columns,
+		i.e. the parent of the roots and the active element of inactive nodes
+	**/
+	constexpr uint64_t archive_no_index = std::numeric_limits<uint64_t>::max();
+
+	/**
+		Header at the beginning of an approximation archive.
+		The columns follow it, each one starting at an offset multiple of 8 bytes,
+		so the file can be mapped in memory and the columns read in place.
+		Values are stored in the byte order of the machine writing the archive.
+	**/
+	struct ArchiveHeader
+	{
+		/**
+			magic number, set when the archive is complete
+		**/
+		uint64_t magic;
+		/**
+			version of the format
+		**/
+		uint32_t version;
+		/**
+			dimension of the mesh
+		**/
+		uint32_t dim;
+		/**
+			number of active elements
+		**/
+		uint64_t elements;
+		/**
+			number of vertices
+		**/
+		uint64_t vertices;
+		/**
+			total number of vertices of the elements
+		**/
+		uint64_t connectivity;
+		/**
+			total number of projection coefficients
+		**/
+		uint64_t coefficients;
+		/**
+			number of nodes of the tree, zero if it has not been stored
+		**/
+		uint64_t tree_nodes;
+		/**
+			number of nodes of the tree whose parameters of the algorithm are stored,
+			zero if they have not been stored, tree_nodes otherwise
+		**/
+		uint64_t state_nodes;
+		/**
+			hash of the identifier and of the formula of the objective function,
+			zero if the parameters of the algorithm have not been stored
+		**/
+		uint64_t function;
+		/**
+			iterations performed by the refiner
+		**/
+		uint64_t iteration;
+		/**
+			projection error of the refiner
+		**/
+		double error;
+		/**
+			size of the file in bytes
+		**/
+		uint64_t file_size;
+		/**
+			offset in bytes from the beginning of the file of each column
+		**/
+		uint64_t offsets[ArchiveColumnsNumber];
+
+		/**
+			Number of entries of input column
+		**/
+		uint64_t Entries (ArchiveColumn) const;
+
+		/**
+			Bytes of each entry of input column
+		**/
+		static size_t EntryBytes (ArchiveColumn);
+
+		/**
+			Set the offsets of the columns and the size of the file from the counts
+		**/
+		void Layout();
+	};
+
+	/**
+		Archive file being written.
+		The file is created with its final size, then the columns are filled
+		through a buffer each, so they can be written in any order and interleaved,
+		with a memory occupation independent from the size of the archive.
+		The header is written by Close(), once every column is complete:
+		an archive whose writing has been interrupted is not recognized by readers.
+		The full buffers can be written by a background thread,
+		so the caller goes on filling the columns meanwhile.
+	**/
+	class ArchiveOutput
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the file name
+				- the header, with the counts set; the layout is computed here
+				- the size of each column buffer in bytes
+				- flag telling if the buffers are written by a background thread;
+				  at most two full buffers for each column wait to be written
+			It raises a runtime_error exception if the file cannot be created.
+		**/
+		ArchiveOutput (const std::string&, const ArchiveHeader&,
+					   size_t buffer_bytes = (1 << 20), bool background = false);
+
+		/**
+			destructor.
+			If Close() has not been called, the file is left incomplete.
+			The background thread is stopped.
+		**/
+		~ArchiveOutput();
+
+		/**
+			Append a value to input column
+		**/
+		template <typename T>
+		void Append (ArchiveColumn column, T value)
+		{
+			static_assert (std::is_trivially_copyable<T>::value, "Archive entries must be trivially copyable");
+
+			auto& buffer = this->_buffers[column];
+			if (buffer.size() + sizeof (T) > this->_buffer_bytes)
+				Flush (column);
+
+			auto bytes = reinterpret_cast<const char*> (&value);
+			buffer.insert (buffer.end(), bytes, bytes + sizeof (T));
+		};
+
+		/**
+			Write the remaining buffers and the header, then close the file.
+			If input flag is true, the columns are flushed to the disk before the header is written
+			and the header after it, so the archive survives a crash of the system once Close() returns,
+			and a complete header is never found with incomplete columns.
+			It raises a runtime_error exception if a column has not the size given by the header,
+			or if the file cannot be written or flushed.
+		**/
+		void Close (bool sync = false);
+
+	  private:
+		/**
+			Write the buffer of input column to the file,
+			or pass it to the background thread
+		**/
+		void Flush (ArchiveColumn);
+
+		/**
+			Write input bytes at input offset of the file
+		**/
+		void WriteAt (const std::vector<char>&, uint64_t);
+
+		/**
+			Loop of the background thread, writing the queued buffers
+		**/
+		void WriteQueued();
+
+		/**
+			Wait for the background thread to write every queued buffer.
+			It raises again the exception raised by the background thread, if any.
+		**/
+		void Drain();
+
+		/**
+			deleted copy constructor
+		**/
+		ArchiveOutput (const ArchiveOutput&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		ArchiveOutput& operator = (const ArchiveOutput&) = delete;
+
+	  private:
+		/**
+			file name
+		**/
+		std::string _file_name;
+		/**
+			file descriptor, negative when closed
+		**/
+		int _fd;
+		/**
+			header of the archive
+		**/
+		ArchiveHeader _header;
+		/**
+			size of each buffer
+		**/
+		size_t _buffer_bytes;
+		/**
+			buffer of each column
+		**/
+		std::vector<std::vector<char>> _buffers;
+		/**
+			bytes of each column already written to the file, or queued
+		**/
+		std::vector<uint64_t> _written;
+		/**
+			buffers waiting for the background thread, with their offset in the file
+		**/
+		std::deque<std::pair<uint64_t, std::vector<char>>> _queue;
+		/**
+			maximum number of queued buffers
+		**/
+		size_t _max_queued;
+		/**
+			flag telling the background thread to stop once the queue is empty
+		**/
+		bool _stop;
+		/**
+			exception raised by the background thread
+		**/
+		std::exception_ptr _error;
+		/**
+			mutex guarding the queue
+		**/
+		std::mutex _mutex;
+		/**
+			condition variable signaling the changes of the queue
+		**/
+		std::condition_variable _changed;
+		/**
+			the background thread, not joinable if there is none
+		**/
+		std::thread _writer;
+	};
+
+	/**
+		Rename the first file to the second one, replacing it atomically,
+		then flush the directory of the second file to the disk, so the renaming survives a crash.
+		It raises a runtime_error exception if the file cannot be renamed or the directory flushed.
+	**/
+	void ReplaceFile (const std::string&, const std::string&);
+
+	/**
+		Archive file mapped in memory, read-only.
+		The header is checked when the file is opened, the columns are not read:
+		opening an archive takes the same time whatever its size,
+		and the pages of the columns are loaded by the system when they are accessed.
+	**/
+	class ArchiveMapping
+	{
+	  public:
+		/**
+			constructor.
+			It raises a runtime_error exception if the file cannot be mapped,
+			or if it is not a complete archive of the current version.
+		**/
+		ArchiveMapping (const std::string&);
+
+		/**
+			destructor.
+			It releases the mapping: the pointers to the columns become invalid.
+		**/
+		virtual ~ArchiveMapping();
+
+		/**
+			The header of the archive
+		**/
+		const ArchiveHeader& Header() const;
+
+		/**
+			Pointer to the first entry of input column
+		**/
+		template <typename T>
+		const T* Column (ArchiveColumn column) const
+		{
+			return reinterpret_cast<const T*> (this->_data + Header().offsets[column]);
+		};
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		ArchiveMapping (const ArchiveMapping&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		ArchiveMapping& operator = (const ArchiveMapping&) = delete;
+
+	  private:
+		/**
+			file descriptor
+		**/
+		int _fd;
+		/**
+			mapped file
+		**/
+		char* _data;
+		/**
+			size of the file
+		**/
+		size_t _size;
+	};
+
+	/**
+		Writer of the approximation computed by a MeshRefiner to an archive file,
+		see ArchiveColumn for the content.
+		Vertices shared by several elements are stored once.
+		The active elements are visited twice: the first time to count the entries of the columns
+		and to number the vertices, the second one to stream the columns to the file,
+		each vertex when it is met for the first time.
+		The memory used grows with the mesh, since two hash tables are kept until the end:
+		the numbers of the vertices, by coordinates, and, if the tree is stored,
+		the indexes of the active elements, by node identifier;
+		the tree is streamed with only the path from the root to the current node in memory,
+		and a buffer is kept for each column.
+	**/
+	template <size_t dim>
+	class ArchiveWriter
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- flag telling if the structure of the whole tree has to be stored
+				- the size of the buffer of each column in bytes
+		**/
+		ArchiveWriter (bool tree = false, size_t buffer_bytes = (1 << 20));
+
+		/**
+			Set if the parameters of the algorithm of every node have to be stored, with the tree,
+			so the refinement can be resumed, see MeshRefiner::Restore().
+			By default they are not stored.
+		**/
+		void StoreState (bool);
+
+		/**
+			Set if the columns are written to the file by a background thread, see ArchiveOutput,
+			so the writes overlap the walk of the mesh; Write() returns when the file is complete anyway.
+			By default they are written by the calling thread.
+		**/
+		void Background (bool);
+
+		/**
+			Set if the archive is flushed to the disk before Write() returns, see ArchiveOutput::Close().
+			By default it is not.
+		**/
+		void Sync (bool);
+
+		/**
+			Write the archive of input refiner, with the mesh loaded, to input file.
+			The coefficients of the projection are computed on the elements which have not stored them,
+			so the objective function may be evaluated.
+			It raises a runtime_error exception if the file cannot be written.
+		**/
+		void Write (MeshRefiner<dim>&, const std::string&) const;
+
+		/**
+			Hash identifying input function, stored with the parameters of the algorithm
+		**/
+		static uint64_t FunctionHash (const Functor<dim>&);
+
+	  private:
+		/**
+			Hash of the coordinates of a vertex
+		**/
+		struct VertexHash
+		{
+			size_t operator() (const std::array<double, dim>& v) const
+			{
+				return SampleCache::Hash (v.data(), dim * sizeof (double));
+			};
+		};
+
+		using VertexIndex = std::unordered_map<std::array<double, dim>, uint64_t, VertexHash>;
+
+		/**
+			Functor counting the entries of the element columns and numbering the vertices
+		**/
+		class Counter : public DimOperator<dim>
+		{
+		  public:
+			Counter (ArchiveHeader&, VertexIndex&, std::unordered_map<size_t, uint64_t>*);
+
+			virtual void operator() (DimensionedNode<dim>*) override;
+
+		  private:
+			ArchiveHeader& _header;
+			VertexIndex& _vertex_index;
+			std::unordered_map<size_t, uint64_t>* _elements;
+		};
+
+		/**
+			Functor appending the active elements to the element columns,
+			and their vertices to the vertices column the first time they are met,
+			i.e. in the order they have been numbered by the Counter
+		**/
+		class ElementWriter : public DimOperator<dim>
+		{
+		  public:
+			ElementWriter (ArchiveOutput&, const VertexIndex&);
+
+			virtual void operator() (DimensionedNode<dim>*) override;
+
+		  private:
+			ArchiveOutput& _output;
+			const VertexIndex& _vertex_index;
+			uint64_t _vertices;
+			uint64_t _connectivity;
+			uint64_t _coefficients;
+		};
+
+		/**
+			Functor appending the nodes of the tree to the tree columns.
+			The nodes are visited each one before its children,
+			so the parent of a node is on the path from the root to the previous node.
+		**/
+		class TreeWriter : public NodeOperator
+		{
+		  public:
+			TreeWriter (ArchiveOutput&, const std::unordered_map<size_t, uint64_t>&, bool state);
+
+			virtual void operator() (BinaryNode*) override;
+
+		  private:
+			ArchiveOutput& _output;
+			const std::unordered_map<size_t, uint64_t>& _elements;
+			bool _state;
+			uint64_t _nodes;
+			std::vector<std::pair<const BinaryNode*, uint64_t>> _path;
+		};
+
+		/**
+			Coordinates of input vertex, with the negative zeros made positive,
+			so equal vertices have the same hash
+		**/
+		static std::array<double, dim> VertexKey (const Geometry::Point<dim>&);
+
+	  private:
+		/**
+			Flag telling if the tree has to be stored
+		**/
+		bool _tree;
+		/**
+			Flag telling if the parameters of the algorithm have to be stored
+		**/
+		bool _state;
+		/**
+			Size of the column buffers
+		**/
+		size_t _buffer_bytes;
+		/**
+			Flag telling if the columns are written by a background thread
+		**/
+		bool _background;
+		/**
+			Flag telling if the archive is flushed to the disk
+		**/
+		bool _sync;
+	};
+
+
+	template <size_t dim>
+	ArchiveWriter<dim>::ArchiveWriter (bool tree, size_t buffer_bytes) :
+		_tree (tree),
+		_state (false),
+		_buffer_bytes (buffer_bytes),
+		_background (false),
+		_sync (false)
+	{}
+
+	template <size_t dim>
+	void ArchiveWriter<dim>::StoreState (bool flag)
+	{
+		this->_state = flag;
+	}
+
+	template <size_t dim>
+	void ArchiveWriter<dim>::Background (bool flag)
+	{
+		this->_background = flag;
+	}
+
+	template <size_t dim>
+	void ArchiveWriter<dim>::Sync (bool flag)
+	{
+		this->_sync = flag;
+	}
+
+	template <size_t dim>
+	uint64_t ArchiveWriter<dim>::FunctionHash (const Functor<dim>& f)
+	{
+		std::string id = f.ID() + '\n' + f.Formula();
+		return SampleCache::Hash (id.data(), id.size());
+	}
+
+	template <size_t dim>
+	void ArchiveWriter<dim>::Write (MeshRefiner<dim>& refiner, const std::string& file_name) const
+	{
+		ArchiveHeader header = {};
+		header.dim = dim;
+		header.iteration = refiner.Iterations();
+		header.error = refiner.GlobalError();
+
+		bool tree = this->_tree || this->_state;
+		VertexIndex vertex_index;
+		std::unordered_map<size_t, uint64_t> elements;
+
+		Counter counter (header, vertex_index, tree ? &elements : nullptr);
+		refiner.IterateActiveNodes (counter);
+		if (tree)
+			header.tree_nodes = refiner.TreeNodesNumber();
+		if (this->_state)
+		{
+			header.state_nodes = header.tree_nodes;
+			header.function = FunctionHash (refiner.GetFunctor());
+		}
+
+		ArchiveOutput output (file_name, header, this->_buffer_bytes, this->_background);
+
+		output.Append (ConnectivityOffsetsColumn, static_cast<uint64_t> (0));
+		output.Append (CoefficientOffsetsColumn, static_cast<uint64_t> (0));
+		ElementWriter element_writer (output, vertex_index);
+		refiner.IterateActiveNodes (element_writer);
+
+		if (tree)
+		{
+			TreeWriter tree_writer (output, elements, this->_state);
+			refiner.IterateTreeNodes (tree_writer);
+		}
+
+		output.Close (this->_sync);
+	}
+
+	template <size_t dim>
+	std::array<double, dim> ArchiveWriter<dim>::VertexKey (const Geometry::Point<dim>& p)
+	{
+		std::array<double, dim> result;
+		for (size_t d = 0; d < dim; ++d)
+			result[d] = p[d] + 0.0;
+
+		return result;
+	}
+
+	template <size_t dim>
+	ArchiveWriter<dim>::Counter::Counter (ArchiveHeader& header,
+										  VertexIndex& vertex_index,
+										  std::unordered_map<size_t, uint64_t>* elements) :
+		_header (header),
+		_vertex_index (vertex_index),
+		_elements (elements)
+	{}
+
+	template <size_t dim>
+	void ArchiveWriter<dim>::Counter::operator() (DimensionedNode<dim>* node)
+	{
+		if (this->_elements)
+			(*this->_elements)[node->NodeID()] = this->_header.elements;
+		++this->_header.elements;
+
+		auto nodes = node->Nodes();
+		for (size_t v = 0; v < nodes.Size(); ++v)
+			if (this->_vertex_index.emplace (VertexKey (nodes[v]), this->_header.vertices).second)
+				++this->_header.vertices;
+		this->_header.connectivity += nodes.Size();
+
+		//the coefficients are computed here, so the writer finds them stored
+		this->_header.coefficients += node->ProjectionCoefficients().Size();
+	}
+
+	template <size_t dim>
+	ArchiveWriter<dim>::ElementWriter::ElementWriter (ArchiveOutput& output,
+													  const VertexIndex& vertex_index) :
+		_output (output),
+		_vertex_index (vertex_index),
+		_vertices (0),
+		_connectivity (0),
+		_coefficients (0)
+	{}
+
+	template <size_t dim>
+	void ArchiveWriter<dim>::ElementWriter::operator() (DimensionedNode<dim>* node)
+	{
+		this->_output.Append (ElementTypesColumn, static_cast<uint32_t> (node->GetType()));
+		this->_output.Append (BasisTypesColumn, static_cast<uint32_t> (node->GetFeType()));
+		this->_output.Append (NodeIDsColumn, static_cast<uint64_t> (node->NodeID()));
+		this->_output.Append (PLevelsColumn, static_cast<uint32_t> (node->PLevel()));
+		this->_output.Append (LocalErrorsColumn, node->ProjectionError());
+
+		auto nodes = node->Nodes();
+		for (size_t v = 0; v < nodes.Size(); ++v)
+		{
+			auto key = VertexKey (nodes[v]);
+			auto index = this->_vertex_index.at (key);
+			if (index > this->_vertices)
+				throw std::runtime_error ("ArchiveWriter: active elements not visited in the counted order");
+			if (index == this->_vertices)
+			{
+				for (auto x : key)
+					this->_output.Append (VerticesColumn, x);
+				++this->_vertices;
+			}
+			this->_output.Append (ConnectivityColumn, index);
+		}
+		this->_connectivity += nodes.Size();
+		this->_output.Append (ConnectivityOffsetsColumn, this->_connectivity);
+
+		auto coeff = node->ProjectionCoefficients();
+		for (size_t i = 0; i < coeff.Size(); ++i)
+			this->_output.Append (CoefficientsColumn, coeff[i]);
+		this->_coefficients += coeff.Size();
+		this->_output.Append (CoefficientOffsetsColumn, this->_coefficients);
+	}
+
+	template <size_t dim>
+	ArchiveWriter<dim>::TreeWriter::TreeWriter (ArchiveOutput& output,
+												const std::unordered_map<size_t, uint64_t>& elements,
+												bool state) :
+		_output (output),
+		_elements (elements),
+		_state (state),
+		_nodes (0),
+		_path()
+	{}
+
+	template <size_t dim>
+	void ArchiveWriter<dim>::TreeWriter::operator() (BinaryNode* node)
+	{
+		//the nodes of the path which are not ancestors of this one have been completed
+		const BinaryNode* dad = node->Dad();
+		while (!this->_path.empty() && this->_path.back().first != dad)
+			this->_path.pop_back();
+
+		uint64_t parent = archive_no_index;
+		if (dad)
+		{
+			if (this->_path.empty())
+				throw std::runtime_error ("ArchiveWriter: tree node visited before its parent");
+			parent = this->_path.back().second;
+		}
+
+		uint64_t element = archive_no_index;
+		auto active = this->_elements.find (node->NodeID());
+		if (active != this->_elements.end())
+			element = active->second;
+
+		this->_output.Append (TreeIDsColumn, static_cast<uint64_t> (node->NodeID()));
+		this->_output.Append (TreeParentsColumn, parent);
+		this->_output.Append (TreePLevelsColumn, static_cast<uint32_t> (node->PLevel()));
+		this->_output.Append (TreeElementsColumn, element);
+
+		if (this->_state)
+		{
+			this->_output.Append (StateErrorsColumn, node->ProjectionError());
+			this->_output.Append (StateEColumn, node->E());
+			this->_output.Append (StateETildeColumn, node->ETilde());
+			this->_output.Append (StateQColumn, node->Q());
+			this->_output.Append (StateTildeErrorsColumn, node->TildeError());
+			//s is a leaf of the subtree, which follows the node
+			this->_output.Append (StateSColumn, static_cast<uint64_t> (node->S()->NodeID()));
+		}
+
+		this->_path.push_back (std::make_pair (node, this->_nodes++));
+	}
+
+} //namespace BinaryTree
+
+#endif //__ARCHIVE_FILE_H
@@ -138,6 +138,18 @@ namespace FiniteElements
 		**/
 		array<size_t, dim> GetIndexes (size_t);
 
+		/**
+			Tell if each basis function is the product of 1D functions,
+			each one depending only on the 1D index of the same coordinate.
+		**/
+		virtual bool IsSeparable() const;
+
+		/**
+			Evaluate the 1D functions until input degree at input 1D point.
+			The i-th value is the i-th factor used by the tensorization.
+		**/
+		virtual Geometry::Vector OneDBasis (size_t, double) const;
+
 	  protected:
 		/**
 			The 1D function which output will be tensorized.
@@ -273,6 +285,22 @@ namespace FiniteElements
 	}
 
 
+	template <size_t dim>
+	bool TensorialBasis<dim>::IsSeparable() const
+	{
+		return true;
+	}
+
+	template <size_t dim>
+	Geometry::Vector TensorialBasis<dim>::OneDBasis (size_t degree, double x) const
+	{
+		Geometry::Vector result (degree + 1);
+		for (size_t k = 0; k <= degree; ++k)
+			result[k] = OneDEvaluation (k, x);
+
+		return result;
+	}
+
 	template <size_t dim>
 	void TensorialBasis<dim>::PrintIndexes()
 	{
@@ -0,0 +1,412 @@
+#ifndef __BATCH_REFINER_H
+#define __BATCH_REFINER_H
+
+#include "MeshRefiner.h"
+#include "Functor.h"
+#include "LibraryInit.h"
+
+#include <vector>
+#include <string>
+#include <memory> //std::unique_ptr
+#include <functional> //std::function
+#include <utility> //std::pair
+#include <ostream> //std::ostream
+#include <thread> //std::thread
+#include <mutex> //std::mutex, std::lock_guard
+#include <atomic> //std::atomic
+#include <chrono> //std::chrono::steady_clock
+#include <exception> //std::exception_ptr
+#include <stdexcept> //std::invalid_argument
+#include <algorithm> //std::max
+
+namespace BinaryTree
+{
+	/**
+		Result of a job of a BatchRefiner
+	**/
+	template <size_t dim>
+	struct JobResult
+	{
+		/**
+			index of the job, in the order the jobs have been added
+		**/
+		size_t job;
+		/**
+			name of the job
+		**/
+		std::string name;
+		/**
+			true if the refinement has been completed
+		**/
+		bool succeeded;
+		/**
+			message of the exception which stopped the job, empty if it succeeded
+		**/
+		std::string failure;
+		/**
+			projection error on the refined mesh
+		**/
+		double error;
+		/**
+			p levels of the active elements
+		**/
+		std::vector<size_t> p_levels;
+		/**
+			vertices of the active elements
+		**/
+		std::vector<Geometry::NodesVector<dim>> vertices;
+		/**
+			seconds spent by the job, the construction of the refiner included
+		**/
+		double seconds;
+	};
+
+	/**
+		Destination of the results of a BatchRefiner.
+		The results are written as soon as the jobs are completed, so their order is not fixed.
+		Calls are serialized by the BatchRefiner, so the derived classes do not need to.
+	**/
+	template <size_t dim>
+	class ResultSink
+	{
+	  public:
+		/**
+			default destructor
+		**/
+		virtual ~ResultSink() {};
+
+		/**
+			Store the result of a job
+		**/
+		virtual void Write (const JobResult<dim>&) = 0;
+	};
+
+	/**
+		Sink writing the results as text on an output stream.
+		For each job a line with its index, name, number of elements, error and time,
+		or the failure message; then a line with the p levels
+		and a line with the vertices of each element.
+	**/
+	template <size_t dim>
+	class StreamSink : public ResultSink<dim>
+	{
+	  public:
+		/**
+			constructor.
+			Input parameter: the output stream, which has to outlive the sink.
+		**/
+		StreamSink (std::ostream&);
+
+		/**
+			default destructor
+		**/
+		virtual ~StreamSink() {};
+
+		virtual void Write (const JobResult<dim>&) override;
+
+	  protected:
+		/**
+			The output stream
+		**/
+		std::ostream& _output;
+	};
+
+	/**
+		Counters of a run of a BatchRefiner
+	**/
+	struct BatchStatistics
+	{
+		/**
+			number of jobs
+		**/
+		size_t jobs = 0;
+		/**
+			number of failed jobs
+		**/
+		size_t failed = 0;
+		/**
+			wall clock seconds of the run
+		**/
+		double seconds = 0;
+
+		/**
+			Throughput of the run
+		**/
+		double JobsPerSecond() const
+		{
+			return this->seconds > 0 ? this->jobs / this->seconds : 0;
+		};
+	};
+
+	/**
+		Service running many independent refinements, one for each functor, on a pool of threads.
+		Each job builds its own refiner, i.e. its own mesh and tree,
+		while the plugins, the quadrature rules and the standard elements with their basis tables
+		are loaded once and shared read only by all the jobs:
+		the tables are filled before the jobs start until the highest degree they can reach,
+		and they do not change while the jobs run, see SharedStdFElements.
+		So the jobs give the same results they would give if run one at a time.
+		The results are streamed to a ResultSink as soon as the jobs are completed.
+		The library has to be initialized (see BinaryTree::Init()) before the service is run.
+	**/
+	template <size_t dim>
+	class BatchRefiner
+	{
+	  public:
+		/**
+			Function building the refiner of a job from its functor.
+			The refiner has to be initialized with the functor, and its mesh loaded,
+			with no refinement done, i.e. with p levels zero.
+			It is called by one thread at a time,
+			so it may use objects shared by the jobs, e.g. the communicator of the meshes.
+		**/
+		using RefinerBuilder =
+			std::function<std::unique_ptr<MeshRefiner<dim>> (std::unique_ptr<Functor<dim>>)>;
+
+		/**
+			constructor.
+			Input parameters:
+				- the builder of the refiners
+				- the number of threads; if zero, the number of hardware threads
+			It raises an invalid_argument exception if the builder is empty.
+		**/
+		BatchRefiner (const RefinerBuilder&, size_t threads = 0);
+
+		/**
+			Add a job refining input functor
+		**/
+		void Add (const std::string&, std::unique_ptr<Functor<dim>>);
+
+		/**
+			Add a job refining the functor of the #BinaryTree::FunctionsFactory with input identifier.
+			The functor is created here, not by the threads running the jobs.
+		**/
+		void Add (const std::string&);
+
+		/**
+			Number of jobs waiting to be run
+		**/
+		size_t Jobs() const;
+
+		/**
+			Degree until which the basis tables have been filled by the last Run()
+		**/
+		size_t PreparedDegree() const;
+
+		/**
+			Run all the jobs.
+			Input parameters:
+				- maximum number of iterations of each refinement
+				- tolerance on the projection error of each refinement
+				- the sink of the results
+			Since every iteration raises the p levels by one at most,
+			the standard elements are shared until the number of iterations while the jobs run,
+			so the memory of their tables grows with it even if the tolerance stops the jobs earlier.
+			A job raising an exception is reported as failed, the other ones go on.
+			The jobs are removed when they are run, so further jobs can be added and run later.
+			It returns the counters of the run;
+			if the sink raises an exception, it is raised again when the threads are done.
+		**/
+		BatchStatistics Run (size_t, double, ResultSink<dim>&);
+
+	  protected:
+		/**
+			Run a job, it never raises exceptions
+		**/
+		JobResult<dim> RunJob (size_t, size_t, double);
+
+	  protected:
+		/**
+			The builder of the refiners
+		**/
+		RefinerBuilder _builder;
+		/**
+			Number of threads
+		**/
+		size_t _threads;
+		/**
+			The jobs: names and functors
+		**/
+		std::vector<std::pair<std::string, std::unique_ptr<Functor<dim>>>> _jobs;
+		/**
+			Mutex serializing the calls to the builder
+		**/
+		std::mutex _builder_mutex;
+		/**
+			Degree until which the basis tables have been filled by the last run
+		**/
+		size_t _prepared_degree;
+	};
+
+
+	template <size_t dim>
+	StreamSink<dim>::StreamSink (std::ostream& output) : _output (output)
+	{}
+
+	template <size_t dim>
+	void StreamSink<dim>::Write (const JobResult<dim>& result)
+	{
+		this->_output << "job " << result.job << " " << result.name << ": ";
+		if (!result.succeeded)
+		{
+			this->_output << "failed, " << result.failure << std::endl;
+			return;
+		}
+
+		this->_output << result.p_levels.size() << " elements, error "
+					  << result.error << ", "
+					  << result.seconds << " s" << std::endl;
+
+		for (auto p : result.p_levels)
+			this->_output << p << " ";
+		this->_output << std::endl;
+
+		for (auto& nodes : result.vertices)
+		{
+			for (size_t i = 0; i < nodes.Size(); ++i)
+				this->_output << nodes[i];
+			this->_output << " ";
+		}
+		this->_output << std::endl;
+	}
+
+	template <size_t dim>
+	BatchRefiner<dim>::BatchRefiner (const RefinerBuilder& builder, size_t threads) :
+		_builder (builder),
+		_threads (threads ? threads : std::max (std::thread::hardware_concurrency(), 1u)),
+		_jobs(),
+		_builder_mutex(),
+		_prepared_degree (0)
+	{
+		if (!builder)
+			throw std::invalid_argument ("BatchRefiner: empty refiner builder");
+	}
+
+	template <size_t dim>
+	void BatchRefiner<dim>::Add (const std::string& name, std::unique_ptr<Functor<dim>> f)
+	{
+		this->_jobs.push_back (std::make_pair (name, std::move (f)));
+	}
+
+	template <size_t dim>
+	void BatchRefiner<dim>::Add (const std::string& functor_id)
+	{
+		auto& f_factory (FunctionsFactory<dim>::Instance());
+		Add (functor_id, f_factory.create (functor_id));
+	}
+
+	template <size_t dim>
+	size_t BatchRefiner<dim>::Jobs() const
+	{
+		return this->_jobs.size();
+	}
+
+	template <size_t dim>
+	size_t BatchRefiner<dim>::PreparedDegree() const
+	{
+		return this->_prepared_degree;
+	}
+
+	template <size_t dim>
+	BatchStatistics BatchRefiner<dim>::Run (size_t n_iter, double tol, ResultSink<dim>& sink)
+	{
+		//the tables are filled before the threads start, then they are only read
+		this->_prepared_degree = std::max<size_t> (n_iter, 1);
+		SharedStdFElements<dim> shared (this->_prepared_degree);
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::atomic<size_t> next (0);
+		std::atomic<size_t> failed (0);
+		std::mutex sink_mutex;
+		std::exception_ptr sink_error = nullptr;
+
+		auto worker = [&] ()
+		{
+			for (size_t job = next++; job < this->_jobs.size(); job = next++)
+			{
+				auto result = RunJob (job, n_iter, tol);
+				if (!result.succeeded)
+					++failed;
+
+				std::lock_guard<std::mutex> lock (sink_mutex);
+				if (sink_error)
+					continue;
+				try
+				{
+					sink.Write (result);
+				}
+				catch (...)
+				{
+					sink_error = std::current_exception();
+				}
+			}
+		};
+
+		std::vector<std::thread> pool;
+		size_t n_threads = std::min (this->_threads, this->_jobs.size());
+		for (size_t t = 1; t < n_threads; ++t)
+			pool.emplace_back (worker);
+
+		//the calling thread works too
+		worker();
+		for (auto& t : pool)
+			t.join();
+
+		BatchStatistics statistics;
+		statistics.jobs = this->_jobs.size();
+		statistics.failed = failed;
+		statistics.seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+		this->_jobs.clear();
+
+		if (sink_error)
+			std::rethrow_exception (sink_error);
+
+		return statistics;
+	}
+
+	template <size_t dim>
+	JobResult<dim> BatchRefiner<dim>::RunJob (size_t job, size_t n_iter, double tol)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		JobResult<dim> result;
+		result.job = job;
+		result.name = this->_jobs[job].first;
+		result.succeeded = false;
+		result.error = 0;
+
+		try
+		{
+			std::unique_ptr<MeshRefiner<dim>> refiner;
+			{
+				std::lock_guard<std::mutex> lock (this->_builder_mutex);
+				refiner = this->_builder (std::move (this->_jobs[job].second));
+			}
+			if (!refiner)
+				throw std::runtime_error ("no refiner built");
+
+			refiner->Refine (n_iter, tol);
+
+			result.error = refiner->GlobalError();
+			result.p_levels = refiner->ExtractPLevels();
+			result.vertices = refiner->ExtractVertices();
+			result.succeeded = true;
+		}
+		catch (std::exception& e)
+		{
+			result.failure = e.what();
+		}
+		catch (...)
+		{
+			result.failure = "unknown exception";
+		}
+
+		result.seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+		return result;
+	}
+
+} //namespace BinaryTree
+
+#endif //__BATCH_REFINER_H
@@ -1,10 +1,14 @@
 #ifndef __BINARY_GOD_FATHER_H
 #define __BINARY_GOD_FATHER_H
 
-#include <algorithm> //std::for_each
+#include <algorithm> //std::for_each, std::any_of
 #include <list> //std::list
+#include <vector> //std::vector
+#include <functional> //std::function
+#include <unordered_map>
 
 #include "BinaryNode.h"
+#include "LibraryInit.h" //PrepareStdFElements
 
 namespace BinaryTree
 {
@@ -21,7 +25,7 @@ namespace BinaryTree
 		/**
 			default constructor
 		**/
-		DimensionedGodFather() {};
+		DimensionedGodFather() : _elements(), _composite_projections (false) {};
 
 		/**
 			default destructor
@@ -52,8 +56,60 @@ namespace BinaryTree
 			and when it finds that node parameters E = e it makes the trim,
 			that is it activate the node and deactivate the whole subtree rooted at that node.
 			No element is destroyed.
+			If the input flag is true, the deactivated nodes are also compacted, see RecursiveSelector.
 		**/
-		void SelectActiveNodes();
+		void SelectActiveNodes (bool compact = false);
+
+		/**
+			Change the function projected on every node of the tree,
+			inactive ones included, see DimensionedNode::SetFunctor().
+			Nothing is computed here: the nodes are marked as outdated,
+			see BinaryNode::Outdated(), until RebuildParameters() is called.
+		**/
+		void SetFunctor (const FunctionPtr<dim>&);
+
+		/**
+			Set the composite projection mode of every node of the tree,
+			see DimensionedNode::CompositeProjections().
+			The mode is kept and given also to the elements added by FillElements(),
+			while the nodes created by the bisections take it from their father.
+		**/
+		void CompositeProjections (bool);
+
+		/**
+			Compute again the parameters of every node of the tree,
+			e.g. after the projected function has been changed, see ParametersRebuilder.
+			Input parameter: the number of threads computing the projection errors;
+			if more than one, the function has to support concurrent evaluations,
+			and the standard elements are shared until the highest p level of the tree
+			while the threads run, see SharedStdFElements.
+			The active nodes are not selected again, SelectActiveNodes() has to be called.
+		**/
+		void RebuildParameters (size_t threads = 1);
+
+		/**
+			Tell if the parameters of the nodes are outdated,
+			i.e. SetFunctor() has been called and RebuildParameters() not yet.
+		**/
+		bool Outdated() const;
+
+		/**
+			Number of nodes of the whole tree, inactive ones included.
+		**/
+		size_t TreeNodesNumber() const;
+
+		/**
+			Bytes of memory owned by the nodes of the whole tree.
+		**/
+		size_t TreeResidentBytes() const;
+
+		/**
+			Call the input functor on every node of the whole tree, inactive ones included.
+			The trees of the initial elements are visited one after the other,
+			each node before its children, the left child before the right one.
+		**/
+		template <typename Visitor>
+		void IterateTree (Visitor&) const;
 
 	  protected:
 		/**
@@ -61,6 +117,11 @@ namespace BinaryTree
 		**/
 		void SortElements();
 
+		/**
+			Change the function projected on the nodes of the subtree rooted at input node
+		**/
+		static void SetSubTreeFunctor (BinaryNode*, const FunctionPtr<dim>&);
+
 	  protected:
 		/**
 			These are the binary elements of the initial mesh.
@@ -69,6 +130,10 @@ namespace BinaryTree
 			when S() method being called on it, must return the next element to be divided
 		**/
 		std::list<DimensionedNode<dim>*> _elements;
+		/**
+			Composite projection mode of the nodes
+		**/
+		bool _composite_projections;
 	};
 
 
@@ -76,9 +141,14 @@ namespace BinaryTree
 	{
 	  public:
 		/**
-			default constructor
+			constructor.
+			If the input flag is true, the deactivated nodes are compacted, see BinaryNode::Compact():
+			each node is compacted only once, the first time it is deactivated
+			after its creation or after having been active,
+			so the nodes rebuilt on demand, e.g. the ancestors of the bisected leaves,
+			keep their data until they become active again.
 		**/
-		RecursiveSelector();
+		RecursiveSelector (bool compact = false);
 		/**
 			default destructor
 		**/
@@ -89,6 +159,16 @@ namespace BinaryTree
 		**/
 		void operator() (BinaryNode*);
 
+		/**
+			Activate input node and deactivate its subtrees
+		**/
+		void Trim (BinaryNode*);
+
+		/**
+			Deactivate input node, without modifying its subtrees
+		**/
+		void Deactivate (BinaryNode*);
+
 		/**
 			Deactivate every element of the subtree rooted at input node
 		**/
@@ -97,10 +177,183 @@ namespace BinaryTree
 	  protected:
 		/**
 			Recursive selection of active nodes.
-			If E = e it activates the input node and deactivate the subtree rooted at it,
+			If E = e it trims the tree at the input node,
 			otherwise the node is deactivated and the recursive selection done on the children.
 		**/
 		void SelectActiveNodesRecursively (BinaryNode*);
+
+	  protected:
+		/**
+			Flag telling if deactivated nodes have to be compacted
+		**/
+		bool _compact;
+	};
+
+	/**
+		Update the parameters of the algorithm on the path from input node to the root of its tree,
+		after the bisection of a leaf of its subtree has raised their p level:
+			E = min{E(D1) + E(D2), e}, E~ = E * (previous E~) / (E + previous E~),
+			q = min{max{q(D1), q(D2)}, E~}, s = s(argmax{q(D1), q(D2)}).
+		The projection error e of each node is its current one, see BinaryNode::ProjectionError().
+	**/
+	void ClimbUp (BinaryNode*);
+
+	/**
+		As the other overload, with the projection error e of each node given by input function.
+	**/
+	void ClimbUp (BinaryNode*, const std::function<double (BinaryNode*)>&);
+
+	/**
+		Class computing again the parameters of the nodes of binary trees,
+		as if the trees had been built by the algorithm with the current function.
+		The trees are added through operator(), then Rebuild() does the work:
+			-	the projection errors of the nodes at each p level until the current one are computed,
+				possibly by several threads, see DimensionedNode::LowerProjectionErrors();
+				since the error of a node may use the samples of its children (composite projections),
+				the nodes are processed by height, leaves first,
+				and the nodes with the same height, which are in disjoint subtrees, concurrently;
+			-	the bisections are replayed in the order they have been done,
+				given by the identifiers of the children they have created, as MultiResolution does:
+				the new leaves get the values set when they have been created,
+				then ClimbUp() updates their ancestors with the errors at the p levels they had,
+				so e~, E, E~, q, s are the ones the algorithm would have computed.
+		No projection is computed while replaying, the errors are the ones computed before:
+		the errors at the lower p levels may differ from the ones computed by the algorithm
+		by the quadrature error, which affects E~, q and s, not e and E.
+		At the end the nodes are marked as updated, see BinaryNode::Outdated().
+	**/
+	class ParametersRebuilder
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the function giving the projection errors of a node at each p level until the current one
+				- the number of threads computing the projection errors
+		**/
+		ParametersRebuilder (const std::function<std::vector<double> (BinaryNode*)>&, size_t threads = 1);
+		/**
+			default destructor
+		**/
+		virtual ~ParametersRebuilder();
+		/**
+			Add the tree rooted at input node
+		**/
+		void operator() (BinaryNode*);
+
+		/**
+			The highest p level of the added trees
+		**/
+		size_t MaxPLevel() const;
+
+		/**
+			Compute again the parameters of the added trees.
+			If the computation of a projection error raises an exception,
+			it is raised again when the threads are done.
+			It raises a logic_error exception if the p level of a node
+			is not the number of bisections in its subtree.
+		**/
+		void Rebuild();
+
+	  protected:
+		/**
+			Add the subtree rooted at input node to the nodes grouped by height.
+			It returns the height of the node.
+		**/
+		size_t Collect (BinaryNode*);
+
+		/**
+			Compute the projection errors of the nodes with input indexes
+		**/
+		void ComputeErrors (const std::vector<size_t>&);
+
+		/**
+			Projection error of input node at the p level it has while the bisections are replayed
+		**/
+		double ReplayedError (BinaryNode*) const;
+
+	  protected:
+		/**
+			Function giving the projection errors of a node at each p level
+		**/
+		std::function<std::vector<double> (BinaryNode*)> _lower_errors;
+		/**
+			Number of threads
+		**/
+		size_t _threads;
+		/**
+			Roots of the added trees
+		**/
+		std::vector<BinaryNode*> _roots;
+		/**
+			Nodes of the added trees
+		**/
+		std::vector<BinaryNode*> _nodes;
+		/**
+			Index of each node in _nodes
+		**/
+		std::unordered_map<BinaryNode*, size_t> _indexes;
+		/**
+			Indexes of the nodes grouped by height, leaves first
+		**/
+		std::vector<std::vector<size_t>> _heights;
+		/**
+			Nodes with children, i.e. the bisected ones
+		**/
+		std::vector<BinaryNode*> _bisected;
+		/**
+			Projection errors of each node at the p levels until the current one
+		**/
+		std::vector<std::vector<double>> _errors;
+		/**
+			p level of each node while the bisections are replayed
+		**/
+		std::vector<size_t> _levels;
+		/**
+			Highest p level
+		**/
+		size_t _max_p_level;
+	};
+
+	/**
+		Class collecting memory occupation of a binary tree.
+		It visits every node of the subtree rooted at input node, inactive ones included.
+	**/
+	class MemoryInspector
+	{
+	  public:
+		/**
+			default constructor
+		**/
+		MemoryInspector();
+		/**
+			default destructor
+		**/
+		virtual ~MemoryInspector();
+		/**
+			Add the nodes of the subtree rooted at input node to the count
+		**/
+		void operator() (BinaryNode*);
+
+		/**
+			Number of visited nodes
+		**/
+		size_t NodesNumber() const;
+
+		/**
+			Bytes owned by the visited nodes
+		**/
+		size_t ResidentBytes() const;
+
+	  protected:
+		/**
+			Nodes counter
+		**/
+		size_t _nodes;
+		/**
+			Bytes counter
+		**/
+		size_t _bytes;
 	};
 
 	template <size_t dim>
@@ -114,17 +367,119 @@ namespace BinaryTree
 		for (; begin != end; ++begin)
 			this->_elements.push_back (extract (begin));
 
+		CompositeProjections (this->_composite_projections);
 		SortElements();
 	}
 
 
 	template <size_t dim>
-	void DimensionedGodFather<dim>::SelectActiveNodes()
+	void DimensionedGodFather<dim>::SelectActiveNodes (bool compact)
 	{
-		RecursiveSelector rs;
+		RecursiveSelector rs (compact);
 		std::for_each (_elements.begin(), _elements.end(), rs);
 	}
 
+	template <size_t dim>
+	void DimensionedGodFather<dim>::SetFunctor (const FunctionPtr<dim>& f)
+	{
+		for (auto element : this->_elements)
+			SetSubTreeFunctor (element, f);
+	}
+
+	template <size_t dim>
+	void DimensionedGodFather<dim>::CompositeProjections (bool flag)
+	{
+		this->_composite_projections = flag;
+
+		auto set_mode = [flag] (BinaryNode * node)
+		{
+			dynamic_cast<DimensionedNode<dim>*> (node)->CompositeProjections (flag);
+		};
+		IterateTree (set_mode);
+	}
+
+	template <size_t dim>
+	void DimensionedGodFather<dim>::SetSubTreeFunctor (BinaryNode* node, const FunctionPtr<dim>& f)
+	{
+		if (node)
+		{
+			dynamic_cast<DimensionedNode<dim>*> (node)->SetFunctor (f);
+			node->Outdated (true);
+
+			SetSubTreeFunctor (node->Left(), f);
+			SetSubTreeFunctor (node->Right(), f);
+		}
+	}
+
+	template <size_t dim>
+	void DimensionedGodFather<dim>::RebuildParameters (size_t threads)
+	{
+		auto lower_errors = [] (BinaryNode * node)
+		{
+			return dynamic_cast<DimensionedNode<dim>*> (node)->LowerProjectionErrors();
+		};
+
+		ParametersRebuilder pr (lower_errors, threads);
+		for (auto element : this->_elements)
+			pr (element);
+
+		if (threads < 2)
+		{
+			pr.Rebuild();
+			return;
+		}
+
+		//the standard elements are only read by the threads
+		SharedStdFElements<dim> shared (pr.MaxPLevel());
+		pr.Rebuild();
+	}
+
+	template <size_t dim>
+	bool DimensionedGodFather<dim>::Outdated() const
+	{
+		//the roots are marked as the other nodes, see SetFunctor()
+		return std::any_of (_elements.begin(), _elements.end(),
+							[] (BinaryNode * node) {return node->Outdated();});
+	}
+
+	template <size_t dim>
+	size_t DimensionedGodFather<dim>::TreeNodesNumber() const
+	{
+		MemoryInspector mi;
+		mi = std::for_each (_elements.begin(), _elements.end(), mi);
+		return mi.NodesNumber();
+	}
+
+	template <size_t dim>
+	size_t DimensionedGodFather<dim>::TreeResidentBytes() const
+	{
+		MemoryInspector mi;
+		mi = std::for_each (_elements.begin(), _elements.end(), mi);
+		return mi.ResidentBytes();
+	}
+
+	template <size_t dim>
+	template <typename Visitor>
+	void DimensionedGodFather<dim>::IterateTree (Visitor& visitor) const
+	{
+		std::vector<BinaryNode*> stack;
+		for (auto element : this->_elements)
+		{
+			stack.push_back (element);
+			while (!stack.empty())
+			{
+				auto node = stack.back();
+				stack.pop_back();
+				visitor (node);
+
+				if (node->Right())
+					stack.push_back (node->Right());
+				if (node->Left())
+					stack.push_back (node->Left());
+			}
+		}
+	}
+
 	template <size_t dim>
 	BinaryNode* DimensionedGodFather<dim>::MakeBisection()
 	{
@@ -4,6 +4,8 @@
 #include <vector> //std::vector
 
 #include "LinearAlgebra.h"
+#include "SampleBatch.h"
+#include "TypeEnumerations.h"
 
 namespace BinaryTree
 {
@@ -90,6 +92,16 @@ namespace BinaryTree
 		**/
 		virtual void TildeError (double val);
 
+		/**
+			Tell if the parameters of the algorithm have to be computed again,
+			e.g. after the projected function has been changed, see DimensionedGodFather::SetFunctor()
+		**/
+		bool Outdated() const;
+		/**
+			Mark the parameters of the algorithm as outdated or computed
+		**/
+		void Outdated (bool);
+
 		/**
 			get the pointer to the left child node of the element.
 			It returns nullptr if the node is a leaf
@@ -143,6 +155,43 @@ namespace BinaryTree
 		**/
 		virtual size_t NodeID() = 0;
 
+		/**
+			Release the heavy data of the node.
+			Only the parameters needed by the algorithm (e, E, E~, q, s) are kept,
+			everything else has to be rebuilt on demand by derived classes.
+			By default there is nothing to release.
+		**/
+		virtual void Compact();
+
+		/**
+			Number of times the data released by Compact() have been rebuilt.
+			By default nothing is released, so nothing is rebuilt.
+		**/
+		virtual size_t Rebuilds() const;
+
+		/**
+			Tell if the node may be compacted when it is deactivated, see RecursiveSelector
+		**/
+		bool Compactable() const;
+		/**
+			Set if the node may be compacted when it is deactivated
+		**/
+		void Compactable (bool);
+
+		/**
+			get the number of bytes owned by the node
+		**/
+		virtual size_t ResidentBytes() const;
+
+		/**
+			Set the e parameter and the coefficients of the projection at the current p level,
+			as computed by a previous run, see MeshRefiner::Restore();
+			they are not computed again until the node is modified.
+			If no coefficient is given, they are computed when they are needed.
+			By default it raises a logic_error exception.
+		**/
+		virtual void RestoreProjection (double, const Geometry::VectorView&);
+
 	  protected:
 		/**
 			s = s(argmax{q(D1), q(D2)}).
@@ -171,6 +220,55 @@ namespace BinaryTree
 			leaf value : e~ = e
 		**/
 		double _tilde_error;
+		/**
+			true if e, e~, E, E~, q, s are not the ones of the current function.
+			initial value : false
+		**/
+		bool _outdated;
+		/**
+			true if the node has not been compacted since its creation or its last activation.
+			initial value : true
+		**/
+		bool _compactable;
+	};
+
+	/**
+		While an object of this class exists, the nodes initialized by the thread which has created it
+		do not compute their projection error, nor the parameters of the algorithm:
+		they have to be set afterwards, e.g. by MeshRefiner::Restore().
+		Objects can be nested, the projections are deferred until the outermost one is destroyed.
+	**/
+	class DeferredProjections
+	{
+	  public:
+		/**
+			constructor
+		**/
+		DeferredProjections();
+		/**
+			destructor
+		**/
+		~DeferredProjections();
+
+		/**
+			Tell if the projections are deferred in the calling thread
+		**/
+		static bool Active();
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		DeferredProjections (const DeferredProjections&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		DeferredProjections& operator = (const DeferredProjections&) = delete;
+
+		/**
+			Number of objects existing in the calling thread
+		**/
+		static size_t& Count();
 	};
 
 	/**
@@ -198,6 +296,78 @@ namespace BinaryTree
 			vertices of the underliying geometry
 		**/
 		virtual Geometry::NodesVector<dim> Nodes() const = 0;
+		/**
+			type of the underlying geometry
+		**/
+		virtual Geometry::ElementType GetType() const = 0;
+		/**
+			type of the basis of the underlying finite element
+		**/
+		virtual FiniteElements::BasisType GetFeType() const = 0;
+		/**
+			Coefficients of the projection on the basis of the underlying finite element,
+			one for each basis function of the current p level.
+			The view is valid until the node is modified.
+		**/
+		virtual Geometry::VectorView ProjectionCoefficients() const = 0;
+		/**
+			Tell if the coefficients of the current p level are stored,
+			so ProjectionCoefficients() does not evaluate the function;
+			they are not after the node has been compacted, see Compact().
+		**/
+		virtual bool StoresCoefficients() const = 0;
+		/**
+			Number of basis functions of the underlying finite element at input p level
+		**/
+		virtual size_t BasisSize (size_t) const = 0;
+		/**
+			Projection errors at each p level from 0 to the current one.
+			Since the basis is orthogonal, the projection at a lower p level
+			is the truncation of the current one, so its error is computed
+			from the current projection error and coefficients.
+		**/
+		virtual std::vector<double> LowerProjectionErrors() = 0;
+		/**
+			Projection errors of the functions projected on the node,
+			when the objective is a set of functions (see FunctorSet),
+			one for each function and not weighted;
+			by default a node projects a single function, whose error is ProjectionError().
+		**/
+		virtual std::vector<double> FieldProjectionErrors()
+		{
+			return std::vector<double> (1, this->ProjectionError());
+		};
+		/**
+			Change the function projected on the node.
+			The parameters depending on it are not recomputed here,
+			they are invalidated: the projection error is computed again when it is requested.
+		**/
+		virtual void SetFunctor (const FunctionPtr<dim>&) = 0;
+		/**
+			Set the composite projection mode of the node:
+			if true, the projection on a node with children is computed
+			by the composite rule given by the quadrature rules of the children,
+			reusing the samples of the function they have already computed.
+			By default nodes do not support it and the mode is ignored.
+		**/
+		virtual void CompositeProjections (bool) {};
+		/**
+			Composite projection mode of the node, see CompositeProjections(bool)
+		**/
+		virtual bool CompositeProjections() const
+		{
+			return false;
+		};
+		/**
+			Add to input batch the points where the objective function
+			has to be evaluated to update the projection error.
+			It returns false if no evaluation is needed;
+			by default nodes do not support batched evaluations.
+		**/
+		virtual bool RequestSamples (SampleBatch<dim>&)
+		{
+			return false;
+		};
 	};
 
 
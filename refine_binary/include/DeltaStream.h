@@ -0,0 +1,313 @@
+#ifndef __DELTA_STREAM_H
+#define __DELTA_STREAM_H
+
+#include <string>
+#include <vector>
+#include <memory> //std::unique_ptr
+#include <fstream> //std::ofstream, std::ifstream
+#include <cstdint> //uint64_t
+#include <atomic> //std::atomic
+#include <thread> //std::thread
+#include <mutex> //std::mutex
+#include <condition_variable>
+#include <exception> //std::exception_ptr
+#include <stdexcept> //std::runtime_error, std::invalid_argument
+
+namespace BinaryTree
+{
+	/**
+		Changes of the active elements between two snapshots of a SnapshotStream.
+		The elements are stored column by column, as in ApproximationSnapshot.
+	**/
+	struct SnapshotDelta
+	{
+		/**
+			iterations performed by the refiner
+		**/
+		uint64_t iteration;
+		/**
+			projection error of the refiner
+		**/
+		double error;
+		/**
+			identifiers of the nodes which are no longer active
+		**/
+		std::vector<uint64_t> trimmed;
+		/**
+			identifiers of the nodes which have become active, or whose p level has changed
+		**/
+		std::vector<uint64_t> node_ids;
+		/**
+			p level of each element
+		**/
+		std::vector<uint64_t> p_levels;
+		/**
+			projection error on each element
+		**/
+		std::vector<double> local_errors;
+		/**
+			Geometry::ElementType of each element
+		**/
+		std::vector<uint64_t> types;
+		/**
+			FiniteElements::BasisType of each element
+		**/
+		std::vector<uint64_t> fe_types;
+		/**
+			number of coordinates of the vertices of each element
+		**/
+		std::vector<uint64_t> vertex_counts;
+		/**
+			number of projection coefficients of each element
+		**/
+		std::vector<uint64_t> coeff_counts;
+		/**
+			coordinates of the vertices of the elements, vertex after vertex
+		**/
+		std::vector<double> vertices;
+		/**
+			projection coefficients of the elements
+		**/
+		std::vector<double> coefficients;
+	};
+
+	/**
+		Bounded queue of deltas between one producer and one consumer thread, without locks:
+		each thread only writes its own position, so Push() and Pop() never wait.
+	**/
+	class DeltaQueue
+	{
+	  public:
+		/**
+			constructor.
+			It raises an invalid_argument exception if the capacity is zero.
+		**/
+		DeltaQueue (size_t capacity);
+
+		/**
+			Append input delta, which is moved into the queue.
+			It returns false, leaving the delta unchanged, if the queue is full.
+			To be called by the producer thread only.
+		**/
+		bool Push (std::unique_ptr<SnapshotDelta>&);
+
+		/**
+			Remove the first delta, nullptr if the queue is empty.
+			To be called by the consumer thread only.
+		**/
+		std::unique_ptr<SnapshotDelta> Pop();
+
+		/**
+			Tell if Push() would fail
+		**/
+		bool Full() const;
+
+		/**
+			Tell if Pop() would return nullptr
+		**/
+		bool Empty() const;
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		DeltaQueue (const DeltaQueue&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		DeltaQueue& operator = (const DeltaQueue&) = delete;
+
+	  private:
+		/**
+			ring of slots, the delta pushed n-th is in slot n modulo the capacity
+		**/
+		std::vector<std::unique_ptr<SnapshotDelta>> _slots;
+		/**
+			number of deltas popped, written by the consumer
+		**/
+		std::atomic<size_t> _head;
+		/**
+			number of deltas pushed, written by the producer
+		**/
+		std::atomic<size_t> _tail;
+	};
+
+	/**
+		Writer of a delta stream file.
+		The deltas are passed through a DeltaQueue to a background thread,
+		which writes and flushes them one at a time,
+		so an interrupted stream loses at most the last delta, which is ignored by DeltaStreamReader.
+	**/
+	class DeltaStreamWriter
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the file name
+				- the dimension of the mesh
+				- the capacity of the queue
+			It raises a runtime_error exception if the file cannot be written.
+		**/
+		DeltaStreamWriter (const std::string&, size_t dim, size_t capacity);
+
+		/**
+			destructor.
+			The background thread writes the queued deltas, then it is stopped.
+		**/
+		~DeltaStreamWriter();
+
+		/**
+			Pass input delta to the background thread.
+			It returns false, leaving the delta unchanged, if the queue is full; it never waits.
+			It raises again the exception raised by the background thread, if any.
+		**/
+		bool Push (std::unique_ptr<SnapshotDelta>&);
+
+		/**
+			Tell if Push() would fail
+		**/
+		bool Full() const;
+
+		/**
+			Wait for the background thread to write every queued delta.
+			It raises again the exception raised by the background thread, if any.
+		**/
+		void Drain();
+
+	  private:
+		/**
+			Loop of the background thread, writing the queued deltas
+		**/
+		void WriteQueued();
+
+		/**
+			Write input delta to the file
+		**/
+		void Write (const SnapshotDelta&);
+
+		/**
+			Raise again the exception raised by the background thread, if any
+		**/
+		void CheckError();
+
+		/**
+			deleted copy constructor
+		**/
+		DeltaStreamWriter (const DeltaStreamWriter&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		DeltaStreamWriter& operator = (const DeltaStreamWriter&) = delete;
+
+	  private:
+		/**
+			file name
+		**/
+		std::string _file_name;
+		/**
+			the stream file
+		**/
+		std::ofstream _file;
+		/**
+			queue of the deltas waiting to be written
+		**/
+		DeltaQueue _queue;
+		/**
+			number of deltas pushed
+		**/
+		std::atomic<size_t> _pushed;
+		/**
+			number of deltas written, or discarded after an error
+		**/
+		std::atomic<size_t> _written;
+		/**
+			flag telling if the background thread has raised an exception
+		**/
+		std::atomic<bool> _failed;
+		/**
+			flag telling the background thread to stop once the queue is empty
+		**/
+		bool _stop;
+		/**
+			exception raised by the background thread
+		**/
+		std::exception_ptr _error;
+		/**
+			mutex guarding the stop flag and the exception;
+			the producer locks it only in Drain() and after an error
+		**/
+		std::mutex _mutex;
+		/**
+			condition variable waking up the background thread
+		**/
+		std::condition_variable _wake;
+		/**
+			condition variable signaling the written deltas
+		**/
+		std::condition_variable _done;
+		/**
+			the background thread
+		**/
+		std::thread _writer;
+	};
+
+	/**
+		Reader of the deltas of a stream file, one at a time,
+		so the stream is never loaded as a whole.
+	**/
+	class DeltaStreamReader
+	{
+	  public:
+		/**
+			constructor.
+			It raises a runtime_error exception if the file cannot be read,
+			or if it is not a delta stream of input dimension.
+		**/
+		DeltaStreamReader (const std::string&, size_t dim);
+
+		/**
+			Read the next delta into the input one.
+			It returns false if there are no more deltas;
+			a delta truncated by the end of the file is not read.
+		**/
+		bool Next (SnapshotDelta&);
+
+	  private:
+		/**
+			Read input number of values; it returns false if the file ends before
+		**/
+		bool ReadValues (void*, size_t);
+
+		/**
+			Read input number of values into input vector
+		**/
+		template <typename T>
+		bool ReadColumn (std::vector<T>& column, size_t n)
+		{
+			column.resize (n);
+			return ReadValues (column.data(), n);
+		};
+
+	  private:
+		/**
+			file name
+		**/
+		std::string _file_name;
+		/**
+			the stream file
+		**/
+		std::ifstream _file;
+		/**
+			size of the file
+		**/
+		size_t _file_size;
+		/**
+			bytes of the header and of the deltas read
+		**/
+		size_t _read_bytes;
+	};
+
+} //namespace BinaryTree
+
+#endif //__DELTA_STREAM_H
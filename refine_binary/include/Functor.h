@@ -4,6 +4,9 @@
 #include "LinearAlgebra.h"
 #include "AbstractFactory.h"
 
+#include <vector>
+#include <future> //std::future, std::async
+
 namespace BinaryTree
 {
 	/**
@@ -29,6 +32,45 @@ namespace BinaryTree
 			It takes as input the Point where the functor has to be evaluated.
 		**/
 		virtual double operator() (const Geometry::Point<dim>& p) const = 0;
+		/**
+			Batched evaluation.
+			Input parameters:
+				- the coordinates of the points, stored point after point
+				- the storage for the values, of the same size as the number of points
+				- the number of points
+			By default operator() is called on each point,
+			functors which can do better, e.g. the compiled ones, override it.
+		**/
+		virtual void Evaluate (const double* points, double* values, size_t n) const
+		{
+			Geometry::Point<dim> p;
+			for (size_t q = 0; q < n; ++q, points += dim)
+			{
+				for (size_t i = 0; i < dim; ++i)
+					p[i] = points[i];
+				values[q] = (*this) (p);
+			}
+		};
+		/**
+			Asynchronous batched evaluation.
+			Input parameter: the coordinates of the points, stored point after point.
+			It returns the future values at the points.
+			By default the evaluation is deferred, i.e. Evaluate() is called
+			when the values are requested, so functors which are not thread safe can be used;
+			functors backed by an external solver override it,
+			so the caller can go on while the values are computed.
+		**/
+		virtual std::future<std::vector<double>> Submit (std::vector<double> points) const
+		{
+			return std::async (std::launch::deferred,
+							   [this] (const std::vector<double>& p)
+			{
+				std::vector<double> values (p.size() / dim);
+				this->Evaluate (p.data(), values.data(), values.size());
+				return values;
+			},
+			std::move (points));
+		};
 		/**
 			The mathematical expression implented by the functor.
 		**/
@@ -39,6 +81,60 @@ namespace BinaryTree
 		virtual std::string ID() const = 0;
 	};
 
+	/**
+		Base class for separable functions, i.e. products of 1D functions
+			f(x_0, ..., x_dim-1) = f_0(x_0) * ... * f_dim-1(x_dim-1).
+		Binary elements can take advantage of the separability:
+		on elements which are boxes aligned to the axes, with tensorial basis and quadrature rule,
+		the projection is computed from the 1D projections of the factors,
+		so the function is evaluated only along the 1D quadrature nodes.
+	**/
+	template <size_t dim>
+	class SeparableFunctor : public Functor<dim>
+	{
+	  public:
+		/**
+			default constructor
+		**/
+		SeparableFunctor() {};
+		/**
+			default destructor
+		**/
+		virtual ~SeparableFunctor() {};
+
+		/**
+			call operator.
+			It returns the product of the factors.
+		**/
+		virtual double operator() (const Geometry::Point<dim>& p) const override
+		{
+			double result = 1;
+			for (size_t i = 0; i < dim; ++i)
+				result *= Factor (i, p[i]);
+
+			return result;
+		};
+
+		/**
+			Evaluate the factor depending on input coordinate.
+			Input parameters:
+				- the coordinate index
+				- the value of the coordinate
+		**/
+		virtual double Factor (size_t, double) const = 0;
+
+		/**
+			Tell if the function is actually separable.
+			Functors which are separable only for some values of their parameters,
+			e.g. parsed expressions, return false if they are not,
+			so the factors must not be used.
+		**/
+		virtual bool IsSeparable() const
+		{
+			return true;
+		};
+	};
+
 	/**
 		Factory for Functor objects.
 		The key is a string which identifies the function.
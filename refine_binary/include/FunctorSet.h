@@ -0,0 +1,185 @@
+#ifndef __FUNCTOR_SET_H
+#define __FUNCTOR_SET_H
+
+#include "Functor.h"
+
+#include <vector>
+#include <stdexcept> //std::invalid_argument
+#include <algorithm> //std::max
+
+namespace BinaryTree
+{
+	/**
+		How the projection errors of several functions are combined in a single error
+	**/
+	enum ErrorCombination
+	{
+		/**
+			square root of the sum of the squared weighted errors
+		**/
+		SumOfSquares,
+		/**
+			maximum of the weighted errors
+		**/
+		WeightedMax
+	};
+
+	/**
+		Set of functions adapted by the same tree.
+		Binary elements detect it, as they do with SeparableFunctor:
+		the points are mapped once and all the functions are evaluated on them,
+		each one is projected with the same basis tables,
+		and the projection error of the element combines their errors.
+		Called as a single functor, e.g. to compute the projection of an element,
+		it behaves as the first function of the set.
+	**/
+	template <size_t dim>
+	class FunctorSet : public Functor<dim>
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the functions, at least one
+				- their weights in the combined error; if empty, all weights are 1
+				- the combination of the errors
+			It raises an invalid_argument exception if the set is empty
+			or the weights are not as many as the functions.
+		**/
+		FunctorSet (const std::vector<FunctionPtr<dim>>&,
+					const std::vector<double>& weights = {},
+					ErrorCombination = SumOfSquares);
+
+		/**
+			default destructor
+		**/
+		virtual ~FunctorSet() {};
+
+		/**
+			The first function at input point
+		**/
+		virtual double operator() (const Geometry::Point<dim>& p) const override
+		{
+			return (*this->_functions[0]) (p);
+		};
+
+		/**
+			Batched evaluation of the first function
+		**/
+		virtual void Evaluate (const double* points, double* values, size_t n) const override
+		{
+			this->_functions[0]->Evaluate (points, values, n);
+		};
+
+		/**
+			Batched evaluation of all the functions at the same points.
+			The values are stored function after function,
+			so the storage size is Size() times the number of points.
+		**/
+		void EvaluateAll (const double*, double*, size_t) const;
+
+		/**
+			The combined squared error, given the squared errors of the functions
+		**/
+		double CombineSquaredErrors (const std::vector<double>&) const;
+
+		/**
+			Number of functions
+		**/
+		size_t Size() const;
+
+		/**
+			Function with input index
+		**/
+		const Functor<dim>& operator[] (size_t) const;
+
+		/**
+			The formulas of the functions, separated by semicolons
+		**/
+		virtual std::string Formula() const override;
+
+		virtual std::string ID() const override
+		{
+			return "functor_set";
+		};
+
+	  protected:
+		/**
+			The functions
+		**/
+		std::vector<FunctionPtr<dim>> _functions;
+		/**
+			Squared weights
+		**/
+		std::vector<double> _squared_weights;
+		/**
+			Combination of the errors
+		**/
+		ErrorCombination _combination;
+	};
+
+
+	template <size_t dim>
+	FunctorSet<dim>::FunctorSet (const std::vector<FunctionPtr<dim>>& functions,
+								 const std::vector<double>& weights,
+								 ErrorCombination combination) :
+		_functions (functions),
+		_squared_weights (functions.size(), 1),
+		_combination (combination)
+	{
+		if (functions.empty())
+			throw std::invalid_argument ("FunctorSet: no function in the set");
+
+		if (!weights.empty() && weights.size() != functions.size())
+			throw std::invalid_argument ("FunctorSet: weights are not as many as the functions");
+
+		for (size_t k = 0; k < weights.size(); ++k)
+			this->_squared_weights[k] = weights[k] * weights[k];
+	}
+
+	template <size_t dim>
+	void FunctorSet<dim>::EvaluateAll (const double* points, double* values, size_t n) const
+	{
+		for (auto& f : this->_functions)
+		{
+			f->Evaluate (points, values, n);
+			values += n;
+		}
+	}
+
+	template <size_t dim>
+	double FunctorSet<dim>::CombineSquaredErrors (const std::vector<double>& squared_errors) const
+	{
+		double result = 0;
+		for (size_t k = 0; k < this->_functions.size(); ++k)
+		{
+			double weighted = this->_squared_weights[k] * squared_errors[k];
+			result = this->_combination == SumOfSquares ? result + weighted : std::max (result, weighted);
+		}
+		return result;
+	}
+
+	template <size_t dim>
+	size_t FunctorSet<dim>::Size() const
+	{
+		return this->_functions.size();
+	}
+
+	template <size_t dim>
+	const Functor<dim>& FunctorSet<dim>::operator[] (size_t k) const
+	{
+		return *this->_functions[k];
+	}
+
+	template <size_t dim>
+	std::string FunctorSet<dim>::Formula() const
+	{
+		std::string result = this->_functions[0]->Formula();
+		for (size_t k = 1; k < this->_functions.size(); ++k)
+			result += "; " + this->_functions[k]->Formula();
+		return result;
+	}
+
+} //namespace BinaryTree
+
+#endif //__FUNCTOR_SET_H
@@ -76,6 +76,12 @@ namespace FiniteElements
 		virtual Geometry::Vector EvaluateBasis (size_t,
 												const Geometry::Point<dim>&) override;
 
+		/**
+			Evaluate 1D functions until input degree at input point.
+			All the values are obtained by a single jacobi_polynomial evaluation.
+		**/
+		virtual Geometry::Vector OneDBasis (size_t, double) const override;
+
 	  protected:
 		/**
 			Evaluate 1D basis function at input point.
@@ -141,6 +147,18 @@ namespace FiniteElements
 		return result;
 	}
 
+	template <size_t dim>
+	Geometry::Vector LegendreBasis<dim>::OneDBasis (size_t degree, double x) const
+	{
+		auto evaluations = LegendreEvaluator::Evaluate (degree, x);
+
+		Geometry::Vector result (degree + 1);
+		for (size_t k = 0; k <= degree; ++k)
+			result[k] = evaluations[k];
+
+		return result;
+	}
+
 	template <size_t dim>
 	double LegendreBasis<dim>::OneDEvaluation (size_t index, double x) const
 	{
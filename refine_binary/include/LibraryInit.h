@@ -2,6 +2,7 @@
 #define __LIBRARY_INIT_HH
 
 #include <string>
+#include <cstddef> //size_t
 
 namespace BinaryTree
 {
@@ -9,8 +10,82 @@ namespace BinaryTree
 		Library initialization from input configuration file.
 		It returns 0 if everything goes right.
 		If something goes wrong it returns 1.
+		If it is called again, the plugins already loaded are not loaded again.
 	**/
 	bool Init (std::string conf_filename = "../../binary_tree.conf");
+
+	/**
+		The configuration file passed to the last Init() call.
+		Plugins use it to read their parameters from the same file,
+		e.g. the data file of the grid functors.
+		It is empty if Init() has not been called.
+	**/
+	const std::string& ConfigurationFile();
+
+	/**
+		Prepare the standard elements registered for input dimension until input degree,
+		see FiniteElements::StdFElementInterface::Prepare().
+		To be called after Init(), before the standard elements are used by several threads;
+		until ReleaseStdFElements() the requests above input degree raise a logic_error.
+		It is specialized for the dimensions whose standard elements are registered.
+	**/
+	template <size_t dim>
+	void PrepareStdFElements (size_t);
+
+	template <>
+	void PrepareStdFElements<1> (size_t);
+
+	template <>
+	void PrepareStdFElements<2> (size_t);
+
+	/**
+		Release the standard elements registered for input dimension,
+		see FiniteElements::StdFElementInterface::Release().
+		To be called when the threads using them are done.
+	**/
+	template <size_t dim>
+	void ReleaseStdFElements();
+
+	template <>
+	void ReleaseStdFElements<1>();
+
+	template <>
+	void ReleaseStdFElements<2>();
+
+	/**
+		Scope in which the standard elements of a dimension are used by several threads:
+		the constructor prepares them until input degree, see PrepareStdFElements(),
+		the destructor releases them, see ReleaseStdFElements().
+	**/
+	template <size_t dim>
+	class SharedStdFElements
+	{
+	  public:
+		/**
+			constructor
+		**/
+		SharedStdFElements (size_t degree)
+		{
+			PrepareStdFElements<dim> (degree);
+		};
+
+		/**
+			destructor
+		**/
+		~SharedStdFElements()
+		{
+			ReleaseStdFElements<dim>();
+		};
+
+		/**
+			deleted copy constructor
+		**/
+		SharedStdFElements (const SharedStdFElements&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		SharedStdFElements& operator = (const SharedStdFElements&) = delete;
+	};
 } //namespace BinaryTree
 
 #endif //__LIBRARY_INIT_HH
@@ -7,6 +7,7 @@
 #include <array> //array
 #include <math.h> //sqrt, abs
 #include <vector> //vector
+#include <algorithm> //copy, fill
 
 #include <Eigen/Dense>
 /**
@@ -47,6 +48,41 @@ namespace Geometry
 											 static_cast<int> (dim),
 											 Eigen::Dynamic>;
 
+	/**
+		Alignment of fixed-size storage of n doubles.
+		Storage is aligned to 16 bytes when its size is a multiple of 16 bytes,
+		so eigen can use vectorized instructions on it.
+		16 bytes is also the alignment guaranteed by the default operator new,
+		so objects storing a Point or a Matrix can be allocated on the heap
+		without the need of an aligned operator new.
+	**/
+	template <size_t n>
+	struct FixedAlignment
+	{
+		static constexpr size_t bytes = (n % 2 == 0) ? 16 : alignof (double);
+		static constexpr int eigen = (n % 2 == 0) ? Eigen::Aligned16 : Eigen::Unaligned;
+	};
+
+	/**
+		Eigen view on the fixed-size storage of a vector of length dim
+	**/
+	template <size_t dim>
+	using EigVectorMap = Eigen::Map < EigVector<dim>,
+									  FixedAlignment<dim>::eigen >;
+	template <size_t dim>
+	using ConstEigVectorMap = Eigen::Map < const EigVector<dim>,
+										   FixedAlignment<dim>::eigen >;
+
+	/**
+		Eigen view on the fixed-size storage of a dim x dim matrix
+	**/
+	template <size_t dim>
+	using EigMatrixMap = Eigen::Map < EigMatrix<dim>,
+									  FixedAlignment<dim * dim>::eigen >;
+	template <size_t dim>
+	using ConstEigMatrixMap = Eigen::Map < const EigMatrix<dim>,
+										   FixedAlignment<dim * dim>::eigen >;
+
 	/**
 		Type for eigen fully dynamic matrix.
 	**/
@@ -69,6 +105,11 @@ namespace Geometry
 	class DynamicVector;
 	class DynamicMatrix;
 
+	class VectorView;
+
+	template <size_t dim>
+	class PointsView;
+
 	/**
 		Fixed size vector.
 		Used to represent points of dimensionality dim.
@@ -132,7 +173,7 @@ namespace Geometry
 		/**
 			default destructor
 		**/
-		virtual ~DynamicVector();
+		~DynamicVector();
 		/**
 			copy constructor
 		**/
@@ -141,6 +182,14 @@ namespace Geometry
 			assignment operator
 		**/
 		DynamicVector& operator= (const DynamicVector&);
+		/**
+			move constructor
+		**/
+		DynamicVector (DynamicVector&&) = default;
+		/**
+			move assignment operator
+		**/
+		DynamicVector& operator= (DynamicVector&&) = default;
 
 		/**
 			access vector element
@@ -161,10 +210,19 @@ namespace Geometry
 			Must have the same size.
 		**/
 		double Dot (const BlockType&) const;
+		/**
+			Scalar product with a view.
+			Must have the same size.
+		**/
+		double Dot (const VectorView&) const;
 		/**
 			Term by term product.
 		**/
 		DynamicVector CWiseProduct (const DynamicVector&) const;
+		/**
+			Product by scalar, done in place.
+		**/
+		DynamicVector& operator*= (double);
 
 		/**
 			Length of the vector
@@ -180,6 +238,12 @@ namespace Geometry
 		**/
 		BlockType Head (size_t) const;
 
+		/**
+			Read-only view on the vector storage.
+			The view is valid until the vector is resized or destroyed.
+		**/
+		VectorView View() const;
+
 		friend DynamicVector operator* (const DynamicMatrix&, const DynamicVector&);
 
 		friend class DynamicMatrix;
@@ -210,7 +274,7 @@ namespace Geometry
 		/**
 			default destructor
 		**/
-		virtual ~DynamicMatrix();
+		~DynamicMatrix();
 
 		/**
 			Set vector as matrix column.
@@ -228,6 +292,199 @@ namespace Geometry
 
 	DynamicVector operator* (const DynamicMatrix&, const DynamicVector&);
 
+	/**
+		Read-only view on a contiguous sequence of doubles.
+		It does not own the memory, so it is cheap to be copied;
+		it is meant to give access to quadrature data and to
+		vectors storage without making copies.
+	**/
+	class VectorView
+	{
+	  public:
+		/**
+			constructor from the first element and the length of the sequence
+		**/
+		VectorView (const double* data = nullptr, size_t size = 0) :
+			_data (data), _size (size) {};
+
+		/**
+			const access to vector element
+		**/
+		const double& operator[] (size_t i) const
+		{
+			return _data[i];
+		};
+
+		/**
+			Length of the vector
+		**/
+		size_t Size() const
+		{
+			return _size;
+		};
+
+		/**
+			Pointer to the first element
+		**/
+		const double* Data() const
+		{
+			return _data;
+		};
+
+		/**
+			The first part of the view until input index.
+		**/
+		VectorView Head (size_t size) const
+		{
+			return VectorView (_data, size);
+		};
+
+		/**
+			Scalar product with another view.
+			Views must have the same size.
+		**/
+		double Dot (const VectorView&) const;
+
+	  protected:
+		/**
+			first element of the sequence
+		**/
+		const double* _data;
+		/**
+			length of the sequence
+		**/
+		size_t _size;
+	};
+
+	/**
+		Vector of unfixed size with small buffer optimization.
+		Up to N elements are stored inside the object, so no heap allocation is done;
+		if the vector gets longer, elements are moved on the heap.
+		It is meant for short vectors which are frequently resized,
+		as the projection coefficients of an element with low p level.
+	**/
+	template <size_t N = 16>
+	class SmallVector
+	{
+	  public:
+		/**
+			default constructor
+		**/
+		SmallVector() : _size (0), _buffer(), _heap() {};
+		/**
+			constructor with vector length
+		**/
+		SmallVector (size_t l) : SmallVector()
+		{
+			Resize (l);
+		};
+
+		/**
+			access vector element
+		**/
+		double& operator[] (size_t i)
+		{
+			return Storage()[i];
+		};
+		/**
+			const access to vector element
+		**/
+		const double& operator[] (size_t i) const
+		{
+			return Storage()[i];
+		};
+
+		/**
+			Length of the vector
+		**/
+		size_t Size() const
+		{
+			return _size;
+		};
+
+		/**
+			Set new length of the vector, keeping the stored values;
+			the added elements are zero.
+		**/
+		void Resize (size_t);
+
+		/**
+			The first part of the vector until input index.
+		**/
+		VectorView Head (size_t size) const
+		{
+			return VectorView (Storage(), size);
+		};
+
+		/**
+			Read-only view on the whole vector
+		**/
+		VectorView View() const
+		{
+			return VectorView (Storage(), _size);
+		};
+
+		/**
+			Bytes allocated on the heap
+		**/
+		size_t HeapBytes() const
+		{
+			return _heap.capacity() * sizeof (double);
+		};
+
+	  protected:
+		/**
+			Pointer to the storage currently in use
+		**/
+		double* Storage()
+		{
+			return _size > N ? _heap.data() : _buffer.data();
+		};
+		/**
+			Pointer to the storage currently in use
+		**/
+		const double* Storage() const
+		{
+			return _size > N ? _heap.data() : _buffer.data();
+		};
+
+	  protected:
+		/**
+			vector length
+		**/
+		size_t _size;
+		/**
+			inline storage, used if _size <= N
+		**/
+		array<double, N> _buffer;
+		/**
+			heap storage, used if _size > N
+		**/
+		vector<double> _heap;
+	};
+
+	template <size_t N>
+	void SmallVector<N>::Resize (size_t l)
+	{
+		if (l > N && _size <= N)
+			_heap.assign (_buffer.begin(), _buffer.begin() + _size);
+
+		if (l <= N && _size > N)
+		{
+			copy (_heap.begin(), _heap.begin() + l, _buffer.begin());
+			vector<double>().swap (_heap);
+		}
+
+		if (l > N)
+			_heap.resize (l);
+
+		//the new elements are zero in both storages, the buffer may keep the values of a longer vector
+		size_t old_size = _size;
+		_size = l;
+		if (l > old_size)
+			fill (Storage() + old_size, Storage() + l, 0.0);
+	}
+
 	/**
 		Class for points in R^dim.
 		Equally it could be meant as a column vector of length = dim.
@@ -250,7 +507,7 @@ namespace Geometry
 		/**
 			default destructor
 		**/
-		virtual ~Point() {};
+		~Point() = default;
 		/**
 			constructor from initializer list
 		**/
@@ -266,11 +523,11 @@ namespace Geometry
 		/**
 			copy constructor
 		**/
-		Point (const Point&);
+		Point (const Point&) = default;
 		/**
 			assignment operator
 		**/
-		Point& operator= (const Point&);
+		Point& operator= (const Point&) = default;
 
 		/**
 			Implicit cast to double for 1D points
@@ -357,11 +614,35 @@ namespace Geometry
 
 		friend class VectorPoint<dim>;
 
+		friend class PointsView<dim>;
+
+		template <size_t N>
+		friend VectorPoint<N> AffineTransform (const Matrix<N>&,
+											   const VectorPoint<N>&,
+											   const Point<N>&);
+
+	  protected:
+		/**
+			eigen view on the storage
+		**/
+		EigVectorMap<dim> Eig()
+		{
+			return EigVectorMap<dim> (_vec);
+		};
+		/**
+			const eigen view on the storage
+		**/
+		ConstEigVectorMap<dim> Eig() const
+		{
+			return ConstEigVectorMap<dim> (_vec);
+		};
+
 	  protected:
 		/**
-			eigen fixed-size vector storage
+			fixed-size storage.
+			A plain array is used, so the class is trivially copyable.
 		**/
-		EigVector<dim> _vec;
+		alignas (FixedAlignment<dim>::bytes) double _vec[dim];
 	};
 
 	/**
@@ -378,7 +659,7 @@ namespace Geometry
 		/**
 			default destructor
 		**/
-		virtual ~VectorPoint() {};
+		~VectorPoint() = default;
 
 		/**
 			constructor with columns number
@@ -400,6 +681,14 @@ namespace Geometry
 			assignment operator
 		**/
 		VectorPoint& operator= (const VectorPoint&);
+		/**
+			move constructor
+		**/
+		VectorPoint (VectorPoint&&) = default;
+		/**
+			move assignment operator
+		**/
+		VectorPoint& operator= (VectorPoint&&) = default;
 
 		/**
 			Get a copy of a column
@@ -416,9 +705,20 @@ namespace Geometry
 		**/
 		size_t Size() const;
 
+		/**
+			Read-only view on the points.
+			The view is valid until the object is modified or destroyed.
+		**/
+		PointsView<dim> View() const;
+
 		template <size_t N>
 		friend VectorPoint<N> operator* (const Matrix<N>&, const VectorPoint<N>&);
 
+		template <size_t N>
+		friend VectorPoint<N> AffineTransform (const Matrix<N>&,
+											   const VectorPoint<N>&,
+											   const Point<N>&);
+
 		template <size_t N>
 		friend VectorPoint<N> operator+ (const VectorPoint<N>&, const Point<N>&);
 
@@ -446,23 +746,26 @@ namespace Geometry
 		/**
 			default destructor
 		**/
-		virtual ~Matrix() {};
+		~Matrix() = default;
 
 	  protected:
 		/**
 			constructor from eigen type
 		**/
-		Matrix (const EigMatrix<dim>& m) : _mat (m) {};
+		Matrix (const EigMatrix<dim>& m)
+		{
+			Eig() = m;
+		};
 
 	  public:
 		/**
 			copy constructor
 		**/
-		Matrix (const Matrix&);
+		Matrix (const Matrix&) = default;
 		/**
 			assignment operator
 		**/
-		Matrix& operator= (const Matrix&);
+		Matrix& operator= (const Matrix&) = default;
 
 		/**
 			access element of the matrix
@@ -488,11 +791,85 @@ namespace Geometry
 		template <size_t N>
 		friend VectorPoint<N> operator* (const Matrix<N>&, const VectorPoint<N>&);
 
+		template <size_t N>
+		friend VectorPoint<N> AffineTransform (const Matrix<N>&,
+											   const VectorPoint<N>&,
+											   const Point<N>&);
+
 	  protected:
 		/**
-			eigen matrix storage
+			eigen view on the storage
+		**/
+		EigMatrixMap<dim> Eig()
+		{
+			return EigMatrixMap<dim> (_mat);
+		};
+		/**
+			const eigen view on the storage
 		**/
-		EigMatrix<dim> _mat;
+		ConstEigMatrixMap<dim> Eig() const
+		{
+			return ConstEigMatrixMap<dim> (_mat);
+		};
+
+	  protected:
+		/**
+			fixed-size storage, column major.
+			A plain array is used, so the class is trivially copyable.
+		**/
+		alignas (FixedAlignment<dim * dim>::bytes) double _mat[dim * dim];
+	};
+
+	/**
+		Read-only view on a sequence of points of dimensionality dim.
+		Points are stored column by column, as in VectorPoint.
+		It does not own the memory, so it is cheap to be copied.
+	**/
+	template <size_t dim>
+	class PointsView
+	{
+	  public:
+		/**
+			constructor from the first coordinate and the number of points
+		**/
+		PointsView (const double* data = nullptr, size_t size = 0) :
+			_data (data), _size (size) {};
+
+		/**
+			Get a copy of a point
+		**/
+		Point<dim> operator[] (size_t c) const
+		{
+			Point<dim> result;
+			result.Eig() = Eigen::Map<const EigVector<dim>> (_data + c * dim);
+			return result;
+		};
+
+		/**
+			The number of points
+		**/
+		size_t Size() const
+		{
+			return _size;
+		};
+
+		/**
+			Pointer to the first coordinate of the first point
+		**/
+		const double* Data() const
+		{
+			return _data;
+		};
+
+	  protected:
+		/**
+			first coordinate of the first point
+		**/
+		const double* _data;
+		/**
+			number of points
+		**/
+		size_t _size;
 	};
 
 	/**
@@ -501,7 +878,7 @@ namespace Geometry
 	template <size_t dim>
 	Point<dim> operator* (const Matrix<dim>& A, const Point<dim>& b)
 	{
-		EigVector<dim> p = A._mat * b._vec;
+		EigVector<dim> p = A.Eig() * b.Eig();
 		return Point<dim> (p);
 	}
 
@@ -511,7 +888,20 @@ namespace Geometry
 	template <size_t dim>
 	VectorPoint<dim> operator* (const Matrix<dim>& A, const VectorPoint<dim>& B)
 	{
-		EigSemiDynamicMat<dim> M = A._mat * B._mat;
+		EigSemiDynamicMat<dim> M = A.Eig() * B._mat;
+		return VectorPoint<dim> (M);
+	}
+
+	/**
+		Affine transformation of every column: A * B + b.
+		It makes a single allocation, while the equivalent (A * B) + b makes two of them.
+	**/
+	template <size_t dim>
+	VectorPoint<dim> AffineTransform (const Matrix<dim>& A,
+									  const VectorPoint<dim>& B,
+									  const Point<dim>& b)
+	{
+		EigSemiDynamicMat<dim> M = (A.Eig() * B._mat).colwise() + b.Eig();
 		return VectorPoint<dim> (M);
 	}
 
@@ -523,7 +913,7 @@ namespace Geometry
 	{
 		VectorPoint<dim> result (A);
 		for (size_t i = 0; i < result.Size(); ++i)
-			result._mat.col (i) += b._vec;
+			result._mat.col (i) += b.Eig();
 
 		return result;
 	}
@@ -536,7 +926,7 @@ namespace Geometry
 	{
 		VectorPoint<dim> result (A);
 		for (size_t i = 0; i < result.Size(); ++i)
-			result._mat.col (i) -= b._vec;
+			result._mat.col (i) -= b.Eig();
 
 		return result;
 	}
@@ -545,25 +935,25 @@ namespace Geometry
 	template <size_t dim>
 	typename Point<dim>::iterator Point<dim>::begin()
 	{
-		return _vec.data();
+		return _vec;
 	}
 
 	template <size_t dim>
 	typename Point<dim>::iterator Point<dim>::end()
 	{
-		return _vec.data() + dim;
+		return _vec + dim;
 	}
 
 	template <size_t dim>
 	typename Point<dim>::const_iterator Point<dim>::begin()const
 	{
-		return _vec.data();
+		return _vec;
 	}
 
 	template <size_t dim>
 	typename Point<dim>::const_iterator Point<dim>::end()const
 	{
-		return _vec.data() + dim;
+		return _vec + dim;
 	}
 
 	template <size_t dim>
@@ -591,22 +981,9 @@ namespace Geometry
 	}
 
 	template <size_t dim>
-	Point<dim>::Point (const EigVector<dim>& v) : _vec (v)
-	{}
-
-	template <size_t dim>
-	Point<dim>::Point (const Point<dim>& x)
+	Point<dim>::Point (const EigVector<dim>& v)
 	{
-		*this = x;
-	}
-
-	template <size_t dim>
-	Point<dim>& Point<dim>::operator= (const Point<dim>& x)
-	{
-		if (&x != this)
-			this->_vec = x._vec;
-
-		return *this;
+		Eig() = v;
 	}
 
 	template <size_t dim>
@@ -628,39 +1005,39 @@ namespace Geometry
 	template <size_t dim>
 	Point<dim> Point<dim>::operator * (double alfa) const
 	{
-		return Point<dim> (this->_vec * alfa);
+		return Point<dim> (Eig() * alfa);
 	}
 
 	template <size_t dim>
 	Point<dim>& Point<dim>::operator *= (double alfa)
 	{
-		this->_vec *= alfa;
+		Eig() *= alfa;
 		return *this;
 	}
 
 	template <size_t dim>
 	Point<dim> Point<dim>::operator - (const Point<dim>& x) const
 	{
-		return Point<dim> (this->_vec - x._vec);
+		return Point<dim> (Eig() - x.Eig());
 	}
 
 	template <size_t dim>
 	Point<dim> Point<dim>::operator + (const Point<dim>& x) const
 	{
-		return Point<dim> (this->_vec + x._vec);
+		return Point<dim> (Eig() + x.Eig());
 	}
 
 
 	template <size_t dim>
 	double& Point<dim>::operator[] (size_t ind)
 	{
-		return (this->_vec) (ind);
+		return (this->_vec)[ind];
 	}
 
 	template <size_t dim>
 	const double& Point<dim>::operator[] (size_t ind)const
 	{
-		return (this->_vec) (ind);
+		return (this->_vec)[ind];
 	}
 
 	template <size_t dim>
@@ -681,7 +1058,7 @@ namespace Geometry
 	template <size_t dim>
 	double Point<dim>::Abs() const
 	{
-		double result = (this->_vec).dot (this->_vec);
+		double result = Eig().squaredNorm();
 		return sqrt (result);
 	}
 
@@ -700,44 +1077,28 @@ namespace Geometry
 			cout << endl;
 	}
 
-	template <size_t dim>
-	Matrix<dim>::Matrix (const Matrix<dim>& m)
-	{
-		*this = m;
-	}
-
-	template <size_t dim>
-	Matrix<dim>& Matrix<dim>::operator= (const Matrix<dim>& m)
-	{
-		if (&m != this)
-		{
-			this->_mat = m._mat;
-		}
-		return *this;
-	}
-
 	template <size_t dim>
 	double& Matrix<dim>::operator() (size_t i, size_t j)
 	{
-		return (this->_mat) (i, j);
+		return (this->_mat)[i + j * dim];
 	}
 
 	template <size_t dim>
 	const double& Matrix<dim>::operator() (size_t i, size_t j) const
 	{
-		return (this->_mat) (i, j);
+		return (this->_mat)[i + j * dim];
 	}
 
 	template <size_t dim>
 	double Matrix<dim>::Determinant() const
 	{
-		return this->_mat.determinant();
+		return Eig().determinant();
 	}
 
 	template <size_t dim>
 	Matrix<dim> Matrix<dim>::Inverse() const
 	{
-		return Matrix<dim> (this->_mat.inverse());
+		return Matrix<dim> (Eig().inverse());
 	}
 
 	template <size_t dim>
@@ -762,6 +1123,12 @@ namespace Geometry
 		return this->_mat.cols();
 	}
 
+	template <size_t dim>
+	PointsView<dim> VectorPoint<dim>::View() const
+	{
+		return PointsView<dim> (_mat.data(), _mat.cols());
+	}
+
 	template <size_t dim>
 	Point<dim> VectorPoint<dim>::operator[] (size_t c) const
 	{
@@ -791,7 +1158,7 @@ namespace Geometry
 							   + to_string (_mat.cols()));
 #endif //TRY_IT
 		}
-		_mat.col (c) = p._vec;
+		_mat.col (c) = p.Eig();
 	}
 
 } //namespace Geometry
@@ -103,7 +103,7 @@ namespace Geometry
 		**/
 		virtual VectorPoint<dim> Evaluate (const VectorPoint<dim>& vec) const
 		{
-			return this->_mat * vec + this->_trasl;
+			return AffineTransform (this->_mat, vec, this->_trasl);
 		};
 
 		/**
@@ -125,7 +125,10 @@ namespace Geometry
 		**/
 		virtual VectorPoint<dim> ComputeInverse (const VectorPoint<dim>& vec) const
 		{
-			return this->_inverse * (vec - this->_trasl);
+			//L^-1 * (x - b) = L^-1 * x + (- L^-1 * b)
+			return AffineTransform (this->_inverse,
+									vec,
+									(this->_inverse * this->_trasl) * (-1.0));
 		};
 
 		/**
@@ -6,17 +6,28 @@
 #include "BinaryTreeHelper.h"
 #include "AbstractFactory.h"
 #include "Functor.h"
+#include "SampleCache.h"
+#include "SampleBatch.h"
+#include "ProcessFunctor.h"
+#include "FunctorSet.h"
+#include "ArchiveFile.h"
+#include "RefinementLog.h"
 
 #include <algorithm> //std::min
 #include <string> //std::string
 #include <stdexcept> //std::runtime_error
 #include <fstream> //std::ofstream
+#include <queue> //std::priority_queue
+#include <unordered_map>
 
 /**
 	Structures implementing the binary tree adaptation algorithm
 **/
 namespace BinaryTree
 {
+	template <size_t dim>
+	class RefinementSession;
+
 	/**
 		Class implementing the binary tree adaptation algorithm.
 		This is a wrapper for external libraries that practically implement the tree structure and the mesh management.
@@ -30,6 +41,11 @@ namespace BinaryTree
 	template <size_t dim>
 	class MeshRefiner
 	{
+		/**
+			The session performs the iterations of the algorithm one at a time
+		**/
+		friend class RefinementSession<dim>;
+
 	  public:
 		/**
 			default constructor.
@@ -38,7 +54,14 @@ namespace BinaryTree
 		MeshRefiner() : _objective_function (nullptr),
 						_godfather(),
 						_global_error (std::numeric_limits<double>::max()),
-						_error_updated (false)
+						_error_updated (false),
+						_compact_inactive (false),
+						_batch_evaluations (false),
+						_evaluate_in_process (false),
+						_sample_cache (nullptr),
+						_iterations (0),
+						_last_bisection (nullptr),
+						_rebuild_threads (1)
 		{};
 
 		/**
@@ -57,6 +80,68 @@ namespace BinaryTree
 		**/
 		void Init (std::string, int, char**);
 
+		/**
+			Initialize the element with several objective functions.
+			Input parameters:
+				- the identifiers of the functors, as in the other overload
+				- their weights, see FunctorSet
+				- how the errors of the functors are combined
+				- the main parameters
+			The same tree is adapted to all the functors:
+			the projection error of a node combines the errors of each functor,
+			computed at the same quadrature points with the same basis,
+			so the geometry and the basis are evaluated once for all of them.
+			Projections and exported results refer to the first functor.
+		**/
+		void Init (const std::vector<std::string>&,
+				   const std::vector<double>&,
+				   ErrorCombination,
+				   int,
+				   char**);
+
+		/**
+			Change the objective function, keeping the tree built for the previous one,
+			e.g. to adapt the mesh at each step of a time dependent problem.
+			Input parameters:
+				- the new objective function
+				- the number of threads computing the projection errors
+			The nodes of the tree are given the new function, their cached data are invalidated
+			and they are marked as outdated, see DimensionedGodFather::SetFunctor(): nothing is computed here.
+			The parameters of the algorithm are computed when they are next needed, see UpdateParameters(),
+			so swapping again before it costs nothing.
+			Then the active nodes are selected again there: subtrees whose E no longer justifies them
+			are trimmed, i.e. coarsened into their root, which becomes active with a higher p level.
+			Their nodes are kept, so they are reused if needed again;
+			Refine() then goes on from the current tree.
+			The new function is wrapped as the previous one by EvaluateInProcess() and CacheSamples().
+			With several threads the function has to support concurrent evaluations,
+			e.g. functors based on a shared parser do not.
+			It raises a logic_error exception if the new function is a set of several functors
+			and EvaluateInProcess() or CacheSamples() have been called.
+		**/
+		void SwapObjective (std::unique_ptr<Functor<dim>>, size_t threads = 1);
+
+		/**
+			As the other overload, with the functor of the #BinaryTree::FunctionsFactory
+			with input identifier.
+		**/
+		void SwapObjective (std::string, size_t threads = 1);
+
+		/**
+			Compute the parameters of the algorithm, if they are outdated since SwapObjective(),
+			then select the active nodes again.
+			The projection errors of all the nodes, the inactive ones too, are computed,
+			by the number of threads given to SwapObjective(),
+			then the iterations which have built the tree are replayed, see ParametersRebuilder,
+			so the parameters are the ones a refinement with the new function would have computed
+			for the same bisections.
+			It is called by the methods which need the parameters or the active nodes:
+			Refine(), GlobalError(), GlobalFieldErrors() and the non const iterations on the nodes.
+			The const methods, e.g. ExtractPLevels() or ExportMesh(), do not call it:
+			until then they give the active nodes selected for the previous function.
+		**/
+		void UpdateParameters();
+
 		/**
 			Load mesh from file.
 			It calls the derived implementation of the loading process,
@@ -127,6 +212,14 @@ namespace BinaryTree
 		**/
 		double GlobalError();
 
+		/**
+			Extract the projection errors of the functions on refined mesh,
+			when the objective function is a set of functions.
+			Each one is computed as GlobalError(), not weighted;
+			with a single function, the result is GlobalError().
+		**/
+		std::vector<double> GlobalFieldErrors();
+
 		/**
 			Extract the values of the p levels of active elements.
 		**/
@@ -142,11 +235,141 @@ namespace BinaryTree
 		**/
 		size_t ActiveNodesNumber() const;
 
+		/**
+			The number of iterations performed since the mesh has been loaded.
+		**/
+		size_t Iterations() const;
+
 		/**
 			Reference to _objective_function attribute.
 		**/
 		const Functor<dim>& GetFunctor() const;
 
+		/**
+			Set the compaction policy.
+			If true, the nodes deactivated by the selection of the active nodes,
+			interior or trimmed ones, release their heavy data
+			(projection coefficients and finite element map),
+			which are rebuilt on demand if the node is needed again.
+			A node is compacted once, then only after having been active again,
+			see RecursiveSelector.
+			Memory is traded for computations: the ancestors of a bisected node raise their p level,
+			so a compacted one computes again all its coefficients, not only the new ones,
+			see AbstractBinaryElement::Compact(); BinaryNode::Rebuilds() counts these rebuilds.
+			By default no compaction is done.
+		**/
+		void CompactInactiveNodes (bool);
+
+		/**
+			Set the composite projection mode of the nodes of this refiner,
+			see AbstractBinaryElement::CompositeProjections().
+			It can be called before or after loading the mesh,
+			the mode is kept for the meshes loaded later.
+			By default it is false.
+		**/
+		void CompositeProjections (bool);
+
+		/**
+			Set the batched evaluation policy.
+			If true, the objective function is evaluated with a single asynchronous request
+			(see Functor::Submit()) at the quadrature points of all the elements
+			which need it at the same step: the elements built when the mesh is loaded,
+			and at each iteration the two new leaves together with their ancestors.
+			The values are scattered back to the elements,
+			while the refiner goes on with the work which does not need them.
+			By default the elements evaluate the function one at a time.
+		**/
+		void BatchEvaluations (bool);
+
+		/**
+			Evaluate the objective function in a child process,
+			which stands in for an external solver, see ProcessFunctor.
+			To be called after Init() and before LoadMesh(), as CacheSamples();
+			if both are used, this one has to be called first,
+			so the cached samples are not requested to the process.
+			It raises a runtime_error exception if the process cannot be created.
+		**/
+		void EvaluateInProcess();
+
+		/**
+			Cache the samples of the objective function in a persistent file.
+			Input parameters:
+				- the cache file
+				- the size cap of the file in bytes
+			Following runs on the same mesh and functor read the samples from the file
+			instead of evaluating the functor.
+			To be called after Init() and before LoadMesh(),
+			since the elements share the objective function when they are built.
+			It raises a runtime_error exception if the cache cannot be opened.
+		**/
+		void CacheSamples (const std::string&, size_t max_bytes = (1 << 30));
+
+		/**
+			Counters of the samples cache.
+			It raises a logic_error exception if CacheSamples() has not been called.
+		**/
+		SampleCacheStatistics CacheStatistics() const;
+
+		/**
+			Save the whole state of the algorithm to input file:
+			the tree, with p level and parameters of every node, and the active elements
+			with their projection coefficients, see ArchiveWriter::StoreState().
+			The archive is written to a temporary file, flushed to the disk,
+			which then replaces input file, so an interrupted checkpoint does not overwrite the previous one
+			and a completed one survives a crash of the system.
+			The refinement waits for the checkpoint: a background thread writes the columns
+			while the tree is walked, but the call returns only once the file is on the disk.
+			It raises a runtime_error exception if the file cannot be written.
+		**/
+		void Checkpoint (const std::string&);
+
+		/**
+			Resume the algorithm from the state saved to input file by Checkpoint().
+			The refiner has to be initialized with the same objective function
+			and the mesh of the checkpointed run has to be just loaded.
+			The saved tree is rebuilt, bisecting its nodes in the order they have been created,
+			so they get the same identifiers; then the p levels, the projection errors
+			and the parameters of the algorithm are set from the file, without evaluating the objective function.
+			The projection coefficients of the active elements are restored too,
+			the other ones are computed when they are needed.
+			Following iterations give the same tree the uninterrupted run would have given.
+			It raises a logic_error exception if the mesh has been refined,
+			a runtime_error exception if the file is not a checkpoint of this mesh and objective function.
+		**/
+		void Restore (const std::string&);
+
+		/**
+			Rebuild the refined mesh from the refinement log written by a RefinementLog.
+			The refiner has to be initialized and the mesh of the logged run has to be just loaded.
+			The logged nodes are bisected and their p levels raised as in the logged iterations,
+			then the active elements are selected as the refiner selected them,
+			so the mesh and the p levels are the ones of the logged run.
+			No projection is computed while replaying, the objective function is not evaluated:
+			the projection errors of the nodes are computed when they are needed,
+			e.g. by GlobalError(), with the current objective function and quadrature rules.
+			The parameters of the algorithm are not computed,
+			so the replayed mesh is meant to be exported or evaluated, not refined further.
+			It raises a logic_error exception if the mesh has been refined,
+			a runtime_error exception if the log does not refer to this mesh.
+		**/
+		void Replay (const std::string&);
+
+		/**
+			The node bisected by the last iteration, nullptr if none since the mesh has been loaded
+		**/
+		BinaryNode* LastBisection() const;
+
+		/**
+			The number of nodes of the binary tree, inactive ones included.
+		**/
+		size_t TreeNodesNumber() const;
+
+		/**
+			The bytes of memory owned by the nodes of the binary tree.
+			Memory of the underlying mesh library is not counted.
+		**/
+		size_t TreeResidentBytes() const;
+
 		/**
 			Iterate on the activated nodes of the mesh.
 			For each node n it calls the functor NodeOperator();
@@ -159,6 +382,7 @@ namespace BinaryTree
 		**/
 		void IterateActiveNodes (NodeOperator& func)
 		{
+			UpdateParameters();
 			this->IterateActive (func);
 			this->_error_updated = false;
 		};
@@ -168,6 +392,7 @@ namespace BinaryTree
 		**/
 		void IterateActiveNodes (DimOperator<dim>& func)
 		{
+			UpdateParameters();
 			this->IterateActive (func);
 			this->_error_updated = false;
 		};
@@ -184,6 +409,17 @@ namespace BinaryTree
 		**/
 		virtual void IterateActiveNodes (ConstDimOperator<dim>&) const = 0;
 
+		/**
+			Iterate on every node of the binary tree, inactive ones included,
+			each node before its children, see DimensionedGodFather::IterateTree().
+			The functor must not bisect nor activate the nodes.
+		**/
+		void IterateTreeNodes (NodeOperator& func)
+		{
+			UpdateParameters();
+			this->_godfather.IterateTree (func);
+		};
+
 	  protected:
 		/**
 			Must implement the iteration.
@@ -199,10 +435,20 @@ namespace BinaryTree
 	  private:
 		/**
 			Needed by Refine method.
-			It performs the p refinement along the parents of input parameter
-			until an element without father is reached
+			It bisects the next leaf, as DimensionedGodFather::MakeBisection(),
+			then it raises the p level of the father of the new leaves and of its ancestors,
+			so ClimbUp() can be called.
+			If batched evaluations are enabled, the samples needed by all of them
+			are requested to input batch, which is submitted.
+		**/
+		BinaryNode* Bisect (SampleBatch<dim>&);
+
+		/**
+			Perform an iteration of the algorithm, as done by the templated Refine() method:
+			the next leaf is bisected, the parameters of its ancestors are updated
+			and the active nodes are selected again.
 		**/
-		void ClimbUp (BinaryNode* dad);
+		void Iterate();
 
 	  protected:
 		/**
@@ -232,17 +478,38 @@ namespace BinaryTree
 		**/
 		virtual void InitializeGodfather() = 0;
 
+		/**
+			Call input function, which builds new binary elements.
+			If batched evaluations are enabled, the samples needed by the elements
+			are gathered in a single request, which is evaluated after the function returns.
+		**/
+		void BatchedInit (const std::function<void()>&);
+
 	  protected:
 		/**
 			It initialize the _objective_function attribute
 		**/
 		void Init (std::unique_ptr<Functor<dim>> f_ptr);
 
+		/**
+			Build a FunctorSet with the functors of the #BinaryTree::FunctionsFactory
+			with input identifiers, see the public Init() overload for several functors.
+		**/
+		static std::unique_ptr<Functor<dim>> CreateFunctorSet (const std::vector<std::string>&,
+															   const std::vector<double>&,
+															   ErrorCombination);
+
 		/**
 			Method raising an exception if the object has not been initialized.
 		**/
 		void CheckInitialization() const;
 
+		/**
+			Method raising a logic_error exception if there are several objective functions,
+			since wrapping them in another functor would hide them to the elements.
+		**/
+		void CheckSingleObjective() const;
+
 	  protected:
 		/**
 			The objective function based on which the interpolation error
@@ -268,6 +535,42 @@ namespace BinaryTree
 		**/
 		bool _error_updated;
 
+		/**
+			Flag telling if trimmed subtrees have to be compacted
+		**/
+		bool _compact_inactive;
+
+		/**
+			Flag telling if the objective function evaluations are batched
+		**/
+		bool _batch_evaluations;
+
+		/**
+			Flag telling if the objective function is evaluated in a child process
+		**/
+		bool _evaluate_in_process;
+
+		/**
+			Cache of the samples of the objective function, if enabled
+		**/
+		std::shared_ptr<SampleCache> _sample_cache;
+
+		/**
+			Number of iterations performed since the mesh has been loaded
+		**/
+		size_t _iterations;
+
+		/**
+			Node bisected by the last iteration
+		**/
+		BinaryNode* _last_bisection;
+
+		/**
+			Number of threads computing the projection errors when the parameters are outdated,
+			see UpdateParameters()
+		**/
+		size_t _rebuild_threads;
+
 		/**
 			Flag telling if the refiner has been initialized.
 			The usage of the refiner not previously initialized
@@ -300,6 +603,34 @@ namespace BinaryTree
 		this->_initialized = true;
 	}
 
+	template <size_t dim>
+	void MeshRefiner<dim>::Init (const std::vector<std::string>& functors,
+								 const std::vector<double>& weights,
+								 ErrorCombination combination,
+								 int argc,
+								 char** argv)
+	{
+		Init (CreateFunctorSet (functors, weights, combination));
+
+		DerivedInitialization (argc, argv);
+
+		this->_initialized = true;
+	}
+
+	template <size_t dim>
+	std::unique_ptr<Functor<dim>> MeshRefiner<dim>::CreateFunctorSet (const std::vector<std::string>& functors,
+																	  const std::vector<double>& weights,
+																	  ErrorCombination combination)
+	{
+		auto& f_factory (FunctionsFactory<dim>::Instance());
+
+		std::vector<FunctionPtr<dim>> functions;
+		for (auto& id : functors)
+			functions.push_back (FunctionPtr<dim> (f_factory.create (id).release()));
+
+		return Helpers::MakeUnique<FunctorSet<dim>> (functions, weights, combination);
+	}
+
 	template <size_t dim>
 	void MeshRefiner<dim>::Init (std::unique_ptr<Functor<dim>> f_ptr)
 	{
@@ -316,12 +647,62 @@ namespace BinaryTree
 			throw std::runtime_error ("Trying to use an uninitialized refiner");
 	}
 
+	template <size_t dim>
+	void MeshRefiner<dim>::CheckSingleObjective() const
+	{
+		auto fields = dynamic_cast<const FunctorSet<dim>*> (this->_objective_function.get());
+		if (fields && fields->Size() > 1)
+			throw std::logic_error ("Not available with several objective functions");
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::SwapObjective (std::unique_ptr<Functor<dim>> f_ptr, size_t threads)
+	{
+		CheckInitialization();
+
+		auto fields = dynamic_cast<const FunctorSet<dim>*> (f_ptr.get());
+		if ((this->_evaluate_in_process || this->_sample_cache) && fields && fields->Size() > 1)
+			throw std::logic_error ("Not available with several objective functions");
+
+		FunctionPtr<dim> objective (f_ptr.release());
+		if (this->_evaluate_in_process)
+			objective = std::make_shared<ProcessFunctor<dim>> (objective);
+		if (this->_sample_cache)
+			objective = std::make_shared<CachedFunctor<dim>> (objective, this->_sample_cache);
+		this->_objective_function = objective;
+
+		this->_godfather.SetFunctor (objective);
+		this->_rebuild_threads = threads;
+		this->_error_updated = false;
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::SwapObjective (std::string functor, size_t threads)
+	{
+		auto& f_factory (FunctionsFactory<dim>::Instance());
+		SwapObjective (f_factory.create (functor), threads);
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::UpdateParameters()
+	{
+		if (!this->_godfather.Outdated())
+			return;
+
+		this->_godfather.RebuildParameters (this->_rebuild_threads);
+
+		(this->_godfather).SelectActiveNodes (this->_compact_inactive);
+		this->_error_updated = false;
+	}
+
 	template <size_t dim>
 	void MeshRefiner<dim>::LoadMesh(std::string input)
 	{
 		this->CheckInitialization();
-		this->MeshDerivedLoading(input);
+		this->BatchedInit ([this, &input] () {this->MeshDerivedLoading (input);});
 		this->InitializeGodfather();
+		this->_iterations = 0;
+		this->_last_bisection = nullptr;
 	}
 
 	template <size_t dim>
@@ -381,15 +762,7 @@ namespace BinaryTree
 					  << n_iter
 					  << std::endl;
 #endif //VERBOSE
-			BinaryNode* daddy = this->_godfather.MakeBisection();
-
-			daddy->Left()->Deactivate();
-			daddy->Right()->Deactivate();
-
-			ClimbUp (daddy);
-
-			(this->_godfather).SelectActiveNodes();
-			this->_error_updated = false;
+			Iterate();
 
 			total_error = this->GlobalError();
 #ifdef VERBOSE
@@ -412,66 +785,93 @@ namespace BinaryTree
 		this->_error_updated = false;
 	}
 
+	template <size_t dim>
+	void MeshRefiner<dim>::Iterate()
+	{
+		SampleBatch<dim> batch;
+		BinaryNode* daddy = Bisect (batch);
+
+		//this does not need the outstanding samples
+		daddy->Left()->Deactivate();
+		daddy->Right()->Deactivate();
+
+		batch.Scatter();
+		ClimbUp (daddy);
+
+		(this->_godfather).SelectActiveNodes (this->_compact_inactive);
+		this->_error_updated = false;
+		++this->_iterations;
+	}
+
 	template <size_t dim>
 	void MeshRefiner<dim>::Refine (size_t max_iter)
 	{
 		CheckInitialization();
+		UpdateParameters();
 
 		size_t n_iter = 0;
 		while (n_iter < max_iter)
 		{
-			BinaryNode* leaf_dad = this->_godfather.MakeBisection();
+			SampleBatch<dim> batch;
+			BinaryNode* leaf_dad = Bisect (batch);
+			batch.Scatter();
 			ClimbUp (leaf_dad);
 			++n_iter;
 		}
+		this->_iterations += max_iter;
 
-		(this->_godfather).SelectActiveNodes();
+		(this->_godfather).SelectActiveNodes (this->_compact_inactive);
 		this->_error_updated = false;
 	}
 
 	template <size_t dim>
-	void MeshRefiner<dim>::ClimbUp (BinaryNode* leaf_dad)
+	BinaryNode* MeshRefiner<dim>::Bisect (SampleBatch<dim>& batch)
 	{
-		BinaryNode* daddy = leaf_dad;
-		BinaryNode* previous_daddy = nullptr;
+		UpdateParameters();
+
+		if (this->_batch_evaluations)
+			batch.Collect (true);
 
-		while (daddy)
+		BinaryNode* leaf_dad = this->_godfather.MakeBisection();
+		batch.Collect (false);
+		this->_last_bisection = leaf_dad;
+
+		for (BinaryNode* daddy = leaf_dad; daddy; daddy = daddy->Dad())
 		{
 			auto val = daddy->PLevel();
 			daddy->PLevel (val + 1);
 
-			auto hansel = daddy->Left ();
-			auto gretel = daddy->Right();
-
-			auto new_E = std::min (	hansel->E() + gretel->E(),
-									daddy->ProjectionError());
-
-			auto old_E_tilde = daddy->ETilde();
-			auto new_E_tilde = new_E * old_E_tilde
-							   /
-							   (new_E + old_E_tilde);
-
-			daddy->E (new_E);
-			daddy->ETilde (new_E_tilde);
-
-			BinaryNode* alfa_bro (nullptr);
+			if (this->_batch_evaluations)
+				dynamic_cast<DimensionedNode<dim>*> (daddy)->RequestSamples (batch);
+		}
 
-			hansel->Q() > gretel->Q() ? alfa_bro = hansel : alfa_bro = gretel;
+		batch.Submit (*this->_objective_function);
+		return leaf_dad;
+	}
 
-			auto new_q = std::min (alfa_bro->Q(), new_E_tilde);
+	template <size_t dim>
+	void MeshRefiner<dim>::BatchedInit (const std::function<void()>& init)
+	{
+		if (!this->_batch_evaluations)
+		{
+			init();
+			return;
+		}
 
-			daddy->Q (new_q);
-			daddy->S (alfa_bro->S());
+		SampleBatch<dim> batch;
+		batch.Collect (true);
+		init();
+		batch.Collect (false);
 
-			previous_daddy = daddy;
-			daddy = previous_daddy->Dad();
-		} //while(daddy)
+		batch.Submit (*this->_objective_function);
+		batch.Scatter();
 	}
 
 	template <size_t dim>
 	double MeshRefiner<dim>::GlobalError()
 	{
 		CheckInitialization();
+		UpdateParameters();
 
 		if (! (this->_error_updated))
 			UpdateGlobalError();
@@ -479,6 +879,16 @@ namespace BinaryTree
 		return this->_global_error;
 	}
 
+	template <size_t dim>
+	std::vector<double> MeshRefiner<dim>::GlobalFieldErrors()
+	{
+		CheckInitialization();
+
+		FieldErrorsComputer<dim> errors;
+		IterateActiveNodes (errors);
+		return errors.GetErrors();
+	}
+
 	template <size_t dim>
 	std::vector<size_t> MeshRefiner<dim>::ExtractPLevels() const
 	{
@@ -511,6 +921,12 @@ namespace BinaryTree
 		return cont.GetCount();
 	}
 
+	template <size_t dim>
+	size_t MeshRefiner<dim>::Iterations() const
+	{
+		return this->_iterations;
+	}
+
 	template <size_t dim>
 	const Functor<dim>& MeshRefiner<dim>::GetFunctor() const
 	{
@@ -519,6 +935,318 @@ namespace BinaryTree
 		return * (this->_objective_function);
 	}
 
+	template <size_t dim>
+	void MeshRefiner<dim>::CompactInactiveNodes (bool flag)
+	{
+		this->_compact_inactive = flag;
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::CompositeProjections (bool flag)
+	{
+		this->_godfather.CompositeProjections (flag);
+		this->_error_updated = false;
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::BatchEvaluations (bool flag)
+	{
+		this->_batch_evaluations = flag;
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::EvaluateInProcess()
+	{
+		CheckInitialization();
+		CheckSingleObjective();
+
+		this->_objective_function = std::make_shared<ProcessFunctor<dim>> (this->_objective_function);
+		this->_evaluate_in_process = true;
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::CacheSamples (const std::string& file_name, size_t max_bytes)
+	{
+		CheckInitialization();
+
+		if (this->_sample_cache)
+			throw std::logic_error ("Samples cache already enabled");
+		CheckSingleObjective();
+
+		this->_sample_cache = std::make_shared<SampleCache> (file_name, max_bytes);
+		this->_objective_function = std::make_shared<CachedFunctor<dim>> (this->_objective_function,
+																		   this->_sample_cache);
+	}
+
+	template <size_t dim>
+	SampleCacheStatistics MeshRefiner<dim>::CacheStatistics() const
+	{
+		if (!this->_sample_cache)
+			throw std::logic_error ("Samples cache not enabled");
+
+		return this->_sample_cache->Statistics();
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::Checkpoint (const std::string& file_name)
+	{
+		CheckInitialization();
+
+		ArchiveWriter<dim> writer (true);
+		writer.StoreState (true);
+		writer.Background (true);
+		writer.Sync (true);
+
+		std::string temp_name = file_name + ".tmp";
+		writer.Write (*this, temp_name);
+
+		ReplaceFile (temp_name, file_name);
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::Restore (const std::string& file_name)
+	{
+		CheckInitialization();
+
+		ArchiveMapping archive (file_name);
+		auto& header = archive.Header();
+		if (header.dim != dim)
+			throw std::runtime_error ("Checkpoint " + file_name + " stores a mesh of dimension "
+									  + std::to_string (header.dim));
+		if (!header.state_nodes)
+			throw std::runtime_error ("Archive " + file_name + " is not a checkpoint");
+		if (header.function != ArchiveWriter<dim>::FunctionHash (GetFunctor()))
+			throw std::runtime_error ("Checkpoint " + file_name + " refers to another objective function");
+
+		size_t n = header.tree_nodes;
+		auto ids = archive.Column<uint64_t> (TreeIDsColumn);
+		auto parents = archive.Column<uint64_t> (TreeParentsColumn);
+
+		std::unordered_map<size_t, DimensionedNode<dim>*> mesh_roots;
+		auto collect_roots = [&mesh_roots] (BinaryNode * node)
+		{
+			if (node->Left())
+				throw std::logic_error ("Restore needs the mesh to be just loaded");
+			mesh_roots[node->NodeID()] = dynamic_cast<DimensionedNode<dim>*> (node);
+		};
+		this->_godfather.IterateTree (collect_roots);
+
+		//children are stored after their parent, the left one first
+		std::vector<uint64_t> left (n, archive_no_index);
+		std::vector<uint64_t> right (n, archive_no_index);
+		std::vector<BinaryNode*> nodes (n, nullptr);
+		std::vector<DimensionedNode<dim>*> roots;
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (parents[i] == archive_no_index)
+			{
+				auto root = mesh_roots.find (ids[i]);
+				if (root == mesh_roots.end())
+					throw std::runtime_error ("Checkpoint " + file_name + " refers to another mesh");
+				nodes[i] = root->second;
+				roots.push_back (root->second);
+			}
+			else if (left[parents[i]] == archive_no_index)
+				left[parents[i]] = i;
+			else
+				right[parents[i]] = i;
+		}
+		if (roots.size() != mesh_roots.size())
+			throw std::runtime_error ("Checkpoint " + file_name + " refers to another mesh");
+
+		{
+			DeferredProjections deferred;
+
+			//the node whose children have the lowest identifiers has been bisected first
+			using Bisection = std::pair<uint64_t, size_t>;
+			std::priority_queue<Bisection, std::vector<Bisection>, std::greater<Bisection>> bisections;
+			auto schedule = [&] (size_t i)
+			{
+				if (left[i] != archive_no_index)
+					bisections.emplace (ids[left[i]], i);
+			};
+
+			for (size_t i = 0; i < n; ++i)
+				if (nodes[i])
+					schedule (i);
+
+			while (!bisections.empty())
+			{
+				size_t i = bisections.top().second;
+				bisections.pop();
+
+				auto node = nodes[i];
+				node->Deactivate();
+				node->Bisect();
+
+				size_t l = left[i];
+				size_t r = right[i];
+				nodes[l] = node->Left();
+				nodes[r] = node->Right();
+				if (nodes[l]->NodeID() != ids[l] || nodes[r]->NodeID() != ids[r])
+					throw std::runtime_error ("Checkpoint " + file_name + " does not match the tree being rebuilt");
+
+				nodes[l]->Deactivate();
+				nodes[r]->Deactivate();
+				schedule (l);
+				schedule (r);
+			}
+		}
+
+		std::unordered_map<size_t, BinaryNode*> by_id;
+		for (auto node : nodes)
+			by_id[node->NodeID()] = node;
+
+		auto p_levels = archive.Column<uint32_t> (TreePLevelsColumn);
+		auto elements = archive.Column<uint64_t> (TreeElementsColumn);
+		auto errors = archive.Column<double> (StateErrorsColumn);
+		auto E = archive.Column<double> (StateEColumn);
+		auto E_tilde = archive.Column<double> (StateETildeColumn);
+		auto q = archive.Column<double> (StateQColumn);
+		auto tilde_errors = archive.Column<double> (StateTildeErrorsColumn);
+		auto s = archive.Column<uint64_t> (StateSColumn);
+		auto coeff_offsets = archive.Column<uint64_t> (CoefficientOffsetsColumn);
+		auto coeff = archive.Column<double> (CoefficientsColumn);
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			auto node = nodes[i];
+			node->PLevel (p_levels[i]);
+
+			//only the active elements have stored their coefficients
+			Geometry::VectorView coefficients;
+			auto e = elements[i];
+			if (e != archive_no_index)
+				coefficients = Geometry::VectorView (coeff + coeff_offsets[e], coeff_offsets[e + 1] - coeff_offsets[e]);
+			node->RestoreProjection (errors[i], coefficients);
+
+			node->E (E[i]);
+			node->ETilde (E_tilde[i]);
+			node->Q (q[i]);
+			node->TildeError (tilde_errors[i]);
+			node->S (by_id.at (s[i]));
+		}
+
+		//the roots are stored in the order of the checkpointed list
+		this->_godfather.template FillElements<typename std::vector<DimensionedNode<dim>*>::iterator>
+		(roots.begin(), roots.end(),
+		 [] (typename std::vector<DimensionedNode<dim>*>::iterator iter)
+		{
+			return *iter;
+		});
+
+		(this->_godfather).SelectActiveNodes (this->_compact_inactive);
+		this->_iterations = header.iteration;
+		this->_last_bisection = nullptr;
+		this->_error_updated = false;
+	}
+
+	template <size_t dim>
+	void MeshRefiner<dim>::Replay (const std::string& file_name)
+	{
+		CheckInitialization();
+
+		RefinementLogReader log (file_name, dim);
+
+		std::vector<BinaryNode*> roots;
+		std::unordered_map<size_t, BinaryNode*> nodes;
+		auto collect_roots = [&roots, &nodes] (BinaryNode * node)
+		{
+			if (node->Left())
+				throw std::logic_error ("Replay needs the mesh to be just loaded");
+			roots.push_back (node);
+			nodes[node->NodeID()] = node;
+		};
+		this->_godfather.IterateTree (collect_roots);
+
+		//flag telling if E = e, as it is for the leaves
+		std::unordered_map<BinaryNode*, bool> selected;
+		for (auto root : roots)
+			selected[root] = true;
+
+		auto find = [&nodes, &file_name] (uint64_t id)
+		{
+			auto node = nodes.find (id);
+			if (node == nodes.end())
+				throw std::runtime_error ("Refinement log " + file_name + " refers to a missing node");
+			return node->second;
+		};
+
+		size_t n_iter = 0;
+		{
+			DeferredProjections deferred;
+
+			RefinementEvent event;
+			while (log.Next (event))
+			{
+				auto node = find (event.bisected);
+				node->Deactivate();
+				node->Bisect();
+
+				auto hansel = node->Left();
+				auto gretel = node->Right();
+				if (hansel->NodeID() != event.left || gretel->NodeID() != event.right)
+					throw std::runtime_error ("Refinement log " + file_name + " does not match the tree being rebuilt");
+
+				hansel->Deactivate();
+				gretel->Deactivate();
+				nodes[event.left] = hansel;
+				nodes[event.right] = gretel;
+				selected[hansel] = true;
+				selected[gretel] = true;
+
+				for (size_t i = 0; i < event.ancestors.size(); ++i)
+				{
+					auto daddy = find (event.ancestors[i]);
+					daddy->PLevel (daddy->PLevel() + 1);
+					selected[daddy] = event.selected[i];
+				}
+
+				this->_last_bisection = node;
+				++n_iter;
+			}
+		}
+
+		//as RecursiveSelector, with the logged E = e flags
+		RecursiveSelector rs (this->_compact_inactive);
+		std::function<void (BinaryNode*)> select = [&] (BinaryNode * node)
+		{
+			if (selected[node])
+				rs.Trim (node);
+			else
+			{
+				select (node->Left());
+				select (node->Right());
+				rs.Deactivate (node);
+			}
+		};
+		for (auto root : roots)
+			select (root);
+
+		this->_iterations += n_iter;
+		this->_error_updated = false;
+	}
+
+	template <size_t dim>
+	BinaryNode* MeshRefiner<dim>::LastBisection() const
+	{
+		return this->_last_bisection;
+	}
+
+	template <size_t dim>
+	size_t MeshRefiner<dim>::TreeNodesNumber() const
+	{
+		CheckInitialization();
+		return (this->_godfather).TreeNodesNumber();
+	}
+
+	template <size_t dim>
+	size_t MeshRefiner<dim>::TreeResidentBytes() const
+	{
+		CheckInitialization();
+		return (this->_godfather).TreeResidentBytes();
+	}
+
 
 	template <size_t dim>
 	template <size_t dummy,
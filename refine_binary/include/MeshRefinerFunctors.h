@@ -220,6 +220,41 @@ namespace BinaryTree
 	};
 
 
+	/**
+		Functor to get the projection errors of the functions of a FunctorSet.
+		When iterating over active nodes it adds the errors of the node,
+		see DimensionedNode::FieldProjectionErrors(), to the #_errors vector;
+		at the end of the iteration do GetErrors to get it.
+	**/
+	template <size_t dim>
+	class FieldErrorsComputer : public DimOperator<dim>
+	{
+	  public:
+		/**
+			default constructor
+		**/
+		FieldErrorsComputer();
+		/**
+			default destructor
+		**/
+		virtual ~FieldErrorsComputer();
+
+		/**
+			add the errors on input node to #_errors
+		**/
+		virtual void operator() (DimensionedNode<dim>*) override;
+		/**
+			get errors
+		**/
+		std::vector<double> GetErrors() const;
+
+	  protected:
+		/**
+			errors vector, one for each function
+		**/
+		std::vector<double> _errors;
+	};
+
 	/**
 		Functor for MeshRefiner::ExportGnuPlot() method.
 		It directly prints on file.
@@ -350,5 +385,29 @@ namespace BinaryTree
 		return this->_vertices;
 	}
 
+	template <size_t dim>
+	FieldErrorsComputer<dim>::FieldErrorsComputer() : _errors()
+	{}
+
+	template <size_t dim>
+	FieldErrorsComputer<dim>::~FieldErrorsComputer()
+	{}
+
+	template <size_t dim>
+	void FieldErrorsComputer<dim>::operator() (DimensionedNode<dim>* node)
+	{
+		auto errors = node->FieldProjectionErrors();
+		this->_errors.resize (errors.size(), 0);
+
+		for (size_t k = 0; k < errors.size(); ++k)
+			this->_errors[k] += errors[k];
+	}
+
+	template <size_t dim>
+	std::vector<double> FieldErrorsComputer<dim>::GetErrors() const
+	{
+		return this->_errors;
+	}
+
 } //namespace BinaryTree
 #endif //__MESH_REFINER_FUNCTORS_H
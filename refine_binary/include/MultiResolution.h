@@ -0,0 +1,445 @@
+#ifndef __MULTI_RESOLUTION_H
+#define __MULTI_RESOLUTION_H
+
+#include "ApproximationSnapshot.h"
+#include "FunctorSet.h"
+
+#include <vector>
+#include <memory> //std::shared_ptr
+#include <algorithm> //std::min, std::sort
+#include <unordered_map>
+#include <limits> //std::numeric_limits
+#include <stdexcept> //std::logic_error, std::out_of_range
+
+namespace BinaryTree
+{
+	/**
+		Extraction of the meshes of several resolutions from the tree of a single refinement.
+		The n-th mesh is the one the algorithm selects after n iterations:
+		its nodes are the ones created by the first n bisections,
+		each one with p level equal to the number of these bisections in its subtree,
+		and the active ones are selected as the algorithm does, from the parameter E.
+		The projection errors at these p levels are computed once from the current
+		projection errors and coefficients of the nodes, see DimensionedNode::LowerProjectionErrors(),
+		so no mesh is computed again and the objective function is not evaluated
+		on the nodes which store their coefficients.
+		The nodes compacted by the refiner, see MeshRefiner::CompactInactiveNodes(), have released them:
+		the function is evaluated again on these nodes when the object is built
+		and when they are active in an extracted mesh, then they are compacted again.
+		They may differ from the ones computed by the algorithm by the quadrature error,
+		so the selected elements may differ when the errors of two choices are almost equal;
+		the last mesh is the one of the refiner.
+
+		When the object is built, the iterations are replayed on the tree,
+		updating the parameters of the ancestors of the bisected nodes only,
+		so the error and the number of active elements of every mesh are known;
+		then Extract() trims the tree at the requested iteration, leaving it unchanged.
+		The bisections are sorted by the identifiers of the children they have created,
+		which are given in creation order by the mesh library.
+
+		The tree is referred to, not copied: the refiner must not be modified
+		while the object is used.
+	**/
+	template <size_t dim>
+	class MultiResolution
+	{
+	  public:
+		using SnapshotPtr = std::shared_ptr<const ApproximationSnapshot<dim>>;
+
+		/**
+			constructor.
+			The projection coefficients of the nodes are computed if they have been released,
+			then released again.
+			It raises a logic_error exception if the refiner adapts the tree to several functions,
+			whose coefficients cannot give the errors at lower p levels.
+		**/
+		MultiResolution (MeshRefiner<dim>&);
+
+		/**
+			The number of bisections of the tree, i.e. the index of the finest mesh
+		**/
+		size_t Iterations() const;
+
+		/**
+			Projection error of the mesh after input number of iterations
+		**/
+		double Error (size_t) const;
+
+		/**
+			Number of active elements of the mesh after input number of iterations
+		**/
+		size_t Size (size_t) const;
+
+		/**
+			The number of iterations of the coarsest mesh whose error is not higher than the input tolerance;
+			Iterations() if the finest mesh does not achieve it.
+		**/
+		size_t ErrorIteration (double) const;
+
+		/**
+			The number of iterations of the finest mesh with no more active elements than the input budget;
+			0 if even the initial mesh exceeds it.
+		**/
+		size_t BudgetIteration (size_t) const;
+
+		/**
+			Snapshot of the mesh after input number of iterations,
+			with its p levels, local errors and projection coefficients.
+			The coefficients of the compacted nodes are computed again.
+			The snapshot stores the number of iterations and its error.
+			It raises an out_of_range exception if the number is higher than Iterations().
+		**/
+		SnapshotPtr Extract (size_t) const;
+
+		/**
+			The snapshots of the coarsest meshes achieving the input tolerances, see ErrorIteration()
+		**/
+		std::vector<SnapshotPtr> ExtractErrors (const std::vector<double>&) const;
+
+		/**
+			The snapshots of the finest meshes within the input element budgets, see BudgetIteration()
+		**/
+		std::vector<SnapshotPtr> ExtractBudgets (const std::vector<size_t>&) const;
+
+	  private:
+		/**
+			Functor collecting the nodes of the tree
+		**/
+		class Collector : public NodeOperator
+		{
+		  public:
+			Collector (MultiResolution<dim>& multi) : _multi (multi) {};
+
+			virtual void operator() (BinaryNode* node) override
+			{
+				this->_multi.AddNode (node);
+			};
+
+		  private:
+			MultiResolution<dim>& _multi;
+		};
+
+		/**
+			Store input node, which follows its parent
+		**/
+		void AddNode (BinaryNode*);
+
+		/**
+			Projection error of input node at input p level
+		**/
+		double LowerError (size_t node, size_t p) const;
+
+		/**
+			Replay input bisections, in the order they have been done, filling _errors and _sizes
+		**/
+		void ReplayBisections (const std::vector<size_t>&);
+
+		/**
+			deleted copy constructor
+		**/
+		MultiResolution (const MultiResolution&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		MultiResolution& operator = (const MultiResolution&) = delete;
+
+	  private:
+		/**
+			Value of the missing indexes
+		**/
+		static constexpr size_t _none = std::numeric_limits<size_t>::max();
+
+		/**
+			The nodes of the tree, each one before its children
+		**/
+		std::vector<DimensionedNode<dim>*> _nodes;
+		/**
+			Index of the parent of each node, _none for the roots
+		**/
+		std::vector<size_t> _parents;
+		/**
+			Index of the children of each node, _none for the leaves
+		**/
+		std::vector<size_t> _left;
+		std::vector<size_t> _right;
+		/**
+			Index of the bisection of each node, i.e. the number of iterations
+			performed before it has been bisected, _none for the leaves
+		**/
+		std::vector<size_t> _bisection;
+		/**
+			Index in _lower_errors of the errors of each node, plus the end of the last one
+		**/
+		std::vector<size_t> _lower_offsets;
+		/**
+			Projection errors of the nodes at the p levels until the current one
+		**/
+		std::vector<double> _lower_errors;
+		/**
+			Index of each node in _nodes
+		**/
+		std::unordered_map<const BinaryNode*, size_t> _indexes;
+		/**
+			Projection error of the mesh after each number of iterations
+		**/
+		std::vector<double> _errors;
+		/**
+			Number of active elements of the mesh after each number of iterations
+		**/
+		std::vector<size_t> _sizes;
+	};
+
+
+	template <size_t dim>
+	constexpr size_t MultiResolution<dim>::_none;
+
+	template <size_t dim>
+	MultiResolution<dim>::MultiResolution (MeshRefiner<dim>& refiner) :
+		_lower_offsets (1, 0)
+	{
+		auto fields = dynamic_cast<const FunctorSet<dim>*> (&refiner.GetFunctor());
+		if (fields && fields->Size() > 1)
+			throw std::logic_error ("Not available with several objective functions");
+
+		Collector collector (*this);
+		refiner.IterateTreeNodes (collector);
+
+		//the bisections are numbered in the order they have been done
+		std::vector<size_t> bisected;
+		for (size_t i = 0; i < this->_nodes.size(); ++i)
+			if (this->_left[i] != _none)
+				bisected.push_back (i);
+
+		std::sort (bisected.begin(), bisected.end(), [this] (size_t a, size_t b)
+		{
+			return this->_nodes[this->_left[a]]->NodeID() < this->_nodes[this->_left[b]]->NodeID();
+		});
+		for (size_t k = 0; k < bisected.size(); ++k)
+			this->_bisection[bisected[k]] = k;
+
+		ReplayBisections (bisected);
+	}
+
+	template <size_t dim>
+	void MultiResolution<dim>::AddNode (BinaryNode* node)
+	{
+		size_t index = this->_nodes.size();
+		this->_indexes[node] = index;
+		this->_nodes.push_back (dynamic_cast<DimensionedNode<dim>*> (node));
+
+		size_t parent = _none;
+		if (node->Dad())
+		{
+			parent = this->_indexes.at (node->Dad());
+			if (this->_left[parent] == _none)
+				this->_left[parent] = index;
+			else
+				this->_right[parent] = index;
+		}
+		this->_parents.push_back (parent);
+		this->_left.push_back (_none);
+		this->_right.push_back (_none);
+		this->_bisection.push_back (_none);
+
+		//the coefficients computed again are released, so the memory of the tree is not increased
+		bool stored = this->_nodes.back()->StoresCoefficients();
+		auto lower = this->_nodes.back()->LowerProjectionErrors();
+		if (!stored)
+			this->_nodes.back()->Compact();
+		this->_lower_errors.insert (this->_lower_errors.end(), lower.begin(), lower.end());
+		this->_lower_offsets.push_back (this->_lower_errors.size());
+	}
+
+	template <size_t dim>
+	double MultiResolution<dim>::LowerError (size_t node, size_t p) const
+	{
+		return this->_lower_errors[this->_lower_offsets[node] + p];
+	}
+
+	template <size_t dim>
+	void MultiResolution<dim>::ReplayBisections (const std::vector<size_t>& bisected)
+	{
+		size_t n = this->_nodes.size();
+
+		//p level, E parameter and number of active elements of the subtree of each node
+		std::vector<size_t> p (n, 0);
+		std::vector<double> E (n, 0);
+		std::vector<size_t> active (n, 1);
+
+		double error = 0;
+		size_t size = 0;
+		for (size_t i = 0; i < n; ++i)
+			if (this->_parents[i] == _none)
+			{
+				E[i] = LowerError (i, 0);
+				error += E[i];
+				++size;
+			}
+
+		this->_errors.assign (1, error);
+		this->_sizes.assign (1, size);
+
+		//as ClimbUp(), the leaves have E = e
+		for (auto b : bisected)
+		{
+			E[this->_left[b]] = LowerError (this->_left[b], 0);
+			E[this->_right[b]] = LowerError (this->_right[b], 0);
+
+			size_t root = b;
+			double old_E = 0;
+			size_t old_active = 0;
+			for (size_t a = b; a != _none; a = this->_parents[a])
+			{
+				root = a;
+				old_E = E[a];
+				old_active = active[a];
+
+				auto hansel = this->_left[a];
+				auto gretel = this->_right[a];
+
+				++p[a];
+				double e = LowerError (a, p[a]);
+				E[a] = std::min (E[hansel] + E[gretel], e);
+				active[a] = E[a] == e ? 1 : active[hansel] + active[gretel];
+			}
+
+			error += E[root] - old_E;
+			size += active[root] - old_active;
+			this->_errors.push_back (error);
+			this->_sizes.push_back (size);
+		}
+	}
+
+	template <size_t dim>
+	size_t MultiResolution<dim>::Iterations() const
+	{
+		return this->_errors.size() - 1;
+	}
+
+	template <size_t dim>
+	double MultiResolution<dim>::Error (size_t n) const
+	{
+		return this->_errors.at (n);
+	}
+
+	template <size_t dim>
+	size_t MultiResolution<dim>::Size (size_t n) const
+	{
+		return this->_sizes.at (n);
+	}
+
+	template <size_t dim>
+	size_t MultiResolution<dim>::ErrorIteration (double tol) const
+	{
+		for (size_t n = 0; n < this->_errors.size(); ++n)
+			if (this->_errors[n] <= tol)
+				return n;
+
+		return Iterations();
+	}
+
+	template <size_t dim>
+	size_t MultiResolution<dim>::BudgetIteration (size_t budget) const
+	{
+		for (size_t n = this->_sizes.size(); n > 0; --n)
+			if (this->_sizes[n - 1] <= budget)
+				return n - 1;
+
+		return 0;
+	}
+
+	template <size_t dim>
+	typename MultiResolution<dim>::SnapshotPtr MultiResolution<dim>::Extract (size_t n_iter) const
+	{
+		if (n_iter > Iterations())
+			throw std::out_of_range ("The tree has not been bisected " + std::to_string (n_iter) + " times");
+
+		size_t n = this->_nodes.size();
+		auto in_mesh = [this, n_iter] (size_t i)
+		{
+			return this->_parents[i] == _none || this->_bisection[this->_parents[i]] < n_iter;
+		};
+		auto bisected = [this, n_iter] (size_t i)
+		{
+			return this->_bisection[i] < n_iter;
+		};
+
+		//children are stored after their parent, so the subtrees are done backward
+		std::vector<size_t> p (n, 0);
+		std::vector<bool> selected (n, true);
+		std::vector<double> E (n, 0);
+		for (size_t i = n; i-- > 0;)
+			if (in_mesh (i))
+			{
+				double e = LowerError (i, 0);
+				if (bisected (i))
+				{
+					auto hansel = this->_left[i];
+					auto gretel = this->_right[i];
+
+					p[i] = 1 + p[hansel] + p[gretel];
+					e = LowerError (i, p[i]);
+					E[i] = std::min (E[hansel] + E[gretel], e);
+				}
+				else
+					E[i] = e;
+
+				selected[i] = E[i] == e;
+			}
+
+		//as RecursiveSelector, the first selected node of each path is active
+		std::vector<bool> reached (n, false);
+		std::vector<size_t> active;
+		double error = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			auto parent = this->_parents[i];
+			reached[i] = parent == _none || (reached[parent] && !selected[parent] && in_mesh (i));
+			if (reached[i] && selected[i])
+			{
+				active.push_back (i);
+				error += LowerError (i, p[i]);
+			}
+		}
+
+		std::shared_ptr<ApproximationSnapshot<dim>> result (new ApproximationSnapshot<dim> (0, n_iter, error));
+		for (auto i : active)
+		{
+			auto node = this->_nodes[i];
+			bool stored = node->StoresCoefficients();
+			result->Add (node->NodeID(), p[i], LowerError (i, p[i]),
+						 node->GetType(), node->GetFeType(), node->Nodes(),
+						 node->ProjectionCoefficients().Head (node->BasisSize (p[i])));
+			if (!stored)
+				node->Compact();
+		}
+
+		result->PrepareBases();
+		return result;
+	}
+
+	template <size_t dim>
+	std::vector<typename MultiResolution<dim>::SnapshotPtr>
+	MultiResolution<dim>::ExtractErrors (const std::vector<double>& tolerances) const
+	{
+		std::vector<SnapshotPtr> result;
+		for (auto tol : tolerances)
+			result.push_back (Extract (ErrorIteration (tol)));
+
+		return result;
+	}
+
+	template <size_t dim>
+	std::vector<typename MultiResolution<dim>::SnapshotPtr>
+	MultiResolution<dim>::ExtractBudgets (const std::vector<size_t>& budgets) const
+	{
+		std::vector<SnapshotPtr> result;
+		for (auto budget : budgets)
+			result.push_back (Extract (BudgetIteration (budget)));
+
+		return result;
+	}
+
+} //namespace BinaryTree
+
+#endif //__MULTI_RESOLUTION_H
@@ -0,0 +1,684 @@
+#ifndef __POINT_EVALUATOR_H
+#define __POINT_EVALUATOR_H
+
+#include "ApproximationSnapshot.h"
+#include "Functor.h"
+#include "Basis.h"
+
+#include <vector>
+#include <array>
+#include <memory> //std::shared_ptr
+#include <string>
+#include <functional> //std::function
+#include <utility> //std::pair
+#include <thread> //std::thread
+#include <exception> //std::exception_ptr
+#include <algorithm> //std::upper_bound, std::sort, std::max, std::min
+#include <limits> //std::numeric_limits
+#include <cmath> //std::pow, std::floor, std::ceil, std::isnan
+#include <stdexcept> //std::out_of_range
+
+namespace BinaryTree
+{
+	/**
+		Evaluation of the hp approximation computed by a MeshRefiner at arbitrary points.
+		It reads an ApproximationSnapshot, which stores the coefficients and the inverse affine map
+		of each active element, so the refiner can go on or be destroyed meanwhile.
+		The element containing a point is found through a spatial index:
+		the intervals sorted by their lower end in 1D,
+		a uniform grid of cells listing the elements which overlap them in higher dimensions.
+		The batched evaluation splits the points among threads;
+		each thread groups its points by element and evaluates the Legendre basis of ipercubes
+		on blocks of points, with loops over the points the compiler can vectorize;
+		the other bases are evaluated point by point by the snapshot.
+		Single points and small batches skip the grouping, each point is located and evaluated alone.
+		It is a Functor, so the approximation can be used wherever a function is expected,
+		e.g. as the objective function of another refiner.
+	**/
+	template <size_t dim>
+	class PointEvaluator : public Functor<dim>
+	{
+	  public:
+		using SnapshotPtr = std::shared_ptr<const ApproximationSnapshot<dim>>;
+
+		/**
+			constructor.
+			Input parameters:
+				- the snapshot of the approximation
+				- the number of threads of the batched evaluations; if zero, the number of hardware threads
+			It raises an invalid_argument exception if the snapshot is nullptr.
+		**/
+		PointEvaluator (const SnapshotPtr&, size_t threads = 0);
+
+		/**
+			constructor.
+			It takes a snapshot of input refiner, see ApproximationSnapshot.
+		**/
+		PointEvaluator (MeshRefiner<dim>&, size_t threads = 0);
+
+		/**
+			default destructor
+		**/
+		virtual ~PointEvaluator() {};
+
+		/**
+			The approximation at input point.
+			It raises an out_of_range exception if the point does not lie in the mesh,
+			unless a value for such points has been set, see OutsideValue().
+		**/
+		virtual double operator() (const Geometry::Point<dim>&) const override;
+
+		/**
+			Batched evaluation, done by several threads if the points are enough.
+			The points outside the mesh behave as in operator().
+		**/
+		virtual void Evaluate (const double* points, double* values, size_t n) const override;
+
+		/**
+			Set the value of the approximation at the points which do not lie in the mesh,
+			instead of raising an exception.
+		**/
+		void OutsideValue (double);
+
+		/**
+			Index in the snapshot of the element containing input point,
+			the snapshot size if there is none
+		**/
+		size_t Locate (const Geometry::Point<dim>&) const;
+
+		/**
+			The snapshot evaluated
+		**/
+		const ApproximationSnapshot<dim>& Snapshot() const;
+
+		virtual std::string Formula() const override;
+
+		virtual std::string ID() const override
+		{
+			return "point_evaluator";
+		};
+
+	  protected:
+		/**
+			Build the spatial index
+		**/
+		void BuildIndex();
+
+		/**
+			Evaluate a range of points, see Evaluate().
+			The points are sorted by element, so the cost does not depend on the number of elements;
+			ranges shorter than _grouped_points are evaluated point by point.
+			It returns false if a point outside the mesh has been found and no outside value is set.
+		**/
+		bool EvaluateRange (const double* points, double* values, size_t first, size_t last) const;
+
+		/**
+			Evaluate the approximation on an element at a point, given by its coordinates.
+			The last parameter is the storage for the tables of the evaluation, see EvaluateBlock().
+		**/
+		double EvaluatePoint (size_t, const double*, std::vector<double>&) const;
+
+		/**
+			Evaluate the approximation on an element at some points.
+			Input parameters:
+				- the element
+				- the coordinates of all the points
+				- the indexes of the points to be evaluated, at most _block_size
+				- the number of points to be evaluated
+				- the storage of the values of all the points
+				- the storage for the tables of the evaluation
+		**/
+		void EvaluateBlock (size_t, const double*, const size_t*, size_t,
+							double*, std::vector<double>&) const;
+
+		/**
+			Tell if the Legendre basis on the element can be evaluated by EvaluateBlock()
+		**/
+		bool TensorLegendre (size_t) const;
+
+	  protected:
+		/**
+			Number of points evaluated together on an element
+		**/
+		static constexpr size_t _block_size = 64;
+		/**
+			Minimum number of points for each thread of a batched evaluation
+		**/
+		static constexpr size_t _points_per_thread = 4096;
+		/**
+			Minimum number of points of a range grouped by element
+		**/
+		static constexpr size_t _grouped_points = 16;
+
+		/**
+			The snapshot
+		**/
+		SnapshotPtr _snapshot;
+		/**
+			Number of threads
+		**/
+		size_t _threads;
+		/**
+			Value at the points outside the mesh, NaN if they raise an exception
+		**/
+		double _outside_value;
+		/**
+			Tolerance on the coordinates, relative to the size of the mesh
+		**/
+		double _tol;
+		/**
+			Flag telling if each element has a tensorial Legendre basis
+		**/
+		std::vector<bool> _tensor_legendre;
+		/**
+			Tensorial indexes of the basis functions, in the order of the basis
+			until the maximum p level of the elements
+		**/
+		FiniteElements::IndexVector<dim> _indexes;
+
+		/*	1D index */
+
+		/**
+			Lower ends of the intervals, sorted
+		**/
+		std::vector<double> _lower;
+		/**
+			Upper ends of the intervals, in the order of _lower
+		**/
+		std::vector<double> _upper;
+		/**
+			Elements in the order of _lower
+		**/
+		std::vector<size_t> _sorted;
+
+		/*	Grid index */
+
+		/**
+			Lower corner of the grid
+		**/
+		std::array<double, dim> _grid_origin;
+		/**
+			Sides of the cells
+		**/
+		std::array<double, dim> _cell_size;
+		/**
+			Number of cells along each coordinate
+		**/
+		std::array<size_t, dim> _cells;
+		/**
+			Index in _cell_elements of the first element of each cell, plus the end of the last one
+		**/
+		std::vector<size_t> _cell_offsets;
+		/**
+			Elements overlapping each cell, cell after cell
+		**/
+		std::vector<size_t> _cell_elements;
+	};
+
+
+	template <size_t dim>
+	constexpr size_t PointEvaluator<dim>::_block_size;
+
+	template <size_t dim>
+	constexpr size_t PointEvaluator<dim>::_points_per_thread;
+
+	template <size_t dim>
+	constexpr size_t PointEvaluator<dim>::_grouped_points;
+
+	template <size_t dim>
+	PointEvaluator<dim>::PointEvaluator (const SnapshotPtr& snapshot, size_t threads) :
+		_snapshot (snapshot),
+		_threads (threads ? threads : std::max (std::thread::hardware_concurrency(), 1u)),
+		_outside_value (std::numeric_limits<double>::quiet_NaN()),
+		_tol (0)
+	{
+		if (!snapshot)
+			throw std::invalid_argument ("PointEvaluator: no snapshot to be evaluated");
+
+		BuildIndex();
+	}
+
+	template <size_t dim>
+	PointEvaluator<dim>::PointEvaluator (MeshRefiner<dim>& refiner, size_t threads) :
+		PointEvaluator (std::make_shared<const ApproximationSnapshot<dim>> (refiner, 0), threads)
+	{}
+
+	template <size_t dim>
+	bool PointEvaluator<dim>::TensorLegendre (size_t i) const
+	{
+		auto type = this->_snapshot->GetType (i);
+		return this->_snapshot->GetFeType (i) == FiniteElements::LegendreType
+			   && (type == Geometry::IntervalType
+				   || type == Geometry::SquareType
+				   || type == Geometry::CubeType);
+	}
+
+	template <size_t dim>
+	void PointEvaluator<dim>::BuildIndex()
+	{
+		auto& snapshot (*this->_snapshot);
+		size_t n = snapshot.Size();
+
+		this->_tensor_legendre.resize (n);
+		for (size_t i = 0; i < n; ++i)
+			this->_tensor_legendre[i] = TensorLegendre (i);
+
+		//same order as FiniteElements::TensorialBasis
+		size_t max_p = snapshot.MaxPLevel();
+		size_t size = 1;
+		for (size_t d = 1; d <= dim; ++d)
+			size = size * (max_p + d) / d;
+		this->_indexes.resize (size);
+		auto iter = this->_indexes.begin();
+		for (size_t degree = 0; degree <= max_p; ++degree)
+			FiniteElements::Filler<dim>::FillIndexes (iter, degree);
+
+		//bounding boxes of the elements
+		std::vector<std::array<double, dim>> lower (n), upper (n);
+		std::array<double, dim> mesh_lower, mesh_upper;
+		mesh_lower.fill (std::numeric_limits<double>::max());
+		mesh_upper.fill (std::numeric_limits<double>::lowest());
+		for (size_t i = 0; i < n; ++i)
+		{
+			auto vertices = snapshot.Vertices (i);
+			lower[i].fill (std::numeric_limits<double>::max());
+			upper[i].fill (std::numeric_limits<double>::lowest());
+			for (size_t v = 0; v < vertices.Size(); ++v)
+			{
+				auto vertex = vertices[v];
+				for (size_t d = 0; d < dim; ++d)
+				{
+					lower[i][d] = std::min (lower[i][d], vertex[d]);
+					upper[i][d] = std::max (upper[i][d], vertex[d]);
+				}
+			}
+			for (size_t d = 0; d < dim; ++d)
+			{
+				mesh_lower[d] = std::min (mesh_lower[d], lower[i][d]);
+				mesh_upper[d] = std::max (mesh_upper[d], upper[i][d]);
+			}
+		}
+
+		double extent = 0;
+		for (size_t d = 0; d < dim && n; ++d)
+			extent = std::max (extent, mesh_upper[d] - mesh_lower[d]);
+		this->_tol = 1E-12 * extent;
+
+		if (dim == 1)
+		{
+			this->_sorted.resize (n);
+			for (size_t i = 0; i < n; ++i)
+				this->_sorted[i] = i;
+			std::sort (this->_sorted.begin(), this->_sorted.end(),
+					   [&lower] (size_t a, size_t b) {return lower[a][0] < lower[b][0];});
+
+			for (auto i : this->_sorted)
+			{
+				this->_lower.push_back (lower[i][0]);
+				this->_upper.push_back (upper[i][0]);
+			}
+			return;
+		}
+
+		//about one element per cell
+		size_t cells_per_side = std::max (static_cast<size_t> (std::ceil (std::pow (n, 1.0 / dim))),
+										  static_cast<size_t> (1));
+		size_t total_cells = 1;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			this->_grid_origin[d] = n ? mesh_lower[d] : 0;
+			this->_cells[d] = cells_per_side;
+			double side = n ? mesh_upper[d] - mesh_lower[d] : 0;
+			this->_cell_size[d] = side > 0 ? side / cells_per_side : 1;
+			total_cells *= cells_per_side;
+		}
+
+		auto cell_range = [this] (double a, double b, size_t d)
+		{
+			auto to_cell = [this, d] (double x)
+			{
+				double c = std::floor ((x - this->_grid_origin[d]) / this->_cell_size[d]);
+				return static_cast<size_t> (std::min (std::max (c, 0.0),
+													  static_cast<double> (this->_cells[d] - 1)));
+			};
+			return std::make_pair (to_cell (a - this->_tol), to_cell (b + this->_tol));
+		};
+
+		/*	Two passes: the elements of each cell are counted, then stored.
+			The cells of the box of an element are visited through a counter in base _cells */
+		auto visit = [&] (size_t i, const std::function<void (size_t)>& f)
+		{
+			std::array<std::pair<size_t, size_t>, dim> range;
+			std::array<size_t, dim> cell;
+			for (size_t d = 0; d < dim; ++d)
+			{
+				range[d] = cell_range (lower[i][d], upper[i][d], d);
+				cell[d] = range[d].first;
+			}
+
+			while (true)
+			{
+				size_t index = 0;
+				for (size_t d = dim; d-- > 0;)
+					index = index * this->_cells[d] + cell[d];
+				f (index);
+
+				size_t d = 0;
+				while (d < dim && cell[d] == range[d].second)
+				{
+					cell[d] = range[d].first;
+					++d;
+				}
+				if (d == dim)
+					break;
+				++cell[d];
+			}
+		};
+
+		this->_cell_offsets.assign (total_cells + 1, 0);
+		for (size_t i = 0; i < n; ++i)
+			visit (i, [this] (size_t c) {++this->_cell_offsets[c + 1];});
+
+		for (size_t c = 0; c < total_cells; ++c)
+			this->_cell_offsets[c + 1] += this->_cell_offsets[c];
+
+		this->_cell_elements.resize (this->_cell_offsets.back());
+		auto cursor = this->_cell_offsets;
+		for (size_t i = 0; i < n; ++i)
+			visit (i, [this, &cursor, i] (size_t c) {this->_cell_elements[cursor[c]++] = i;});
+	}
+
+	template <size_t dim>
+	size_t PointEvaluator<dim>::Locate (const Geometry::Point<dim>& p) const
+	{
+		auto& snapshot (*this->_snapshot);
+		size_t not_found = snapshot.Size();
+
+		if (dim == 1)
+		{
+			double x = p[0];
+			size_t pos = std::upper_bound (this->_lower.begin(), this->_lower.end(), x)
+						 - this->_lower.begin();
+
+			if (pos > 0 && x <= this->_upper[pos - 1] + this->_tol)
+				return this->_sorted[pos - 1];
+			//points slightly before the first interval
+			if (pos < this->_lower.size() && x >= this->_lower[pos] - this->_tol)
+				return this->_sorted[pos];
+
+			return not_found;
+		}
+
+		size_t index = 0;
+		for (size_t d = dim; d-- > 0;)
+		{
+			double offset = p[d] - this->_grid_origin[d];
+			if (offset < -this->_tol || offset > this->_cells[d] * this->_cell_size[d] + this->_tol)
+				return not_found;
+
+			double c = std::floor (offset / this->_cell_size[d]);
+			c = std::min (std::max (c, 0.0), static_cast<double> (this->_cells[d] - 1));
+			index = index * this->_cells[d] + static_cast<size_t> (c);
+		}
+
+		for (size_t k = this->_cell_offsets[index]; k < this->_cell_offsets[index + 1]; ++k)
+			if (snapshot.Contains (this->_cell_elements[k], p))
+				return this->_cell_elements[k];
+
+		return not_found;
+	}
+
+	template <size_t dim>
+	double PointEvaluator<dim>::operator() (const Geometry::Point<dim>& p) const
+	{
+		size_t e = Locate (p);
+		if (e == this->_snapshot->Size())
+		{
+			if (std::isnan (this->_outside_value))
+				throw std::out_of_range ("PointEvaluator: evaluation at a point outside the mesh");
+			return this->_outside_value;
+		}
+
+		double point[dim];
+		for (size_t d = 0; d < dim; ++d)
+			point[d] = p[d];
+
+		std::vector<double> scratch;
+		return EvaluatePoint (e, point, scratch);
+	}
+
+	template <size_t dim>
+	void PointEvaluator<dim>::Evaluate (const double* points, double* values, size_t n) const
+	{
+		size_t n_threads = std::min (this->_threads,
+									 std::max (n / _points_per_thread, static_cast<size_t> (1)));
+
+		std::vector<char> inside (n_threads, 1);
+		std::vector<std::exception_ptr> errors (n_threads, nullptr);
+
+		auto worker = [&] (size_t t)
+		{
+			try
+			{
+				inside[t] = EvaluateRange (points, values, n * t / n_threads, n * (t + 1) / n_threads);
+			}
+			catch (...)
+			{
+				errors[t] = std::current_exception();
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (size_t t = 1; t < n_threads; ++t)
+			pool.emplace_back (worker, t);
+
+		//the calling thread works too
+		worker (0);
+		for (auto& t : pool)
+			t.join();
+
+		for (size_t t = 0; t < n_threads; ++t)
+		{
+			if (errors[t])
+				std::rethrow_exception (errors[t]);
+			if (!inside[t])
+				throw std::out_of_range ("PointEvaluator: evaluation at a point outside the mesh");
+		}
+	}
+
+	template <size_t dim>
+	bool PointEvaluator<dim>::EvaluateRange (const double* points, double* values,
+											 size_t first, size_t last) const
+	{
+		size_t n_elements = this->_snapshot->Size();
+		bool inside = true;
+		std::vector<double> scratch;
+		Geometry::Point<dim> p;
+
+		auto locate = [&] (size_t q)
+		{
+			for (size_t d = 0; d < dim; ++d)
+				p[d] = points[q * dim + d];
+			return Locate (p);
+		};
+
+		auto outside = [&] (size_t q)
+		{
+			if (std::isnan (this->_outside_value))
+				inside = false;
+			values[q] = this->_outside_value;
+		};
+
+		if (last - first < _grouped_points)
+		{
+			for (size_t q = first; q < last; ++q)
+			{
+				size_t e = locate (q);
+				if (e == n_elements)
+					outside (q);
+				else
+					values[q] = EvaluatePoint (e, points + q * dim, scratch);
+			}
+			return inside;
+		}
+
+		//the points are grouped by element, the ones outside the mesh are the last group
+		std::vector<std::pair<size_t, size_t>> grouped (last - first);
+		for (size_t q = first; q < last; ++q)
+			grouped[q - first] = std::make_pair (locate (q), q);
+		std::sort (grouped.begin(), grouped.end());
+
+		std::vector<size_t> which (_block_size);
+		for (size_t k = 0; k < grouped.size();)
+		{
+			size_t e = grouped[k].first;
+			size_t end = k;
+			while (end < grouped.size() && grouped[end].first == e)
+				++end;
+
+			if (e == n_elements)
+				for (; k < end; ++k)
+					outside (grouped[k].second);
+			else if (this->_tensor_legendre[e])
+				for (; k < end; k += _block_size)
+				{
+					size_t m = std::min (_block_size, end - k);
+					for (size_t j = 0; j < m; ++j)
+						which[j] = grouped[k + j].second;
+					EvaluateBlock (e, points, which.data(), m, values, scratch);
+				}
+			else
+				for (; k < end; ++k)
+				{
+					size_t q = grouped[k].second;
+					values[q] = EvaluatePoint (e, points + q * dim, scratch);
+				}
+
+			k = end;
+		}
+
+		return inside;
+	}
+
+	template <size_t dim>
+	double PointEvaluator<dim>::EvaluatePoint (size_t e, const double* point, std::vector<double>& scratch) const
+	{
+		if (this->_tensor_legendre[e])
+		{
+			size_t zero = 0;
+			double value;
+			EvaluateBlock (e, point, &zero, 1, &value, scratch);
+			return value;
+		}
+
+		Geometry::Point<dim> p;
+		for (size_t d = 0; d < dim; ++d)
+			p[d] = point[d];
+		return this->_snapshot->Evaluate (e, p);
+	}
+
+	template <size_t dim>
+	void PointEvaluator<dim>::EvaluateBlock (size_t e,
+											 const double* points,
+											 const size_t* which,
+											 size_t m,
+											 double* values,
+											 std::vector<double>& scratch) const
+	{
+		const size_t B = _block_size;
+		auto& snapshot (*this->_snapshot);
+		size_t p_level = snapshot.PLevel (e);
+		auto coeff = snapshot.Coefficients (e);
+		auto matrix = snapshot.InverseMatrix (e);
+		auto shift = snapshot.InverseShift (e);
+
+		/*	Layout of the scratch storage:
+				- the reference coordinates, coordinate after coordinate
+				- the 1D Legendre polynomials until p_level,
+				  coordinate after coordinate and degree after degree
+				- the values
+			each row has B entries, one for each point */
+		scratch.resize (B * (dim + dim * (p_level + 1) + 1));
+		double* ref = scratch.data();
+		double* table = ref + B * dim;
+		double* result = table + B * dim * (p_level + 1);
+
+		for (size_t d = 0; d < dim; ++d)
+			for (size_t j = 0; j < m; ++j)
+			{
+				const double* x = points + which[j] * dim;
+				double t = shift[d];
+				for (size_t c = 0; c < dim; ++c)
+					t += matrix[d * dim + c] * x[c];
+				ref[d * B + j] = t;
+			}
+
+		//three terms recurrence of the Legendre polynomials
+		for (size_t d = 0; d < dim; ++d)
+		{
+			const double* x = ref + d * B;
+			double* row = table + d * (p_level + 1) * B;
+
+			for (size_t j = 0; j < m; ++j)
+				row[j] = 1;
+
+			if (p_level >= 1)
+				for (size_t j = 0; j < m; ++j)
+					row[B + j] = x[j];
+
+			for (size_t k = 1; k < p_level; ++k)
+			{
+				double a = (2.0 * k + 1) / (k + 1);
+				double b = static_cast<double> (k) / (k + 1);
+				const double* previous = row + (k - 1) * B;
+				const double* current = row + k * B;
+				double* next = row + (k + 1) * B;
+				for (size_t j = 0; j < m; ++j)
+					next[j] = a * x[j] * current[j] - b * previous[j];
+			}
+		}
+
+		for (size_t j = 0; j < m; ++j)
+			result[j] = 0;
+
+		for (size_t i = 0; i < coeff.Size(); ++i)
+		{
+			std::array<const double*, dim> factors;
+			for (size_t d = 0; d < dim; ++d)
+				factors[d] = table + (d * (p_level + 1) + this->_indexes[i][d]) * B;
+
+			double c = coeff[i];
+			for (size_t j = 0; j < m; ++j)
+			{
+				double v = c;
+				for (size_t d = 0; d < dim; ++d)
+					v *= factors[d][j];
+				result[j] += v;
+			}
+		}
+
+		for (size_t j = 0; j < m; ++j)
+			values[which[j]] = result[j];
+	}
+
+	template <size_t dim>
+	void PointEvaluator<dim>::OutsideValue (double value)
+	{
+		this->_outside_value = value;
+	}
+
+	template <size_t dim>
+	const ApproximationSnapshot<dim>& PointEvaluator<dim>::Snapshot() const
+	{
+		return *this->_snapshot;
+	}
+
+	template <size_t dim>
+	std::string PointEvaluator<dim>::Formula() const
+	{
+		return "hp approximation on " + std::to_string (this->_snapshot->Size()) + " elements";
+	}
+
+} //namespace BinaryTree
+
+#endif //__POINT_EVALUATOR_H
@@ -0,0 +1,217 @@
+#ifndef __PROCESS_FUNCTOR_H
+#define __PROCESS_FUNCTOR_H
+
+#include "Functor.h"
+
+#include <functional> //std::function
+#include <mutex> //std::mutex, std::lock_guard
+#include <sys/types.h> //pid_t
+
+namespace BinaryTree
+{
+	/**
+		Child process evaluating a function on request.
+		The function is evaluated in a process forked at construction,
+		which receives the points and sends back the values through a socket,
+		as an external solver would do.
+		Every request costs a round trip between the processes,
+		so the points should be sent in batches as large as possible.
+	**/
+	class SolverProcess
+	{
+	  public:
+		/**
+			Batched evaluator run by the child process:
+			points coordinates, storage for the values, number of points
+		**/
+		using Evaluator = std::function<void (const double*, double*, size_t)>;
+
+		/**
+			constructor.
+			Input parameters:
+				- the evaluator
+				- the number of coordinates of a point
+			It raises a runtime_error exception if the process cannot be created.
+		**/
+		SolverProcess (const Evaluator&, size_t);
+
+		/**
+			destructor.
+			It shuts down and closes the socket, then waits for the child process.
+			Since the child processes created later inherit the socket,
+			closing it alone would not stop the child, so the processes
+			can be destroyed in any order.
+		**/
+		~SolverProcess();
+
+		/**
+			Evaluate the function.
+			Input parameters:
+				- the coordinates of the points
+				- the storage for the values
+				- the number of points
+			Requests are not serialized, the caller has to do it.
+			It raises a runtime_error exception if the communication fails.
+		**/
+		void Request (const double*, double*, size_t);
+
+		/**
+			Number of requests sent to the child process
+		**/
+		size_t Requests() const;
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		SolverProcess (const SolverProcess&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		SolverProcess& operator = (const SolverProcess&) = delete;
+
+		/**
+			Loop executed by the child process, until the socket is closed
+		**/
+		void Serve (int, const Evaluator&);
+
+	  private:
+		/**
+			number of coordinates of a point
+		**/
+		size_t _dim;
+		/**
+			socket connected to the child process
+		**/
+		int _socket;
+		/**
+			child process identifier
+		**/
+		pid_t _pid;
+		/**
+			number of requests
+		**/
+		size_t _requests;
+	};
+
+	/**
+		Functor evaluated by a SolverProcess.
+		It stands in for functors backed by an external solver:
+		each evaluation is a request to another process,
+		and Submit() sends the batch without waiting for the values.
+		Requests are serialized, so the functor can be used by several threads.
+	**/
+	template <size_t dim>
+	class ProcessFunctor : public Functor<dim>
+	{
+	  public:
+		/**
+			constructor.
+			Input parameter: the functor evaluated by the child process.
+			It raises a runtime_error exception if the process cannot be created.
+		**/
+		ProcessFunctor (const FunctionPtr<dim>&);
+
+		/**
+			default destructor
+		**/
+		virtual ~ProcessFunctor() {};
+
+		/**
+			Single point evaluation, i.e. a request with one point
+		**/
+		virtual double operator() (const Geometry::Point<dim>&) const override;
+
+		/**
+			Batched evaluation, i.e. a single request to the child process
+		**/
+		virtual void Evaluate (const double*, double*, size_t) const override;
+
+		/**
+			Asynchronous batched evaluation.
+			The request is sent by another thread.
+		**/
+		virtual std::future<std::vector<double>> Submit (std::vector<double>) const override;
+
+		virtual std::string Formula() const override
+		{
+			return this->_f->Formula();
+		};
+
+		virtual std::string ID() const override
+		{
+			return this->_f->ID();
+		};
+
+		/**
+			Number of requests sent to the child process
+		**/
+		size_t Requests() const;
+
+	  protected:
+		/**
+			The functor evaluated by the child process
+		**/
+		FunctionPtr<dim> _f;
+		/**
+			The child process
+		**/
+		mutable SolverProcess _process;
+		/**
+			Mutex serializing the requests
+		**/
+		mutable std::mutex _mutex;
+	};
+
+
+	template <size_t dim>
+	ProcessFunctor<dim>::ProcessFunctor (const FunctionPtr<dim>& f) :
+		_f (f),
+		_process ([f] (const double* points, double* values, size_t n)
+	{
+		f->Evaluate (points, values, n);
+	}, dim)
+	{}
+
+	template <size_t dim>
+	double ProcessFunctor<dim>::operator() (const Geometry::Point<dim>& p) const
+	{
+		double coordinates[dim];
+		for (size_t i = 0; i < dim; ++i)
+			coordinates[i] = p[i];
+
+		double value;
+		Evaluate (coordinates, &value, 1);
+		return value;
+	}
+
+	template <size_t dim>
+	void ProcessFunctor<dim>::Evaluate (const double* points, double* values, size_t n) const
+	{
+		std::lock_guard<std::mutex> lock (this->_mutex);
+		this->_process.Request (points, values, n);
+	}
+
+	template <size_t dim>
+	std::future<std::vector<double>> ProcessFunctor<dim>::Submit (std::vector<double> points) const
+	{
+		return std::async (std::launch::async,
+						   [this] (const std::vector<double>& p)
+		{
+			std::vector<double> values (p.size() / dim);
+			this->Evaluate (p.data(), values.data(), values.size());
+			return values;
+		},
+		std::move (points));
+	}
+
+	template <size_t dim>
+	size_t ProcessFunctor<dim>::Requests() const
+	{
+		std::lock_guard<std::mutex> lock (this->_mutex);
+		return this->_process.Requests();
+	}
+
+} //namespace BinaryTree
+
+#endif //__PROCESS_FUNCTOR_H
@@ -5,6 +5,9 @@
 #include "TypeEnumerations.h"
 #include "AbstractFactory.h"
 
+#include <stdexcept> //logic_error
+#include <vector>
+
 namespace Geometry
 {
 	/**
@@ -41,6 +44,66 @@ namespace Geometry
 		**/
 		virtual QuadWeightVec GetWeights() const = 0;
 
+		/**
+			Tell if the rule is the tensor product of a 1D rule.
+			In this case the nodes are ordered as a Cartesian grid,
+			with the last coordinate varying fastest:
+			if n is the number of 1D nodes, the node of index
+				i_0 * n^(dim-1) + ... + i_(dim-2) * n + i_(dim-1)
+			is the point (x_(i_0), ..., x_(i_(dim-1))).
+		**/
+		virtual bool IsTensorial() const
+		{
+			return false;
+		};
+		/**
+			Get the nodes of the 1D rule generating a tensorial rule
+		**/
+		virtual QuadPointVec<1> OneDPoints() const
+		{
+			throw logic_error ("OneDPoints requested to a not tensorial quadrature rule");
+		};
+		/**
+			Get the weights of the 1D rule generating a tensorial rule
+		**/
+		virtual QuadWeightVec OneDWeights() const
+		{
+			throw logic_error ("OneDWeights requested to a not tensorial quadrature rule");
+		};
+
+		/**
+			Tell if the rule is the last one of a family of nested rules.
+			In this case the nodes of the rule of level l are
+			the first LevelSizes()[l] nodes given by GetPoints(),
+			so a rule of higher level only adds nodes to the previous ones.
+			GetWeights() gives the weights of the highest level.
+		**/
+		virtual bool IsNested() const
+		{
+			return false;
+		};
+		/**
+			Get the number of nodes of each level of a nested rule
+		**/
+		virtual std::vector<size_t> LevelSizes() const
+		{
+			throw logic_error ("LevelSizes requested to a not nested quadrature rule");
+		};
+		/**
+			Get the order of exactness of each level of a nested rule
+		**/
+		virtual std::vector<size_t> LevelOrders() const
+		{
+			throw logic_error ("LevelOrders requested to a not nested quadrature rule");
+		};
+		/**
+			Get the weights of the rule of input level, one for each of its nodes
+		**/
+		virtual QuadWeightVec LevelWeights (size_t) const
+		{
+			throw logic_error ("LevelWeights requested to a not nested quadrature rule");
+		};
+
 		/**
 			Get the order of exactness of the rule.
 		**/
@@ -0,0 +1,249 @@
+#ifndef __REFINEMENT_LOG_H
+#define __REFINEMENT_LOG_H
+
+#include "BinaryNode.h"
+
+#include <string>
+#include <vector>
+#include <fstream> //std::ofstream, std::ifstream
+#include <functional> //std::function
+#include <limits> //std::numeric_limits
+#include <cstdint> //uint64_t
+#include <stdexcept> //std::runtime_error, std::logic_error
+
+namespace BinaryTree
+{
+	template <size_t dim>
+	class MeshRefiner;
+
+	/**
+		Record of an iteration of the algorithm in a refinement log
+	**/
+	struct RefinementEvent
+	{
+		/**
+			identifier of the bisected node
+		**/
+		uint64_t bisected;
+		/**
+			identifier of the left child of the bisected node
+		**/
+		uint64_t left;
+		/**
+			identifier of the right child of the bisected node
+		**/
+		uint64_t right;
+		/**
+			identifiers of the nodes whose p level has been raised,
+			i.e. the bisected node and its ancestors, from the bisected node up to the root
+		**/
+		std::vector<uint64_t> ancestors;
+		/**
+			for each one of the ancestors, flag telling if E = e after the iteration,
+			i.e. if the node is made active when its ancestors are not
+		**/
+		std::vector<bool> selected;
+	};
+
+	/**
+		Append-only file of refinement events, see RefinementLog and MeshRefiner::Replay().
+		Each event is written as a whole and flushed,
+		so an interrupted log loses at most the last event, which is ignored by RefinementLogReader.
+	**/
+	class RefinementLogFile
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the file name
+				- the dimension of the refined mesh
+				- flag telling if the events have to be appended to an existing log;
+				  if false, or the file does not exist, a new log is created.
+				  An event truncated by the end of the existing log is removed.
+			It raises a runtime_error exception if the file cannot be written,
+			or if it is appended to and it is not a log of the same dimension.
+		**/
+		RefinementLogFile (const std::string&, size_t dim, bool append = false);
+
+		/**
+			Write input event.
+			It raises a runtime_error exception if the file cannot be written.
+		**/
+		void Write (const RefinementEvent&);
+
+	  private:
+		/**
+			file name
+		**/
+		std::string _file_name;
+		/**
+			the log file
+		**/
+		std::ofstream _file;
+		/**
+			buffer of the event being written
+		**/
+		std::vector<uint64_t> _record;
+	};
+
+	/**
+		Reader of the events of a refinement log, one at a time,
+		so the log is never loaded as a whole.
+	**/
+	class RefinementLogReader
+	{
+	  public:
+		/**
+			constructor.
+			It raises a runtime_error exception if the file cannot be read,
+			or if it is not a log of input dimension.
+		**/
+		RefinementLogReader (const std::string&, size_t dim);
+
+		/**
+			Read the next event into the input one.
+			It returns false if there are no more events;
+			an event truncated by the end of the file is not read.
+		**/
+		bool Next (RefinementEvent&);
+
+		/**
+			Bytes of the file read so far, the truncated events excluded
+		**/
+		size_t ReadBytes() const;
+
+	  private:
+		/**
+			Read input number of values; it returns false at the end of the file
+		**/
+		bool ReadValues (uint64_t*, size_t);
+
+	  private:
+		/**
+			file name
+		**/
+		std::string _file_name;
+		/**
+			the log file
+		**/
+		std::ifstream _file;
+		/**
+			buffer of the event being read
+		**/
+		std::vector<uint64_t> _record;
+		/**
+			size of the file
+		**/
+		size_t _file_size;
+		/**
+			bytes of the header and of the events read
+		**/
+		size_t _read_bytes;
+	};
+
+	/**
+		Writer of the refinement log of a MeshRefiner:
+		for each iteration it records the bisected node, its children,
+		the ancestors whose p level has been raised and which of them are selected as active.
+		It is much lighter than a checkpoint, see MeshRefiner::Checkpoint(),
+		and MeshRefiner::Replay() rebuilds from it the refined mesh with its p levels
+		without computing any projection.
+
+		The events are recorded by Record(), to be called after each iteration,
+		or by the functor returned by Sink(), to be passed to MeshRefiner::Refine();
+		the non templated overload of Refine() does not call it, so it cannot be logged.
+	**/
+	template <size_t dim>
+	class RefinementLog
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the log file
+				- flag telling if the events have to be appended to an existing log,
+				  e.g. when the refinement is resumed
+			It raises a runtime_error exception if the file cannot be written.
+		**/
+		RefinementLog (const std::string&, bool append = false);
+
+		/**
+			Record the last iteration of input refiner, if it has not been recorded yet.
+			It raises a logic_error exception if some iterations have been performed
+			since the last recorded one, i.e. the log would be incomplete.
+		**/
+		void Record (MeshRefiner<dim>&);
+
+		/**
+			The functor recording the iterations of input refiner.
+			Passed to MeshRefiner::Refine(), it is called before the first iteration,
+			when there is nothing to record, and after each one.
+			The iterations performed before this call are not recorded.
+		**/
+		std::function<void()> Sink (MeshRefiner<dim>&);
+
+	  private:
+		/**
+			The log file
+		**/
+		RefinementLogFile _file;
+		/**
+			Iteration of the refiner recorded last, the maximum size_t if none
+		**/
+		size_t _recorded;
+		/**
+			The event being recorded
+		**/
+		RefinementEvent _event;
+	};
+
+
+	template <size_t dim>
+	RefinementLog<dim>::RefinementLog (const std::string& file_name, bool append) :
+		_file (file_name, dim, append),
+		_recorded (std::numeric_limits<size_t>::max()),
+		_event()
+	{}
+
+	template <size_t dim>
+	void RefinementLog<dim>::Record (MeshRefiner<dim>& refiner)
+	{
+		BinaryNode* node = refiner.LastBisection();
+		size_t iteration = refiner.Iterations();
+		if (!node || iteration == this->_recorded)
+			return;
+
+		if (this->_recorded != std::numeric_limits<size_t>::max() && iteration != this->_recorded + 1)
+			throw std::logic_error ("Iterations missing from the refinement log");
+
+		this->_event.bisected = node->NodeID();
+		this->_event.left = node->Left()->NodeID();
+		this->_event.right = node->Right()->NodeID();
+
+		this->_event.ancestors.clear();
+		this->_event.selected.clear();
+		for (; node; node = node->Dad())
+		{
+			this->_event.ancestors.push_back (node->NodeID());
+			//the projection error has been updated by the iteration
+			this->_event.selected.push_back (node->E() == node->ProjectionError());
+		}
+
+		this->_file.Write (this->_event);
+		this->_recorded = iteration;
+	}
+
+	template <size_t dim>
+	std::function<void()> RefinementLog<dim>::Sink (MeshRefiner<dim>& refiner)
+	{
+		this->_recorded = refiner.Iterations();
+		return [this, &refiner] ()
+		{
+			this->Record (refiner);
+		};
+	}
+
+} //namespace BinaryTree
+
+#endif //__REFINEMENT_LOG_H
@@ -0,0 +1,274 @@
+#ifndef __REFINEMENT_SESSION_H
+#define __REFINEMENT_SESSION_H
+
+#include "MeshRefiner.h"
+
+#include <chrono> //std::chrono::steady_clock
+#include <atomic> //std::atomic
+#include <limits> //std::numeric_limits
+
+namespace BinaryTree
+{
+	/**
+		State of a RefinementSession
+	**/
+	enum SessionState
+	{
+		/**
+			further iterations can be performed
+		**/
+		Running,
+		/**
+			the error is within the tolerance
+		**/
+		Converged,
+		/**
+			the maximum number of iterations has been performed
+		**/
+		Exhausted,
+		/**
+			the session has been cancelled
+		**/
+		Cancelled
+	};
+
+	/**
+		Resumable execution of the refinement algorithm on a MeshRefiner.
+		It performs the same iterations of MeshRefiner::Refine (max_iter, tol),
+		but the caller decides when they are performed: a few at a time through Step(),
+		or as many as fit in a time budget through RunFor() and RunUntil().
+		The state of the algorithm is kept by the refiner, so the calls can be interleaved
+		with other work, e.g. the refinement of other meshes in a service loop.
+		The error and the number of active elements are stored by the session,
+		so querying them does not iterate on the mesh.
+		The refiner has to outlive the session and it must not be refined by other means meanwhile.
+		Only Cancel() can be called by a thread other than the one running the session.
+	**/
+	template <size_t dim>
+	class RefinementSession
+	{
+	  public:
+		using Clock = std::chrono::steady_clock;
+
+		/**
+			constructor.
+			Input parameters:
+				- the refiner, already initialized and with the mesh loaded
+				- maximum number of iterations
+				- tolerance on the projection error
+		**/
+		RefinementSession (MeshRefiner<dim>&, size_t, double);
+
+		/**
+			Perform at most input number of iterations.
+			It returns the number of iterations performed,
+			less than requested if the session is no more running.
+		**/
+		size_t Step (size_t k = 1);
+
+		/**
+			Perform iterations until input deadline.
+			An iteration is not started if it is expected to end after the deadline,
+			given the duration of the previous one.
+			It returns the number of iterations performed.
+		**/
+		size_t RunUntil (Clock::time_point);
+
+		/**
+			As RunUntil(), with the deadline given by input time budget from now
+		**/
+		size_t RunFor (Clock::duration);
+
+		/**
+			Stop the session; the iteration being performed, if any, is completed.
+			It can be called by any thread.
+		**/
+		void Cancel();
+
+		/**
+			The state of the session
+		**/
+		SessionState State() const;
+
+		/**
+			True if no further iteration can be performed
+		**/
+		bool Done() const;
+
+		/**
+			Number of iterations performed
+		**/
+		size_t Iterations() const;
+
+		/**
+			Projection error after the last iteration
+		**/
+		double Error() const;
+
+		/**
+			Number of active elements after the last iteration.
+			It is counted on the first request after an iteration.
+		**/
+		size_t ActiveNodes() const;
+
+		/**
+			Duration of the last iteration
+		**/
+		Clock::duration LastIterationTime() const;
+
+	  protected:
+		/**
+			Perform an iteration and update the stored values,
+			if the session is running
+		**/
+		bool Iterate();
+
+	  protected:
+		/**
+			The refiner
+		**/
+		MeshRefiner<dim>& _refiner;
+		/**
+			Maximum number of iterations
+		**/
+		size_t _max_iter;
+		/**
+			Tolerance on the projection error
+		**/
+		double _tol;
+		/**
+			Number of iterations performed
+		**/
+		size_t _iterations;
+		/**
+			Projection error after the last iteration
+		**/
+		double _error;
+		/**
+			Number of active elements, or max size_t if not counted yet
+		**/
+		mutable size_t _active_nodes;
+		/**
+			Duration of the last iteration
+		**/
+		Clock::duration _last_iteration;
+		/**
+			Flag telling if the session has been cancelled
+		**/
+		std::atomic<bool> _cancelled;
+	};
+
+
+	template <size_t dim>
+	RefinementSession<dim>::RefinementSession (MeshRefiner<dim>& refiner,
+											   size_t max_iter,
+											   double tol) :
+		_refiner (refiner),
+		_max_iter (max_iter),
+		_tol (tol),
+		_iterations (0),
+		_error (refiner.GlobalError()),
+		_active_nodes (std::numeric_limits<size_t>::max()),
+		_last_iteration (Clock::duration::zero()),
+		_cancelled (false)
+	{}
+
+	template <size_t dim>
+	size_t RefinementSession<dim>::Step (size_t k)
+	{
+		size_t done = 0;
+		while (done < k && Iterate())
+			++done;
+
+		return done;
+	}
+
+	template <size_t dim>
+	size_t RefinementSession<dim>::RunUntil (Clock::time_point deadline)
+	{
+		size_t done = 0;
+		while (Clock::now() + this->_last_iteration <= deadline && Iterate())
+			++done;
+
+		return done;
+	}
+
+	template <size_t dim>
+	size_t RefinementSession<dim>::RunFor (Clock::duration budget)
+	{
+		return RunUntil (Clock::now() + budget);
+	}
+
+	template <size_t dim>
+	void RefinementSession<dim>::Cancel()
+	{
+		this->_cancelled = true;
+	}
+
+	template <size_t dim>
+	SessionState RefinementSession<dim>::State() const
+	{
+		if (this->_cancelled)
+			return Cancelled;
+		if (this->_error <= this->_tol)
+			return Converged;
+		if (this->_iterations >= this->_max_iter)
+			return Exhausted;
+
+		return Running;
+	}
+
+	template <size_t dim>
+	bool RefinementSession<dim>::Done() const
+	{
+		return State() != Running;
+	}
+
+	template <size_t dim>
+	size_t RefinementSession<dim>::Iterations() const
+	{
+		return this->_iterations;
+	}
+
+	template <size_t dim>
+	double RefinementSession<dim>::Error() const
+	{
+		return this->_error;
+	}
+
+	template <size_t dim>
+	size_t RefinementSession<dim>::ActiveNodes() const
+	{
+		if (this->_active_nodes == std::numeric_limits<size_t>::max())
+			this->_active_nodes = this->_refiner.ActiveNodesNumber();
+
+		return this->_active_nodes;
+	}
+
+	template <size_t dim>
+	typename RefinementSession<dim>::Clock::duration
+	RefinementSession<dim>::LastIterationTime() const
+	{
+		return this->_last_iteration;
+	}
+
+	template <size_t dim>
+	bool RefinementSession<dim>::Iterate()
+	{
+		if (Done())
+			return false;
+
+		auto start = Clock::now();
+
+		this->_refiner.Iterate();
+		this->_error = this->_refiner.GlobalError();
+		this->_active_nodes = std::numeric_limits<size_t>::max();
+		++this->_iterations;
+
+		this->_last_iteration = Clock::now() - start;
+		return true;
+	}
+
+} //namespace BinaryTree
+
+#endif //__REFINEMENT_SESSION_H
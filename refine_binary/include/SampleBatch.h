@@ -0,0 +1,220 @@
+#ifndef __SAMPLE_BATCH_H
+#define __SAMPLE_BATCH_H
+
+#include "Functor.h"
+
+#include <vector>
+#include <functional> //std::function
+#include <future> //std::future
+#include <utility> //std::pair
+#include <stdexcept> //std::logic_error, std::runtime_error
+
+namespace BinaryTree
+{
+	/**
+		Batch of points where a functor has to be evaluated, gathered from several elements.
+		Each element adds the coordinates of the points it needs, together with a receiver;
+		the whole batch is then submitted to the functor as a single asynchronous request
+		(see Functor::Submit()), and when the values are available
+		they are scattered back, calling each receiver with its own values.
+		Between Submit() and Scatter() the caller can go on with the work
+		which does not depend on the values.
+		While a batch is collecting, binary elements being initialized add their requests to it,
+		instead of evaluating the functor, see AbstractBinaryElement::Init().
+	**/
+	template <size_t dim>
+	class SampleBatch
+	{
+	  public:
+		/**
+			Function receiving the values at the points of a request
+		**/
+		using Receiver = std::function<void (const double*)>;
+
+		/**
+			default constructor
+		**/
+		SampleBatch();
+
+		/**
+			destructor.
+			It stops collecting, the outstanding values are not scattered.
+		**/
+		~SampleBatch();
+
+		/**
+			Add a request.
+			Input parameters:
+				- the coordinates of the points, stored point after point
+				- the receiver of the values
+			It raises a logic_error exception if the batch has been already submitted.
+		**/
+		void Add (const std::vector<double>&, const Receiver&);
+
+		/**
+			Submit the batch to input functor.
+			It does nothing if the batch is empty.
+		**/
+		void Submit (const Functor<dim>&);
+
+		/**
+			Wait for the values and scatter them to the receivers, in the order of the requests.
+			Then the batch is empty, and it can be used again.
+			It raises a logic_error exception if a non empty batch has not been submitted.
+		**/
+		void Scatter();
+
+		/**
+			Number of points in the batch
+		**/
+		size_t Size() const;
+
+		/**
+			Number of requests in the batch
+		**/
+		size_t Requests() const;
+
+		/**
+			Start or stop collecting the requests of the elements being initialized.
+			Only one batch per thread can collect at the same time,
+			a batch which starts collecting takes the place of the previous one.
+		**/
+		void Collect (bool);
+
+		/**
+			The batch collecting the requests in the calling thread, nullptr if there is none
+		**/
+		static SampleBatch<dim>* Collecting();
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		SampleBatch (const SampleBatch&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		SampleBatch& operator = (const SampleBatch&) = delete;
+
+		/**
+			Reference to the pointer to the collecting batch
+		**/
+		static SampleBatch<dim>*& CollectingBatch();
+
+	  private:
+		/**
+			coordinates of the points of all the requests
+		**/
+		std::vector<double> _points;
+		/**
+			receivers, together with the index of the first point of their request
+		**/
+		std::vector<std::pair<size_t, Receiver>> _receivers;
+		/**
+			values of the submitted batch
+		**/
+		std::future<std::vector<double>> _values;
+		/**
+			flag telling if the batch has been submitted
+		**/
+		bool _submitted;
+	};
+
+
+	template <size_t dim>
+	SampleBatch<dim>::SampleBatch() :
+		_points(),
+		_receivers(),
+		_values(),
+		_submitted (false)
+	{}
+
+	template <size_t dim>
+	SampleBatch<dim>::~SampleBatch()
+	{
+		if (CollectingBatch() == this)
+			CollectingBatch() = nullptr;
+	}
+
+	template <size_t dim>
+	void SampleBatch<dim>::Add (const std::vector<double>& points, const Receiver& receiver)
+	{
+		if (this->_submitted)
+			throw std::logic_error ("Trying to add a request to a submitted batch");
+
+		this->_receivers.push_back (std::make_pair (Size(), receiver));
+		this->_points.insert (this->_points.end(), points.begin(), points.end());
+	}
+
+	template <size_t dim>
+	void SampleBatch<dim>::Submit (const Functor<dim>& f)
+	{
+		if (this->_submitted || this->_receivers.empty())
+			return;
+
+		this->_values = f.Submit (this->_points);
+		this->_submitted = true;
+	}
+
+	template <size_t dim>
+	void SampleBatch<dim>::Scatter()
+	{
+		if (this->_receivers.empty())
+			return;
+
+		if (!this->_submitted)
+			throw std::logic_error ("Trying to scatter a batch not submitted");
+
+		auto values = this->_values.get();
+		if (values.size() != Size())
+			throw std::runtime_error ("Wrong number of values in the evaluated batch");
+
+		/*	The batch is emptied before calling the receivers,
+			so they can add new requests to it */
+		auto receivers = std::move (this->_receivers);
+		this->_receivers.clear();
+		this->_points.clear();
+		this->_submitted = false;
+
+		for (auto& r : receivers)
+			r.second (values.data() + r.first);
+	}
+
+	template <size_t dim>
+	size_t SampleBatch<dim>::Size() const
+	{
+		return this->_points.size() / dim;
+	}
+
+	template <size_t dim>
+	size_t SampleBatch<dim>::Requests() const
+	{
+		return this->_receivers.size();
+	}
+
+	template <size_t dim>
+	void SampleBatch<dim>::Collect (bool flag)
+	{
+		if (flag)
+			CollectingBatch() = this;
+		else if (CollectingBatch() == this)
+			CollectingBatch() = nullptr;
+	}
+
+	template <size_t dim>
+	SampleBatch<dim>* SampleBatch<dim>::Collecting()
+	{
+		return CollectingBatch();
+	}
+
+	template <size_t dim>
+	SampleBatch<dim>*& SampleBatch<dim>::CollectingBatch()
+	{
+		//each thread collects its own requests, so concurrent refinements do not mix them
+		static thread_local SampleBatch<dim>* collecting = nullptr;
+		return collecting;
+	}
+
+} //namespace BinaryTree
+
+#endif //__SAMPLE_BATCH_H
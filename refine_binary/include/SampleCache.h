@@ -0,0 +1,327 @@
+#ifndef __SAMPLE_CACHE_H
+#define __SAMPLE_CACHE_H
+
+#include "Functor.h"
+
+#include <string>
+#include <memory> //std::shared_ptr
+#include <unordered_map>
+#include <mutex> //std::mutex
+#include <cstdint> //uint64_t
+
+namespace BinaryTree
+{
+	/**
+		Counters of a SampleCache
+	**/
+	struct SampleCacheStatistics
+	{
+		/**
+			number of blocks found in the cache
+		**/
+		size_t hits = 0;
+		/**
+			number of blocks not found in the cache
+		**/
+		size_t misses = 0;
+		/**
+			number of samples read from the cache
+		**/
+		size_t hit_samples = 0;
+		/**
+			number of samples stored in the cache
+		**/
+		size_t stored_samples = 0;
+		/**
+			number of blocks removed to make room for new ones
+		**/
+		size_t evicted_blocks = 0;
+		/**
+			bytes of the cache file used by the blocks
+		**/
+		size_t used_bytes = 0;
+	};
+
+	/**
+		Persistent cache of blocks of function samples.
+		Blocks are identified by a 64 bit key, together with a second 64 bit hash
+		used to detect collisions, and stored in an append-only memory-mapped file,
+		so they are available to following runs.
+		The file has a fixed size, split in segments which are filled in turn:
+		when the last one is full, the oldest segment is emptied and reused,
+		i.e. the blocks are evicted in FIFO order.
+		The file is locked while the cache is open, so it cannot be shared by concurrent runs.
+		Each block is flushed to the file before it is published in the segment header,
+		and it is stored with a hash of its values, checked when the file is opened again,
+		so the blocks torn by a crash are discarded instead of being read as samples.
+		The methods are synchronized by an internal mutex,
+		so a cache can be used by several threads at the same time.
+	**/
+	class SampleCache
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the cache file; it is created if it does not exist,
+				  or if it has been created with a different size
+				- the size cap of the file in bytes
+			It raises a runtime_error exception if the file cannot be created, mapped or locked.
+		**/
+		SampleCache (const std::string&, size_t max_bytes = (1 << 30));
+
+		/**
+			destructor.
+			It flushes the mapping and releases the file.
+		**/
+		~SampleCache();
+
+		/**
+			Look for a block.
+			Input parameters:
+				- the key
+				- the collision check hash
+				- the storage for the values
+				- the number of values
+			It returns true, filling the storage, if the block is found.
+		**/
+		bool Find (uint64_t, uint64_t, double*, size_t);
+
+		/**
+			Store a block.
+			Input parameters as Find().
+			Blocks larger than a segment are not stored.
+			The block is written to the file before this method returns,
+			it raises a runtime_error exception if it cannot be flushed.
+		**/
+		void Store (uint64_t, uint64_t, const double*, size_t);
+
+		/**
+			Number of blocks currently stored
+		**/
+		size_t Size() const;
+
+		/**
+			The cache counters
+		**/
+		SampleCacheStatistics Statistics() const;
+
+		/**
+			64 bit FNV-1a hash of input bytes, starting from input hash value
+		**/
+		static uint64_t Hash (const void*, size_t, uint64_t seed = 14695981039346656037ULL);
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		SampleCache (const SampleCache&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		SampleCache& operator = (const SampleCache&) = delete;
+
+		/**
+			Initialize the header of an empty cache file
+		**/
+		void Format();
+
+		/**
+			Fill the index with the blocks stored in input segment
+		**/
+		void IndexSegment (size_t);
+
+		/**
+			Empty input segment, removing its blocks from the index
+		**/
+		void EvictSegment (size_t);
+
+		/**
+			Write to the file input number of bytes of the mapping starting from input offset
+		**/
+		void Flush (size_t, size_t);
+
+		/**
+			Pointer to the header field with input index
+		**/
+		uint64_t* HeaderField (size_t) const;
+
+		/**
+			Offset of the beginning of input segment
+		**/
+		size_t SegmentBegin (size_t) const;
+
+	  private:
+		/**
+			Location of a stored block
+		**/
+		struct Block
+		{
+			size_t offset;
+			uint64_t check;
+			size_t size;
+		};
+
+		/**
+			file descriptor
+		**/
+		int _fd;
+		/**
+			mapped file
+		**/
+		char* _data;
+		/**
+			size of the file
+		**/
+		size_t _size;
+		/**
+			size of a segment
+		**/
+		size_t _segment_bytes;
+		/**
+			index of the stored blocks
+		**/
+		std::unordered_map<uint64_t, Block> _index;
+		/**
+			counters
+		**/
+		SampleCacheStatistics _statistics;
+		/**
+			mutex synchronizing the methods
+		**/
+		mutable std::mutex _mutex;
+	};
+
+	/**
+		Functor memoizing the batched evaluations of another functor in a SampleCache.
+		The key of a batch is the hash of the functor ID() and Formula(), and of the coordinates of the points:
+		the points of a batch are the quadrature nodes mapped on an element,
+		so the key depends on the element geometry and on the quadrature rule.
+		Single point evaluations are not cached.
+		The wrapped functor is hidden, so its specializations
+		(e.g. the separable ones) are not seen by the binary elements.
+	**/
+	template <size_t dim>
+	class CachedFunctor : public Functor<dim>
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the functor to be cached
+				- the cache
+		**/
+		CachedFunctor (const FunctionPtr<dim>&, const std::shared_ptr<SampleCache>&);
+
+		/**
+			default destructor
+		**/
+		virtual ~CachedFunctor() {};
+
+		virtual double operator() (const Geometry::Point<dim>& p) const override
+		{
+			return (*this->_f) (p);
+		};
+
+		/**
+			Batched evaluation.
+			The values are taken from the cache if available,
+			otherwise they are computed by the wrapped functor and stored.
+		**/
+		virtual void Evaluate (const double*, double*, size_t) const override;
+
+		/**
+			Asynchronous batched evaluation.
+			If the values are not in the cache, the batch is submitted to the wrapped functor,
+			and the values are stored when they are requested.
+		**/
+		virtual std::future<std::vector<double>> Submit (std::vector<double>) const override;
+
+		virtual std::string Formula() const override
+		{
+			return this->_f->Formula();
+		};
+
+		virtual std::string ID() const override
+		{
+			return this->_f->ID();
+		};
+
+		/**
+			The cache
+		**/
+		const SampleCache& Cache() const
+		{
+			return *this->_cache;
+		};
+
+	  protected:
+		/**
+			The cached functor
+		**/
+		FunctionPtr<dim> _f;
+		/**
+			The cache
+		**/
+		std::shared_ptr<SampleCache> _cache;
+		/**
+			Hash of the functor identifiers, seed of the batch keys
+		**/
+		uint64_t _seed;
+	};
+
+
+	template <size_t dim>
+	CachedFunctor<dim>::CachedFunctor (const FunctionPtr<dim>& f,
+									   const std::shared_ptr<SampleCache>& cache) :
+		_f (f),
+		_cache (cache)
+	{
+		std::string id = f->ID() + '\n' + f->Formula() + '\n' + std::to_string (dim);
+		this->_seed = SampleCache::Hash (id.data(), id.size());
+	}
+
+	template <size_t dim>
+	void CachedFunctor<dim>::Evaluate (const double* points, double* values, size_t n) const
+	{
+		size_t bytes = n * dim * sizeof (double);
+		uint64_t key = SampleCache::Hash (points, bytes, this->_seed);
+		//the check hash starts from a different seed, so it is independent from the key
+		uint64_t check = SampleCache::Hash (points, bytes, ~this->_seed);
+
+		if (this->_cache->Find (key, check, values, n))
+			return;
+
+		this->_f->Evaluate (points, values, n);
+		this->_cache->Store (key, check, values, n);
+	}
+
+	template <size_t dim>
+	std::future<std::vector<double>> CachedFunctor<dim>::Submit (std::vector<double> points) const
+	{
+		size_t bytes = points.size() * sizeof (double);
+		uint64_t key = SampleCache::Hash (points.data(), bytes, this->_seed);
+		uint64_t check = SampleCache::Hash (points.data(), bytes, ~this->_seed);
+
+		std::vector<double> values (points.size() / dim);
+		if (this->_cache->Find (key, check, values.data(), values.size()))
+		{
+			std::promise<std::vector<double>> found;
+			found.set_value (std::move (values));
+			return found.get_future();
+		}
+
+		/*	The wrapped functor starts the evaluation now,
+			the cache is updated by the thread requesting the values */
+		auto submitted = std::make_shared<std::future<std::vector<double>>> (this->_f->Submit (std::move (points)));
+		return std::async (std::launch::deferred, [this, key, check, submitted] ()
+		{
+			auto result = submitted->get();
+			this->_cache->Store (key, check, result.data(), result.size());
+			return result;
+		});
+	}
+
+} //namespace BinaryTree
+
+#endif //__SAMPLE_CACHE_H
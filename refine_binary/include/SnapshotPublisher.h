@@ -0,0 +1,231 @@
+#ifndef __SNAPSHOT_PUBLISHER_H
+#define __SNAPSHOT_PUBLISHER_H
+
+#include "ApproximationSnapshot.h"
+
+#include <memory> //std::shared_ptr
+#include <atomic> //std::atomic
+#include <mutex> //std::mutex, std::lock_guard
+#include <thread> //std::this_thread::yield
+#include <functional> //std::function
+#include <stdexcept> //std::invalid_argument
+
+namespace BinaryTree
+{
+	/**
+		Publisher of the snapshots of the approximation computed by a MeshRefiner,
+		in read-copy-update style: the refining thread builds a new ApproximationSnapshot
+		and replaces the current one, while any number of reader threads
+		get the latest one through Latest(), never waiting for a snapshot to be built.
+		Each snapshot is reference counted: it is kept alive by the readers holding it,
+		so it stays valid while newer ones are published,
+		and it is freed as soon as it has been replaced and its last reader releases it,
+		whatever the other readers are doing.
+
+		Readers are lock-free, std::atomic_load on a shared_ptr is not
+		(it takes a lock of a pool shared by the whole program).
+		The pointer is kept in one of two slots, each one with the count of the readers copying it:
+		a reader announces itself on the current slot, checks that it is still the current one,
+		then copies the pointer; if a publication has replaced the slot meanwhile, it tries again,
+		so a reader retries only when the publisher has made progress.
+		The publisher writes the other slot, makes it the current one,
+		then waits for the readers still copying the replaced pointer before releasing it:
+		they are done after a copy, while the new readers go to the new slot.
+
+		The snapshots are published by the refining thread calling Publish(),
+		or by the functor returned by Every(), to be passed to MeshRefiner::Refine()
+		so a snapshot is published every k iterations;
+		readers can ask for a snapshot of the next iteration through Request().
+	**/
+	template <size_t dim>
+	class SnapshotPublisher
+	{
+	  public:
+		using SnapshotPtr = std::shared_ptr<const ApproximationSnapshot<dim>>;
+
+		/**
+			default constructor.
+			No snapshot is available until the first one is published.
+		**/
+		SnapshotPublisher();
+
+		/**
+			destructor.
+			The snapshots held by the readers are still valid,
+			but Latest() must not be running.
+		**/
+		~SnapshotPublisher() {};
+
+		/**
+			Take a snapshot of input refiner and publish it.
+			It has to be called by the thread refining the mesh, when it is not iterating.
+			It returns the published snapshot.
+		**/
+		SnapshotPtr Publish (MeshRefiner<dim>&);
+
+		/**
+			The functor publishing a snapshot of input refiner
+			every k calls, and on the calls following a Request().
+			Passed to MeshRefiner::Refine(), it is called before the first iteration
+			and after each one, so the initial mesh is published too.
+			The last mesh is not published if the number of iterations is not a multiple of k;
+			Publish() can be called when Refine() returns.
+			It raises an invalid_argument exception if k is zero.
+		**/
+		std::function<void()> Every (MeshRefiner<dim>&, size_t k = 1);
+
+		/**
+			The latest snapshot, nullptr if none has been published.
+			It can be called by any thread; it never waits for the publisher nor for the other readers.
+		**/
+		SnapshotPtr Latest() const;
+
+		/**
+			Version of the latest snapshot, 0 if none has been published
+		**/
+		size_t Version() const;
+
+		/**
+			Ask for a snapshot to be published on the next call of the Every() functor.
+			It can be called by any thread.
+		**/
+		void Request();
+
+	  private:
+		/**
+			deleted copy constructor
+		**/
+		SnapshotPublisher (const SnapshotPublisher&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		SnapshotPublisher& operator = (const SnapshotPublisher&) = delete;
+
+	  private:
+		/**
+			A published snapshot with the number of readers copying it
+		**/
+		struct Slot
+		{
+			/**
+				The snapshot, written only by the publisher when no reader is copying it
+			**/
+			SnapshotPtr snapshot;
+			/**
+				Number of readers which have announced themselves on the slot
+			**/
+			std::atomic<size_t> readers;
+		};
+		/**
+			The slots of the latest snapshot and of the previous one, while it is released
+		**/
+		mutable Slot _slots[2];
+		/**
+			Index of the slot of the latest snapshot
+		**/
+		std::atomic<size_t> _current;
+		/**
+			Version of the latest snapshot
+		**/
+		std::atomic<size_t> _version;
+		/**
+			Flag telling if a reader has requested a snapshot
+		**/
+		std::atomic<bool> _requested;
+		/**
+			Mutex serializing the publications
+		**/
+		std::mutex _publish_mutex;
+	};
+
+
+	template <size_t dim>
+	SnapshotPublisher<dim>::SnapshotPublisher() :
+		_current (0),
+		_version (0),
+		_requested (false),
+		_publish_mutex()
+	{
+		for (auto& slot : this->_slots)
+			slot.readers = 0;
+	}
+
+	template <size_t dim>
+	typename SnapshotPublisher<dim>::SnapshotPtr
+	SnapshotPublisher<dim>::Publish (MeshRefiner<dim>& refiner)
+	{
+		std::lock_guard<std::mutex> lock (this->_publish_mutex);
+
+		this->_requested = false;
+
+		SnapshotPtr snapshot = std::make_shared<const ApproximationSnapshot<dim>> (refiner, this->_version + 1);
+
+		/*	The other slot has been released by the previous publication:
+			the readers which announce themselves on it find it is not the current one and leave it */
+		size_t old = this->_current;
+		Slot& slot = this->_slots[1 - old];
+		slot.snapshot = snapshot;
+		this->_current = 1 - old;
+		++this->_version;
+
+		/*	The readers announced on the replaced slot before the switch are copying its pointer;
+			the ones announced after it leave the slot without reading it */
+		Slot& replaced = this->_slots[old];
+		while (replaced.readers != 0)
+			std::this_thread::yield();
+
+		//the replaced snapshot is freed here, or by the last reader holding it
+		replaced.snapshot.reset();
+
+		return snapshot;
+	}
+
+	template <size_t dim>
+	std::function<void()> SnapshotPublisher<dim>::Every (MeshRefiner<dim>& refiner, size_t k)
+	{
+		if (k == 0)
+			throw std::invalid_argument ("SnapshotPublisher: snapshots have to be published every k > 0 iterations");
+
+		auto calls = std::make_shared<size_t> (0);
+		return [this, &refiner, k, calls] ()
+		{
+			if ((*calls)++ % k == 0 || this->_requested)
+				this->Publish (refiner);
+		};
+	}
+
+	template <size_t dim>
+	typename SnapshotPublisher<dim>::SnapshotPtr SnapshotPublisher<dim>::Latest() const
+	{
+		while (true)
+		{
+			size_t current = this->_current;
+			Slot& slot = this->_slots[current];
+
+			//the publisher does not release the slot while it is announced
+			++slot.readers;
+			if (this->_current == current)
+			{
+				SnapshotPtr snapshot = slot.snapshot;
+				--slot.readers;
+				return snapshot;
+			}
+			--slot.readers;
+		}
+	}
+
+	template <size_t dim>
+	size_t SnapshotPublisher<dim>::Version() const
+	{
+		return this->_version;
+	}
+
+	template <size_t dim>
+	void SnapshotPublisher<dim>::Request()
+	{
+		this->_requested = true;
+	}
+
+} //namespace BinaryTree
+
+#endif //__SNAPSHOT_PUBLISHER_H
@@ -0,0 +1,543 @@
+#ifndef __SNAPSHOT_STREAM_H
+#define __SNAPSHOT_STREAM_H
+
+#include "DeltaStream.h"
+#include "ApproximationSnapshot.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory> //std::unique_ptr, std::shared_ptr
+#include <functional> //std::function
+#include <limits> //std::numeric_limits
+#include <thread> //std::this_thread::yield
+#include <stdexcept> //std::logic_error, std::out_of_range
+
+namespace BinaryTree
+{
+	/**
+		Snapshot sink of a MeshRefiner, writing to a stream file the changes of the active elements:
+		after each iteration it stores the elements which have become active or have been re-leveled,
+		with their p level, error, vertices and coefficients, and the identifiers of the trimmed ones.
+		SnapshotStreamPlayer rebuilds from the stream the snapshot of any recorded iteration.
+
+		An iteration changes the active elements only below the highest node of the bisected path
+		which is active before or after it, so the sink does not sweep the mesh:
+		it compares the subtree of that node with the active elements recorded last,
+		the ones of the whole tree only if the path is not known,
+		e.g. on the first call or after iterations performed without the sink.
+
+		The deltas are passed to a background thread writing them to the file,
+		through a bounded queue without locks, so the refinement never waits for the file:
+		if the queue is full, the changes of the iteration are merged into the next delta,
+		whose snapshot is recorded in place of the skipped one.
+		Flush() records the last iteration in any case, waiting for room in the queue.
+
+		The sink is the functor returned by Sink(), to be passed to MeshRefiner::Refine(),
+		or Record(), to be called after each iteration.
+	**/
+	template <size_t dim>
+	class SnapshotStream
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the stream file
+				- the maximum number of deltas waiting to be written
+			It raises a runtime_error exception if the file cannot be written,
+			an invalid_argument exception if the capacity is zero.
+		**/
+		SnapshotStream (const std::string&, size_t capacity = 64);
+
+		/**
+			Record the current state of input refiner, if it has changed since the last record,
+			unless the queue is full.
+			The coefficients of the projection are computed on the new elements which have not stored them,
+			so the objective function may be evaluated;
+			it has to be called by the thread refining the mesh.
+		**/
+		void Record (MeshRefiner<dim>&);
+
+		/**
+			The functor recording the iterations of input refiner.
+			Passed to MeshRefiner::Refine(), it is called before the first iteration,
+			which records the whole initial mesh, and after each one.
+		**/
+		std::function<void()> Sink (MeshRefiner<dim>&);
+
+		/**
+			Record the current state of input refiner, if it has not been recorded,
+			waiting for room in the queue, then wait for every delta to be written.
+			To be called when Refine() returns.
+		**/
+		void Flush (MeshRefiner<dim>&);
+
+		/**
+			Number of deltas recorded
+		**/
+		size_t Deltas() const;
+
+		/**
+			Number of iterations whose changes have been merged into the next delta,
+			because the queue was full
+		**/
+		size_t MergedIterations() const;
+
+	  private:
+		/**
+			Functor collecting the roots of the tree
+		**/
+		class RootCollector : public NodeOperator
+		{
+		  public:
+			RootCollector (std::vector<BinaryNode*>& roots) : _roots (roots) {};
+
+			virtual void operator() (BinaryNode* node) override
+			{
+				if (!node->Dad())
+					this->_roots.push_back (node);
+			};
+
+		  private:
+			std::vector<BinaryNode*>& _roots;
+		};
+
+		/**
+			Compute the delta from the last recorded state and pass it to the writer,
+			which must have room for it
+		**/
+		void Push (MeshRefiner<dim>&);
+
+		/**
+			Compare the subtree of input node with the recorded active elements,
+			storing the changes in input delta.
+			The flags tell if the node has an ancestor active in the recorded state and in the current one;
+			the node is active in the current state if it has no such ancestor and E = e,
+			as set by RecursiveSelector.
+		**/
+		void Compare (BinaryNode*, bool recorded_above, bool active_above, SnapshotDelta&);
+
+		/**
+			Store the data of input active node in input delta
+		**/
+		static void AddElement (BinaryNode*, SnapshotDelta&);
+
+	  private:
+		/**
+			The writer of the stream
+		**/
+		DeltaStreamWriter _writer;
+		/**
+			p level of the active elements of the last recorded state, by node identifier
+		**/
+		std::unordered_map<size_t, size_t> _active;
+		/**
+			nodes bisected since the last recorded state
+		**/
+		std::vector<BinaryNode*> _bisected;
+		/**
+			flag telling if the whole tree has to be compared with the recorded state
+		**/
+		bool _whole_tree;
+		/**
+			iterations of the refiner on the last call, the maximum size_t if none
+		**/
+		size_t _seen;
+		/**
+			flag telling if the last seen state has been recorded
+		**/
+		bool _recorded;
+		/**
+			number of deltas recorded
+		**/
+		size_t _deltas;
+		/**
+			number of merged iterations
+		**/
+		size_t _merged;
+	};
+
+	/**
+		Reader rebuilding the snapshots recorded by a SnapshotStream.
+		The deltas are applied one at a time by Next(),
+		keeping in memory only the active elements of the current one;
+		Reconstruct() rebuilds the snapshot of a given iteration.
+	**/
+	template <size_t dim>
+	class SnapshotStreamPlayer
+	{
+	  public:
+		/**
+			constructor.
+			No delta is applied until Next() is called.
+			It raises a runtime_error exception if the file is not a delta stream of dimension dim.
+		**/
+		SnapshotStreamPlayer (const std::string&);
+
+		/**
+			Apply the next delta of the stream.
+			It returns false if there are no more deltas.
+		**/
+		bool Next();
+
+		/**
+			Iteration of the last applied delta.
+			It raises an out_of_range exception if no delta has been applied.
+		**/
+		size_t Iteration() const;
+
+		/**
+			Number of active elements after the last applied delta
+		**/
+		size_t Size() const;
+
+		/**
+			Snapshot after the last applied delta, with input version.
+			It raises an out_of_range exception if no delta has been applied.
+		**/
+		std::shared_ptr<const ApproximationSnapshot<dim>> Snapshot (size_t version = 0) const;
+
+		/**
+			Snapshot of the latest recorded iteration which does not follow input one.
+			It raises an out_of_range exception if the first recorded iteration follows it.
+		**/
+		static std::shared_ptr<const ApproximationSnapshot<dim>> Reconstruct (const std::string&, size_t);
+
+	  private:
+		/**
+			Data of an active element
+		**/
+		struct Element
+		{
+			size_t p_level;
+			double local_error;
+			Geometry::ElementType type;
+			FiniteElements::BasisType fe_type;
+			std::vector<double> vertices;
+			std::vector<double> coefficients;
+		};
+
+	  private:
+		/**
+			The stream
+		**/
+		DeltaStreamReader _reader;
+		/**
+			The last applied delta
+		**/
+		SnapshotDelta _delta;
+		/**
+			Flag telling if a delta has been applied
+		**/
+		bool _started;
+		/**
+			The active elements, by node identifier
+		**/
+		std::map<size_t, Element> _elements;
+	};
+
+
+	template <size_t dim>
+	SnapshotStream<dim>::SnapshotStream (const std::string& file_name, size_t capacity) :
+		_writer (file_name, dim, capacity),
+		_active(),
+		_bisected(),
+		_whole_tree (true),
+		_seen (std::numeric_limits<size_t>::max()),
+		_recorded (true),
+		_deltas (0),
+		_merged (0)
+	{}
+
+	template <size_t dim>
+	void SnapshotStream<dim>::Record (MeshRefiner<dim>& refiner)
+	{
+		size_t iteration = refiner.Iterations();
+		if (this->_seen == std::numeric_limits<size_t>::max())
+			this->_recorded = false;
+		else if (iteration != this->_seen)
+		{
+			//only the path of a single bisection is known
+			BinaryNode* bisected = refiner.LastBisection();
+			if (iteration == this->_seen + 1 && bisected)
+				this->_bisected.push_back (bisected);
+			else
+				this->_whole_tree = true;
+
+			if (!this->_recorded)
+				++this->_merged;
+			this->_recorded = false;
+		}
+		this->_seen = iteration;
+
+		if (!this->_recorded && !this->_writer.Full())
+			Push (refiner);
+	}
+
+	template <size_t dim>
+	std::function<void()> SnapshotStream<dim>::Sink (MeshRefiner<dim>& refiner)
+	{
+		return [this, &refiner] ()
+		{
+			this->Record (refiner);
+		};
+	}
+
+	template <size_t dim>
+	void SnapshotStream<dim>::Flush (MeshRefiner<dim>& refiner)
+	{
+		Record (refiner);
+		if (!this->_recorded)
+		{
+			while (this->_writer.Full())
+				std::this_thread::yield();
+			Push (refiner);
+		}
+
+		this->_writer.Drain();
+	}
+
+	template <size_t dim>
+	size_t SnapshotStream<dim>::Deltas() const
+	{
+		return this->_deltas;
+	}
+
+	template <size_t dim>
+	size_t SnapshotStream<dim>::MergedIterations() const
+	{
+		return this->_merged;
+	}
+
+	template <size_t dim>
+	void SnapshotStream<dim>::Push (MeshRefiner<dim>& refiner)
+	{
+		std::unique_ptr<SnapshotDelta> delta (new SnapshotDelta());
+		delta->iteration = refiner.Iterations();
+		delta->error = refiner.GlobalError();
+
+		/*	The changed elements lie below the highest node of each bisected path
+			which is active, in the recorded state or in the current one:
+			E and e have changed only along the paths */
+		std::vector<BinaryNode*> subtrees;
+		if (!this->_whole_tree)
+			for (auto bisected : this->_bisected)
+			{
+				BinaryNode* highest = nullptr;
+				for (auto node = bisected; node; node = node->Dad())
+					if (this->_active.count (node->NodeID()) || node->E() == node->ProjectionError())
+						highest = node;
+
+				if (!highest)
+				{
+					this->_whole_tree = true;
+					break;
+				}
+				subtrees.push_back (highest);
+			}
+
+		if (this->_whole_tree)
+		{
+			subtrees.clear();
+			RootCollector collector (subtrees);
+			refiner.IterateTreeNodes (collector);
+		}
+
+		//a subtree contained in another one is compared once
+		std::unordered_set<BinaryNode*> roots (subtrees.begin(), subtrees.end());
+		for (auto root : roots)
+		{
+			bool nested = false;
+			for (auto node = root->Dad(); node && !nested; node = node->Dad())
+				nested = roots.count (node);
+
+			if (!nested)
+				Compare (root, false, false, *delta);
+		}
+
+		this->_bisected.clear();
+		this->_whole_tree = false;
+		this->_recorded = true;
+		++this->_deltas;
+
+		this->_writer.Push (delta);
+	}
+
+	template <size_t dim>
+	void SnapshotStream<dim>::Compare (BinaryNode* node,
+									   bool recorded_above,
+									   bool active_above,
+									   SnapshotDelta& delta)
+	{
+		//below a node active in both states nothing is active
+		if (!node || (recorded_above && active_above))
+			return;
+
+		auto recorded = this->_active.end();
+		if (!recorded_above)
+			recorded = this->_active.find (node->NodeID());
+		bool was_active = recorded != this->_active.end();
+		bool is_active = !active_above && node->E() == node->ProjectionError();
+
+		if (was_active && is_active)
+		{
+			if (recorded->second != node->PLevel())
+			{
+				recorded->second = node->PLevel();
+				AddElement (node, delta);
+			}
+			return;
+		}
+
+		if (was_active)
+		{
+			delta.trimmed.push_back (node->NodeID());
+			this->_active.erase (recorded);
+		}
+		if (is_active)
+		{
+			this->_active[node->NodeID()] = node->PLevel();
+			AddElement (node, delta);
+		}
+
+		Compare (node->Left(), recorded_above || was_active, active_above || is_active, delta);
+		Compare (node->Right(), recorded_above || was_active, active_above || is_active, delta);
+	}
+
+	template <size_t dim>
+	void SnapshotStream<dim>::AddElement (BinaryNode* node, SnapshotDelta& delta)
+	{
+		auto element = dynamic_cast<DimensionedNode<dim>*> (node);
+		if (!element)
+			throw std::logic_error ("SnapshotStream: node of unexpected dimension");
+
+		delta.node_ids.push_back (element->NodeID());
+		delta.p_levels.push_back (element->PLevel());
+		delta.local_errors.push_back (element->ProjectionError());
+		delta.types.push_back (element->GetType());
+		delta.fe_types.push_back (element->GetFeType());
+
+		auto nodes = element->Nodes();
+		for (size_t v = 0; v < nodes.Size(); ++v)
+		{
+			auto vertex = nodes[v];
+			for (size_t d = 0; d < dim; ++d)
+				delta.vertices.push_back (vertex[d]);
+		}
+		delta.vertex_counts.push_back (nodes.Size() * dim);
+
+		auto coeff = element->ProjectionCoefficients();
+		delta.coefficients.insert (delta.coefficients.end(), coeff.Data(), coeff.Data() + coeff.Size());
+		delta.coeff_counts.push_back (coeff.Size());
+	}
+
+	template <size_t dim>
+	SnapshotStreamPlayer<dim>::SnapshotStreamPlayer (const std::string& file_name) :
+		_reader (file_name, dim),
+		_delta(),
+		_started (false),
+		_elements()
+	{}
+
+	template <size_t dim>
+	bool SnapshotStreamPlayer<dim>::Next()
+	{
+		if (!this->_reader.Next (this->_delta))
+			return false;
+
+		for (auto id : this->_delta.trimmed)
+			this->_elements.erase (id);
+
+		size_t vertex = 0;
+		size_t coeff = 0;
+		for (size_t i = 0; i < this->_delta.node_ids.size(); ++i)
+		{
+			auto& element = this->_elements[this->_delta.node_ids[i]];
+			element.p_level = this->_delta.p_levels[i];
+			element.local_error = this->_delta.local_errors[i];
+			element.type = static_cast<Geometry::ElementType> (this->_delta.types[i]);
+			element.fe_type = static_cast<FiniteElements::BasisType> (this->_delta.fe_types[i]);
+
+			auto first_vertex = this->_delta.vertices.begin() + vertex;
+			vertex += this->_delta.vertex_counts[i];
+			element.vertices.assign (first_vertex, this->_delta.vertices.begin() + vertex);
+
+			auto first_coeff = this->_delta.coefficients.begin() + coeff;
+			coeff += this->_delta.coeff_counts[i];
+			element.coefficients.assign (first_coeff, this->_delta.coefficients.begin() + coeff);
+		}
+
+		this->_started = true;
+		return true;
+	}
+
+	template <size_t dim>
+	size_t SnapshotStreamPlayer<dim>::Iteration() const
+	{
+		if (!this->_started)
+			throw std::out_of_range ("SnapshotStreamPlayer: no delta has been applied");
+
+		return this->_delta.iteration;
+	}
+
+	template <size_t dim>
+	size_t SnapshotStreamPlayer<dim>::Size() const
+	{
+		return this->_elements.size();
+	}
+
+	template <size_t dim>
+	std::shared_ptr<const ApproximationSnapshot<dim>>
+	SnapshotStreamPlayer<dim>::Snapshot (size_t version) const
+	{
+		if (!this->_started)
+			throw std::out_of_range ("SnapshotStreamPlayer: no delta has been applied");
+
+		std::shared_ptr<ApproximationSnapshot<dim>> result (
+			new ApproximationSnapshot<dim> (version, this->_delta.iteration, this->_delta.error));
+
+		for (auto& e : this->_elements)
+		{
+			auto& element = e.second;
+			size_t n_vertices = element.vertices.size() / dim;
+
+			Geometry::NodesVector<dim> nodes (n_vertices);
+			for (size_t v = 0; v < n_vertices; ++v)
+			{
+				Geometry::Point<dim> vertex;
+				for (size_t d = 0; d < dim; ++d)
+					vertex[d] = element.vertices[v * dim + d];
+				nodes.Insert (v, vertex);
+			}
+
+			result->Add (e.first, element.p_level, element.local_error,
+						 element.type, element.fe_type, nodes,
+						 Geometry::VectorView (element.coefficients.data(), element.coefficients.size()));
+		}
+
+		result->PrepareBases();
+		return result;
+	}
+
+	template <size_t dim>
+	std::shared_ptr<const ApproximationSnapshot<dim>>
+	SnapshotStreamPlayer<dim>::Reconstruct (const std::string& file_name, size_t iteration)
+	{
+		SnapshotStreamPlayer<dim> player (file_name);
+
+		/*	Deltas are read until the one following the iteration,
+			whose changes are not applied */
+		DeltaStreamReader lookahead (file_name, dim);
+		SnapshotDelta delta;
+		while (lookahead.Next (delta) && delta.iteration <= iteration)
+			player.Next();
+
+		return player.Snapshot();
+	}
+
+} //namespace BinaryTree
+
+#endif //__SNAPSHOT_STREAM_H
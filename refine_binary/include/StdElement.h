@@ -16,6 +16,8 @@ namespace Geometry
 		Class for reference elements.
 		It represents the standard element for elements with ElementType = Type
 		It stores the quadrature rule, which gives quadrature nodes and weights.
+		Nodes and weights are taken from the rule only once, at construction,
+		and they can be accessed without copies through QuadPointsView() and QuadWeightsView().
 	**/
 	template <size_t dim, ElementType Type = InvalidElementType>
 	class StdElement : public AbstractElement<dim>
@@ -53,11 +55,98 @@ namespace Geometry
 		**/
 		virtual size_t QuadratureOrder() const;
 
+		/**
+			Read-only view on the quadrature points of the standard element
+		**/
+		PointsView<dim> QuadPointsView() const;
+
+		/**
+			Read-only view on the quadrature weights of the standard element
+		**/
+		VectorView QuadWeightsView() const;
+
+		/**
+			Tell if the quadrature nodes are a Cartesian grid,
+			see QuadratureRuleInterface::IsTensorial()
+		**/
+		bool IsTensorial() const;
+
+		/**
+			Read-only view on the 1D nodes generating the quadrature grid.
+			It is empty if the quadrature rule is not tensorial.
+		**/
+		PointsView<1> OneDPointsView() const;
+
+		/**
+			Read-only view on the weights of the 1D rule generating the quadrature grid.
+			It is empty if the quadrature rule is not tensorial.
+		**/
+		VectorView OneDWeightsView() const;
+
+		/**
+			Number of levels of the quadrature rule.
+			A not nested rule has a single level, the whole rule;
+			see QuadratureRuleInterface::IsNested() for nested ones.
+		**/
+		size_t QuadLevels() const;
+
+		/**
+			Number of nodes of input level,
+			they are the first ones of QuadPointsView()
+		**/
+		size_t LevelSize (size_t) const;
+
+		/**
+			Exactness order of input level
+		**/
+		size_t LevelOrder (size_t) const;
+
+		/**
+			Read-only view on the weights of input level
+		**/
+		VectorView LevelWeightsView (size_t) const;
+
 	  protected:
 		/**
 			The quadrature rule
 		**/
 		unique_ptr<QuadratureRuleInterface<dim>> _quadrature_rule;
+
+		/**
+			The quadrature points, as given by the rule at construction
+		**/
+		QuadPointVec<dim> _points;
+
+		/**
+			The quadrature weights, as given by the rule at construction
+		**/
+		QuadWeightVec _weights;
+
+		/**
+			The 1D quadrature nodes, if the rule is tensorial
+		**/
+		QuadPointVec<1> _one_d_points;
+
+		/**
+			The 1D quadrature weights, if the rule is tensorial
+		**/
+		QuadWeightVec _one_d_weights;
+
+		/**
+			Number of nodes of each level, if the rule is nested
+		**/
+		vector<size_t> _level_sizes;
+
+		/**
+			Exactness order of each level, if the rule is nested
+		**/
+		vector<size_t> _level_orders;
+
+		/**
+			Weights of each level but the last one, if the rule is nested;
+			the last level weights are stored in _weights
+		**/
+		vector<QuadWeightVec> _level_weights;
 	};
 
 	template <size_t dim, ElementType Type>
@@ -65,6 +154,48 @@ namespace Geometry
 	{
 		auto& quad_factory = QuadratureFactory<dim>::Instance();
 		_quadrature_rule = move (quad_factory.create (Type));
+
+		//the conversion from the rule format is done here once for all
+		_points = _quadrature_rule->GetPoints();
+		_weights = _quadrature_rule->GetWeights();
+
+		if (_points.Size() != _weights.Size())
+			throw length_error
+			("Quadrature rule with different number of nodes and weights!");
+
+		if (_quadrature_rule->IsTensorial())
+		{
+			_one_d_points = _quadrature_rule->OneDPoints();
+			_one_d_weights = _quadrature_rule->OneDWeights();
+
+			size_t grid_size = 1;
+			for (size_t i = 0; i < dim; ++i)
+				grid_size *= _one_d_points.Size();
+
+			if (grid_size != _points.Size() || _one_d_weights.Size() != _one_d_points.Size())
+				throw length_error
+				("Tensorial quadrature rule with wrong number of nodes!");
+		}
+
+		if (_quadrature_rule->IsNested())
+		{
+			_level_sizes = _quadrature_rule->LevelSizes();
+			_level_orders = _quadrature_rule->LevelOrders();
+
+			if (_level_sizes.empty()
+					|| _level_sizes.size() != _level_orders.size()
+					|| _level_sizes.back() != _points.Size())
+				throw length_error
+				("Nested quadrature rule with wrong number of nodes!");
+
+			for (size_t l = 0; l + 1 < _level_sizes.size(); ++l)
+			{
+				_level_weights.push_back (_quadrature_rule->LevelWeights (l));
+				if (_level_weights.back().Size() != _level_sizes[l])
+					throw length_error
+					("Nested quadrature rule with different number of nodes and weights!");
+			}
+		}
 	}
 
 	template <size_t dim, ElementType Type>
@@ -80,15 +211,13 @@ namespace Geometry
 	template <size_t dim, ElementType Type>
 	QuadPointVec<dim> StdElement<dim, Type>::GetQuadPoints() const
 	{
-		//TODO: verify if it's convenient to store
-		//the quadrature nodes and weights as an attribute of the element
-		return _quadrature_rule->GetPoints();
+		return _points;
 	}
 
 	template <size_t dim, ElementType Type>
 	QuadWeightVec StdElement<dim, Type>::GetQuadWeights() const
 	{
-		return _quadrature_rule->GetWeights();
+		return _weights;
 	}
 
 	template <size_t dim, ElementType Type>
@@ -97,6 +226,63 @@ namespace Geometry
 		return _quadrature_rule->Order();
 	}
 
+	template <size_t dim, ElementType Type>
+	PointsView<dim> StdElement<dim, Type>::QuadPointsView() const
+	{
+		return _points.View();
+	}
+
+	template <size_t dim, ElementType Type>
+	VectorView StdElement<dim, Type>::QuadWeightsView() const
+	{
+		return _weights.View();
+	}
+
+	template <size_t dim, ElementType Type>
+	bool StdElement<dim, Type>::IsTensorial() const
+	{
+		return _one_d_points.Size() > 0;
+	}
+
+	template <size_t dim, ElementType Type>
+	PointsView<1> StdElement<dim, Type>::OneDPointsView() const
+	{
+		return _one_d_points.View();
+	}
+
+	template <size_t dim, ElementType Type>
+	VectorView StdElement<dim, Type>::OneDWeightsView() const
+	{
+		return _one_d_weights.View();
+	}
+
+	template <size_t dim, ElementType Type>
+	size_t StdElement<dim, Type>::QuadLevels() const
+	{
+		return _level_sizes.empty() ? 1 : _level_sizes.size();
+	}
+
+	template <size_t dim, ElementType Type>
+	size_t StdElement<dim, Type>::LevelSize (size_t level) const
+	{
+		return _level_sizes.empty() ? _points.Size() : _level_sizes.at (level);
+	}
+
+	template <size_t dim, ElementType Type>
+	size_t StdElement<dim, Type>::LevelOrder (size_t level) const
+	{
+		return _level_orders.empty() ? QuadratureOrder() : _level_orders.at (level);
+	}
+
+	template <size_t dim, ElementType Type>
+	VectorView StdElement<dim, Type>::LevelWeightsView (size_t level) const
+	{
+		if (level + 1 >= QuadLevels())
+			return _weights.View();
+
+		return _level_weights[level].View();
+	}
+
 
 	/*
 		I don't have a general definition of std ipercube geometry,
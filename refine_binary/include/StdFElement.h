@@ -79,6 +79,122 @@ namespace FiniteElements
 		**/
 		virtual size_t QuadratureOrder() const;
 
+		/**
+			Read-only view on the quadrature points of standard ipercube
+		**/
+		virtual Geometry::PointsView<dim> QuadPointsView() const;
+
+		/**
+			Read-only view on the quadrature weights of standard ipercube
+		**/
+		virtual Geometry::VectorView QuadWeightsView() const;
+
+		/**
+			Number of levels of the quadrature rule of the standard geometry
+		**/
+		virtual size_t QuadLevels() const;
+
+		/**
+			Number of quadrature nodes of input level
+		**/
+		virtual size_t LevelSize (size_t) const;
+
+		/**
+			Order of exactness of input quadrature level
+		**/
+		virtual size_t LevelOrder (size_t) const;
+
+		/**
+			Read-only view on the quadrature weights of input level
+		**/
+		virtual Geometry::VectorView LevelWeightsView (size_t) const;
+
+		/**
+			Tell if L2 products and basis combinations can be computed by sum factorization,
+			i.e. if both the quadrature nodes and the basis functions are tensor products
+			of 1D counterparts.
+		**/
+		virtual bool SumFactorizable() const override;
+
+		/**
+			Read-only view on the 1D quadrature nodes of the standard ipercube
+		**/
+		virtual Geometry::PointsView<1> OneDQuadPointsView() const override;
+
+		/**
+			Projection of a separable function.
+			Since the basis function of tensorial indexes (k_0, ..., k_dim-1) is
+			the product of 1D functions of degrees k_0, ..., k_dim-1,
+			the L2 product of a separable function with it is the product
+			of the 1D L2 products of the factors.
+			So the projection costs O(dim p n), n being the number of 1D quadrature nodes,
+			plus a product for each basis function.
+			The squared error is computed as the quadrature of (f - projection)^2
+			on the tensor grid of the 1D nodes, with the projection evaluated
+			by CombineBasis(), so no cancellation between ||f||^2 and ||projection||^2
+			spoils it when it is small.
+		**/
+		virtual double SeparableProjection (const vector<double>&,
+											size_t,
+											Geometry::ColumnVector&) override;
+
+		/**
+			L2 products with basis functions.
+			If SumFactorizable(), the values are contracted
+			one direction at a time with the 1D basis table,
+			with O(p n^dim) operations instead of O(p^dim n^dim),
+			being n the number of 1D quadrature nodes.
+		**/
+		virtual Geometry::ColumnVector BasisL2Prods (const Geometry::VectorView&,
+													 size_t first,
+													 size_t last) override;
+
+		/**
+			Linear combination of basis functions at the quadrature points.
+			If SumFactorizable(), it is computed by sum factorization,
+			as for BasisL2Prods().
+		**/
+		virtual Geometry::ColumnVector CombineBasis (const Geometry::VectorView&,
+													 size_t n_points = 0) override;
+
+	  protected:
+		/**
+			As the base class method, the table of the 1D basis functions included
+		**/
+		virtual void FillTables (size_t) override;
+
+		/**
+			Values of the 1D basis functions until input degree at the 1D quadrature nodes.
+			The value of k-th function at i-th node is stored in position k * n + i,
+			being n the number of 1D nodes.
+		**/
+		const vector<double>& OneDTable (size_t);
+
+		/**
+			Minimum degree such that the basis of that degree has at least input size.
+		**/
+		size_t MinimumDegree (size_t) const;
+
+		/**
+			Position in the tensor of sum factorization of the basis function with input index,
+			for a tensor of input extent in each direction.
+		**/
+		size_t TensorPosition (size_t, size_t);
+
+		/**
+			Contraction of a tensor along one direction.
+			The input tensor is meant as a (outer x in_size x inner) array,
+			with last index varying fastest; the output one as a (outer x out_size x inner) array,
+			whose elements are
+				output(o, r, j) = sum_c M(r, c) * input(o, c, j)
+			where M(r, c) = matrix[r * row_stride + c * col_stride].
+		**/
+		static vector<double> Contract (const vector<double>& input,
+										size_t outer, size_t inner,
+										size_t in_size, size_t out_size,
+										const double* matrix,
+										size_t row_stride, size_t col_stride);
+
 	  protected:
 		/**
 			The basis functions.
@@ -89,6 +205,14 @@ namespace FiniteElements
 			The standard ipercube.
 		**/
 		shared_ptr<Geometry::StdIperCube<dim>> _std_geometry;
+		/**
+			Storage for OneDTable()
+		**/
+		vector<double> _one_d_table;
+		/**
+			Degree of the 1D functions stored in _one_d_table
+		**/
+		size_t _one_d_degree;
 	};
 
 	/**
@@ -223,6 +347,36 @@ namespace FiniteElements
 		**/
 		virtual size_t QuadratureOrder() const;
 
+		/**
+			Read-only view on the quadrature nodes of the standard geometry
+		**/
+		virtual Geometry::PointsView<dim> QuadPointsView() const;
+
+		/**
+			Read-only view on the quadrature weights of the standard geometry
+		**/
+		virtual Geometry::VectorView QuadWeightsView() const;
+
+		/**
+			Number of levels of the quadrature rule of the standard geometry
+		**/
+		virtual size_t QuadLevels() const;
+
+		/**
+			Number of quadrature nodes of input level
+		**/
+		virtual size_t LevelSize (size_t) const;
+
+		/**
+			Order of exactness of input quadrature level
+		**/
+		virtual size_t LevelOrder (size_t) const;
+
+		/**
+			Read-only view on the quadrature weights of input level
+		**/
+		virtual Geometry::VectorView LevelWeightsView (size_t) const;
+
 		/* Public methods to use the _ipercube_map attribute */
 
 
@@ -276,7 +430,8 @@ namespace FiniteElements
 	};
 
 	template <size_t dim, BasisType FeType>
-	AlmostStdFIperCube<dim, FeType>::AlmostStdFIperCube()
+	AlmostStdFIperCube<dim, FeType>::AlmostStdFIperCube() : _one_d_table(),
+		_one_d_degree (0)
 	{
 		_std_geometry =
 			Helpers::Builders<Geometry::StdIperCube<dim>>::BuildSingleton ();
@@ -303,6 +458,8 @@ namespace FiniteElements
 	::EvaluateBasisFunction (size_t ind,
 							 const Geometry::Point<dim>& point) const
 	{
+		//the basis builds the indexes of the functions the first time they are evaluated
+		this->CheckIndex (ind);
 		return this->_basis->Evaluate (ind, point);
 	}
 
@@ -311,12 +468,15 @@ namespace FiniteElements
 	::EvaluateBasis (size_t degree,
 					 const Geometry::Point<dim>& point) const
 	{
+		this->CheckDegree (degree);
 		return this->_basis->EvaluateBasis (degree, point);
 	}
 
 	template <size_t dim, BasisType FeType>
 	size_t AlmostStdFIperCube<dim, FeType>::BasisSize (size_t degree) const
 	{
+		//the sizes are stored by the basis the first time they are computed
+		this->CheckDegree (degree);
 		return this->_basis->ComputeSize (degree);
 	}
 
@@ -346,6 +506,273 @@ namespace FiniteElements
 		return this->_std_geometry->QuadratureOrder();
 	}
 
+	template <size_t dim, BasisType FeType>
+	Geometry::PointsView<dim> AlmostStdFIperCube<dim, FeType>
+	::QuadPointsView() const
+	{
+		return this->_std_geometry->QuadPointsView();
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::VectorView AlmostStdFIperCube<dim, FeType>
+	::QuadWeightsView() const
+	{
+		return this->_std_geometry->QuadWeightsView();
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AlmostStdFIperCube<dim, FeType>::QuadLevels() const
+	{
+		return this->_std_geometry->QuadLevels();
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AlmostStdFIperCube<dim, FeType>::LevelSize (size_t level) const
+	{
+		return this->_std_geometry->LevelSize (level);
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AlmostStdFIperCube<dim, FeType>::LevelOrder (size_t level) const
+	{
+		return this->_std_geometry->LevelOrder (level);
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::VectorView AlmostStdFIperCube<dim, FeType>
+	::LevelWeightsView (size_t level) const
+	{
+		return this->_std_geometry->LevelWeightsView (level);
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool AlmostStdFIperCube<dim, FeType>::SumFactorizable() const
+	{
+		return this->_std_geometry->IsTensorial() && this->_basis->IsSeparable();
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::PointsView<1> AlmostStdFIperCube<dim, FeType>::OneDQuadPointsView() const
+	{
+		return this->_std_geometry->OneDPointsView();
+	}
+
+	template <size_t dim, BasisType FeType>
+	double AlmostStdFIperCube<dim, FeType>
+	::SeparableProjection (const vector<double>& factors,
+						   size_t basis_size,
+						   Geometry::ColumnVector& coeff)
+	{
+		if (!SumFactorizable())
+			return StdFElementInterface<dim, FeType>::SeparableProjection (factors, basis_size, coeff);
+
+		auto weights = this->_std_geometry->OneDWeightsView();
+		size_t n = weights.Size();
+		if (factors.size() != dim * n)
+			throw length_error ("Wrong number of factor values in separable projection");
+
+		size_t m = MinimumDegree (basis_size) + 1;
+		auto& table = OneDTable (m - 1);
+
+		//1D L2 products with the 1D basis
+		vector<double> prods (dim * m, 0);
+		for (size_t d = 0; d < dim; ++d)
+			for (size_t i = 0; i < n; ++i)
+			{
+				double wf = weights[i] * factors[d * n + i];
+				for (size_t k = 0; k < m; ++k)
+					prods[d * m + k] += wf * table[k * n + i];
+			}
+
+		coeff = Geometry::ColumnVector (basis_size);
+		for (size_t ind = 0; ind < basis_size; ++ind)
+		{
+			auto indexes = this->_basis->GetIndexes (ind);
+
+			double prod = 1;
+			for (size_t d = 0; d < dim; ++d)
+				prod *= prods[d * m + indexes[d]];
+
+			coeff[ind] = prod / this->BasisNormSquared (ind);
+		}
+
+		/*	f and the weights on the tensor grid, as outer products of the 1D ones,
+			with the first direction varying slowest as in CombineBasis() */
+		vector<double> f_values (1, 1), grid_weights (1, 1);
+		for (size_t d = 0; d < dim; ++d)
+		{
+			vector<double> f_next (f_values.size() * n), w_next (grid_weights.size() * n);
+			for (size_t j = 0; j < f_values.size(); ++j)
+				for (size_t i = 0; i < n; ++i)
+				{
+					f_next[j * n + i] = f_values[j] * factors[d * n + i];
+					w_next[j * n + i] = grid_weights[j] * weights[i];
+				}
+
+			f_values.swap (f_next);
+			grid_weights.swap (w_next);
+		}
+
+		auto projection = CombineBasis (coeff.View(), f_values.size());
+
+		double err_squared = 0;
+		for (size_t q = 0; q < f_values.size(); ++q)
+		{
+			double diff = f_values[q] - projection[q];
+			err_squared += grid_weights[q] * diff * diff;
+		}
+
+		return err_squared;
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::ColumnVector AlmostStdFIperCube<dim, FeType>
+	::BasisL2Prods (const Geometry::VectorView& values, size_t first, size_t last)
+	{
+		if (!SumFactorizable() || last <= first
+				|| values.Size() != this->QuadWeightsView().Size())
+			return StdFElementInterface<dim, FeType>::BasisL2Prods (values, first, last);
+
+		auto weights = this->QuadWeightsView();
+		size_t n = this->_std_geometry->OneDPointsView().Size();
+		size_t m = MinimumDegree (last) + 1;
+		auto& table = OneDTable (m - 1);
+
+		vector<double> tensor (weights.Size());
+		for (size_t q = 0; q < weights.Size(); ++q)
+			tensor[q] = weights[q] * values[q];
+
+		//direction d is contracted, so the first d directions have extent m, the last ones n
+		size_t outer = 1, inner = weights.Size() / n;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			tensor = Contract (tensor, outer, inner, n, m, table.data(), n, 1);
+			outer *= m;
+			inner /= n;
+		}
+
+		Geometry::ColumnVector result (last - first);
+		for (size_t ind = first; ind < last; ++ind)
+			result[ind - first] = tensor[TensorPosition (ind, m)];
+
+		return result;
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::ColumnVector AlmostStdFIperCube<dim, FeType>
+	::CombineBasis (const Geometry::VectorView& coeff, size_t n_points)
+	{
+		if (!SumFactorizable() || !coeff.Size()
+				|| (n_points && n_points != this->QuadWeightsView().Size()))
+			return StdFElementInterface<dim, FeType>::CombineBasis (coeff, n_points);
+
+		size_t n = this->_std_geometry->OneDPointsView().Size();
+		size_t m = MinimumDegree (coeff.Size()) + 1;
+		auto& table = OneDTable (m - 1);
+
+		size_t tensor_size = 1;
+		for (size_t d = 0; d < dim; ++d)
+			tensor_size *= m;
+
+		vector<double> tensor (tensor_size, 0);
+		for (size_t ind = 0; ind < coeff.Size(); ++ind)
+			tensor[TensorPosition (ind, m)] = coeff[ind];
+
+		//direction d is expanded, so the first d directions have extent n, the last ones m
+		size_t outer = 1, inner = tensor_size / m;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			tensor = Contract (tensor, outer, inner, m, n, table.data(), 1, n);
+			outer *= n;
+			inner /= m;
+		}
+
+		Geometry::ColumnVector result (tensor.size());
+		for (size_t q = 0; q < tensor.size(); ++q)
+			result[q] = tensor[q];
+
+		return result;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void AlmostStdFIperCube<dim, FeType>::FillTables (size_t degree)
+	{
+		StdFElementInterface<dim, FeType>::FillTables (degree);
+		OneDTable (degree);
+	}
+
+	template <size_t dim, BasisType FeType>
+	const vector<double>& AlmostStdFIperCube<dim, FeType>::OneDTable (size_t degree)
+	{
+		this->CheckDegree (degree);
+
+		auto points = this->_std_geometry->OneDPointsView();
+		size_t n = points.Size();
+
+		if (this->_one_d_table.empty() || degree > this->_one_d_degree)
+		{
+			this->_one_d_degree = degree;
+			this->_one_d_table.resize ((degree + 1) * n);
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				auto values = this->_basis->OneDBasis (degree, points[i][0]);
+				for (size_t k = 0; k <= degree; ++k)
+					this->_one_d_table[k * n + i] = values[k];
+			}
+		}
+
+		return this->_one_d_table;
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AlmostStdFIperCube<dim, FeType>::MinimumDegree (size_t size) const
+	{
+		size_t degree = 0;
+		while (this->BasisSize (degree) < size)
+			++degree;
+
+		return degree;
+	}
+
+	template <size_t dim, BasisType FeType>
+	size_t AlmostStdFIperCube<dim, FeType>::TensorPosition (size_t ind, size_t extent)
+	{
+		auto indexes = this->_basis->GetIndexes (ind);
+
+		size_t position = 0;
+		for (auto k : indexes)
+			position = position * extent + k;
+
+		return position;
+	}
+
+	template <size_t dim, BasisType FeType>
+	vector<double> AlmostStdFIperCube<dim, FeType>
+	::Contract (const vector<double>& input,
+				size_t outer, size_t inner,
+				size_t in_size, size_t out_size,
+				const double* matrix,
+				size_t row_stride, size_t col_stride)
+	{
+		vector<double> output (outer * out_size * inner, 0);
+
+		for (size_t o = 0; o < outer; ++o)
+			for (size_t r = 0; r < out_size; ++r)
+			{
+				double* out = output.data() + (o * out_size + r) * inner;
+				for (size_t c = 0; c < in_size; ++c)
+				{
+					double coeff = matrix[r * row_stride + c * col_stride];
+					const double* in = input.data() + (o * in_size + c) * inner;
+					for (size_t j = 0; j < inner; ++j)
+						out[j] += coeff * in[j];
+				}
+			}
+
+		return output;
+	}
+
 	template <size_t dim, BasisType FeType>
 	StdFIperCube<dim, FeType>::StdFIperCube() : AlmostStdFIperCube<dim, FeType>()
 	{}
@@ -418,6 +845,8 @@ namespace FiniteElements
 	::EvaluateBasisFunction (size_t ind,
 							 const Geometry::Point<dim>& point) const
 	{
+		//the standard ipercube is not shared with this element, so the check is done here
+		this->CheckIndex (ind);
 		return this->_std_cube->EvaluateBasisFunction (ind, MapBackward (point));
 	}
 
@@ -426,12 +855,14 @@ namespace FiniteElements
 	::EvaluateBasis (size_t degree,
 					 const Geometry::Point<dim>& point) const
 	{
+		this->CheckDegree (degree);
 		return this->_std_cube->EvaluateBasis (degree, MapBackward (point));
 	}
 
 	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
 	size_t StdFElement<dim, Type, FeType>::BasisSize (size_t degree) const
 	{
+		this->CheckDegree (degree);
 		return this->_std_cube->BasisSize (degree);
 	}
 
@@ -461,6 +892,45 @@ namespace FiniteElements
 		return this->_std_geometry->QuadratureOrder();
 	}
 
+	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
+	Geometry::PointsView<dim> StdFElement<dim, Type, FeType>
+	::QuadPointsView() const
+	{
+		return this->_std_geometry->QuadPointsView();
+	}
+
+	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
+	Geometry::VectorView StdFElement<dim, Type, FeType>
+	::QuadWeightsView() const
+	{
+		return this->_std_geometry->QuadWeightsView();
+	}
+
+	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
+	size_t StdFElement<dim, Type, FeType>::QuadLevels() const
+	{
+		return this->_std_geometry->QuadLevels();
+	}
+
+	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
+	size_t StdFElement<dim, Type, FeType>::LevelSize (size_t level) const
+	{
+		return this->_std_geometry->LevelSize (level);
+	}
+
+	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
+	size_t StdFElement<dim, Type, FeType>::LevelOrder (size_t level) const
+	{
+		return this->_std_geometry->LevelOrder (level);
+	}
+
+	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
+	Geometry::VectorView StdFElement<dim, Type, FeType>
+	::LevelWeightsView (size_t level) const
+	{
+		return this->_std_geometry->LevelWeightsView (level);
+	}
+
 	template <size_t dim, Geometry::ElementType Type, BasisType FeType>
 	Geometry::Point<dim> StdFElement<dim, Type, FeType>
 	::MapBackward (const Geometry::Point<dim>& p) const
@@ -511,17 +981,23 @@ namespace FiniteElements
 			size_t degree = 0;
 			while (BasisSize (degree) < new_l)
 				++degree;
-//*INDENT-OFF*
-			this->_norm_values =
-				this->MultiIntegrate(
-										[degree, this]
-										(const Geometry::Point<dim>& p)
-										{
-											auto vals = this->EvaluateBasis (degree, p);
-											return vals.CWiseProduct (vals);
-										}
-								 	);
-//*INDENT-ON*
+
+			/*	Only the missing norms are computed, one quadrature node at a time:
+				a norm does not depend on how many norms are computed together,
+				so it is the same whatever the degree at which it has been requested */
+			auto points = this->QuadPointsView();
+			auto weights = this->QuadWeightsView();
+
+			(this->_norm_values).Resize (new_l);
+			for (size_t i = l; i < new_l; ++i)
+				(this->_norm_values)[i] = 0;
+
+			for (size_t q = 0; q < points.Size(); ++q)
+			{
+				auto vals = this->EvaluateBasis (degree, points[q]);
+				for (size_t i = l; i < new_l; ++i)
+					(this->_norm_values)[i] += weights[q] * vals[i] * vals[i];
+			}
 		}
 	}
 
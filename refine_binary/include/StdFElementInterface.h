@@ -15,6 +15,14 @@ namespace FiniteElements
 		ElementType parameter cannot be set as template parameter, since it is known at runtime.
 		As for generic FElements, a standard FElement has to provide the abstract space interface and the
 		abstract element one.
+
+		A standard element is shared by all the finite elements of its type,
+		and its tables (basis norms, basis values at the quadrature points, indexes of the basis)
+		are filled lazily, the first time a function of higher degree is requested.
+		The filling is not synchronized, so before the element is used by several threads
+		Prepare() has to be called with the highest degree the threads will request:
+		until Release() the tables are only read, and the requests above that degree
+		raise a logic_error instead of growing them. See BinaryTree::SharedStdFElements.
 	**/
 	template <size_t dim, BasisType FeType = InvalidFeType>
 	class StdFElementInterface :
@@ -50,6 +58,44 @@ namespace FiniteElements
 
 		/* from now on stuff introduced with optimization purpose */
 
+		/**
+			Read-only view on the quadrature points, without copies.
+		**/
+		virtual Geometry::PointsView<dim> QuadPointsView() const = 0;
+
+		/**
+			Read-only view on the quadrature weights, without copies.
+		**/
+		virtual Geometry::VectorView QuadWeightsView() const = 0;
+
+		/**
+			Number of levels of the quadrature rule, 1 if the rule is not nested.
+			See Geometry::QuadratureRuleInterface::IsNested().
+		**/
+		virtual size_t QuadLevels() const = 0;
+
+		/**
+			Number of quadrature nodes of input level,
+			they are the first ones of QuadPointsView()
+		**/
+		virtual size_t LevelSize (size_t) const = 0;
+
+		/**
+			Order of exactness of input quadrature level
+		**/
+		virtual size_t LevelOrder (size_t) const = 0;
+
+		/**
+			Read-only view on the quadrature weights of input level
+		**/
+		virtual Geometry::VectorView LevelWeightsView (size_t) const = 0;
+
+		/**
+			Read-only view on the quadrature weights of the level with input number of nodes.
+			It throws an exception if there is no such level.
+		**/
+		Geometry::VectorView QuadWeightsOfSize (size_t) const;
+
 		/**
 			Evaluate whole basis untill fixed degree.
 			Input parameters:
@@ -64,6 +110,8 @@ namespace FiniteElements
 			If the value is already stored in _norm_values attribute, it returns it,
 			otherwise it computes it through the pure virtual ComputeNormSquared method,
 			which will be defined by derived classes.
+			While the element is shared, see Prepare(), the index has to be a function
+			of degree not higher than the prepared one.
 		**/
 		double BasisNormSquared (size_t);
 
@@ -80,7 +128,119 @@ namespace FiniteElements
 			much more performant than compute each basis norm when effectively needed.
 		**/
 		static void InitNorms (size_t);
+
+		/**
+			Values of the basis function with input index at the quadrature points.
+			Values are computed the first time they are requested, then stored,
+			so the basis is evaluated at each reference quadrature point only once.
+			The returned view is valid until a basis function with higher index is requested.
+			While the element is shared, see Prepare(), the index has to be a function
+			of degree not higher than the prepared one.
+		**/
+		Geometry::VectorView BasisAtQuadPoints (size_t);
+
+		/**
+			Compute the tables of the basis functions until input degree,
+			i.e. their values at the quadrature points and their norms,
+			which are otherwise computed the first time they are requested,
+			and share the element until Release() is called.
+			Since the standard elements are shared by all the finite elements,
+			while the element is shared it can be used by concurrent refinements,
+			as the tables are only read: the requests above the prepared degree
+			raise a logic_error, since growing the tables would be a data race.
+			It must not be called while other threads use the element;
+			if the element is already shared, the degree cannot be raised.
+		**/
+		void Prepare (size_t);
+
+		/**
+			Stop sharing the element, so the tables grow again when needed.
+			It must not be called while other threads use the element.
+		**/
+		void Release();
+
+		/**
+			Tell if the element is shared, see Prepare()
+		**/
+		bool Shared() const;
+
+		/**
+			L2 scalar products on the standard element between a function,
+			given by its values at the quadrature points,
+			and the basis functions with index in [first, last).
+			Input parameters:
+				- the function values
+				- first basis function index
+				- last basis function index (excluded)
+			If the values are less than the quadrature nodes,
+			the level of the rule with as many nodes is used.
+			In this general setting products are computed one by one
+			from the values stored by BasisAtQuadPoints().
+		**/
+		virtual Geometry::ColumnVector BasisL2Prods (const Geometry::VectorView&,
+													 size_t first,
+													 size_t last);
+
+		/**
+			Values at the quadrature points of the linear combination
+			of the first basis functions, with input vector as coefficients.
+			If the number of points is given, only the first ones are computed.
+		**/
+		virtual Geometry::ColumnVector CombineBasis (const Geometry::VectorView&,
+													 size_t n_points = 0);
+
+		/**
+			Tell if both the quadrature nodes and the basis functions
+			are tensor products of 1D counterparts.
+			By default they are not.
+		**/
+		virtual bool SumFactorizable() const
+		{
+			return false;
+		};
+
+		/**
+			Read-only view on the 1D quadrature nodes, if SumFactorizable()
+		**/
+		virtual Geometry::PointsView<1> OneDQuadPointsView() const
+		{
+			throw logic_error ("1D quadrature nodes requested to a not factorizable element");
+		};
+
+		/**
+			Projection of a separable function on the first basis functions, if SumFactorizable().
+			Input parameters:
+				- the values of the 1D factors of the function at the 1D quadrature nodes,
+				  the ones of the factor depending on coordinate d stored in [d * n, (d + 1) * n)
+				- the number of basis functions
+				- the vector where the projection coefficients are stored
+			It returns the squared L2 norm of the projection error on the standard element.
+		**/
+		virtual double SeparableProjection (const vector<double>&,
+											size_t,
+											Geometry::ColumnVector&)
+		{
+			throw logic_error ("Separable projection requested to a not factorizable element");
+		};
+
 	  protected:
+		/**
+			Fill the tables until input degree, see Prepare()
+		**/
+		virtual void FillTables (size_t);
+
+		/**
+			Raise a logic_error if the element is shared
+			and input degree is higher than the prepared one
+		**/
+		void CheckDegree (size_t) const;
+
+		/**
+			Raise a logic_error if the element is shared
+			and the basis function of input index has degree higher than the prepared one
+		**/
+		void CheckIndex (size_t) const;
+
 		/**
 			Compute the norm of the basis of input index.
 		**/
@@ -97,12 +257,26 @@ namespace FiniteElements
 			The values of basis functions norms.
 		**/
 		Geometry::Vector _norm_values;
+		/**
+			The values of basis functions at quadrature points.
+			Values of i-th function are stored contiguously,
+			starting from position i * (number of quadrature points).
+		**/
+		vector<double> _basis_at_quad;
 		/**
 			The maximum basis degree needed.
 			It is updated by UpdateNorms() method,
 			but it can be also set a priori through the InitNorms() method.
 		**/
 		static size_t _max_degree;
+		/**
+			True from Prepare() to Release()
+		**/
+		bool _shared;
+		/**
+			Degree until which the tables are filled while the element is shared
+		**/
+		size_t _shared_degree;
 	};
 
 	/* Initialization of the static attribute */
@@ -116,7 +290,10 @@ namespace FiniteElements
 	}
 
 	template <size_t dim, BasisType FeType>
-	StdFElementInterface<dim, FeType>::StdFElementInterface() : _norm_values()
+	StdFElementInterface<dim, FeType>::StdFElementInterface() : _norm_values(),
+		_basis_at_quad(),
+		_shared (false),
+		_shared_degree (0)
 	{}
 
 	template <size_t dim, BasisType FeType>
@@ -131,14 +308,169 @@ namespace FiniteElements
 	template <size_t dim, BasisType FeType>
 	double StdFElementInterface<dim, FeType>::BasisNormSquared (size_t ind)
 	{
-		while ( ind >= this->BasisSize (_max_degree))
-			++_max_degree;
+		CheckIndex (ind);
 
-		this->UpdateNorms();
+		//the norms and the static degree are only written when a norm is missing
+		if (ind >= (this->_norm_values).Size())
+		{
+			while ( ind >= this->BasisSize (_max_degree))
+				++_max_degree;
+
+			this->UpdateNorms();
+		}
 
 		return (this->_norm_values)[ind];
 	}
 
+	template <size_t dim, BasisType FeType>
+	Geometry::VectorView StdFElementInterface<dim, FeType>
+	::BasisAtQuadPoints (size_t ind)
+	{
+		CheckIndex (ind);
+
+		auto points = this->QuadPointsView();
+		size_t n = points.Size();
+
+		size_t computed = this->_basis_at_quad.size() / n;
+		if (ind >= computed)
+		{
+			//I compute all the functions with degree not higher than the requested one
+			size_t degree = 0;
+			while (ind >= this->BasisSize (degree))
+				++degree;
+			size_t new_size = this->BasisSize (degree);
+
+			this->_basis_at_quad.resize (new_size * n);
+			//the whole basis is evaluated at once, single evaluations are inefficient
+			for (size_t q = 0; q < n; ++q)
+			{
+				auto values = this->EvaluateBasis (degree, points[q]);
+				for (size_t i = computed; i < new_size; ++i)
+					this->_basis_at_quad[i * n + q] = values[i];
+			}
+		}
+
+		return Geometry::VectorView (this->_basis_at_quad.data() + ind * n, n);
+	}
+
+	template <size_t dim, BasisType FeType>
+	void StdFElementInterface<dim, FeType>::Prepare (size_t degree)
+	{
+		if (this->_shared)
+		{
+			CheckDegree (degree);
+			return;
+		}
+
+		FillTables (degree);
+
+		this->_shared_degree = degree;
+		this->_shared = true;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void StdFElementInterface<dim, FeType>::Release()
+	{
+		this->_shared = false;
+	}
+
+	template <size_t dim, BasisType FeType>
+	bool StdFElementInterface<dim, FeType>::Shared() const
+	{
+		return this->_shared;
+	}
+
+	template <size_t dim, BasisType FeType>
+	void StdFElementInterface<dim, FeType>::FillTables (size_t degree)
+	{
+		size_t last = this->BasisSize (degree) - 1;
+
+		//the basis evaluation first, since it builds the indexes of the functions
+		this->EvaluateBasis (degree, this->QuadPointsView()[0]);
+		BasisAtQuadPoints (last);
+		BasisNormSquared (last);
+	}
+
+	template <size_t dim, BasisType FeType>
+	void StdFElementInterface<dim, FeType>::CheckDegree (size_t degree) const
+	{
+		if (this->_shared && degree > this->_shared_degree)
+			throw logic_error ("Degree " + to_string (degree)
+							   + " requested to a standard element shared until degree "
+							   + to_string (this->_shared_degree));
+	}
+
+	template <size_t dim, BasisType FeType>
+	void StdFElementInterface<dim, FeType>::CheckIndex (size_t ind) const
+	{
+		if (this->_shared && ind >= this->BasisSize (this->_shared_degree))
+			throw logic_error ("Basis function #" + to_string (ind)
+							   + " requested to a standard element shared until degree "
+							   + to_string (this->_shared_degree));
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::VectorView StdFElementInterface<dim, FeType>
+	::QuadWeightsOfSize (size_t n_points) const
+	{
+		for (size_t l = 0; l < this->QuadLevels(); ++l)
+			if (this->LevelSize (l) == n_points)
+				return this->LevelWeightsView (l);
+
+		throw length_error
+		("No quadrature level with " + to_string (n_points) + " nodes");
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::ColumnVector StdFElementInterface<dim, FeType>
+	::BasisL2Prods (const Geometry::VectorView& values, size_t first, size_t last)
+	{
+		auto weights = this->QuadWeightsOfSize (values.Size());
+		size_t n = weights.Size();
+
+		Geometry::ColumnVector result (last > first ? last - first : 0);
+
+		//I request the last function first, so all the needed values are computed
+		//before taking the views (a later request may invalidate them)
+		if (last > first)
+			BasisAtQuadPoints (last - 1);
+
+		for (size_t ind = first; ind < last; ++ind)
+		{
+			auto basis = BasisAtQuadPoints (ind);
+
+			double prod = 0;
+			for (size_t q = 0; q < n; ++q)
+				prod += weights[q] * values[q] * basis[q];
+
+			result[ind - first] = prod;
+		}
+
+		return result;
+	}
+
+	template <size_t dim, BasisType FeType>
+	Geometry::ColumnVector StdFElementInterface<dim, FeType>
+	::CombineBasis (const Geometry::VectorView& coeff, size_t n_points)
+	{
+		size_t n = n_points ? n_points : this->QuadWeightsView().Size();
+		Geometry::ColumnVector result (n);
+		for (size_t q = 0; q < n; ++q)
+			result[q] = 0;
+
+		if (coeff.Size())
+			BasisAtQuadPoints (coeff.Size() - 1);
+
+		for (size_t i = 0; i < coeff.Size(); ++i)
+		{
+			auto basis = BasisAtQuadPoints (i);
+			for (size_t q = 0; q < n; ++q)
+				result[q] += coeff[i] * basis[q];
+		}
+
+		return result;
+	}
+
 	template <size_t dim, BasisType FeType>
 	void StdFElementInterface<dim, FeType>::UpdateNorms()
 	{
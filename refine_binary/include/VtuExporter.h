@@ -0,0 +1,386 @@
+#ifndef __VTU_EXPORTER_H
+#define __VTU_EXPORTER_H
+
+#include "VtuFile.h"
+#include "ApproximationSnapshot.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility> //std::pair
+#include <algorithm> //std::min, std::max
+#include <cstdint> //uint64_t, uint32_t, uint8_t
+#include <atomic> //std::atomic
+#include <thread> //std::thread
+#include <exception> //std::exception_ptr
+#include <stdexcept> //std::runtime_error, std::invalid_argument
+
+namespace BinaryTree
+{
+	/**
+		Writer of the hp approximation computed by a MeshRefiner to a VTK unstructured grid (VTU) file,
+		to be visualized e.g. by ParaView, in 1D and 2D.
+		Each active element is split into s segments for each side, with s depending on its p level,
+		see Subdivisions(), and the projection is sampled at the vertices of the sub-cells:
+		points are not shared by the elements, so the discontinuities of the approximation are kept.
+		The p level, the local error and the node identifier of the element are stored as cell data.
+
+		The exporter reads an ApproximationSnapshot, whose evaluations can be done by several threads.
+		The elements are split into chunks, taken by the threads one at a time:
+		a thread samples its chunk and writes it in place into the binary appended data of the file,
+		see VtuOutput, so only the data of one chunk for each thread are kept in memory.
+	**/
+	template <size_t dim>
+	class VtuExporter
+	{
+		static_assert (dim == 1 || dim == 2, "VTU export is available in 1D and 2D");
+
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the number of threads; if zero, the number of hardware threads
+				- the number of elements of each chunk
+			It raises an invalid_argument exception if the chunk size is zero.
+		**/
+		VtuExporter (size_t threads = 0, size_t chunk_elements = 1024);
+
+		/**
+			Set the number of segments each side of an element is split into:
+			input number for each p level, at least one and at most input maximum.
+			By default the sides are split into p segments, at most 16.
+			It raises an invalid_argument exception if the maximum is zero.
+		**/
+		void Subdivisions (size_t per_level, size_t max);
+
+		/**
+			Number of segments of each side of an element of input p level
+		**/
+		size_t Segments (size_t) const;
+
+		/**
+			Write input snapshot to input file.
+			It raises a runtime_error exception if the file cannot be written,
+			or if an element is not an interval or a triangle.
+		**/
+		void Write (const ApproximationSnapshot<dim>&, const std::string&) const;
+
+		/**
+			Write the approximation of input refiner, with the mesh loaded, to input file.
+			It takes a snapshot of the refiner, see ApproximationSnapshot.
+		**/
+		void Write (MeshRefiner<dim>&, const std::string&) const;
+
+	  private:
+		/**
+			Subdivision of the reference simplex into sub-cells
+		**/
+		struct Pattern
+		{
+			/**
+				barycentric coordinates of the points, dim for each point,
+				as coefficients of the sides from the first vertex
+			**/
+			std::vector<double> weights;
+			/**
+				local indexes of the points of the sub-cells
+			**/
+			std::vector<uint64_t> cells;
+			/**
+				number of points of each sub-cell
+			**/
+			size_t cell_points;
+			/**
+				VTK type of the sub-cells
+			**/
+			uint8_t cell_type;
+
+			size_t Points() const
+			{
+				return this->weights.size() / dim;
+			};
+
+			size_t Cells() const
+			{
+				return this->cells.size() / this->cell_points;
+			};
+		};
+
+		using Patterns = std::map<std::pair<Geometry::ElementType, size_t>, Pattern>;
+
+		/**
+			Entries of the arrays before a chunk
+		**/
+		struct Counts
+		{
+			uint64_t points;
+			uint64_t cells;
+			uint64_t connectivity;
+		};
+
+		/**
+			Data of a chunk, sampled by a thread
+		**/
+		struct Buffers
+		{
+			std::vector<double> projection;
+			std::vector<uint32_t> p_levels;
+			std::vector<double> local_errors;
+			std::vector<uint64_t> node_ids;
+			std::vector<double> points;
+			std::vector<uint64_t> connectivity;
+			std::vector<uint64_t> offsets;
+			std::vector<uint8_t> cell_types;
+		};
+
+		/**
+			Subdivision of input element type into input number of segments for each side.
+			It raises a runtime_error exception if the type is not an interval or a triangle.
+		**/
+		static Pattern MakePattern (Geometry::ElementType, size_t);
+
+		/**
+			Sample the elements of the chunk with input index and write them to the file
+		**/
+		void WriteChunk (const ApproximationSnapshot<dim>&, const Patterns&,
+						 size_t chunk, const Counts&, Buffers&, VtuOutput&) const;
+
+	  private:
+		/**
+			Number of threads
+		**/
+		size_t _threads;
+		/**
+			Number of elements of a chunk
+		**/
+		size_t _chunk_elements;
+		/**
+			Segments for each p level
+		**/
+		size_t _per_level;
+		/**
+			Maximum number of segments
+		**/
+		size_t _max_segments;
+	};
+
+
+	template <size_t dim>
+	VtuExporter<dim>::VtuExporter (size_t threads, size_t chunk_elements) :
+		_threads (threads ? threads : std::max (std::thread::hardware_concurrency(), 1u)),
+		_chunk_elements (chunk_elements),
+		_per_level (1),
+		_max_segments (16)
+	{
+		if (chunk_elements == 0)
+			throw std::invalid_argument ("VtuExporter: chunks must have at least one element");
+	}
+
+	template <size_t dim>
+	void VtuExporter<dim>::Subdivisions (size_t per_level, size_t max)
+	{
+		if (max == 0)
+			throw std::invalid_argument ("VtuExporter: elements must be split into at least one segment");
+
+		this->_per_level = per_level;
+		this->_max_segments = max;
+	}
+
+	template <size_t dim>
+	size_t VtuExporter<dim>::Segments (size_t p_level) const
+	{
+		return std::min (std::max (this->_per_level * p_level, static_cast<size_t> (1)), this->_max_segments);
+	}
+
+	template <size_t dim>
+	void VtuExporter<dim>::Write (MeshRefiner<dim>& refiner, const std::string& file_name) const
+	{
+		Write (ApproximationSnapshot<dim> (refiner, 0), file_name);
+	}
+
+	template <size_t dim>
+	void VtuExporter<dim>::Write (const ApproximationSnapshot<dim>& snapshot, const std::string& file_name) const
+	{
+		size_t n = snapshot.Size();
+		size_t n_chunks = (n + this->_chunk_elements - 1) / this->_chunk_elements;
+
+		//the patterns are built here, so the threads only read them
+		Patterns patterns;
+		std::vector<Counts> starts (n_chunks + 1, Counts {0, 0, 0});
+		Counts total {0, 0, 0};
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (i % this->_chunk_elements == 0)
+				starts[i / this->_chunk_elements] = total;
+
+			auto key = std::make_pair (snapshot.GetType (i), Segments (snapshot.PLevel (i)));
+			auto pattern = patterns.find (key);
+			if (pattern == patterns.end())
+				pattern = patterns.emplace (key, MakePattern (key.first, key.second)).first;
+
+			total.points += pattern->second.Points();
+			total.cells += pattern->second.Cells();
+			total.connectivity += pattern->second.cells.size();
+		}
+		starts[n_chunks] = total;
+
+		VtuOutput output (file_name, total.points, total.cells, total.connectivity);
+
+		size_t n_threads = std::max (std::min (this->_threads, n_chunks), static_cast<size_t> (1));
+		std::atomic<size_t> next_chunk (0);
+		std::vector<std::exception_ptr> errors (n_threads, nullptr);
+
+		auto worker = [&] (size_t t)
+		{
+			try
+			{
+				Buffers buffers;
+				for (size_t c = next_chunk++; c < n_chunks; c = next_chunk++)
+					WriteChunk (snapshot, patterns, c, starts[c], buffers, output);
+			}
+			catch (...)
+			{
+				errors[t] = std::current_exception();
+				//the other threads stop after their chunk
+				next_chunk = n_chunks;
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (size_t t = 1; t < n_threads; ++t)
+			pool.emplace_back (worker, t);
+
+		//the calling thread works too
+		worker (0);
+		for (auto& t : pool)
+			t.join();
+
+		for (auto& e : errors)
+			if (e)
+				std::rethrow_exception (e);
+
+		output.Close();
+	}
+
+	template <size_t dim>
+	void VtuExporter<dim>::WriteChunk (const ApproximationSnapshot<dim>& snapshot,
+									   const Patterns& patterns,
+									   size_t chunk,
+									   const Counts& start,
+									   Buffers& buffers,
+									   VtuOutput& output) const
+	{
+		size_t first = chunk * this->_chunk_elements;
+		size_t last = std::min (first + this->_chunk_elements, snapshot.Size());
+
+		buffers.projection.clear();
+		buffers.p_levels.clear();
+		buffers.local_errors.clear();
+		buffers.node_ids.clear();
+		buffers.points.clear();
+		buffers.connectivity.clear();
+		buffers.offsets.clear();
+		buffers.cell_types.clear();
+
+		uint64_t point_index = start.points;
+		uint64_t cell_end = start.connectivity;
+		for (size_t i = first; i < last; ++i)
+		{
+			auto p_level = snapshot.PLevel (i);
+			auto& pattern = patterns.at (std::make_pair (snapshot.GetType (i), Segments (p_level)));
+			auto vertices = snapshot.Vertices (i);
+
+			for (size_t k = 0; k < pattern.Points(); ++k)
+			{
+				Geometry::Point<dim> p = vertices[0];
+				for (size_t side = 0; side < dim; ++side)
+				{
+					double w = pattern.weights[k * dim + side];
+					for (size_t d = 0; d < dim; ++d)
+						p[d] += w * (vertices[side + 1][d] - vertices[0][d]);
+				}
+
+				for (size_t d = 0; d < 3; ++d)
+					buffers.points.push_back (d < dim ? p[d] : 0);
+				buffers.projection.push_back (snapshot.Evaluate (i, p));
+			}
+
+			for (auto local : pattern.cells)
+				buffers.connectivity.push_back (point_index + local);
+			point_index += pattern.Points();
+
+			for (size_t c = 0; c < pattern.Cells(); ++c)
+			{
+				cell_end += pattern.cell_points;
+				buffers.offsets.push_back (cell_end);
+				buffers.cell_types.push_back (pattern.cell_type);
+				buffers.p_levels.push_back (p_level);
+				buffers.local_errors.push_back (snapshot.LocalError (i));
+				buffers.node_ids.push_back (snapshot.NodeID (i));
+			}
+		}
+
+		output.Write (ProjectionArray, start.points, buffers.projection.data(), buffers.projection.size());
+		output.Write (PointsArray, 3 * start.points, buffers.points.data(), buffers.points.size());
+		output.Write (ConnectivityArray, start.connectivity, buffers.connectivity.data(), buffers.connectivity.size());
+		output.Write (OffsetsArray, start.cells, buffers.offsets.data(), buffers.offsets.size());
+		output.Write (CellTypesArray, start.cells, buffers.cell_types.data(), buffers.cell_types.size());
+		output.Write (PLevelArray, start.cells, buffers.p_levels.data(), buffers.p_levels.size());
+		output.Write (LocalErrorArray, start.cells, buffers.local_errors.data(), buffers.local_errors.size());
+		output.Write (NodeIDArray, start.cells, buffers.node_ids.data(), buffers.node_ids.size());
+	}
+
+	template <size_t dim>
+	typename VtuExporter<dim>::Pattern VtuExporter<dim>::MakePattern (Geometry::ElementType type, size_t s)
+	{
+		Pattern result;
+		double h = 1.0 / s;
+
+		if (type == Geometry::IntervalType && dim == 1)
+		{
+			//VTK_LINE
+			result.cell_points = 2;
+			result.cell_type = 3;
+
+			for (size_t k = 0; k <= s; ++k)
+				result.weights.push_back (k * h);
+			for (size_t k = 0; k < s; ++k)
+				result.cells.insert (result.cells.end(), {k, k + 1});
+
+			return result;
+		}
+
+		if (type == Geometry::TriangleType && dim == 2)
+		{
+			//VTK_TRIANGLE
+			result.cell_points = 3;
+			result.cell_type = 5;
+
+			//point (i, j) is the i-th of the j-th row, which has s + 1 - j points
+			auto index = [s] (size_t i, size_t j)
+			{
+				return j * (s + 1) - j * (j - 1) / 2 + i;
+			};
+
+			for (size_t j = 0; j <= s; ++j)
+				for (size_t i = 0; i + j <= s; ++i)
+					result.weights.insert (result.weights.end(), {i * h, j * h});
+
+			//each sub-triangle oriented as the element is followed by the upside down one at its side, if any
+			for (size_t j = 0; j < s; ++j)
+				for (size_t i = 0; i + j < s; ++i)
+				{
+					result.cells.insert (result.cells.end(), {index (i, j), index (i + 1, j), index (i, j + 1)});
+					if (i + j + 1 < s)
+						result.cells.insert (result.cells.end(), {index (i + 1, j), index (i + 1, j + 1), index (i, j + 1)});
+				}
+
+			return result;
+		}
+
+		throw std::runtime_error ("VtuExporter: elements of type " + std::to_string (type) + " cannot be exported");
+	}
+
+} //namespace BinaryTree
+
+#endif //__VTU_EXPORTER_H
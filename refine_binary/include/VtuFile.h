@@ -0,0 +1,130 @@
+#ifndef __VTU_FILE_H
+#define __VTU_FILE_H
+
+#include <string>
+#include <cstdint> //uint64_t
+#include <stdexcept> //std::runtime_error
+
+namespace BinaryTree
+{
+	/**
+		Arrays of a VTU file written by VtuOutput, in the order they are stored in the appended data:
+			- ProjectionArray:		Float64, projection at each point
+			- PLevelArray:			UInt32, p level of the element of each cell
+			- LocalErrorArray:		Float64, projection error on the element of each cell
+			- NodeIDArray:			UInt64, node identifier of the element of each cell
+			- PointsArray:			Float64, 3 coordinates of each point
+			- ConnectivityArray:	Int64, indexes of the points of the cells
+			- OffsetsArray:			Int64, index in ConnectivityArray of the end of each cell
+			- CellTypesArray:		UInt8, VTK type of each cell
+	**/
+	enum VtuArray
+	{
+		ProjectionArray = 0,
+		PLevelArray,
+		LocalErrorArray,
+		NodeIDArray,
+		PointsArray,
+		ConnectivityArray,
+		OffsetsArray,
+		CellTypesArray,
+
+		VtuArraysNumber
+	};
+
+	/**
+		VTK unstructured grid file, with the arrays stored as raw binary appended data.
+		The file is created with its final size and the XML description,
+		then the arrays are filled by Write(), at any position and in any order,
+		so several threads can write their parts at the same time
+		and no array has to be kept in memory as a whole.
+	**/
+	class VtuOutput
+	{
+	  public:
+		/**
+			constructor.
+			Input parameters:
+				- the file name
+				- the number of points
+				- the number of cells
+				- the total number of points of the cells
+			It raises a runtime_error exception if the file cannot be created.
+		**/
+		VtuOutput (const std::string&, uint64_t points, uint64_t cells, uint64_t connectivity);
+
+		/**
+			destructor.
+			If Close() has not been called, the file is left with the arrays not written filled by zeros.
+		**/
+		~VtuOutput();
+
+		/**
+			Write input number of entries of input array, starting from input entry.
+			It can be called by several threads at the same time, on different entries.
+			It raises a runtime_error exception if the file cannot be written
+			or the entries exceed the size of the array.
+		**/
+		void Write (VtuArray, uint64_t first, const void*, size_t entries);
+
+		/**
+			Close the file.
+			It raises a runtime_error exception if the file cannot be closed.
+		**/
+		void Close();
+
+		/**
+			Number of entries of input array
+		**/
+		uint64_t Entries (VtuArray) const;
+
+		/**
+			Bytes of each entry of input array
+		**/
+		static size_t EntryBytes (VtuArray);
+
+	  private:
+		/**
+			Write input bytes at input offset of the file
+		**/
+		void WriteAt (const void*, size_t, uint64_t);
+
+		/**
+			deleted copy constructor
+		**/
+		VtuOutput (const VtuOutput&) = delete;
+		/**
+			deleted assignment operator
+		**/
+		VtuOutput& operator = (const VtuOutput&) = delete;
+
+	  private:
+		/**
+			file name
+		**/
+		std::string _file_name;
+		/**
+			file descriptor, negative when closed
+		**/
+		int _fd;
+		/**
+			number of points
+		**/
+		uint64_t _points;
+		/**
+			number of cells
+		**/
+		uint64_t _cells;
+		/**
+			total number of points of the cells
+		**/
+		uint64_t _connectivity;
+		/**
+			offset in bytes from the beginning of the file of the first entry of each array
+		**/
+		uint64_t _offsets[VtuArraysNumber];
+	};
+
+} //namespace BinaryTree
+
+#endif //__VTU_FILE_H
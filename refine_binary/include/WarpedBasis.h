@@ -40,6 +40,10 @@ namespace FiniteElements
 			an exception is raised in the case.
 		**/
 		virtual double OneDEvaluation (size_t, double)const override;
+		/**
+			Warped functions are not products of 1D functions.
+		**/
+		virtual bool IsSeparable() const override;
 		/**
 			Evaluate one function at input point.
 			Input parameters:
@@ -0,0 +1,355 @@
+#include "ArchiveFile.h"
+
+#include <cstring> //std::memcmp
+#include <cerrno> //errno, EINTR
+#include <algorithm> //std::max
+#include <sys/mman.h> //mmap, munmap
+#include <sys/stat.h> //fstat
+#include <fcntl.h> //open
+#include <unistd.h> //close, ftruncate, pwrite, fsync
+#include <cstdio> //std::rename
+
+using namespace std;
+
+namespace BinaryTree
+{
+	/*	File layout:
+			ArchiveHeader
+			the columns, in the order of ArchiveColumn,
+			each one padded to a multiple of 8 bytes */
+	static const uint64_t archive_magic = 0x3148435241484242ULL; //"BBHARCH1"
+	static const uint32_t archive_version = 2;
+
+	uint64_t ArchiveHeader::Entries (ArchiveColumn column) const
+	{
+		switch (column)
+		{
+			case VerticesColumn:
+				return this->vertices * this->dim;
+			case ElementTypesColumn:
+			case BasisTypesColumn:
+			case NodeIDsColumn:
+			case PLevelsColumn:
+			case LocalErrorsColumn:
+				return this->elements;
+			case ConnectivityOffsetsColumn:
+			case CoefficientOffsetsColumn:
+				return this->elements + 1;
+			case ConnectivityColumn:
+				return this->connectivity;
+			case CoefficientsColumn:
+				return this->coefficients;
+			case TreeIDsColumn:
+			case TreeParentsColumn:
+			case TreePLevelsColumn:
+			case TreeElementsColumn:
+				return this->tree_nodes;
+			case StateErrorsColumn:
+			case StateEColumn:
+			case StateETildeColumn:
+			case StateQColumn:
+			case StateTildeErrorsColumn:
+			case StateSColumn:
+				return this->state_nodes;
+			default:
+				return 0;
+		}
+	}
+
+	size_t ArchiveHeader::EntryBytes (ArchiveColumn column)
+	{
+		switch (column)
+		{
+			case ElementTypesColumn:
+			case BasisTypesColumn:
+			case PLevelsColumn:
+			case TreePLevelsColumn:
+				return sizeof (uint32_t);
+			case VerticesColumn:
+			case LocalErrorsColumn:
+			case CoefficientsColumn:
+			case StateErrorsColumn:
+			case StateEColumn:
+			case StateETildeColumn:
+			case StateQColumn:
+			case StateTildeErrorsColumn:
+				return sizeof (double);
+			default:
+				return sizeof (uint64_t);
+		}
+	}
+
+	void ArchiveHeader::Layout()
+	{
+		uint64_t offset = sizeof (ArchiveHeader);
+		for (size_t c = 0; c < ArchiveColumnsNumber; ++c)
+		{
+			auto column = static_cast<ArchiveColumn> (c);
+			this->offsets[c] = offset;
+			offset += Entries (column) * EntryBytes (column);
+			offset = (offset + 7) / 8 * 8;
+		}
+		this->file_size = offset;
+	}
+
+	ArchiveOutput::ArchiveOutput (const string& file_name,
+								  const ArchiveHeader& header,
+								  size_t buffer_bytes,
+								  bool background) :
+		_file_name (file_name),
+		_fd (-1),
+		_header (header),
+		_buffer_bytes (max (buffer_bytes, sizeof (uint64_t))),
+		_buffers (ArchiveColumnsNumber),
+		_written (ArchiveColumnsNumber, 0),
+		_queue(),
+		_max_queued (2 * ArchiveColumnsNumber),
+		_stop (false),
+		_error (nullptr),
+		_mutex(),
+		_changed(),
+		_writer()
+	{
+		this->_header.magic = archive_magic;
+		this->_header.version = archive_version;
+		this->_header.Layout();
+
+		this->_fd = open (file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (this->_fd < 0)
+			throw runtime_error ("ArchiveOutput: cannot open " + file_name);
+
+		if (ftruncate (this->_fd, this->_header.file_size) != 0)
+		{
+			close (this->_fd);
+			throw runtime_error ("ArchiveOutput: cannot resize " + file_name);
+		}
+
+		for (auto& b : this->_buffers)
+			b.reserve (this->_buffer_bytes);
+
+		if (background)
+			this->_writer = thread ([this] () {WriteQueued();});
+	}
+
+	ArchiveOutput::~ArchiveOutput()
+	{
+		if (this->_writer.joinable())
+		{
+			{
+				lock_guard<mutex> lock (this->_mutex);
+				this->_stop = true;
+			}
+			this->_changed.notify_all();
+			this->_writer.join();
+		}
+
+		if (this->_fd >= 0)
+			close (this->_fd);
+	}
+
+	void ArchiveOutput::Flush (ArchiveColumn column)
+	{
+		auto& buffer = this->_buffers[column];
+		uint64_t capacity = this->_header.Entries (column) * ArchiveHeader::EntryBytes (column);
+		if (this->_written[column] + buffer.size() > capacity)
+			throw runtime_error ("ArchiveOutput: column " + to_string (column) + " of " + this->_file_name
+								 + " exceeds the size given by the header");
+
+		if (buffer.empty())
+			return;
+
+		uint64_t offset = this->_header.offsets[column] + this->_written[column];
+		this->_written[column] += buffer.size();
+
+		if (!this->_writer.joinable())
+		{
+			WriteAt (buffer, offset);
+			buffer.clear();
+			return;
+		}
+
+		unique_lock<mutex> lock (this->_mutex);
+		this->_changed.wait (lock, [this] ()
+		{
+			return this->_queue.size() < this->_max_queued || this->_error;
+		});
+		if (this->_error)
+			rethrow_exception (this->_error);
+
+		vector<char> full;
+		full.reserve (this->_buffer_bytes);
+		full.swap (buffer);
+		this->_queue.emplace_back (offset, move (full));
+		lock.unlock();
+		this->_changed.notify_all();
+	}
+
+	void ArchiveOutput::WriteAt (const vector<char>& bytes, uint64_t offset)
+	{
+		size_t done = 0;
+		while (done < bytes.size())
+		{
+			auto result = pwrite (this->_fd, bytes.data() + done, bytes.size() - done, offset + done);
+			if (result < 0 && errno == EINTR)
+				continue;
+			if (result <= 0)
+				throw runtime_error ("ArchiveOutput: cannot write " + this->_file_name);
+			done += result;
+		}
+	}
+
+	void ArchiveOutput::WriteQueued()
+	{
+		unique_lock<mutex> lock (this->_mutex);
+		while (true)
+		{
+			this->_changed.wait (lock, [this] () {return !this->_queue.empty() || this->_stop;});
+			if (this->_queue.empty())
+				return;
+
+			//the buffer stays in the queue while it is written, so Drain() waits for it
+			auto& next = this->_queue.front();
+			lock.unlock();
+			try
+			{
+				WriteAt (next.second, next.first);
+			}
+			catch (...)
+			{
+				lock.lock();
+				this->_error = current_exception();
+				this->_queue.clear();
+				this->_changed.notify_all();
+				return;
+			}
+			lock.lock();
+
+			this->_queue.pop_front();
+			this->_changed.notify_all();
+		}
+	}
+
+	void ArchiveOutput::Drain()
+	{
+		if (!this->_writer.joinable())
+			return;
+
+		unique_lock<mutex> lock (this->_mutex);
+		this->_changed.wait (lock, [this] () {return this->_queue.empty() || this->_error;});
+		if (this->_error)
+			rethrow_exception (this->_error);
+	}
+
+	void ArchiveOutput::Close (bool sync)
+	{
+		for (size_t c = 0; c < ArchiveColumnsNumber; ++c)
+		{
+			auto column = static_cast<ArchiveColumn> (c);
+			Flush (column);
+			if (this->_written[c] != this->_header.Entries (column) * ArchiveHeader::EntryBytes (column))
+				throw runtime_error ("ArchiveOutput: column " + to_string (c) + " of " + this->_file_name
+									 + " is shorter than the size given by the header");
+		}
+		Drain();
+
+		if (sync && fsync (this->_fd) != 0)
+			throw runtime_error ("ArchiveOutput: cannot flush " + this->_file_name);
+
+		//the header is written last, so an interrupted archive has no magic number
+		if (pwrite (this->_fd, &this->_header, sizeof (ArchiveHeader), 0) != sizeof (ArchiveHeader))
+			throw runtime_error ("ArchiveOutput: cannot write " + this->_file_name);
+
+		if (sync && fsync (this->_fd) != 0)
+			throw runtime_error ("ArchiveOutput: cannot flush " + this->_file_name);
+
+		if (close (this->_fd) != 0)
+		{
+			this->_fd = -1;
+			throw runtime_error ("ArchiveOutput: cannot close " + this->_file_name);
+		}
+		this->_fd = -1;
+	}
+
+	void ReplaceFile (const string& source, const string& target)
+	{
+		if (rename (source.c_str(), target.c_str()) != 0)
+			throw runtime_error ("ReplaceFile: cannot rename " + source + " to " + target);
+
+		auto slash = target.find_last_of ('/');
+		string directory = slash == string::npos ? "." : (slash == 0 ? "/" : target.substr (0, slash));
+
+		int fd = open (directory.c_str(), O_RDONLY | O_DIRECTORY);
+		if (fd < 0)
+			throw runtime_error ("ReplaceFile: cannot open the directory " + directory);
+
+		int result = fsync (fd);
+		close (fd);
+		if (result != 0)
+			throw runtime_error ("ReplaceFile: cannot flush the directory " + directory);
+	}
+
+	ArchiveMapping::ArchiveMapping (const string& file_name) :
+		_fd (-1),
+		_data (nullptr),
+		_size (0)
+	{
+		this->_fd = open (file_name.c_str(), O_RDONLY);
+		if (this->_fd < 0)
+			throw runtime_error ("ArchiveMapping: cannot open " + file_name);
+
+		struct stat info;
+		fstat (this->_fd, &info);
+		this->_size = info.st_size;
+		if (this->_size < sizeof (ArchiveHeader))
+		{
+			close (this->_fd);
+			throw runtime_error ("ArchiveMapping: " + file_name + " is not an archive");
+		}
+
+		void* data = mmap (nullptr, this->_size, PROT_READ, MAP_SHARED, this->_fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close (this->_fd);
+			throw runtime_error ("ArchiveMapping: cannot map " + file_name);
+		}
+		this->_data = static_cast<char*> (data);
+
+		/*	The layout is computed again from the counts,
+			so the columns are known to lie in the file */
+		auto& header = Header();
+		ArchiveHeader expected (header);
+		expected.Layout();
+
+		string problem;
+		if (header.magic != archive_magic)
+			problem = " is not a complete archive";
+		else if (header.version != archive_version)
+			problem = " has format version " + to_string (header.version)
+					  + " instead of " + to_string (archive_version);
+		else if (header.file_size != this->_size
+				 || memcmp (header.offsets, expected.offsets, sizeof (header.offsets)) != 0
+				 || expected.file_size != this->_size
+				 || Column<uint64_t> (ConnectivityOffsetsColumn)[header.elements] != header.connectivity
+				 || Column<uint64_t> (CoefficientOffsetsColumn)[header.elements] != header.coefficients)
+			problem = " is corrupted";
+
+		if (!problem.empty())
+		{
+			munmap (this->_data, this->_size);
+			close (this->_fd);
+			throw runtime_error ("ArchiveMapping: " + file_name + problem);
+		}
+	}
+
+	ArchiveMapping::~ArchiveMapping()
+	{
+		munmap (this->_data, this->_size);
+		close (this->_fd);
+	}
+
+	const ArchiveHeader& ArchiveMapping::Header() const
+	{
+		return *reinterpret_cast<const ArchiveHeader*> (this->_data);
+	}
+
+} //namespace BinaryTree
@@ -1,10 +1,16 @@
 #include "BinaryGodFather.h"
 
+#include <thread> //std::thread
+#include <atomic> //std::atomic
+#include <mutex> //std::mutex, std::lock_guard
+#include <exception> //std::exception_ptr
+#include <stdexcept> //std::logic_error
+
 using namespace std;
 
 namespace BinaryTree
 {
-	RecursiveSelector::RecursiveSelector() {}
+	RecursiveSelector::RecursiveSelector (bool compact) : _compact (compact) {}
 	RecursiveSelector::~RecursiveSelector() {}
 
 	void RecursiveSelector::operator() (BinaryNode* node)
@@ -16,34 +22,269 @@ namespace BinaryTree
 	{
 		if (node)
 		{
-			auto hansel = node->Left();
-			auto gretel = node->Right();
-
 			if (node->E() == node->ProjectionError())
-			{
-				node->Activate();
-
-				DeactivateSubTree (hansel);
-				DeactivateSubTree (gretel);
-			}
+				Trim (node);
 			else
 			{
-				SelectActiveNodesRecursively (hansel);
-				SelectActiveNodesRecursively (gretel);
+				SelectActiveNodesRecursively (node->Left());
+				SelectActiveNodesRecursively (node->Right());
 
-				node->Deactivate();
+				Deactivate (node);
 			}
 		}
 	}
 
+	void RecursiveSelector::Trim (BinaryNode* node)
+	{
+		node->Activate();
+		//once compacted, the node will be compacted again only after having been active
+		if (this->_compact)
+			node->Compactable (true);
+
+		DeactivateSubTree (node->Left());
+		DeactivateSubTree (node->Right());
+	}
+
+	void RecursiveSelector::Deactivate (BinaryNode* node)
+	{
+		node->Deactivate();
+		if (this->_compact && node->Compactable())
+		{
+			node->Compact();
+			node->Compactable (false);
+		}
+	}
+
 	void RecursiveSelector::DeactivateSubTree (BinaryNode* node)
 	{
 		if (node)
 		{
-			node->Deactivate();
+			Deactivate (node);
+
 			DeactivateSubTree (node->Left());
 			DeactivateSubTree (node->Right());
 		}
 	}
 
+	void ClimbUp (BinaryNode* leaf_dad)
+	{
+		ClimbUp (leaf_dad, [] (BinaryNode * node) {return node->ProjectionError();});
+	}
+
+	void ClimbUp (BinaryNode* leaf_dad, const function<double (BinaryNode*)>& projection_error)
+	{
+		BinaryNode* daddy = leaf_dad;
+		BinaryNode* previous_daddy = nullptr;
+
+		while (daddy)
+		{
+			auto hansel = daddy->Left ();
+			auto gretel = daddy->Right();
+
+			auto new_E = min (	hansel->E() + gretel->E(),
+								projection_error (daddy));
+
+			auto old_E_tilde = daddy->ETilde();
+			auto new_E_tilde = new_E * old_E_tilde
+							   /
+							   (new_E + old_E_tilde);
+
+			daddy->E (new_E);
+			daddy->ETilde (new_E_tilde);
+
+			BinaryNode* alfa_bro (nullptr);
+
+			hansel->Q() > gretel->Q() ? alfa_bro = hansel : alfa_bro = gretel;
+
+			auto new_q = min (alfa_bro->Q(), new_E_tilde);
+
+			daddy->Q (new_q);
+			daddy->S (alfa_bro->S());
+
+			previous_daddy = daddy;
+			daddy = previous_daddy->Dad();
+		} //while(daddy)
+	}
+
+	/*	Set the parameters of a new leaf, as AbstractBinaryElement::InitLeafParameters() does */
+	static void InitLeaf (BinaryNode* node, double e)
+	{
+		BinaryNode* daddy = node->Dad();
+		double tilde_error = daddy ? e * daddy->TildeError() / (e + daddy->TildeError()) : e;
+
+		node->TildeError (tilde_error);
+		node->E (e);
+		node->ETilde (tilde_error);
+		node->Q (tilde_error);
+		node->S (node);
+	}
+
+	ParametersRebuilder::ParametersRebuilder (const function<vector<double> (BinaryNode*)>& lower_errors,
+											  size_t threads) :
+		_lower_errors (lower_errors),
+		_threads (max (threads, size_t (1))),
+		_roots(),
+		_nodes(),
+		_indexes(),
+		_heights(),
+		_bisected(),
+		_errors(),
+		_levels(),
+		_max_p_level (0)
+	{}
+
+	ParametersRebuilder::~ParametersRebuilder() {}
+
+	void ParametersRebuilder::operator() (BinaryNode* node)
+	{
+		if (node)
+		{
+			this->_roots.push_back (node);
+			Collect (node);
+		}
+	}
+
+	size_t ParametersRebuilder::MaxPLevel() const
+	{
+		return this->_max_p_level;
+	}
+
+	void ParametersRebuilder::Rebuild()
+	{
+		this->_errors.assign (this->_nodes.size(), vector<double>());
+		for (auto& indexes : this->_heights)
+			ComputeErrors (indexes);
+
+		auto replayed_error = [this] (BinaryNode * node) {return ReplayedError (node);};
+
+		this->_levels.assign (this->_nodes.size(), 0);
+		for (auto root : this->_roots)
+			InitLeaf (root, ReplayedError (root));
+
+		//the bisections are numbered in the order they have been done
+		sort (this->_bisected.begin(), this->_bisected.end(), [] (BinaryNode * a, BinaryNode * b)
+		{
+			return a->Left()->NodeID() < b->Left()->NodeID();
+		});
+
+		//as MeshRefiner::Refine(), the p levels are raised before the new leaves are initialized
+		for (auto leaf_dad : this->_bisected)
+		{
+			for (auto daddy = leaf_dad; daddy; daddy = daddy->Dad())
+				++this->_levels[this->_indexes.at (daddy)];
+
+			InitLeaf (leaf_dad->Left(), ReplayedError (leaf_dad->Left()));
+			InitLeaf (leaf_dad->Right(), ReplayedError (leaf_dad->Right()));
+			ClimbUp (leaf_dad, replayed_error);
+		}
+
+		for (size_t i = 0; i < this->_nodes.size(); ++i)
+		{
+			if (this->_levels[i] + 1 != this->_errors[i].size())
+				throw logic_error ("The p level of a node is not the number of bisections of its subtree");
+
+			this->_nodes[i]->Outdated (false);
+		}
+	}
+
+	size_t ParametersRebuilder::Collect (BinaryNode* node)
+	{
+		this->_max_p_level = max (this->_max_p_level, node->PLevel());
+
+		size_t index = this->_nodes.size();
+		this->_nodes.push_back (node);
+		this->_indexes[node] = index;
+
+		size_t height = 0;
+		auto hansel = node->Left();
+		auto gretel = node->Right();
+		if (hansel && gretel)
+		{
+			this->_bisected.push_back (node);
+			height = max (Collect (hansel), Collect (gretel)) + 1;
+		}
+
+		if (this->_heights.size() <= height)
+			this->_heights.resize (height + 1);
+		this->_heights[height].push_back (index);
+
+		return height;
+	}
+
+	void ParametersRebuilder::ComputeErrors (const vector<size_t>& indexes)
+	{
+		atomic<size_t> next (0);
+		mutex error_mutex;
+		exception_ptr error = nullptr;
+
+		auto worker = [&] ()
+		{
+			for (size_t i = next++; i < indexes.size(); i = next++)
+			{
+				try
+				{
+					BinaryNode* node = this->_nodes[indexes[i]];
+					auto errors = this->_lower_errors (node);
+
+					//the active nodes are selected comparing E with the current error as it is
+					errors.back() = node->ProjectionError();
+					this->_errors[indexes[i]] = move (errors);
+				}
+				catch (...)
+				{
+					lock_guard<mutex> lock (error_mutex);
+					if (!error)
+						error = current_exception();
+				}
+			}
+		};
+
+		vector<thread> pool;
+		size_t n_threads = min (this->_threads, indexes.size());
+		for (size_t t = 1; t < n_threads; ++t)
+			pool.emplace_back (worker);
+
+		//the calling thread works too
+		worker();
+		for (auto& t : pool)
+			t.join();
+
+		if (error)
+			rethrow_exception (error);
+	}
+
+	double ParametersRebuilder::ReplayedError (BinaryNode* node) const
+	{
+		size_t i = this->_indexes.at (node);
+		if (this->_levels[i] >= this->_errors[i].size())
+			throw logic_error ("The p level of a node is not the number of bisections of its subtree");
+
+		return this->_errors[i][this->_levels[i]];
+	}
+
+	MemoryInspector::MemoryInspector() : _nodes (0), _bytes (0) {}
+	MemoryInspector::~MemoryInspector() {}
+
+	void MemoryInspector::operator() (BinaryNode* node)
+	{
+		if (node)
+		{
+			++(this->_nodes);
+			this->_bytes += node->ResidentBytes();
+
+			(*this) (node->Left());
+			(*this) (node->Right());
+		}
+	}
+
+	size_t MemoryInspector::NodesNumber() const
+	{
+		return this->_nodes;
+	}
+
+	size_t MemoryInspector::ResidentBytes() const
+	{
+		return this->_bytes;
+	}
+
 } //namespace BinaryTree
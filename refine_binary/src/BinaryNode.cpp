@@ -1,6 +1,7 @@
 #include "BinaryNode.h"
 
 #include <limits> //numeric_limits::max()
+#include <stdexcept> //std::logic_error
 
 using namespace std;
 
@@ -11,7 +12,9 @@ namespace BinaryTree
 		_E			(numeric_limits<double>::max()),
 		_E_tilde	(numeric_limits<double>::max()),
 		_q			(numeric_limits<double>::max()),
-		_tilde_error(numeric_limits<double>::max())
+		_tilde_error(numeric_limits<double>::max()),
+		_outdated	(false),
+		_compactable(true)
 	{}
 
 	BinaryNode::~BinaryNode()
@@ -31,6 +34,8 @@ namespace BinaryTree
 			_E_tilde = bn._E_tilde;
 			_q = bn._q;
 			_tilde_error = bn._tilde_error;
+			_outdated = bn._outdated;
+			_compactable = bn._compactable;
 		}
 		return *this;
 	}
@@ -85,4 +90,63 @@ namespace BinaryTree
 		_tilde_error = val;
 	}
 
+	bool BinaryNode::Outdated() const
+	{
+		return _outdated;
+	}
+
+	void BinaryNode::Outdated (bool val)
+	{
+		_outdated = val;
+	}
+
+	void BinaryNode::Compact()
+	{}
+
+	size_t BinaryNode::Rebuilds() const
+	{
+		return 0;
+	}
+
+	bool BinaryNode::Compactable() const
+	{
+		return _compactable;
+	}
+
+	void BinaryNode::Compactable (bool val)
+	{
+		_compactable = val;
+	}
+
+	size_t BinaryNode::ResidentBytes() const
+	{
+		return sizeof (BinaryNode);
+	}
+
+	void BinaryNode::RestoreProjection (double, const Geometry::VectorView&)
+	{
+		throw logic_error ("This node cannot restore its projection");
+	}
+
+	DeferredProjections::DeferredProjections()
+	{
+		++Count();
+	}
+
+	DeferredProjections::~DeferredProjections()
+	{
+		--Count();
+	}
+
+	bool DeferredProjections::Active()
+	{
+		return Count() > 0;
+	}
+
+	size_t& DeferredProjections::Count()
+	{
+		static thread_local size_t count = 0;
+		return count;
+	}
+
 } //namespace BinaryTree
@@ -0,0 +1,289 @@
+#include "DeltaStream.h"
+
+#include <cstring> //std::memcpy
+#include <chrono> //std::chrono::milliseconds
+
+using namespace std;
+
+namespace BinaryTree
+{
+	/*	File layout, in 8 bytes values:
+			magic number, version, dimension of the mesh
+			then for each delta:
+				iteration, error,
+				number of trimmed nodes, of elements, of vertex coordinates, of coefficients,
+				the trimmed nodes,
+				the node identifiers, p levels, local errors, element types, basis types,
+				vertex counts and coefficient counts of the elements,
+				the vertex coordinates, the coefficients */
+	static const uint64_t stream_magic = 0x31544c4544484242ULL; //"BBHDELT1"
+	static const uint64_t stream_version = 1;
+	static const size_t stream_header_size = 3;
+	static const size_t stream_delta_head = 6;
+	static const size_t stream_element_columns = 7;
+
+	/*	The background thread checks the queue at least this often,
+		since the producer wakes it up without locking the mutex */
+	static const chrono::milliseconds stream_poll (10);
+
+	DeltaQueue::DeltaQueue (size_t capacity) :
+		_slots (capacity),
+		_head (0),
+		_tail (0)
+	{
+		if (capacity == 0)
+			throw invalid_argument ("DeltaQueue: the capacity has to be positive");
+	}
+
+	bool DeltaQueue::Push (unique_ptr<SnapshotDelta>& delta)
+	{
+		size_t tail = this->_tail.load (memory_order_relaxed);
+		if (tail - this->_head.load (memory_order_acquire) == this->_slots.size())
+			return false;
+
+		this->_slots[tail % this->_slots.size()] = move (delta);
+		this->_tail.store (tail + 1, memory_order_release);
+		return true;
+	}
+
+	unique_ptr<SnapshotDelta> DeltaQueue::Pop()
+	{
+		size_t head = this->_head.load (memory_order_relaxed);
+		if (head == this->_tail.load (memory_order_acquire))
+			return nullptr;
+
+		auto result = move (this->_slots[head % this->_slots.size()]);
+		this->_head.store (head + 1, memory_order_release);
+		return result;
+	}
+
+	bool DeltaQueue::Full() const
+	{
+		return this->_tail.load (memory_order_acquire) - this->_head.load (memory_order_acquire)
+			   == this->_slots.size();
+	}
+
+	bool DeltaQueue::Empty() const
+	{
+		return this->_tail.load (memory_order_acquire) == this->_head.load (memory_order_acquire);
+	}
+
+	DeltaStreamWriter::DeltaStreamWriter (const string& file_name, size_t dim, size_t capacity) :
+		_file_name (file_name),
+		_file (file_name, ios::binary | ios::trunc),
+		_queue (capacity),
+		_pushed (0),
+		_written (0),
+		_failed (false),
+		_stop (false),
+		_error (nullptr),
+		_mutex(),
+		_wake(),
+		_done(),
+		_writer()
+	{
+		if (!this->_file)
+			throw runtime_error ("Cannot open the snapshot stream " + file_name);
+
+		uint64_t header[stream_header_size] = {stream_magic, stream_version, dim};
+		this->_file.write (reinterpret_cast<const char*> (header), sizeof (header));
+		this->_file.flush();
+		if (!this->_file)
+			throw runtime_error ("Cannot write the snapshot stream " + file_name);
+
+		this->_writer = thread ([this] () {WriteQueued();});
+	}
+
+	DeltaStreamWriter::~DeltaStreamWriter()
+	{
+		{
+			lock_guard<mutex> lock (this->_mutex);
+			this->_stop = true;
+		}
+		this->_wake.notify_all();
+		this->_writer.join();
+	}
+
+	bool DeltaStreamWriter::Push (unique_ptr<SnapshotDelta>& delta)
+	{
+		CheckError();
+
+		if (!this->_queue.Push (delta))
+			return false;
+
+		++this->_pushed;
+		this->_wake.notify_one();
+		return true;
+	}
+
+	bool DeltaStreamWriter::Full() const
+	{
+		return this->_queue.Full();
+	}
+
+	void DeltaStreamWriter::Drain()
+	{
+		unique_lock<mutex> lock (this->_mutex);
+		this->_done.wait (lock, [this] ()
+		{
+			return this->_written == this->_pushed;
+		});
+		lock.unlock();
+
+		CheckError();
+	}
+
+	void DeltaStreamWriter::CheckError()
+	{
+		if (!this->_failed)
+			return;
+
+		lock_guard<mutex> lock (this->_mutex);
+		rethrow_exception (this->_error);
+	}
+
+	void DeltaStreamWriter::WriteQueued()
+	{
+		while (true)
+		{
+			auto delta = this->_queue.Pop();
+			if (delta)
+			{
+				//after an error the deltas are discarded, so the stream ends with the last complete one
+				if (!this->_failed)
+				{
+					try
+					{
+						Write (*delta);
+					}
+					catch (...)
+					{
+						lock_guard<mutex> lock (this->_mutex);
+						this->_error = current_exception();
+						this->_failed = true;
+					}
+				}
+
+				{
+					lock_guard<mutex> lock (this->_mutex);
+					++this->_written;
+				}
+				this->_done.notify_all();
+				continue;
+			}
+
+			unique_lock<mutex> lock (this->_mutex);
+			if (this->_stop && this->_queue.Empty())
+				return;
+
+			this->_wake.wait_for (lock, stream_poll, [this] ()
+			{
+				return this->_stop || !this->_queue.Empty();
+			});
+		}
+	}
+
+	void DeltaStreamWriter::Write (const SnapshotDelta& delta)
+	{
+		static_assert (sizeof (double) == sizeof (uint64_t), "Stream values must be 8 bytes long");
+
+		uint64_t error;
+		memcpy (&error, &delta.error, sizeof (double));
+
+		uint64_t head[stream_delta_head] = {delta.iteration, error,
+											delta.trimmed.size(), delta.node_ids.size(),
+											delta.vertices.size(), delta.coefficients.size()
+										   };
+		this->_file.write (reinterpret_cast<const char*> (head), sizeof (head));
+
+		auto write = [this] (const void* values, size_t n)
+		{
+			this->_file.write (reinterpret_cast<const char*> (values), n * sizeof (uint64_t));
+		};
+		write (delta.trimmed.data(), delta.trimmed.size());
+		write (delta.node_ids.data(), delta.node_ids.size());
+		write (delta.p_levels.data(), delta.p_levels.size());
+		write (delta.local_errors.data(), delta.local_errors.size());
+		write (delta.types.data(), delta.types.size());
+		write (delta.fe_types.data(), delta.fe_types.size());
+		write (delta.vertex_counts.data(), delta.vertex_counts.size());
+		write (delta.coeff_counts.data(), delta.coeff_counts.size());
+		write (delta.vertices.data(), delta.vertices.size());
+		write (delta.coefficients.data(), delta.coefficients.size());
+
+		this->_file.flush();
+		if (!this->_file)
+			throw runtime_error ("Cannot write the snapshot stream " + this->_file_name);
+	}
+
+	DeltaStreamReader::DeltaStreamReader (const string& file_name, size_t dim) :
+		_file_name (file_name),
+		_file (file_name, ios::binary),
+		_file_size (0),
+		_read_bytes (0)
+	{
+		if (!this->_file)
+			throw runtime_error ("Cannot open the snapshot stream " + file_name);
+
+		this->_file.seekg (0, ios::end);
+		this->_file_size = this->_file.tellg();
+		this->_file.seekg (0);
+
+		uint64_t header[stream_header_size];
+		if (!ReadValues (header, stream_header_size) || header[0] != stream_magic)
+			throw runtime_error (file_name + " is not a snapshot stream");
+		if (header[1] != stream_version)
+			throw runtime_error ("Snapshot stream " + file_name + " has version " + to_string (header[1])
+								 + " instead of " + to_string (stream_version));
+		if (header[2] != dim)
+			throw runtime_error ("Snapshot stream " + file_name + " refers to a mesh of dimension "
+								 + to_string (header[2]));
+
+		this->_read_bytes = sizeof (header);
+	}
+
+	bool DeltaStreamReader::Next (SnapshotDelta& delta)
+	{
+		uint64_t head[stream_delta_head];
+		if (!ReadValues (head, stream_delta_head))
+			return false;
+
+		//a delta truncated within its head may give any count
+		size_t left_values = (this->_file_size - this->_read_bytes) / sizeof (uint64_t) - stream_delta_head;
+		if (head[3] > left_values / stream_element_columns)
+			return false;
+		size_t values = 0;
+		for (auto n : {head[2], stream_element_columns * head[3], head[4], head[5]})
+		{
+			if (n > left_values - values)
+				return false;
+			values += n;
+		}
+
+		delta.iteration = head[0];
+		memcpy (&delta.error, &head[1], sizeof (double));
+
+		bool complete = ReadColumn (delta.trimmed, head[2])
+						&& ReadColumn (delta.node_ids, head[3])
+						&& ReadColumn (delta.p_levels, head[3])
+						&& ReadColumn (delta.local_errors, head[3])
+						&& ReadColumn (delta.types, head[3])
+						&& ReadColumn (delta.fe_types, head[3])
+						&& ReadColumn (delta.vertex_counts, head[3])
+						&& ReadColumn (delta.coeff_counts, head[3])
+						&& ReadColumn (delta.vertices, head[4])
+						&& ReadColumn (delta.coefficients, head[5]);
+		if (!complete)
+			return false;
+
+		this->_read_bytes += (stream_delta_head + values) * sizeof (uint64_t);
+		return true;
+	}
+
+	bool DeltaStreamReader::ReadValues (void* values, size_t n)
+	{
+		this->_file.read (reinterpret_cast<char*> (values), n * sizeof (uint64_t));
+		return static_cast<size_t> (this->_file.gcount()) == n * sizeof (uint64_t);
+	}
+
+} //namespace BinaryTree
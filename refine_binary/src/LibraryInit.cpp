@@ -3,16 +3,28 @@
 #include "StdFElementInterface.h"
 #include "MeshRefiner.h"
 #include "HelpFile.h" //Cfgfile
+#include "ConcreteFactories.h"
 
 using namespace std;
 
 namespace BinaryTree
 {
-	//TODO:	maybe add a different behaviour (throw exception, do nothing, do something else...)
-	//		if this function is called more than once
+	/*	Storage of the configuration file name, set by Init() */
+	static string& ConfigurationFileStorage()
+	{
+		static string conf_file = "";
+		return conf_file;
+	}
+
+	const string& ConfigurationFile()
+	{
+		return ConfigurationFileStorage();
+	}
+
 	bool Init (string conf_filename)
 	{
 		Helpers::Cfgfile cl(conf_filename);
+		ConfigurationFileStorage() = conf_filename;
 
 		/* TODO:
 		if two different libraries try to register with the same key,
@@ -70,9 +82,12 @@ namespace BinaryTree
 			/*	I'm giving priority to ipercube quadratures,
 				i.e. if tri_quad_so_file makes some registration for quadratures
 				for ipercube objects (interval, square, ...)
-				iper_quad_so_file will overwrite them */
+				iper_quad_so_file will overwrite them;
+				the quadrature libraries register a triangle rule only if there is none,
+				so the one of tri_quad_so_file, loaded first, is kept */
 			pl.Add (iper_quad_so_file);
 
+		//the plugins already loaded by a previous call are not added again
 		if (!pl.Load())
 		{
 			cerr << "Houston we have a problem! Something went wrong loading plugins";
@@ -94,4 +109,47 @@ namespace BinaryTree
 
 		return 0;
 	}
+
+	/*	Every standard element registered in the factory is prepared */
+	template <size_t dim, FiniteElements::BasisType FeType>
+	static void PrepareRegistered (size_t degree)
+	{
+		auto& factory (GenericFactory::StdFElementFactory<dim, FeType>::Instance());
+		for (auto& key : factory.registered())
+			factory.create (key)->Prepare (degree);
+	}
+
+	template <>
+	void PrepareStdFElements<1> (size_t degree)
+	{
+		PrepareRegistered<1, FiniteElements::LegendreType> (degree);
+	}
+
+	template <>
+	void PrepareStdFElements<2> (size_t degree)
+	{
+		PrepareRegistered<2, FiniteElements::LegendreType> (degree);
+		PrepareRegistered<2, FiniteElements::WarpedType> (degree);
+	}
+
+	template <size_t dim, FiniteElements::BasisType FeType>
+	static void ReleaseRegistered()
+	{
+		auto& factory (GenericFactory::StdFElementFactory<dim, FeType>::Instance());
+		for (auto& key : factory.registered())
+			factory.create (key)->Release();
+	}
+
+	template <>
+	void ReleaseStdFElements<1>()
+	{
+		ReleaseRegistered<1, FiniteElements::LegendreType>();
+	}
+
+	template <>
+	void ReleaseStdFElements<2>()
+	{
+		ReleaseRegistered<2, FiniteElements::LegendreType>();
+		ReleaseRegistered<2, FiniteElements::WarpedType>();
+	}
 } //namespace BinaryTree
@@ -51,12 +51,23 @@ namespace Geometry
 		return (this->_vec).dot (v);
 	}
 
+	double DynamicVector::Dot (const VectorView& v) const
+	{
+		return (this->_vec).dot (Eigen::Map<const EigDynamicVec> (v.Data(), v.Size()));
+	}
+
 	DynamicVector DynamicVector::CWiseProduct (const DynamicVector& v) const
 	{
 		auto eig_v = (this->_vec).cwiseProduct (v._vec);
 		return DynamicVector (eig_v);
 	}
 
+	DynamicVector& DynamicVector::operator*= (double alfa)
+	{
+		this->_vec *= alfa;
+		return *this;
+	}
+
 	size_t DynamicVector::Size() const
 	{
 		return this->_vec.size();
@@ -72,6 +83,18 @@ namespace Geometry
 		return (this->_vec).head (size);
 	}
 
+	VectorView DynamicVector::View() const
+	{
+		return VectorView ((this->_vec).data(), (this->_vec).size());
+	}
+
+	double VectorView::Dot (const VectorView& v) const
+	{
+		Eigen::Map<const EigDynamicVec> a (this->_data, this->_size);
+		Eigen::Map<const EigDynamicVec> b (v._data, v._size);
+		return a.dot (b);
+	}
+
 	DynamicMatrix::DynamicMatrix() : _mat() {}
 
 	DynamicMatrix::~DynamicMatrix() {}
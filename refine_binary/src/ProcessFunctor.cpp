@@ -0,0 +1,128 @@
+#include "ProcessFunctor.h"
+
+#include <stdexcept>
+#include <vector>
+#include <cstdint> //uint64_t
+#include <sys/socket.h> //socketpair, send, recv, shutdown
+#include <sys/wait.h> //waitpid
+#include <unistd.h> //fork, close, _exit
+
+using namespace std;
+
+namespace BinaryTree
+{
+	/*	Protocol: the parent sends the number of points as uint64,
+		followed by the coordinates; the child answers with the values.
+		The child exits when the socket is closed. */
+
+	static bool SendAll (int fd, const void* data, size_t bytes)
+	{
+		auto ptr = static_cast<const char*> (data);
+		while (bytes > 0)
+		{
+			auto sent = send (fd, ptr, bytes, MSG_NOSIGNAL);
+			if (sent <= 0)
+				return false;
+			ptr += sent;
+			bytes -= sent;
+		}
+		return true;
+	}
+
+	static bool ReceiveAll (int fd, void* data, size_t bytes)
+	{
+		auto ptr = static_cast<char*> (data);
+		while (bytes > 0)
+		{
+			auto received = recv (fd, ptr, bytes, 0);
+			if (received <= 0)
+				return false;
+			ptr += received;
+			bytes -= received;
+		}
+		return true;
+	}
+
+	SolverProcess::SolverProcess (const Evaluator& evaluator, size_t dim) :
+		_dim (dim),
+		_socket (-1),
+		_pid (-1),
+		_requests (0)
+	{
+		int sockets[2];
+		if (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+			throw runtime_error ("SolverProcess: cannot create the socket");
+
+		this->_pid = fork();
+		if (this->_pid < 0)
+		{
+			close (sockets[0]);
+			close (sockets[1]);
+			throw runtime_error ("SolverProcess: cannot create the process");
+		}
+
+		if (this->_pid == 0)
+		{
+			close (sockets[0]);
+			Serve (sockets[1], evaluator);
+			//the child must not run the destructors of the parent objects
+			_exit (0);
+		}
+
+		close (sockets[1]);
+		this->_socket = sockets[0];
+	}
+
+	SolverProcess::~SolverProcess()
+	{
+		/*	The processes created later have inherited a copy of the socket,
+			so closing it would not end the child: the connection is shut down */
+		shutdown (this->_socket, SHUT_RDWR);
+		close (this->_socket);
+		waitpid (this->_pid, nullptr, 0);
+	}
+
+	void SolverProcess::Request (const double* points, double* values, size_t n)
+	{
+		uint64_t size = n;
+		if (!SendAll (this->_socket, &size, sizeof (size))
+				|| !SendAll (this->_socket, points, n * this->_dim * sizeof (double))
+				|| !ReceiveAll (this->_socket, values, n * sizeof (double)))
+			throw runtime_error ("SolverProcess: communication with the process failed");
+
+		++this->_requests;
+	}
+
+	size_t SolverProcess::Requests() const
+	{
+		return this->_requests;
+	}
+
+	void SolverProcess::Serve (int fd, const Evaluator& evaluator)
+	{
+		vector<double> points, values;
+		uint64_t n;
+		while (ReceiveAll (fd, &n, sizeof (n)))
+		{
+			points.resize (n * this->_dim);
+			values.resize (n);
+			if (!ReceiveAll (fd, points.data(), points.size() * sizeof (double)))
+				break;
+
+			try
+			{
+				evaluator (points.data(), values.data(), n);
+			}
+			catch (...)
+			{
+				//the parent sees the closed socket
+				break;
+			}
+
+			if (!SendAll (fd, values.data(), values.size() * sizeof (double)))
+				break;
+		}
+		close (fd);
+	}
+
+} //namespace BinaryTree
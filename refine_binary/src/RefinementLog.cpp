@@ -0,0 +1,155 @@
+#include "RefinementLog.h"
+
+#include <unistd.h> //truncate
+
+using namespace std;
+
+namespace BinaryTree
+{
+	/*	File layout, in uint64 values:
+			magic number, version, dimension of the mesh
+			then for each event:
+				bisected node, left child, right child,
+				number n of ancestors, the n ancestors,
+				the selected flags of the ancestors, 64 for each value, the first one in the lowest bit */
+	static const uint64_t log_magic = 0x31474f4c48424242ULL; //"BBBHLOG1"
+	static const uint64_t log_version = 1;
+	static const size_t log_header_size = 3;
+	static const size_t log_event_head = 4;
+
+	static size_t FlagWords (size_t n)
+	{
+		return (n + 63) / 64;
+	}
+
+	RefinementLogFile::RefinementLogFile (const string& file_name, size_t dim, bool append) :
+		_file_name (file_name),
+		_file(),
+		_record()
+	{
+		bool existing = false;
+		if (append)
+		{
+			ifstream input (file_name, ios::binary);
+			if (input)
+			{
+				input.close();
+
+				//the log is checked, and the event interrupted by a previous run removed
+				RefinementLogReader reader (file_name, dim);
+				RefinementEvent event;
+				while (reader.Next (event));
+
+				if (truncate (file_name.c_str(), reader.ReadBytes()))
+					throw runtime_error ("Cannot truncate the refinement log " + file_name);
+				existing = true;
+			}
+		}
+
+		if (existing)
+			this->_file.open (file_name, ios::binary | ios::app);
+		else
+			this->_file.open (file_name, ios::binary | ios::trunc);
+
+		if (!this->_file)
+			throw runtime_error ("Cannot open the refinement log " + file_name);
+
+		if (!existing)
+		{
+			uint64_t header[log_header_size] = {log_magic, log_version, dim};
+			this->_file.write (reinterpret_cast<const char*> (header), sizeof (header));
+			this->_file.flush();
+			if (!this->_file)
+				throw runtime_error ("Cannot write the refinement log " + file_name);
+		}
+	}
+
+	void RefinementLogFile::Write (const RefinementEvent& event)
+	{
+		size_t n = event.ancestors.size();
+
+		this->_record.assign ({event.bisected, event.left, event.right, n});
+		this->_record.insert (this->_record.end(), event.ancestors.begin(), event.ancestors.end());
+
+		this->_record.resize (log_event_head + n + FlagWords (n), 0);
+		auto flags = this->_record.data() + log_event_head + n;
+		for (size_t i = 0; i < n; ++i)
+			if (event.selected[i])
+				flags[i / 64] |= uint64_t (1) << (i % 64);
+
+		this->_file.write (reinterpret_cast<const char*> (this->_record.data()),
+						   this->_record.size() * sizeof (uint64_t));
+		this->_file.flush();
+		if (!this->_file)
+			throw runtime_error ("Cannot write the refinement log " + this->_file_name);
+	}
+
+	RefinementLogReader::RefinementLogReader (const string& file_name, size_t dim) :
+		_file_name (file_name),
+		_file (file_name, ios::binary),
+		_record(),
+		_file_size (0),
+		_read_bytes (0)
+	{
+		if (!this->_file)
+			throw runtime_error ("Cannot open the refinement log " + file_name);
+
+		this->_file.seekg (0, ios::end);
+		this->_file_size = this->_file.tellg();
+		this->_file.seekg (0);
+
+		uint64_t header[log_header_size];
+		if (!ReadValues (header, log_header_size) || header[0] != log_magic)
+			throw runtime_error (file_name + " is not a refinement log");
+		if (header[1] != log_version)
+			throw runtime_error ("Refinement log " + file_name + " has version " + to_string (header[1])
+								 + " instead of " + to_string (log_version));
+		if (header[2] != dim)
+			throw runtime_error ("Refinement log " + file_name + " refers to a mesh of dimension "
+								 + to_string (header[2]));
+
+		this->_read_bytes = sizeof (header);
+	}
+
+	bool RefinementLogReader::Next (RefinementEvent& event)
+	{
+		uint64_t head[log_event_head];
+		if (!ReadValues (head, log_event_head))
+			return false;
+
+		//an event truncated within its head may give any n
+		uint64_t n = head[3];
+		size_t left_values = (this->_file_size - this->_read_bytes) / sizeof (uint64_t) - log_event_head;
+		if (n > left_values)
+			return false;
+
+		this->_record.resize (n + FlagWords (n));
+		if (!ReadValues (this->_record.data(), this->_record.size()))
+			return false;
+
+		event.bisected = head[0];
+		event.left = head[1];
+		event.right = head[2];
+		event.ancestors.assign (this->_record.begin(), this->_record.begin() + n);
+
+		event.selected.resize (n);
+		auto flags = this->_record.data() + n;
+		for (size_t i = 0; i < n; ++i)
+			event.selected[i] = (flags[i / 64] >> (i % 64)) & 1;
+
+		this->_read_bytes += (log_event_head + this->_record.size()) * sizeof (uint64_t);
+		return true;
+	}
+
+	size_t RefinementLogReader::ReadBytes() const
+	{
+		return this->_read_bytes;
+	}
+
+	bool RefinementLogReader::ReadValues (uint64_t* values, size_t n)
+	{
+		this->_file.read (reinterpret_cast<char*> (values), n * sizeof (uint64_t));
+		return static_cast<size_t> (this->_file.gcount()) == n * sizeof (uint64_t);
+	}
+
+} //namespace BinaryTree
@@ -0,0 +1,257 @@
+#include "SampleCache.h"
+
+#include <stdexcept>
+#include <cstring> //std::memcpy
+#include <sys/mman.h> //mmap, msync
+#include <sys/stat.h> //fstat
+#include <sys/file.h> //flock
+#include <fcntl.h> //open
+#include <unistd.h> //close, ftruncate, sysconf
+
+using namespace std;
+
+namespace BinaryTree
+{
+	/*	File layout:
+			header, header_bytes long, made of uint64 fields:
+				0					magic number
+				1					file size
+				2					index of the segment being filled
+				3 ... 3 + segments	used bytes of each segment
+			segments, each one a sequence of blocks:
+				uint64	key
+				uint64	check
+				uint64	number of values
+				uint64	hash of the values
+				double	values
+		A block is published by increasing the used bytes of its segment
+		only after it has been flushed to the file,
+		and the hash of the values discards the blocks torn by a crash anyway. */
+	static const uint64_t cache_magic = 0x3245484341434142ULL; //"BACACHE2"
+	static const size_t segments = 4;
+	static const size_t header_bytes = 128;
+	static const size_t block_header_bytes = 4 * sizeof (uint64_t);
+
+	SampleCache::SampleCache (const string& file_name, size_t max_bytes) :
+		_fd (-1),
+		_data (nullptr),
+		_size (max_bytes),
+		_segment_bytes (0),
+		_index(),
+		_statistics(),
+		_mutex()
+	{
+		if (max_bytes < header_bytes + segments * 1024)
+			throw runtime_error ("SampleCache: size cap too small");
+
+		this->_segment_bytes = (max_bytes - header_bytes) / segments;
+		this->_segment_bytes -= this->_segment_bytes % sizeof (double);
+
+		this->_fd = open (file_name.c_str(), O_RDWR | O_CREAT, 0644);
+		if (this->_fd < 0)
+			throw runtime_error ("SampleCache: cannot open " + file_name);
+
+		if (flock (this->_fd, LOCK_EX | LOCK_NB) != 0)
+		{
+			close (this->_fd);
+			throw runtime_error ("SampleCache: " + file_name + " is used by another process");
+		}
+
+		/*	A file with a different size is emptied,
+			so the new one is made of zeros and it is formatted below */
+		struct stat info;
+		fstat (this->_fd, &info);
+		bool fresh = static_cast<size_t> (info.st_size) != this->_size;
+
+		if ((fresh && ftruncate (this->_fd, 0) != 0) || ftruncate (this->_fd, this->_size) != 0)
+		{
+			close (this->_fd);
+			throw runtime_error ("SampleCache: cannot resize " + file_name);
+		}
+
+		void* data = mmap (nullptr, this->_size, PROT_READ | PROT_WRITE, MAP_SHARED, this->_fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close (this->_fd);
+			throw runtime_error ("SampleCache: cannot map " + file_name);
+		}
+		this->_data = static_cast<char*> (data);
+
+		if (fresh || *HeaderField (0) != cache_magic || *HeaderField (1) != this->_size
+				|| *HeaderField (2) >= segments)
+			Format();
+
+		for (size_t s = 0; s < segments; ++s)
+			IndexSegment (s);
+	}
+
+	SampleCache::~SampleCache()
+	{
+		msync (this->_data, this->_size, MS_SYNC);
+		munmap (this->_data, this->_size);
+		flock (this->_fd, LOCK_UN);
+		close (this->_fd);
+	}
+
+	bool SampleCache::Find (uint64_t key, uint64_t check, double* values, size_t n)
+	{
+		lock_guard<mutex> lock (this->_mutex);
+
+		auto it = this->_index.find (key);
+		if (it == this->_index.end() || it->second.check != check || it->second.size != n)
+		{
+			++this->_statistics.misses;
+			return false;
+		}
+
+		memcpy (values, this->_data + it->second.offset + block_header_bytes, n * sizeof (double));
+
+		++this->_statistics.hits;
+		this->_statistics.hit_samples += n;
+		return true;
+	}
+
+	void SampleCache::Store (uint64_t key, uint64_t check, const double* values, size_t n)
+	{
+		size_t bytes = block_header_bytes + n * sizeof (double);
+		if (bytes > this->_segment_bytes)
+			return;
+
+		lock_guard<mutex> lock (this->_mutex);
+
+		size_t current = *HeaderField (2);
+		uint64_t* used = HeaderField (3 + current);
+
+		if (*used + bytes > this->_segment_bytes)
+		{
+			current = (current + 1) % segments;
+			EvictSegment (current);
+			*HeaderField (2) = current;
+			used = HeaderField (3 + current);
+		}
+
+		size_t offset = SegmentBegin (current) + *used;
+		uint64_t block_header[4] = {key, check, n, Hash (values, n * sizeof (double))};
+		memcpy (this->_data + offset, block_header, block_header_bytes);
+		memcpy (this->_data + offset + block_header_bytes, values, n * sizeof (double));
+
+		//the block is made visible only after it has been written to the file
+		Flush (offset, bytes);
+		*used += bytes;
+		this->_index[key] = {offset, check, n};
+
+		this->_statistics.stored_samples += n;
+		this->_statistics.used_bytes += bytes;
+	}
+
+	size_t SampleCache::Size() const
+	{
+		lock_guard<mutex> lock (this->_mutex);
+		return this->_index.size();
+	}
+
+	SampleCacheStatistics SampleCache::Statistics() const
+	{
+		lock_guard<mutex> lock (this->_mutex);
+		return this->_statistics;
+	}
+
+	uint64_t SampleCache::Hash (const void* data, size_t bytes, uint64_t seed)
+	{
+		auto ptr = static_cast<const unsigned char*> (data);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < bytes; ++i)
+		{
+			hash ^= ptr[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	void SampleCache::Format()
+	{
+		memset (this->_data, 0, header_bytes);
+		*HeaderField (0) = cache_magic;
+		*HeaderField (1) = this->_size;
+	}
+
+	void SampleCache::IndexSegment (size_t s)
+	{
+		size_t begin = SegmentBegin (s);
+		size_t used = *HeaderField (3 + s);
+		if (used > this->_segment_bytes)
+		{
+			//corrupted header: the segment is discarded
+			*HeaderField (3 + s) = 0;
+			return;
+		}
+
+		for (size_t offset = 0; offset + block_header_bytes <= used;)
+		{
+			uint64_t block_header[4];
+			memcpy (block_header, this->_data + begin + offset, block_header_bytes);
+			if (block_header[2] > used)
+				break;
+
+			size_t bytes = block_header_bytes + block_header[2] * sizeof (double);
+			if (offset + bytes > used)
+				break;
+
+			//a torn block and the following ones are discarded
+			if (Hash (this->_data + begin + offset + block_header_bytes, block_header[2] * sizeof (double))
+					!= block_header[3])
+			{
+				*HeaderField (3 + s) = offset;
+				break;
+			}
+
+			this->_index[block_header[0]] = {begin + offset, block_header[1], block_header[2]};
+			this->_statistics.used_bytes += bytes;
+			offset += bytes;
+		}
+	}
+
+	void SampleCache::EvictSegment (size_t s)
+	{
+		size_t begin = SegmentBegin (s);
+		uint64_t* used = HeaderField (3 + s);
+
+		for (size_t offset = 0; offset + block_header_bytes <= *used;)
+		{
+			uint64_t block_header[4];
+			memcpy (block_header, this->_data + begin + offset, block_header_bytes);
+			size_t bytes = block_header_bytes + block_header[2] * sizeof (double);
+
+			//the key may have been stored again in a newer segment
+			auto it = this->_index.find (block_header[0]);
+			if (it != this->_index.end() && it->second.offset == begin + offset)
+				this->_index.erase (it);
+
+			++this->_statistics.evicted_blocks;
+			this->_statistics.used_bytes -= min (this->_statistics.used_bytes, bytes);
+			offset += bytes;
+		}
+
+		*used = 0;
+	}
+
+	void SampleCache::Flush (size_t offset, size_t bytes)
+	{
+		static const size_t page = static_cast<size_t> (sysconf (_SC_PAGESIZE));
+		size_t begin = offset - offset % page;
+
+		if (msync (this->_data + begin, offset + bytes - begin, MS_SYNC) != 0)
+			throw runtime_error ("SampleCache: cannot flush the cache file");
+	}
+
+	uint64_t* SampleCache::HeaderField (size_t i) const
+	{
+		return reinterpret_cast<uint64_t*> (this->_data) + i;
+	}
+
+	size_t SampleCache::SegmentBegin (size_t s) const
+	{
+		return header_bytes + s * this->_segment_bytes;
+	}
+
+} //namespace BinaryTree
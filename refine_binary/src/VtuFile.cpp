@@ -0,0 +1,181 @@
+#include "VtuFile.h"
+
+#include <sstream> //std::ostringstream
+#include <cerrno> //errno, EINTR
+#include <fcntl.h> //open
+#include <unistd.h> //close, ftruncate, pwrite
+
+using namespace std;
+
+namespace BinaryTree
+{
+	/*	File layout:
+			XML description of the grid, giving the offset of each array in the appended data
+			'_', then for each array, in the order of VtuArray:
+				the size in bytes of the array as UInt64, the entries
+			closing XML tags */
+	static const char* vtu_names[VtuArraysNumber] =
+	{"projection", "p_level", "local_error", "node_id", "points", "connectivity", "offsets", "types"};
+	static const char* vtu_types[VtuArraysNumber] =
+	{"Float64", "UInt32", "Float64", "UInt64", "Float64", "Int64", "Int64", "UInt8"};
+
+	static const char* ByteOrder()
+	{
+		const uint16_t one = 1;
+		return *reinterpret_cast<const char*> (&one) ? "LittleEndian" : "BigEndian";
+	}
+
+	VtuOutput::VtuOutput (const string& file_name, uint64_t points, uint64_t cells, uint64_t connectivity) :
+		_file_name (file_name),
+		_fd (-1),
+		_points (points),
+		_cells (cells),
+		_connectivity (connectivity),
+		_offsets()
+	{
+		uint64_t appended[VtuArraysNumber];
+		uint64_t offset = 0;
+		for (size_t a = 0; a < VtuArraysNumber; ++a)
+		{
+			appended[a] = offset;
+			offset += sizeof (uint64_t) + Entries (static_cast<VtuArray> (a)) * EntryBytes (static_cast<VtuArray> (a));
+		}
+
+		auto data_array = [&appended] (ostringstream & xml, VtuArray a, const string & indent)
+		{
+			xml << indent << "<DataArray type=\"" << vtu_types[a] << "\" Name=\"" << vtu_names[a] << "\"";
+			if (a == PointsArray)
+				xml << " NumberOfComponents=\"3\"";
+			xml << " format=\"appended\" offset=\"" << appended[a] << "\"/>\n";
+		};
+
+		ostringstream xml;
+		xml << "<?xml version=\"1.0\"?>\n"
+			<< "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << ByteOrder()
+			<< "\" header_type=\"UInt64\">\n"
+			<< "  <UnstructuredGrid>\n"
+			<< "    <Piece NumberOfPoints=\"" << points << "\" NumberOfCells=\"" << cells << "\">\n"
+			<< "      <PointData Scalars=\"" << vtu_names[ProjectionArray] << "\">\n";
+		data_array (xml, ProjectionArray, "        ");
+		xml << "      </PointData>\n"
+			<< "      <CellData Scalars=\"" << vtu_names[PLevelArray] << "\">\n";
+		data_array (xml, PLevelArray, "        ");
+		data_array (xml, LocalErrorArray, "        ");
+		data_array (xml, NodeIDArray, "        ");
+		xml << "      </CellData>\n"
+			<< "      <Points>\n";
+		data_array (xml, PointsArray, "        ");
+		xml << "      </Points>\n"
+			<< "      <Cells>\n";
+		data_array (xml, ConnectivityArray, "        ");
+		data_array (xml, OffsetsArray, "        ");
+		data_array (xml, CellTypesArray, "        ");
+		xml << "      </Cells>\n"
+			<< "    </Piece>\n"
+			<< "  </UnstructuredGrid>\n"
+			<< "  <AppendedData encoding=\"raw\">\n"
+			<< "_";
+		string head = xml.str();
+		string tail = "\n  </AppendedData>\n</VTKFile>\n";
+
+		this->_fd = open (file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (this->_fd < 0)
+			throw runtime_error ("VtuOutput: cannot open " + file_name);
+
+		if (ftruncate (this->_fd, head.size() + offset + tail.size()) != 0)
+		{
+			close (this->_fd);
+			this->_fd = -1;
+			throw runtime_error ("VtuOutput: cannot resize " + file_name);
+		}
+
+		try
+		{
+			WriteAt (head.data(), head.size(), 0);
+			for (size_t a = 0; a < VtuArraysNumber; ++a)
+			{
+				auto array = static_cast<VtuArray> (a);
+				uint64_t bytes = Entries (array) * EntryBytes (array);
+				WriteAt (&bytes, sizeof (bytes), head.size() + appended[a]);
+				this->_offsets[a] = head.size() + appended[a] + sizeof (bytes);
+			}
+			WriteAt (tail.data(), tail.size(), head.size() + offset);
+		}
+		catch (...)
+		{
+			close (this->_fd);
+			this->_fd = -1;
+			throw;
+		}
+	}
+
+	VtuOutput::~VtuOutput()
+	{
+		if (this->_fd >= 0)
+			close (this->_fd);
+	}
+
+	uint64_t VtuOutput::Entries (VtuArray array) const
+	{
+		switch (array)
+		{
+			case ProjectionArray:
+				return this->_points;
+			case PointsArray:
+				return 3 * this->_points;
+			case ConnectivityArray:
+				return this->_connectivity;
+			default:
+				return this->_cells;
+		}
+	}
+
+	size_t VtuOutput::EntryBytes (VtuArray array)
+	{
+		switch (array)
+		{
+			case PLevelArray:
+				return sizeof (uint32_t);
+			case CellTypesArray:
+				return sizeof (uint8_t);
+			default:
+				return sizeof (uint64_t);
+		}
+	}
+
+	void VtuOutput::Write (VtuArray array, uint64_t first, const void* entries, size_t n)
+	{
+		if (first + n > Entries (array))
+			throw runtime_error ("VtuOutput: array " + string (vtu_names[array]) + " of " + this->_file_name
+								 + " exceeds the size given to the constructor");
+
+		WriteAt (entries, n * EntryBytes (array), this->_offsets[array] + first * EntryBytes (array));
+	}
+
+	void VtuOutput::Close()
+	{
+		if (this->_fd < 0)
+			return;
+
+		int fd = this->_fd;
+		this->_fd = -1;
+		if (close (fd) != 0)
+			throw runtime_error ("VtuOutput: cannot close " + this->_file_name);
+	}
+
+	void VtuOutput::WriteAt (const void* bytes, size_t size, uint64_t offset)
+	{
+		auto data = reinterpret_cast<const char*> (bytes);
+		size_t done = 0;
+		while (done < size)
+		{
+			auto result = pwrite (this->_fd, data + done, size - done, offset + done);
+			if (result < 0 && errno == EINTR)
+				continue;
+			if (result <= 0)
+				throw runtime_error ("VtuOutput: cannot write " + this->_file_name);
+			done += result;
+		}
+	}
+
+} //namespace BinaryTree
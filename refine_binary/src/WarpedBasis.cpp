@@ -31,6 +31,11 @@ namespace FiniteElements
 			"Trying to call the meaningless 1d evaluation of the warped basis");
 	}
 
+	bool WarpedBasis::IsSeparable() const
+	{
+		return false;
+	}
+
 	double WarpedBasis::Evaluate (size_t ind, const Geometry::Point<2>& p)
 	{
 #ifdef VERBOSE
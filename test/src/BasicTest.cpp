@@ -1,6 +1,11 @@
 #include "BasicConfiguration.h"
 
 #include "Maps.h"
+#include "SampleCache.h"
+#include "SampleBatch.h"
+#include "ProcessFunctor.h"
+
+#include <cstdio> //std::remove
 
 using namespace std;
 using namespace Geometry;
@@ -317,3 +322,281 @@ TEST_F (BasicTest, MapsTest)
 }
 
 
+
+TEST_F (BasicTest, SmallVectorTest)
+{
+	clog << endl << "Starting SmallVectorTest" << endl;
+
+	SmallVector<4> v;
+	for (size_t i = 0; i < 4; ++i)
+	{
+		v.Resize (i + 1);
+		v[i] = i;
+	}
+	EXPECT_EQ (v.HeapBytes(), 0) << "Short vector expected to be stored inline";
+
+	v.Resize (8);
+	for (size_t i = 4; i < 8; ++i)
+		v[i] = i;
+	EXPECT_GT (v.HeapBytes(), 0) << "Long vector expected to be stored on the heap";
+
+	for (size_t i = 0; i < 8; ++i)
+		EXPECT_EQ (v[i], i) << "Value lost while moving the vector on the heap";
+
+	v.Resize (3);
+	EXPECT_EQ (v.HeapBytes(), 0) << "Heap memory not released";
+	for (size_t i = 0; i < 3; ++i)
+		EXPECT_EQ (v[i], i) << "Value lost while moving the vector inline";
+
+	//the values of the longer vector are not exposed again, in either storage
+	v.Resize (4);
+	EXPECT_EQ (v[3], 0) << "Stale value after growing inline";
+	v.Resize (2);
+	v.Resize (8);
+	for (size_t i = 2; i < 8; ++i)
+		EXPECT_EQ (v[i], 0) << "Stale value after growing on the heap";
+	v.Resize (3);
+
+	DynamicVector w (3);
+	for (size_t i = 0; i < 3; ++i)
+		w[i] = 1;
+
+	EXPECT_EQ (w.Dot (v.Head (3)), 3) << "Scalar product with view failed";
+	EXPECT_EQ (w.View().Dot (v.View()), 3) << "Scalar product between views failed";
+
+	clog << "SmallVectorTest ended" << endl << endl;
+}
+
+/*	Functor counting its evaluations */
+class CountingFunctor : public BinaryTree::Functor<2>
+{
+  public:
+	CountingFunctor() : evaluations (0) {};
+
+	virtual double operator() (const Point<2>& p) const override
+	{
+		++evaluations;
+		return p[0] * p[0] + p[1];
+	};
+	virtual string Formula() const override
+	{
+		return "x^2+y";
+	};
+	virtual string ID() const override
+	{
+		return "counting";
+	};
+
+	mutable size_t evaluations;
+};
+
+TEST_F (BasicTest, SampleCacheTest)
+{
+	clog << endl << "Starting SampleCacheTest" << endl;
+
+	string file_name = "./samples.cache";
+	remove (file_name.c_str());
+
+	auto counting = make_shared<CountingFunctor>();
+	size_t n_batches = 100, n_points = 9;
+
+	vector<double> points (2 * n_points), values (n_points);
+	auto fill_points = [&] (size_t b)
+	{
+		for (size_t q = 0; q < n_points; ++q)
+		{
+			points[2 * q] = b + 0.1 * q;
+			points[2 * q + 1] = 0.5 * b - 0.2 * q;
+		}
+	};
+	auto check_values = [&] (size_t b)
+	{
+		for (size_t q = 0; q < n_points; ++q)
+			EXPECT_EQ (values[q], points[2 * q] * points[2 * q] + points[2 * q + 1])
+					<< "Wrong cached value in batch #" << b;
+	};
+
+	{
+		auto cache = make_shared<BinaryTree::SampleCache> (file_name, 1 << 20);
+		BinaryTree::CachedFunctor<2> cached (counting, cache);
+
+		clog << "First evaluation: every batch is a miss" << endl;
+		for (size_t b = 0; b < n_batches; ++b)
+		{
+			fill_points (b);
+			cached.Evaluate (points.data(), values.data(), n_points);
+			check_values (b);
+		}
+		EXPECT_EQ (counting->evaluations, n_batches * n_points);
+		EXPECT_EQ (cache->Statistics().misses, n_batches);
+
+		clog << "Second evaluation: every batch is a hit" << endl;
+		for (size_t b = 0; b < n_batches; ++b)
+		{
+			fill_points (b);
+			cached.Evaluate (points.data(), values.data(), n_points);
+			check_values (b);
+		}
+		EXPECT_EQ (counting->evaluations, n_batches * n_points);
+		EXPECT_EQ (cache->Statistics().hits, n_batches);
+		EXPECT_EQ (cache->Statistics().hit_samples, n_batches * n_points);
+
+		clog << "The file cannot be opened twice" << endl;
+		EXPECT_THROW (BinaryTree::SampleCache other (file_name, 1 << 20), runtime_error);
+	}
+
+	{
+		clog << "Reopening the cache file" << endl;
+		auto cache = make_shared<BinaryTree::SampleCache> (file_name, 1 << 20);
+		EXPECT_EQ (cache->Size(), n_batches);
+
+		BinaryTree::CachedFunctor<2> cached (counting, cache);
+		for (size_t b = 0; b < n_batches; ++b)
+		{
+			fill_points (b);
+			cached.Evaluate (points.data(), values.data(), n_points);
+			check_values (b);
+		}
+		EXPECT_EQ (counting->evaluations, n_batches * n_points)
+				<< "The functor has been evaluated although the samples were cached";
+	}
+
+	{
+		/*	The first block is at the beginning of the first segment, after the 128 bytes
+			of the file header, and its values follow the 4 fields of the block header */
+		clog << "Corrupting a value of the first block" << endl;
+		FILE* file = fopen (file_name.c_str(), "r+b");
+		ASSERT_NE (file, nullptr);
+		fseek (file, 128 + 4 * 8, SEEK_SET);
+		int byte = fgetc (file);
+		fseek (file, 128 + 4 * 8, SEEK_SET);
+		fputc (byte ^ 0xFF, file);
+		fclose (file);
+
+		auto cache = make_shared<BinaryTree::SampleCache> (file_name, 1 << 20);
+		EXPECT_EQ (cache->Size(), 0u) << "A corrupted block has been read from the cache file";
+
+		BinaryTree::CachedFunctor<2> cached (counting, cache);
+		fill_points (0);
+		cached.Evaluate (points.data(), values.data(), n_points);
+		check_values (0);
+		EXPECT_EQ (counting->evaluations, (n_batches + 1) * n_points);
+	}
+
+	{
+		clog << "Reopening the cache file with a smaller cap: blocks are evicted" << endl;
+		auto cache = make_shared<BinaryTree::SampleCache> (file_name, 16 * 1024);
+		EXPECT_EQ (cache->Size(), 0u) << "The cache with a different size has not been emptied";
+
+		BinaryTree::CachedFunctor<2> cached (counting, cache);
+		size_t n_many = 10 * n_batches;
+		for (size_t b = 0; b < n_many; ++b)
+		{
+			fill_points (b);
+			cached.Evaluate (points.data(), values.data(), n_points);
+			check_values (b);
+		}
+
+		auto stats = cache->Statistics();
+		EXPECT_GT (stats.evicted_blocks, 0u);
+		EXPECT_LT (cache->Size(), n_many);
+		EXPECT_LE (stats.used_bytes, 16u * 1024);
+
+		clog << "The last batch is still cached" << endl;
+		size_t evaluations = counting->evaluations;
+		fill_points (n_many - 1);
+		cached.Evaluate (points.data(), values.data(), n_points);
+		check_values (n_many - 1);
+		EXPECT_EQ (counting->evaluations, evaluations);
+	}
+
+	remove (file_name.c_str());
+
+	clog << "SampleCacheTest ended" << endl << endl;
+}
+
+TEST_F (BasicTest, ProcessFunctorTest)
+{
+	clog << endl << "Starting ProcessFunctorTest" << endl;
+
+	/*	The second child process inherits the socket of the first one,
+		which has to stop anyway when the first functor is destroyed */
+	auto counting = make_shared<CountingFunctor>();
+	unique_ptr<BinaryTree::ProcessFunctor<2>> first (new BinaryTree::ProcessFunctor<2> (counting));
+	unique_ptr<BinaryTree::ProcessFunctor<2>> second (new BinaryTree::ProcessFunctor<2> (counting));
+
+	Point<2> p ({0.5, 2});
+	EXPECT_EQ ((*first) (p), 2.25);
+	EXPECT_EQ ((*second) (p), 2.25);
+
+	clog << "Destroying the functors in creation order" << endl;
+	first.reset();
+	EXPECT_EQ ((*second) (p), 2.25) << "The second process stopped with the first one";
+	second.reset();
+
+	clog << "ProcessFunctorTest ended" << endl << endl;
+}
+
+TEST_F (BasicTest, SampleBatchTest)
+{
+	clog << endl << "Starting SampleBatchTest" << endl;
+
+	auto counting = make_shared<CountingFunctor>();
+	BinaryTree::ProcessFunctor<2> solver (counting);
+
+	Point<2> p ({0.5, 2});
+	EXPECT_EQ (solver (p), 2.25) << "Wrong value computed by the process";
+	EXPECT_EQ (solver.Requests(), 1u);
+	EXPECT_EQ (counting->evaluations, 0u) << "The functor has been evaluated by this process";
+
+	clog << "Gathering the requests of three elements" << endl;
+	BinaryTree::SampleBatch<2> batch;
+	vector<vector<double>> received (3);
+	for (size_t r = 0; r < 3; ++r)
+	{
+		vector<double> points;
+		for (size_t q = 0; q <= r; ++q)
+		{
+			points.push_back (r + 0.1 * q);
+			points.push_back (-0.5 * q);
+		}
+		batch.Add (points, [&received, r] (const double* values)
+		{
+			received[r].assign (values, values + r + 1);
+		});
+	}
+	EXPECT_EQ (batch.Requests(), 3u);
+	EXPECT_EQ (batch.Size(), 6u);
+
+	EXPECT_THROW (batch.Scatter(), logic_error) << "Scattered a batch not submitted";
+
+	batch.Submit (solver);
+	EXPECT_THROW (batch.Add ({0, 0}, [] (const double*) {}), logic_error)
+			<< "Request added to a submitted batch";
+
+	batch.Scatter();
+	EXPECT_EQ (solver.Requests(), 2u) << "The batch has not been sent as a single request";
+	EXPECT_EQ (batch.Size(), 0u);
+
+	for (size_t r = 0; r < 3; ++r)
+	{
+		ASSERT_EQ (received[r].size(), r + 1);
+		for (size_t q = 0; q <= r; ++q)
+		{
+			double x = r + 0.1 * q, y = -0.5 * q;
+			EXPECT_EQ (received[r][q], x * x + y) << "Wrong value scattered to request #" << r;
+		}
+	}
+
+	clog << "Collecting batch" << endl;
+	EXPECT_EQ (BinaryTree::SampleBatch<2>::Collecting(), nullptr);
+	{
+		BinaryTree::SampleBatch<2> collecting;
+		collecting.Collect (true);
+		EXPECT_EQ (BinaryTree::SampleBatch<2>::Collecting(), &collecting);
+	}
+	EXPECT_EQ (BinaryTree::SampleBatch<2>::Collecting(), nullptr)
+			<< "Destroyed batch still collecting";
+
+	clog << "SampleBatchTest ended" << endl << endl;
+}
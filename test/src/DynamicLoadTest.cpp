@@ -1,6 +1,15 @@
 #include "DynamicLoadConfiguration.h"
 
 #include "StdFElement.h"
+#include "SandiaQuadrature.h"
+#include "CompiledFunctor.h"
+#include "GridFunctor.h"
+
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <cstdio> //std::remove
+#include <sys/stat.h> //chmod
 
 using namespace std;
 using namespace Geometry;
@@ -17,6 +26,32 @@ TEST_F (LoadTest, IsRegistered)
 	clog << "IsRegisterd ended" << endl << endl;
 }
 
+TEST_F (LoadTest, PluginPriority)
+{
+	clog << endl << "Starting PluginPriority" << endl;
+
+	//the plugins are added again, as by a second BinaryTree::Init() call
+	auto size = _pl.Size();
+	for (auto& handle : {"libmesh_quadrature", "libsandia_quadrature", "libinterpolating_functions"})
+#ifndef DEBUG
+		_pl.Add (string (handle) + ".so");
+#else //DEBUG
+		_pl.Add (string (handle) + "_Debug.so");
+#endif //DEBUG
+	EXPECT_EQ (_pl.Size(), size) << "Plugins added twice";
+	EXPECT_TRUE (_pl.Load()) << "Loading again failed";
+
+	//the triangle rule of mesh_quadrature, loaded first, is not overwritten by sandia_quadrature
+	auto tri_ptr = QuadratureFactory<2>::Instance().create (TriangleType);
+	EXPECT_EQ (dynamic_cast<SandiaQuadrature::SandiaTriangleRule*> (tri_ptr.get()), nullptr)
+			<< "Triangle rule of the library loaded first overwritten";
+	auto square_ptr = QuadratureFactory<2>::Instance().create (SquareType);
+	EXPECT_NE (dynamic_cast<SandiaQuadrature::SandiaQuadratureRule<2>*> (square_ptr.get()), nullptr)
+			<< "Square rule of the library loaded last not registered";
+
+	clog << "PluginPriority ended" << endl << endl;
+}
+
 
 TEST_F (LoadTest, StdIntegration)
 {
@@ -259,6 +294,178 @@ TEST_F (LoadTest, StdIntegration)
 	clog << "StdIntegration ended" << endl << endl;
 }
 
+TEST_F (LoadTest, CubeIntegration)
+{
+	clog << endl << "Starting CubeIntegration" << endl;
+
+	//cube (-1,1)^3, nodes can be either tensorial or sparse
+	StdIperCube<3> std_cube;
+	size_t order = std_cube.QuadratureOrder();
+	clog << "Quadrature rule with "
+		 << std_cube.GetQuadPoints().Size()
+		 << " nodes"
+		 << endl;
+
+	//integral in (-1,1) of x^k
+	auto moment = [] (size_t k)
+	{
+		return k % 2 ? 0.0 : 2.0 / (k + 1);
+	};
+
+	//the rule has to be exact for each monomial with total degree not higher than order
+	vector<array<size_t, 3>> exponents =
+	{
+		{{order, 0, 0}},
+		{{0, order / 2, order - order / 2}},
+		{{2, order - 4, 2}},
+		{{order - 1, 0, 0}}
+	};
+
+	for (auto& k : exponents)
+	{
+		double val = std_cube.Integrate ([&k] (const Point<3>& p)
+		{
+			return pow (p[0], k[0]) * pow (p[1], k[1]) * pow (p[2], k[2]);
+		});
+		double solex = moment (k[0]) * moment (k[1]) * moment (k[2]);
+
+		EXPECT_NEAR (val, solex, 1E-13) << "Integrating x^" << k[0]
+										<< " y^" << k[1]
+										<< " z^" << k[2]
+										<< " on the standard cube";
+	}
+
+	//the sparse grid is built explicitly, whatever grid is configured
+	SandiaQuadrature::SandiaQuadratureRule<3> sparse (order, SandiaQuadrature::SparseNodes);
+	EXPECT_FALSE (sparse.IsTensorial());
+
+	auto points = sparse.GetPoints();
+	auto weights = sparse.GetWeights();
+	ASSERT_EQ (points.Size(), weights.Size());
+	clog << "Sparse grid with " << points.Size() << " nodes" << endl;
+
+	for (auto& k : exponents)
+	{
+		double val = 0;
+		for (size_t q = 0; q < points.Size(); ++q)
+			val += weights[q] * pow (points[q][0], k[0]) * pow (points[q][1], k[1]) * pow (points[q][2], k[2]);
+		double solex = moment (k[0]) * moment (k[1]) * moment (k[2]);
+
+		EXPECT_NEAR (val, solex, 1E-13) << "Integrating x^" << k[0]
+										<< " y^" << k[1]
+										<< " z^" << k[2]
+										<< " on the sparse grid";
+	}
+
+	clog << "CubeIntegration ended" << endl << endl;
+}
+
+TEST_F (LoadTest, NestedQuadrature)
+{
+	clog << endl << "Starting NestedQuadrature" << endl;
+
+	//square (-1,1)^2, nested Kronrod-Patterson grids
+	SandiaQuadrature::SandiaQuadratureRule<2> rule (30, SandiaQuadrature::NestedNodes);
+	ASSERT_TRUE (rule.IsNested());
+	EXPECT_FALSE (rule.IsTensorial());
+
+	auto points = rule.GetPoints();
+	auto sizes = rule.LevelSizes();
+	auto orders = rule.LevelOrders();
+	ASSERT_EQ (sizes.size(), orders.size());
+	ASSERT_EQ (sizes.back(), points.Size());
+	EXPECT_GE (orders.back(), 30u);
+
+	//integral in (-1,1) of x^k
+	auto moment = [] (size_t k)
+	{
+		return k % 2 ? 0.0 : 2.0 / (k + 1);
+	};
+
+	for (size_t l = 0; l < sizes.size(); ++l)
+	{
+		if (l)
+			EXPECT_LT (sizes[l - 1], sizes[l]) << "Level " << l << " adds no nodes";
+
+		auto weights = rule.LevelWeights (l);
+		ASSERT_EQ (weights.Size(), sizes[l]);
+
+		//each level is exact until its order in each variable, on its first nodes only
+		size_t k = orders[l];
+		vector<array<size_t, 2>> exponents = {{{0, 0}}, {{k, 0}}, {{k, k}}, {{k - 1, k / 2}}};
+		for (auto& e : exponents)
+		{
+			double val = 0;
+			for (size_t q = 0; q < sizes[l]; ++q)
+				val += weights[q] * pow (points[q][0], e[0]) * pow (points[q][1], e[1]);
+
+			EXPECT_NEAR (val, moment (e[0]) * moment (e[1]), 1E-13)
+					<< "Integrating x^" << e[0]
+					<< " y^" << e[1]
+					<< " with level " << l;
+		}
+	}
+
+	clog << "NestedQuadrature ended" << endl << endl;
+}
+
+TEST_F (LoadTest, TriangleIntegration)
+{
+	clog << endl << "Starting TriangleIntegration" << endl;
+
+	//triangle co{(-1,-1),(1,-1),(-1,1)}
+	StdElement<2, TriangleType> std_triangle;
+	size_t order = std_triangle.QuadratureOrder();
+
+	//integral in (-1,1) of y^k
+	auto moment = [] (size_t k)
+	{
+		return k % 2 ? 0.0 : 2.0 / (k + 1);
+	};
+
+	clog << "I compute the area of the standard triangle" << endl;
+	double area = std_triangle.Integrate ([] (const Point<2>&) {return 1.0;});
+	EXPECT_NEAR (area, 2, 1E-13) << "Wrong area of the standard triangle";
+
+	/*
+		In the triangle x goes from -1 to -y, so
+			integral of y^k 	= integral in (-1,1) of y^k (1 - y)
+			integral of x y^k 	= integral in (-1,1) of y^k (y^2 - 1) / 2
+	*/
+	clog << "I compute the integral of y^" << order
+		 << ", the highest power exactly integrated" << endl;
+	double val = std_triangle.Integrate ([&order]							//*NOPAD*
+										 (const Point<2>& p)				//*NOPAD*
+										 {return pow (p[1], order);});		//*NOPAD*
+	double solex = moment (order) - moment (order + 1);
+	EXPECT_NEAR (val, solex, 1E-13) << "Integrating y^" << order
+									<< " on the standard triangle";
+
+	--order;
+	clog << "I compute the integral of x y^" << order << endl;
+	val = std_triangle.Integrate ([&order]									//*NOPAD*
+								  (const Point<2>& p)						//*NOPAD*
+								  {return p[0] * pow (p[1], order);});		//*NOPAD*
+	solex = (moment (order + 2) - moment (order)) / 2;
+	EXPECT_NEAR (val, solex, 1E-13) << "Integrating x y^" << order
+									<< " on the standard triangle";
+
+	//the sandia rule is not the registered one, see PluginPriority
+	order = std_triangle.QuadratureOrder();
+	clog << "I compute the integral of y^" << order << " with the sandia rule" << endl;
+	SandiaQuadrature::SandiaTriangleRule sandia_rule (order);
+	auto points = sandia_rule.GetPoints();
+	auto weights = sandia_rule.GetWeights();
+	val = 0;
+	for (size_t i = 0; i < weights.Size(); ++i)
+		val += weights[i] * pow (points[i][1], order);
+	solex = moment (order) - moment (order + 1);
+	EXPECT_NEAR (val, solex, 1E-13) << "Integrating y^" << order
+									<< " with the sandia triangle rule";
+
+	clog << "TriangleIntegration ended" << endl << endl;
+}
+
 TEST_F (LoadTest, IntervalLegendreOrthonormality)
 {
 	clog << endl << "Starting IntervalLegendreOrthonormality" << endl;
@@ -404,6 +611,195 @@ TEST_F (LoadTest, SquareLegendreOrthonormality)
 	clog << "SquareLegendreOrthonormality ended" << endl << endl;
 }
 
+TEST_F (LoadTest, SumFactorization)
+{
+	clog << endl << "Starting SumFactorization" << endl;
+
+	StdFIperCube<2, LegendreType> std_square;
+	ASSERT_TRUE (std_square.SumFactorizable())
+		<< "Sum factorization not selected on the standard square";
+
+	using Interface = StdFElementInterface<2, LegendreType>;
+
+	auto points = std_square.GetQuadPoints();
+	Vector values (points.Size());
+	for (size_t q = 0; q < points.Size(); ++q)
+		values[q] = exp (points[q][0]) * sin (3 * points[q][1] + 1);
+
+	size_t degree = std_square.QuadratureOrder() / 2;
+	size_t size = std_square.BasisSize (degree);
+
+	clog << "Comparing sum factorized L2 products with the generic ones" << endl;
+	//the qualified call bypasses the virtual dispatch
+	auto generic_prods = std_square.Interface::BasisL2Prods (values.View(), 0, size);
+	auto prods = std_square.BasisL2Prods (values.View(), 0, size);
+	ASSERT_EQ (prods.Size(), size);
+	for (size_t i = 0; i < size; ++i)
+		EXPECT_NEAR (prods[i], generic_prods[i], 1E-12)
+				<< "L2 product with Legendre function #" << i << " differs";
+
+	//a range not starting from zero, as requested when the p level is raised
+	auto tail_prods = std_square.BasisL2Prods (values.View(), 3, size);
+	for (size_t i = 3; i < size; ++i)
+		EXPECT_NEAR (tail_prods[i - 3], generic_prods[i], 1E-12)
+				<< "L2 product with Legendre function #" << i << " differs";
+
+	clog << "Comparing sum factorized basis combination with the generic one" << endl;
+	auto generic_combination = std_square.Interface::CombineBasis (prods.View());
+	auto combination = std_square.CombineBasis (prods.View());
+	ASSERT_EQ (combination.Size(), points.Size());
+	for (size_t q = 0; q < points.Size(); ++q)
+		EXPECT_NEAR (combination[q], generic_combination[q], 1E-12)
+				<< "Basis combination differs at quadrature point #" << q;
+
+	clog << "SumFactorization ended" << endl << endl;
+}
+
+TEST_F (LoadTest, SeparableProjection)
+{
+	clog << endl << "Starting SeparableProjection" << endl;
+
+	StdFIperCube<2, LegendreType> std_square;
+	ASSERT_TRUE (std_square.SumFactorizable())
+		<< "Sum factorization not selected on the standard square";
+
+	//f(x, y) = exp(x) * sin(3y + 1), the two factors are different
+	auto factor = [] (size_t d, double x)
+	{
+		return d ? sin (3 * x + 1) : exp (x);
+	};
+
+	auto one_d_points = std_square.OneDQuadPointsView();
+	size_t n = one_d_points.Size();
+	vector<double> factors (2 * n);
+	for (size_t d = 0; d < 2; ++d)
+		for (size_t i = 0; i < n; ++i)
+			factors[d * n + i] = factor (d, one_d_points[i][0]);
+
+	auto points = std_square.GetQuadPoints();
+	auto weights = std_square.GetQuadWeights();
+	Vector values (points.Size());
+	for (size_t q = 0; q < points.Size(); ++q)
+		values[q] = factor (0, points[q][0]) * factor (1, points[q][1]);
+
+	size_t size = std_square.BasisSize (10);
+
+	clog << "Comparing the separable projection with the generic one" << endl;
+	ColumnVector coeff (0);
+	double err_squared = std_square.SeparableProjection (factors, size, coeff);
+	ASSERT_EQ (coeff.Size(), size);
+
+	auto prods = std_square.BasisL2Prods (values.View(), 0, size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		prods[i] /= std_square.BasisNormSquared (i);
+		EXPECT_NEAR (coeff[i], prods[i], 1E-12)
+				<< "Projection coefficient #" << i << " differs";
+	}
+
+	auto projection = std_square.CombineBasis (prods.View());
+	double generic_err_squared = 0;
+	for (size_t q = 0; q < points.Size(); ++q)
+		generic_err_squared += weights[q] * pow (values[q] - projection[q], 2);
+
+	EXPECT_NEAR (err_squared, generic_err_squared, 1E-12)
+			<< "Squared projection error differs";
+
+	/*	At a higher degree the error is far smaller than ||f||^2,
+		so it has to be computed without subtracting the two norms */
+	clog << "Comparing the errors of an almost exact projection" << endl;
+	double f_norm_squared = 0;
+	for (size_t q = 0; q < points.Size(); ++q)
+		f_norm_squared += weights[q] * values[q] * values[q];
+
+	size = std_square.BasisSize (12);
+	err_squared = std_square.SeparableProjection (factors, size, coeff);
+
+	prods = std_square.BasisL2Prods (values.View(), 0, size);
+	for (size_t i = 0; i < size; ++i)
+		prods[i] /= std_square.BasisNormSquared (i);
+
+	projection = std_square.CombineBasis (prods.View());
+	generic_err_squared = 0;
+	for (size_t q = 0; q < points.Size(); ++q)
+		generic_err_squared += weights[q] * pow (values[q] - projection[q], 2);
+
+	clog << "Squared error: " << err_squared << ", squared norm of f: " << f_norm_squared << endl;
+	ASSERT_LT (generic_err_squared, 1E-12 * f_norm_squared);
+	EXPECT_NEAR (err_squared, generic_err_squared, 1E-6 * generic_err_squared)
+			<< "Squared projection error lost its relative accuracy";
+
+	clog << "SeparableProjection ended" << endl << endl;
+}
+
+TEST_F (LoadTest, SharedStdFElement)
+{
+	clog << endl << "Starting SharedStdFElement" << endl;
+
+	StdFIperCube<2, LegendreType> std_square;
+	StdFElement<2, TriangleType, WarpedType> std_triangle;
+
+	size_t degree = 6;
+	std_square.Prepare (degree);
+	std_triangle.Prepare (degree);
+	ASSERT_TRUE (std_square.Shared());
+	ASSERT_TRUE (std_triangle.Shared());
+
+	auto points = std_square.GetQuadPoints();
+	Vector values (points.Size());
+	for (size_t q = 0; q < points.Size(); ++q)
+		values[q] = exp (points[q][0]) * sin (3 * points[q][1] + 1);
+
+	size_t size = std_square.BasisSize (degree);
+	auto reference = std_square.BasisL2Prods (values.View(), 0, size);
+
+	clog << "Reading the prepared tables from several threads" << endl;
+	vector<ColumnVector> prods (4, ColumnVector (0));
+	vector<double> norms (prods.size(), 0);
+	vector<thread> threads;
+	for (size_t t = 0; t < prods.size(); ++t)
+		threads.emplace_back ([&, t] ()
+		{
+			for (size_t i = 0; i < 20; ++i)
+				prods[t] = std_square.BasisL2Prods (values.View(), 0, size);
+			norms[t] = std_triangle.BasisNormSquared (std_triangle.BasisSize (degree) - 1);
+		});
+	for (auto& t : threads)
+		t.join();
+
+	for (size_t t = 0; t < prods.size(); ++t)
+	{
+		ASSERT_EQ (prods[t].Size(), size);
+		for (size_t i = 0; i < size; ++i)
+			EXPECT_EQ (prods[t][i], reference[i]) << "L2 product #" << i << " read by thread #" << t << " differs";
+		EXPECT_EQ (norms[t], norms[0]);
+	}
+
+	clog << "Requesting a degree higher than the prepared one" << endl;
+	EXPECT_THROW (std_square.BasisSize (degree + 1), logic_error);
+	EXPECT_THROW (std_square.BasisAtQuadPoints (size), logic_error);
+	EXPECT_THROW (std_square.BasisNormSquared (size), logic_error);
+	EXPECT_THROW (std_square.EvaluateBasis (degree + 1, points[0]), logic_error);
+	EXPECT_THROW (std_square.BasisL2Prods (values.View(), 0, size + 1), logic_error);
+	EXPECT_THROW (std_triangle.EvaluateBasisFunction (std_triangle.BasisSize (degree), Point<2>()),
+				  logic_error);
+	EXPECT_THROW (std_triangle.Prepare (degree + 1), logic_error);
+	EXPECT_NO_THROW (std_triangle.Prepare (degree - 1));
+
+	clog << "Growing the tables again after the release" << endl;
+	std_square.Release();
+	std_triangle.Release();
+	EXPECT_FALSE (std_square.Shared());
+	size = std_square.BasisSize (degree + 1);
+	auto grown = std_square.BasisL2Prods (values.View(), 0, size);
+	ASSERT_EQ (grown.Size(), size);
+	for (size_t i = 0; i < reference.Size(); ++i)
+		EXPECT_EQ (grown[i], reference[i]) << "L2 product #" << i << " changed by the growth";
+	EXPECT_NO_THROW (std_triangle.EvaluateBasis (degree + 1, Point<2>()));
+
+	clog << "SharedStdFElement ended" << endl << endl;
+}
+
 TEST_F (LoadTest, WarpedOrthogonality)
 {
 	clog << endl << "WarpedOrthogonality" << endl;
@@ -444,3 +840,270 @@ TEST_F (LoadTest, WarpedOrthogonality)
 	clog << "WarpedOrthogonality ended" << endl << endl;
 }
 
+
+TEST_F (LoadTest, CompiledFunctorBenchmark)
+{
+	clog << endl << "Starting CompiledFunctorBenchmark" << endl;
+
+	if (system ("c++ --version > /dev/null 2>&1") != 0)
+	{
+		clog << "No compiler available, CompiledFunctorBenchmark skipped" << endl;
+		return;
+	}
+
+	string expr = "exp(-x^2) * sin(3*y) + sqrt(x*y + 1) - (x > y ? x : y^2)";
+	Functions::ParserFunctor<2> interpreted (expr);
+	Functions::CompiledFunctor<2> compiled (expr);
+
+	size_t n = 1 << 18;
+	vector<double> coordinates (2 * n);
+	for (size_t q = 0; q < n; ++q)
+	{
+		coordinates[2 * q] = fmod (0.618034 * q, 1.0);
+		coordinates[2 * q + 1] = fmod (0.414214 * q, 1.0);
+	}
+
+	vector<double> interpreted_values (n), compiled_values (n), batch_values (n);
+
+	auto start = chrono::steady_clock::now();
+	for (size_t q = 0; q < n; ++q)
+		interpreted_values[q] = interpreted ({coordinates[2 * q], coordinates[2 * q + 1]});
+	auto interpreted_end = chrono::steady_clock::now();
+
+	for (size_t q = 0; q < n; ++q)
+		compiled_values[q] = compiled ({coordinates[2 * q], coordinates[2 * q + 1]});
+	auto compiled_end = chrono::steady_clock::now();
+
+	compiled.Evaluate (coordinates.data(), batch_values.data(), n);
+	auto batch_end = chrono::steady_clock::now();
+
+	for (size_t q = 0; q < n; ++q)
+	{
+		ASSERT_NEAR (compiled_values[q], interpreted_values[q], 1E-12)
+				<< "Compiled and interpreted evaluators differ at point #" << q;
+		ASSERT_DOUBLE_EQ (batch_values[q], compiled_values[q])
+				<< "Batch and scalar compiled evaluators differ at point #" << q;
+	}
+
+	chrono::duration<double> interpreted_time = interpreted_end - start;
+	chrono::duration<double> compiled_time = compiled_end - interpreted_end;
+	chrono::duration<double> batch_time = batch_end - compiled_end;
+
+	clog << "Evaluation of " << expr << " at " << n << " points:" << endl
+		 << "	muParser:         " << interpreted_time.count() << " s" << endl
+		 << "	compiled scalar:  " << compiled_time.count() << " s" << endl
+		 << "	compiled batch:   " << batch_time.count() << " s" << endl
+		 << "	speedup:          " << interpreted_time.count() / batch_time.count() << endl;
+
+	clog << "CompiledFunctorBenchmark ended" << endl << endl;
+}
+
+TEST_F (LoadTest, CompiledFunctorSeparable)
+{
+	clog << endl << "Starting CompiledFunctorSeparable" << endl;
+
+	if (system ("c++ --version > /dev/null 2>&1") != 0)
+	{
+		clog << "No compiler available, CompiledFunctorSeparable skipped" << endl;
+		return;
+	}
+
+	Functions::CompiledFunctor<2> separable ("sqrt(x)*sqrt(y)");
+	auto as_separable = dynamic_cast<const BinaryTree::SeparableFunctor<2>*> (&separable);
+	ASSERT_NE (as_separable, nullptr);
+	EXPECT_TRUE (as_separable->IsSeparable());
+
+	for (double x : {0.25, 0.5, 0.75})
+		for (double y : {0.125, 0.625})
+			EXPECT_NEAR (separable.Factor (0, x) * separable.Factor (1, y), separable ({x, y}), 1E-14);
+
+	Functions::CompiledFunctor<2> not_separable ("sqrt(x*y + 1)");
+	EXPECT_FALSE (not_separable.IsSeparable());
+
+	clog << "CompiledFunctorSeparable ended" << endl << endl;
+}
+
+TEST_F (LoadTest, JitCachePermissions)
+{
+	clog << endl << "Starting JitCachePermissions" << endl;
+
+	char dir_name[] = "/tmp/binary_adapt_test.XXXXXX";
+	ASSERT_NE (mkdtemp (dir_name), nullptr);
+	string dir = dir_name;
+
+	Functions::JitCompiler compiler ("c++", "-O3", dir);
+	string source = Functions::JitSource ("p[0]", 1, "x");
+	string so_file = dir + "/" + compiler.Hash (source) + ".so";
+
+	//a directory writable by the others is refused
+	chmod (dir.c_str(), 0777);
+	EXPECT_THROW (compiler.SharedObject (source), runtime_error);
+
+	//a cached shared object writable by the others is refused, without compiling it again
+	chmod (dir.c_str(), 0700);
+	ofstream (so_file) << "not a shared object";
+	chmod (so_file.c_str(), 0666);
+	EXPECT_THROW (compiler.SharedObject (source), runtime_error);
+
+	//a private one is loaded as it is
+	chmod (so_file.c_str(), 0700);
+	EXPECT_EQ (compiler.SharedObject (source), so_file);
+
+	remove (so_file.c_str());
+	remove (dir.c_str());
+
+	clog << "JitCachePermissions ended" << endl << endl;
+}
+
+TEST_F (LoadTest, GridFunctorInterpolation)
+{
+	clog << endl << "Starting GridFunctorInterpolation" << endl;
+
+	Functions::GridLayout layout;
+	layout.n = {33, 65};
+	layout.lower = {0, -1};
+	layout.upper = {1, 1};
+
+	//bilinear function: both interpolations are exact
+	auto f = [] (double x, double y)
+	{
+		return x * y + 2 * x - y + 0.5;
+	};
+
+	vector<double> values;
+	for (size_t j = 0; j < layout.n[1]; ++j)
+		for (size_t i = 0; i < layout.n[0]; ++i)
+			values.push_back (f (i / 32.0, -1 + j / 32.0));
+
+	string double_file = "./grid_double.bin";
+	string float_file = "./grid_float.bin";
+	layout.value_bytes = 8;
+	Functions::WriteGridFile (double_file, layout, values);
+	layout.value_bytes = 4;
+	Functions::WriteGridFile (float_file, layout, values);
+
+	Functions::GridFunctor<2> linear (double_file);
+	Functions::GridFunctor<2> cubic (double_file, Functions::CubicInterpolation);
+	Functions::GridFunctor<2> single (float_file);
+
+	vector<double> points;
+	for (size_t q = 0; q < 100; ++q)
+	{
+		points.push_back (fmod (0.618034 * q, 1.0));
+		points.push_back (-1 + 2 * fmod (0.414214 * q, 1.0));
+	}
+
+	vector<double> batch (100);
+	cubic.Evaluate (points.data(), batch.data(), 100);
+
+	for (size_t q = 0; q < 100; ++q)
+	{
+		double x = points[2 * q], y = points[2 * q + 1];
+		double expected = f (x, y);
+		EXPECT_NEAR (linear ({x, y}), expected, 1E-12) << "Linear interpolation not exact";
+		EXPECT_NEAR (cubic ({x, y}), expected, 1E-12) << "Cubic interpolation not exact";
+		EXPECT_NEAR (batch[q], expected, 1E-12) << "Batched cubic interpolation not exact";
+		EXPECT_NEAR (single ({x, y}), expected, 1E-6) << "Single precision interpolation not exact";
+	}
+
+	clog << "Checking that the grid dimension is validated" << endl;
+	EXPECT_THROW (Functions::GridFunctor<1> wrong (double_file), runtime_error);
+
+	remove (double_file.c_str());
+	remove (float_file.c_str());
+
+	clog << "Comparing linear and cubic interpolation of a smooth 1D signal" << endl;
+	layout.n = {101};
+	layout.lower = {0};
+	layout.upper = {1};
+	layout.value_bytes = 8;
+	values.clear();
+	for (size_t i = 0; i < 101; ++i)
+		values.push_back (sin (5 * i / 100.0));
+
+	string signal_file = "./grid_signal.bin";
+	Functions::WriteGridFile (signal_file, layout, values);
+
+	Functions::GridFunctor<1> linear_signal (signal_file);
+	Functions::GridFunctor<1> cubic_signal (signal_file, Functions::CubicInterpolation);
+
+	double linear_err = 0, cubic_err = 0;
+	for (size_t q = 0; q < 1000; ++q)
+	{
+		double x = (q + 0.5) / 1000;
+		linear_err = max (linear_err, abs (linear_signal (x) - sin (5 * x)));
+		cubic_err = max (cubic_err, abs (cubic_signal (x) - sin (5 * x)));
+	}
+	clog << "Max error: linear " << linear_err << ", cubic " << cubic_err << endl;
+	EXPECT_LT (linear_err, 1E-3);
+	EXPECT_LT (cubic_err, linear_err);
+
+	remove (signal_file.c_str());
+
+	clog << "GridFunctorInterpolation ended" << endl << endl;
+}
+
+TEST_F (LoadTest, GridFunctorBenchmark)
+{
+	clog << endl << "Starting GridFunctorBenchmark" << endl;
+
+	StdFIperCube<2, LegendreType> std_square;
+	auto ref_points = std_square.GetQuadPoints();
+	auto ref_weights = std_square.GetQuadWeights();
+	size_t n_ref = ref_points.Size();
+
+	//the unit square is split in elements, each one integrated through a batched evaluation
+	size_t n_elem = 64;
+	double h = 1.0 / n_elem;
+	vector<double> points (2 * n_ref), values (n_ref);
+	double exact = (1 - cos (1.0)) * sin (1.0);
+
+	for (size_t n : {256, 1024, 2048})
+	{
+		Functions::GridLayout layout;
+		layout.n = {n, n};
+		layout.lower = {0, 0};
+		layout.upper = {1, 1};
+		layout.value_bytes = 8;
+
+		vector<double> samples (n * n);
+		for (size_t j = 0; j < n; ++j)
+			for (size_t i = 0; i < n; ++i)
+				samples[j * n + i] = sin (i / (n - 1.0)) * cos (j / (n - 1.0));
+
+		string file = "./grid_benchmark.bin";
+		Functions::WriteGridFile (file, layout, samples);
+		samples = vector<double>();
+
+		Functions::GridFunctor<2> f (file);
+
+		auto start = chrono::steady_clock::now();
+		double integral = 0;
+		for (size_t ex = 0; ex < n_elem; ++ex)
+			for (size_t ey = 0; ey < n_elem; ++ey)
+			{
+				for (size_t q = 0; q < n_ref; ++q)
+				{
+					//reference square is [-1, 1]^2
+					points[2 * q] = (ex + 0.5 * (ref_points[q][0] + 1)) * h;
+					points[2 * q + 1] = (ey + 0.5 * (ref_points[q][1] + 1)) * h;
+				}
+				f.Evaluate (points.data(), values.data(), n_ref);
+				for (size_t q = 0; q < n_ref; ++q)
+					integral += ref_weights[q] * values[q] * h * h / 4;
+			}
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+		size_t evaluations = n_elem * n_elem * n_ref;
+		clog << "Grid " << n << "x" << n
+			 << " (" << n * n * 8 / (1 << 20) << " MB): "
+			 << evaluations / elapsed.count() << " evaluations/s, "
+			 << "integral error " << abs (integral - exact) << endl;
+
+		EXPECT_NEAR (integral, exact, 1E-4) << "Integral of the grid data is wrong";
+
+		remove (file.c_str());
+	}
+
+	clog << "GridFunctorBenchmark ended" << endl << endl;
+}
@@ -2,6 +2,14 @@
 
 #include "LibMeshRefiner.h"
 #include "LibMeshBinaryElements.h"
+#include "BatchRefiner.h"
+#include "RefinementSession.h"
+#include "SnapshotPublisher.h"
+#include "PointEvaluator.h"
+#include "ApproximationArchive.h"
+#include "MultiResolution.h"
+#include "SnapshotStream.h"
+#include "VtuExporter.h"
 
 #include "libmesh/mesh_generation.h" //MeshTools
 
@@ -517,6 +525,71 @@ TEST_F (LibmeshTest, TriangleOrthogonality)
 	clog << "TriangleOrthogonality ended" << endl << endl;
 }
 
+TEST_F (LibmeshTest, ReferenceCoordinatesIntegration)
+{
+	clog << endl << "Starting ReferenceCoordinatesIntegration" << endl;
+	int nx = 2, ny = 2;
+	libMesh::Mesh mesh (_mesh_init_ptr->comm());
+
+	clog << "Building a 2D mesh with "
+		 << 2 * nx* ny
+		 << " triangular elements in (0,1)x(0,1)"
+		 << endl;
+
+	libMesh::MeshTools::Generation::build_square (mesh, nx, ny, 0., 1., 0., 1.,
+												  LibmeshTriangleType);
+
+	auto libmesh_ptr = * (mesh.elements_begin());
+
+	auto el = dynamic_cast<LibmeshBinary::LibmeshTriangleClass*> (libmesh_ptr);
+	ASSERT_NE (el, nullptr) << "Mesh element not recognized "
+							<< "casting to LibmeshBinary::LibmeshTriangleClass*";
+
+	unique_ptr<LibmeshBinary::LibmeshTriangleClass> smart_el (el);
+	LibmeshBinary::FElement<2, WarpedType, LibmeshBinary::LibmeshTriangleClass>
+	f_el (move (smart_el));
+
+	f_el.Init();
+
+	auto f = [] (const Point<2>& p) { return exp (p[0]) * sin (3 * p[1]);};
+
+	auto f_values = f_el.EvaluateAtQuadPoints (f);
+	auto points = f_el.GetQuadPoints();
+	ASSERT_EQ (f_values.Size(), points.Size()) << "Wrong number of function samples";
+
+	clog << "Comparing integrals computed in reference and physical coordinates" << endl;
+	double I_phys = f_el.Integrate (f);
+	double I_ref = f_el.IntegrateQuadValues (f_values.View());
+	EXPECT_NEAR (I_ref, I_phys, 1E-12) << "Integral in reference coordinates differs";
+
+	f_el.PLevel (4);
+	size_t basis_size = f_el.BasisSize();
+	Geometry::ColumnVector coeff (basis_size);
+	for (size_t i = 0; i < basis_size; ++i)
+	{
+		double prod_phys = f_el.L2Prod (f,
+										[&] (const Point<2>& p)
+										{ return f_el.EvaluateBasisFunction (i, p);});
+		double prod_ref = f_el.L2ProdWithBasisFunction (i, f_values.View());
+		EXPECT_NEAR (prod_ref, prod_phys, 1E-12) << "L2 product with basis function #"
+												 << i
+												 << " differs";
+		coeff[i] = prod_ref;
+	}
+
+	auto combination = f_el.CombineBasisAtQuadPoints (coeff.View());
+	for (size_t q = 0; q < points.Size(); ++q)
+	{
+		auto basis = f_el.EvaluateBasis (points[q]);
+		EXPECT_NEAR (combination[q], basis.Dot (coeff), 1E-12)
+				<< "Linear combination differs at quadrature point #" << q;
+	}
+
+	//to avoid segfault when libMesh::Mesh destructor is called
+	libmesh_ptr = f_el.ReleaseGeometry();
+	clog << "ReferenceCoordinatesIntegration ended" << endl << endl;
+}
+
 TEST_F (LibmeshTest, TriangleProjectionTest)
 {
 	clog << endl << "Starting TriangleProjectionTest" << endl;
@@ -957,6 +1030,1265 @@ TEST_F (LibmeshTest, BinaryRefinement)
 	clog << "BinaryRefinement ended" << endl << endl;
 }
 
+/**
+	Sum of the rebuilds of the nodes after their compaction, see BinaryNode::Rebuilds()
+**/
+class RebuildsCounter : public BinaryTree::NodeOperator
+{
+  public:
+	RebuildsCounter() : rebuilds (0) {};
+
+	virtual void operator() (BinaryTree::BinaryNode* node) override
+	{
+		rebuilds += node->Rebuilds();
+	};
+
+	size_t rebuilds;
+};
+
+TEST_F (LibmeshTest, CompactedRefinement)
+{
+	clog << endl << "Starting CompactedRefinement" << endl;
+
+	size_t n_iter (20);
+	vector<LibmeshBinary::LibmeshRefiner<1>> refiners (2);
+	vector<shared_ptr<libMesh::Mesh>> meshes;
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+		libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+													LibmeshIntervalType);
+		meshes.push_back (mesh_ptr);
+
+		refiners[i].Init ("sqrt_x");
+		refiners[i].CompactInactiveNodes (i == 1);
+		refiners[i].SetMesh (mesh_ptr);
+		refiners[i].Refine (n_iter, 0, [] () {});
+	}
+
+	auto& plain = refiners[0];
+	auto& compacted = refiners[1];
+
+	EXPECT_EQ (plain.ExtractPLevels(), compacted.ExtractPLevels())
+			<< "Compaction modified the refinement result";
+	EXPECT_DOUBLE_EQ (plain.GlobalError(), compacted.GlobalError())
+			<< "Compaction modified the projection error";
+
+	size_t nodes = plain.TreeNodesNumber();
+	EXPECT_EQ (nodes, compacted.TreeNodesNumber());
+
+	clog << "Resident bytes per node without compaction: "
+		 << plain.TreeResidentBytes() / nodes << endl
+		 << "Resident bytes per node with compaction: "
+		 << compacted.TreeResidentBytes() / nodes << endl;
+
+	EXPECT_LT (compacted.TreeResidentBytes(), plain.TreeResidentBytes());
+
+	//the memory is saved by computing again the coefficients of the compacted ancestors
+	RebuildsCounter plain_counter, compacted_counter;
+	plain.IterateTreeNodes (plain_counter);
+	compacted.IterateTreeNodes (compacted_counter);
+	clog << "Projections rebuilt after compaction in " << n_iter << " iterations: "
+		 << compacted_counter.rebuilds << endl;
+
+	EXPECT_EQ (plain_counter.rebuilds, 0u) << "Projections rebuilt without compaction";
+	EXPECT_GT (compacted_counter.rebuilds, 0u) << "Compacted ancestors not rebuilt by the climb";
+
+	clog << "CompactedRefinement ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, CompositeRefinement)
+{
+	clog << endl << "Starting CompositeRefinement" << endl;
+
+	size_t n_iter (20);
+	vector<LibmeshBinary::LibmeshRefiner<1>> refiners (2);
+	vector<shared_ptr<libMesh::Mesh>> meshes;
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+		libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+													LibmeshIntervalType);
+		meshes.push_back (mesh_ptr);
+
+		refiners[i].CompositeProjections (i == 1);
+		refiners[i].Init ("sqrt_x");
+		refiners[i].SetMesh (mesh_ptr);
+		refiners[i].Refine (n_iter, 0, [] () {});
+	}
+
+	auto& plain = refiners[0];
+	auto& composite = refiners[1];
+
+	/*	Composite rules are at least as accurate as the ancestor ones,
+		so errors can slightly differ, but not the refinement result */
+	EXPECT_EQ (plain.ExtractPLevels(), composite.ExtractPLevels())
+			<< "Composite projections modified the refinement result";
+	EXPECT_NEAR (plain.GlobalError(), composite.GlobalError(), 5E-2 * plain.GlobalError())
+			<< "Composite projections modified the projection error";
+
+	clog << "Global error with ancestors own quadrature rules: "
+		 << plain.GlobalError() << endl
+		 << "Global error with composite quadrature rules: "
+		 << composite.GlobalError() << endl;
+
+	clog << "CompositeRefinement ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, BatchedRefinement)
+{
+	clog << endl << "Starting BatchedRefinement" << endl;
+
+	/*	The function is evaluated by this process without and with batches,
+		then by a child process without and with batches:
+		only the child process answers the batches asynchronously */
+	size_t n_iter (20);
+	vector<LibmeshBinary::LibmeshRefiner<1>> refiners (4);
+	vector<shared_ptr<libMesh::Mesh>> meshes;
+
+	for (size_t i = 0; i < 4; ++i)
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+		libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+													LibmeshIntervalType);
+		meshes.push_back (mesh_ptr);
+
+		refiners[i].Init ("sqrt_x");
+		refiners[i].BatchEvaluations (i % 2 == 1);
+		if (i >= 2)
+			refiners[i].EvaluateInProcess();
+		refiners[i].SetMesh (mesh_ptr);
+		refiners[i].Refine (n_iter, 0, [] () {});
+	}
+
+	auto& plain = refiners[0];
+	for (size_t i = 1; i < 4; ++i)
+	{
+		EXPECT_EQ (plain.ExtractPLevels(), refiners[i].ExtractPLevels())
+				<< "Batched or remote evaluations modified the refinement result of refiner #" << i;
+		EXPECT_DOUBLE_EQ (plain.GlobalError(), refiners[i].GlobalError())
+				<< "Batched or remote evaluations modified the projection error of refiner #" << i;
+	}
+
+	using Process = BinaryTree::ProcessFunctor<1>;
+	auto& remote = dynamic_cast<const Process&> (refiners[2].GetFunctor());
+	auto& async = dynamic_cast<const Process&> (refiners[3].GetFunctor());
+	clog << "Requests to the child process without batches: " << remote.Requests()
+		 << ", with asynchronous batches: " << async.Requests() << endl;
+	EXPECT_LT (async.Requests(), remote.Requests())
+			<< "The batches have not been submitted as single requests";
+
+	clog << "BatchedRefinement ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, MultiObjectiveRefinement)
+{
+	clog << endl << "Starting MultiObjectiveRefinement" << endl;
+
+	size_t n_iter (20);
+	vector<LibmeshBinary::LibmeshRefiner<1>> refiners (4);
+	vector<shared_ptr<libMesh::Mesh>> meshes;
+
+	for (size_t i = 0; i < 4; ++i)
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+		libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+													LibmeshIntervalType);
+		meshes.push_back (mesh_ptr);
+
+		if (i == 0)
+			refiners[i].Init ("sqrt_x");
+		else if (i == 1)
+			refiners[i].Init (vector<string> {"sqrt_x"});
+		else if (i == 2)
+			refiners[i].Init (vector<string> {"sqrt_x", "x_squared"}, {1, 0.5});
+		else
+			refiners[i].Init ("x_squared");
+
+		refiners[i].SetMesh (mesh_ptr);
+		refiners[i].Refine (n_iter, 0, [] () {});
+	}
+
+	auto& plain = refiners[0];
+	auto& single = refiners[1];
+	auto& multi = refiners[2];
+	auto& second = refiners[3];
+
+	EXPECT_EQ (plain.ExtractPLevels(), single.ExtractPLevels())
+			<< "A set with one functor modified the refinement result";
+	EXPECT_DOUBLE_EQ (plain.GlobalError(), single.GlobalError())
+			<< "A set with one functor modified the projection error";
+	EXPECT_EQ (single.GlobalFieldErrors(), vector<double> {single.GlobalError()});
+
+	size_t dofs = 0;
+	for (auto p : multi.ExtractPLevels())
+		dofs += p + 1;
+	EXPECT_EQ (dofs, n_iter + 2) << "Wrong complexity of the multi objective refinement";
+
+	/*	With the same complexity, the refinement driven by sqrt_x only is the best one for it,
+		while x_squared is projected exactly by both trees as soon as p >= 2 */
+	auto field_errors = multi.GlobalFieldErrors();
+	ASSERT_EQ (field_errors.size(), 2u);
+	EXPECT_GE (field_errors[0], (1 - 1E-12) * plain.GlobalError())
+			<< "sqrt_x is better approximated sharing the tree with x_squared";
+	EXPECT_LT (field_errors[0], 2 * plain.GlobalError())
+			<< "x_squared took too many degrees of freedom from sqrt_x";
+	EXPECT_LT (second.GlobalError(), 1E-10);
+	EXPECT_LT (field_errors[1], 1E-10) << "x_squared not projected exactly";
+
+	EXPECT_THROW (multi.CacheSamples ("./multi.cache"), logic_error)
+			<< "Functors set hidden by the samples cache";
+
+	clog << "Global error with sqrt_x only: " << plain.GlobalError() << endl
+		 << "Global error with sqrt_x and x_squared: " << multi.GlobalError() << endl
+		 << "Errors of sqrt_x and x_squared on the shared tree: "
+		 << field_errors[0] << ", " << field_errors[1] << endl;
+
+	clog << "MultiObjectiveRefinement ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, BatchRefinement)
+{
+	clog << endl << "Starting BatchRefinement" << endl;
+
+	size_t n_iter (20);
+	vector<string> functors = {"sqrt_x", "x_squared", "sqrt_x", "x_squared", "sqrt_x"};
+
+	auto& comm (_mesh_init_ptr->comm());
+	BinaryTree::BatchRefiner<1>::RefinerBuilder builder =
+		[&comm] (unique_ptr<BinaryTree::Functor<1>> f)
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (comm);
+		libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+													LibmeshIntervalType);
+
+		auto refiner = Helpers::MakeUnique<LibmeshBinary::LibmeshRefiner<1>> ();
+		refiner->Init (move (f));
+		refiner->SetMesh (mesh_ptr);
+		return unique_ptr<BinaryTree::MeshRefiner<1>> (move (refiner));
+	};
+
+	/*	The sink keeps the results in job order */
+	struct JobsSink : public BinaryTree::ResultSink<1>
+	{
+		vector<BinaryTree::JobResult<1>> results;
+
+		virtual void Write (const BinaryTree::JobResult<1>& r) override
+		{
+			if (results.size() <= r.job)
+				results.resize (r.job + 1);
+			results[r.job] = r;
+		};
+	};
+
+	BinaryTree::BatchRefiner<1> service (builder, 2);
+	for (auto& id : functors)
+		service.Add (id);
+	EXPECT_EQ (service.Jobs(), functors.size()) << "Wrong number of jobs";
+
+	JobsSink sink;
+	auto statistics = service.Run (n_iter, 0, sink);
+
+	EXPECT_EQ (statistics.jobs, functors.size()) << "Wrong number of jobs run";
+	EXPECT_EQ (statistics.failed, 0u) << "Some jobs failed";
+	EXPECT_EQ (service.Jobs(), 0u) << "Jobs not removed after the run";
+	ASSERT_EQ (sink.results.size(), functors.size()) << "Missing results";
+
+	for (size_t i = 0; i < functors.size(); ++i)
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (comm);
+		libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+													LibmeshIntervalType);
+		LibmeshBinary::LibmeshRefiner<1> serial;
+		serial.Init (functors[i]);
+		serial.SetMesh (mesh_ptr);
+		serial.Refine (n_iter, 0, [] () {});
+
+		auto& result = sink.results[i];
+		EXPECT_TRUE (result.succeeded) << result.failure;
+		EXPECT_EQ (result.name, functors[i]) << "Wrong job name";
+		EXPECT_EQ (result.p_levels, serial.ExtractPLevels())
+				<< "Concurrent jobs modified the refinement result";
+		EXPECT_DOUBLE_EQ (result.error, serial.GlobalError())
+				<< "Concurrent jobs modified the projection error";
+		EXPECT_EQ (result.vertices.size(), result.p_levels.size())
+				<< "Vertices and p levels of different elements";
+	}
+
+	clog << statistics.JobsPerSecond() << " jobs per second" << endl;
+
+	clog << "BatchRefinement ended" << endl << endl;
+}
+
+/*	Square root of x + y shifted by a constant, singular near the origin */
+class ShiftedRootFunctor : public BinaryTree::Functor<2>
+{
+  public:
+	ShiftedRootFunctor (double s) : shift (s) {};
+
+	virtual double operator() (const Point<2>& p) const override
+	{
+		return sqrt (p[0] + p[1] + shift);
+	};
+	virtual string Formula() const override
+	{
+		return "sqrt(x+y+" + to_string (shift) + ")";
+	};
+	virtual string ID() const override
+	{
+		return "shifted_root";
+	};
+
+	double shift;
+};
+
+TEST_F (LibmeshTest, BatchRefinement2D)
+{
+	clog << endl << "Starting BatchRefinement2D" << endl;
+
+	size_t n_iter (30);
+	vector<double> shifts = {1E-3, 1E-2, 1E-1, 1E-3};
+
+	auto& comm (_mesh_init_ptr->comm());
+	auto build_mesh = [&comm] ()
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (comm);
+		libMesh::MeshTools::Generation::build_square (*mesh_ptr, 1, 1, 0., 1., 0., 1.,
+													  LibmeshTriangleType);
+		return mesh_ptr;
+	};
+
+	BinaryTree::BatchRefiner<2>::RefinerBuilder builder =
+		[&build_mesh] (unique_ptr<BinaryTree::Functor<2>> f)
+	{
+		auto refiner = Helpers::MakeUnique<LibmeshBinary::LibmeshRefiner<2>> ();
+		refiner->Init (move (f));
+		refiner->SetMesh (build_mesh());
+		return unique_ptr<BinaryTree::MeshRefiner<2>> (move (refiner));
+	};
+
+	struct JobsSink : public BinaryTree::ResultSink<2>
+	{
+		vector<BinaryTree::JobResult<2>> results;
+
+		virtual void Write (const BinaryTree::JobResult<2>& r) override
+		{
+			if (results.size() <= r.job)
+				results.resize (r.job + 1);
+			results[r.job] = r;
+		};
+	};
+
+	BinaryTree::BatchRefiner<2> service (builder, 3);
+	for (auto s : shifts)
+		service.Add ("shifted_root", unique_ptr<BinaryTree::Functor<2>> (new ShiftedRootFunctor (s)));
+	service.Add ("x_squared_plus_y_squared");
+
+	JobsSink sink;
+	auto statistics = service.Run (n_iter, 0, sink);
+
+	EXPECT_EQ (statistics.failed, 0u) << "Some jobs failed";
+	ASSERT_EQ (sink.results.size(), shifts.size() + 1) << "Missing results";
+
+	/*	The basis tables are filled before the jobs until the degree they can reach */
+	size_t max_p_level = 0;
+	for (auto& result : sink.results)
+		for (auto p : result.p_levels)
+			max_p_level = max (max_p_level, p);
+	EXPECT_EQ (service.PreparedDegree(), n_iter) << "Basis tables not filled until the reachable degree";
+	EXPECT_GE (service.PreparedDegree(), max_p_level) << "Basis tables not filled until the degree of the jobs";
+
+	for (size_t i = 0; i < shifts.size(); ++i)
+	{
+		LibmeshBinary::LibmeshRefiner<2> serial;
+		serial.Init (unique_ptr<BinaryTree::Functor<2>> (new ShiftedRootFunctor (shifts[i])));
+		serial.SetMesh (build_mesh());
+		serial.Refine (n_iter, 0, [] () {});
+
+		auto& result = sink.results[i];
+		EXPECT_TRUE (result.succeeded) << result.failure;
+		EXPECT_EQ (result.p_levels, serial.ExtractPLevels())
+				<< "Concurrent jobs modified the refinement result";
+		EXPECT_EQ (result.error, serial.GlobalError())
+				<< "Concurrent jobs modified the projection error";
+		EXPECT_EQ (result.vertices.size(), result.p_levels.size())
+				<< "Vertices and p levels of different elements";
+	}
+
+	auto& polynomial = sink.results.back();
+	EXPECT_TRUE (polynomial.succeeded) << polynomial.failure;
+	EXPECT_LT (polynomial.error, 1E-12) << "Polynomial of degree 2 not projected exactly";
+
+	clog << statistics.JobsPerSecond() << " jobs per second, basis tables filled until degree "
+		 << service.PreparedDegree() << endl;
+
+	clog << "BatchRefinement2D ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, ObjectiveSwap)
+{
+	clog << endl << "Starting ObjectiveSwap" << endl;
+
+	size_t n_iter (20);
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+	refiner.Refine (n_iter, 0, [] () {});
+
+	auto p_levels = refiner.ExtractPLevels();
+	double error = refiner.GlobalError();
+	size_t nodes = refiner.TreeNodesNumber();
+
+	refiner.SwapObjective ("sqrt_x", 2);
+
+	EXPECT_EQ (refiner.ExtractPLevels(), p_levels)
+			<< "Swapping the same objective modified the refinement result";
+	EXPECT_DOUBLE_EQ (refiner.GlobalError(), error)
+			<< "Swapping the same objective modified the projection error";
+	EXPECT_EQ (refiner.TreeNodesNumber(), nodes) << "Swapping the objective modified the tree";
+
+	refiner.SwapObjective ("x_squared", 2);
+	refiner.Refine (n_iter, 0, [] () {});
+
+	size_t dofs = 0;
+	for (auto p : refiner.ExtractPLevels())
+		dofs += p + 1;
+	EXPECT_EQ (dofs, 2 * n_iter + 2) << "Refinement not continued from the current tree";
+	EXPECT_NEAR (refiner.GlobalError(), 0, 1E-10) << "Wrong projection error after the swap";
+
+	clog << "ObjectiveSwap ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, ObjectiveSwapAsFreshRefinement)
+{
+	clog << endl << "Starting ObjectiveSwapAsFreshRefinement" << endl;
+
+	size_t n_iter (20);
+	vector<LibmeshBinary::LibmeshRefiner<1>> refiners (2);
+	vector<shared_ptr<libMesh::Mesh>> meshes;
+	for (auto& refiner : refiners)
+	{
+		meshes.push_back (make_shared<libMesh::Mesh> (_mesh_init_ptr->comm()));
+		libMesh::MeshTools::Generation::build_line (*meshes.back(), 2, 0, 1,
+													LibmeshIntervalType);
+		refiner.Init ("sqrt_x");
+		refiner.SetMesh (meshes.back());
+		refiner.Refine (n_iter, 0, [] () {});
+	}
+	auto& fresh = refiners[0];
+	auto& swapped = refiners[1];
+
+	//the parameters computed for another function are replaced
+	swapped.SwapObjective ("x_squared", 2);
+	swapped.GlobalError();
+	swapped.SwapObjective ("sqrt_x", 2);
+
+	EXPECT_DOUBLE_EQ (swapped.GlobalError(), fresh.GlobalError())
+			<< "Swapped refiner and fresh refinement have different projection errors";
+	EXPECT_EQ (swapped.ExtractPLevels(), fresh.ExtractPLevels())
+			<< "Swapped refiner and fresh refinement have different active elements";
+
+	//E~, q and s choose the next bisections
+	for (auto& refiner : refiners)
+		refiner.Refine (n_iter, 0, [] () {});
+
+	EXPECT_DOUBLE_EQ (swapped.GlobalError(), fresh.GlobalError())
+			<< "Refinement continued after the swap differs from the fresh one";
+	EXPECT_EQ (swapped.ExtractPLevels(), fresh.ExtractPLevels())
+			<< "Refinement continued after the swap differs from the fresh one";
+
+	clog << "ObjectiveSwapAsFreshRefinement ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, RefinementSessionTest)
+{
+	clog << endl << "Starting RefinementSessionTest" << endl;
+
+	size_t n_iter (20);
+	vector<LibmeshBinary::LibmeshRefiner<1>> refiners (3);
+	vector<shared_ptr<libMesh::Mesh>> meshes;
+
+	for (size_t i = 0; i < 3; ++i)
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+		libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+													LibmeshIntervalType);
+		meshes.push_back (mesh_ptr);
+
+		refiners[i].Init ("sqrt_x");
+		refiners[i].SetMesh (mesh_ptr);
+	}
+
+	auto& plain = refiners[0];
+	plain.Refine (n_iter, 0, [] () {});
+
+	BinaryTree::RefinementSession<1> session (refiners[1], n_iter, 0);
+	EXPECT_EQ (session.Step (3), 3u) << "Wrong number of iterations";
+	EXPECT_EQ (session.RunFor (chrono::seconds (0)), 0u) << "Iterations beyond the time budget";
+
+	while (!session.Done())
+		session.Step (4);
+
+	EXPECT_EQ (session.State(), BinaryTree::Exhausted) << "Wrong state of the session";
+	EXPECT_EQ (session.Iterations(), n_iter) << "Wrong number of iterations";
+	EXPECT_EQ (session.Step(), 0u) << "Iteration after the end of the session";
+	EXPECT_EQ (refiners[1].ExtractPLevels(), plain.ExtractPLevels())
+			<< "The session modified the refinement result";
+	EXPECT_DOUBLE_EQ (session.Error(), plain.GlobalError())
+			<< "The session modified the projection error";
+	EXPECT_EQ (session.ActiveNodes(), plain.ActiveNodesNumber())
+			<< "Wrong number of active elements";
+
+	BinaryTree::RefinementSession<1> cancelled (refiners[2], n_iter, 0);
+	cancelled.Step();
+	cancelled.Cancel();
+	EXPECT_EQ (cancelled.State(), BinaryTree::Cancelled) << "Wrong state of the session";
+	EXPECT_EQ (cancelled.RunFor (chrono::seconds (10)), 0u) << "Iteration after the cancellation";
+	EXPECT_EQ (cancelled.Iterations(), 1u) << "Wrong number of iterations";
+
+	clog << "RefinementSessionTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, SnapshotTest)
+{
+	clog << endl << "Starting SnapshotTest" << endl;
+
+	size_t n_iter (20);
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+
+	BinaryTree::SnapshotPublisher<1> publisher;
+	EXPECT_EQ (publisher.Latest(), nullptr) << "Snapshot available before the first publication";
+
+	//the reader checks that each snapshot it gets is consistent
+	atomic<bool> stop (false);
+	atomic<size_t> inconsistent (0);
+	thread reader ([&] ()
+	{
+		while (!stop)
+		{
+			auto snapshot = publisher.Latest();
+			if (!snapshot)
+				continue;
+
+			size_t dofs = 0;
+			for (size_t i = 0; i < snapshot->Size(); ++i)
+				dofs += snapshot->PLevel (i) + 1;
+			//each iteration adds a degree of freedom to the 2 initial elements
+			if (dofs != 2 + snapshot->Iteration())
+				++inconsistent;
+		}
+	});
+
+	refiner.Refine (n_iter, 0, publisher.Every (refiner, 4));
+	auto last = publisher.Publish (refiner);
+
+	stop = true;
+	reader.join();
+
+	EXPECT_EQ (inconsistent.load(), 0u) << "Inconsistent snapshot read";
+	EXPECT_EQ (publisher.Version(), n_iter / 4 + 2) << "Wrong number of published snapshots";
+	EXPECT_EQ (publisher.Latest(), last) << "Latest snapshot not returned";
+	EXPECT_EQ (last->Iteration(), n_iter) << "Wrong iteration of the snapshot";
+	EXPECT_DOUBLE_EQ (last->Error(), refiner.GlobalError()) << "Wrong error of the snapshot";
+
+	vector<size_t> p_levels;
+	for (size_t i = 0; i < last->Size(); ++i)
+		p_levels.push_back (last->PLevel (i));
+	EXPECT_EQ (p_levels, refiner.ExtractPLevels()) << "Wrong p levels of the snapshot";
+
+	//the snapshot is kept while the refiner goes on
+	refiner.Refine (5, 0, [] () {});
+	for (double x = 0.05; x < 1; x += 0.1)
+		EXPECT_NEAR (last->Evaluate (Geometry::Point<1> (x)), sqrt (x), 1E-2)
+				<< "Wrong snapshot evaluation at " << x;
+
+	EXPECT_THROW (last->Evaluate (Geometry::Point<1> (2)), out_of_range)
+			<< "Evaluation outside the mesh";
+
+	clog << "SnapshotTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, SnapshotReclaimTest)
+{
+	clog << endl << "Starting SnapshotReclaimTest" << endl;
+
+	size_t n_iter (200), n_readers (4);
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+
+	BinaryTree::SnapshotPublisher<1> publisher;
+
+	//the readers always hold a snapshot, so there is never a time without readers
+	atomic<bool> stop (false);
+	atomic<size_t> reads (0);
+	vector<thread> readers;
+	for (size_t r = 0; r < n_readers; ++r)
+		readers.emplace_back ([&] ()
+		{
+			BinaryTree::SnapshotPublisher<1>::SnapshotPtr held;
+			while (!stop)
+			{
+				held = publisher.Latest();
+				if (held)
+					held->Evaluate (Geometry::Point<1> (0.5));
+				++reads;
+			}
+		});
+
+	/*	Each reader holds at most two snapshots, while replacing its one,
+		so the replaced snapshots have to be freed while the others are read */
+	vector<weak_ptr<const BinaryTree::ApproximationSnapshot<1>>> published;
+	size_t max_alive = 0;
+	refiner.Refine (n_iter, 0, publisher.Every (refiner, 1), [&] ()
+	{
+		published.push_back (publisher.Latest());
+		size_t alive = 0;
+		for (auto& snapshot : published)
+			if (!snapshot.expired())
+				++alive;
+		max_alive = max (max_alive, alive);
+	});
+
+	stop = true;
+	for (auto& t : readers)
+		t.join();
+
+	EXPECT_GT (reads.load(), 0u) << "No snapshot read";
+	EXPECT_EQ (published.size(), n_iter + 1) << "Wrong number of published snapshots";
+	EXPECT_LE (max_alive, 2 * n_readers + 1) << "Replaced snapshots not freed while being read";
+
+	size_t alive = 0;
+	for (auto& snapshot : published)
+		if (!snapshot.expired())
+			++alive;
+	EXPECT_EQ (alive, 1u) << "Replaced snapshots not freed after the readers are done";
+	EXPECT_EQ (published.back().lock(), publisher.Latest()) << "Latest snapshot freed";
+
+	clog << "SnapshotReclaimTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, SnapshotReadersProgress)
+{
+	clog << endl << "Starting SnapshotReadersProgress" << endl;
+
+	size_t n_iter (200), n_readers (4);
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 2, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+
+	BinaryTree::SnapshotPublisher<1> publisher;
+	publisher.Publish (refiner);
+
+	//each reader counts the reads done while the publisher is active, checking the versions do not go back
+	atomic<bool> publishing (false), stop (false);
+	atomic<size_t> started (0);
+	vector<size_t> reads (n_readers, 0);
+	vector<bool> ordered (n_readers, true);
+	vector<thread> readers;
+	for (size_t r = 0; r < n_readers; ++r)
+		readers.emplace_back ([&, r] ()
+		{
+			size_t version = 0;
+			++started;
+			while (!stop)
+			{
+				auto snapshot = publisher.Latest();
+				if (snapshot->Version() < version)
+					ordered[r] = false;
+				version = snapshot->Version();
+				if (publishing)
+					++reads[r];
+			}
+		});
+
+	while (started != n_readers)
+		this_thread::yield();
+
+	publishing = true;
+	refiner.Refine (n_iter, 0, publisher.Every (refiner, 1));
+	for (size_t i = 0; i < n_iter; ++i)
+		publisher.Publish (refiner);
+	publishing = false;
+
+	stop = true;
+	for (auto& t : readers)
+		t.join();
+
+	for (size_t r = 0; r < n_readers; ++r)
+	{
+		EXPECT_GT (reads[r], 0u) << "Reader " << r << " blocked while the publisher is active";
+		EXPECT_TRUE (ordered[r]) << "Reader " << r << " read an older snapshot after a newer one";
+	}
+	EXPECT_EQ (publisher.Latest()->Version(), 2 * n_iter + 2) << "Wrong version of the latest snapshot";
+
+	clog << "SnapshotReadersProgress ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, PointEvaluatorTest)
+{
+	clog << endl << "Starting PointEvaluatorTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+	refiner.Refine (30);
+
+	BinaryTree::PointEvaluator<1> evaluator (refiner, 2);
+	const auto& snapshot = evaluator.Snapshot();
+
+	size_t n_points (10000);
+	vector<double> points (n_points), values (n_points);
+	for (size_t i = 0; i < n_points; ++i)
+		points[i] = (i + 0.5) / n_points;
+
+	evaluator.Evaluate (points.data(), values.data(), n_points);
+	for (size_t i = 0; i < n_points; i += 37)
+	{
+		Geometry::Point<1> p (points[i]);
+		EXPECT_NEAR (values[i], snapshot.Evaluate (p), 1E-12)
+				<< "Batched evaluation differs from the snapshot at " << points[i];
+		EXPECT_NEAR (evaluator (p), snapshot.Evaluate (p), 1E-12)
+				<< "Single point evaluation differs from the snapshot at " << points[i];
+	}
+
+	points[n_points / 2] = 2;
+	EXPECT_THROW (evaluator.Evaluate (points.data(), values.data(), n_points), out_of_range)
+			<< "Batched evaluation outside the mesh";
+	EXPECT_THROW (evaluator (Geometry::Point<1> (-1)), out_of_range)
+			<< "Evaluation outside the mesh";
+
+	evaluator.OutsideValue (-1);
+	evaluator.Evaluate (points.data(), values.data(), n_points);
+	EXPECT_DOUBLE_EQ (values[n_points / 2], -1) << "Outside value not returned";
+	EXPECT_NEAR (values[n_points / 4], sqrt (points[n_points / 4]), 1E-2)
+			<< "Wrong evaluation next to a point outside the mesh";
+
+	clog << "PointEvaluatorTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, PointEvaluator2DTest)
+{
+	clog << endl << "Starting PointEvaluator2DTest" << endl;
+
+	/*	On squares the Legendre basis is evaluated on blocks of points by the evaluator,
+		on triangles by the snapshot; both are located through the grid of cells */
+	for (auto type : {LibmeshSquareType, LibmeshTriangleType})
+	{
+		auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+		libMesh::MeshTools::Generation::build_square (*mesh_ptr, 3, 3, 0., 1., 0., 1., type);
+
+		LibmeshBinary::LibmeshRefiner<2> refiner;
+		refiner.Init (unique_ptr<BinaryTree::Functor<2>> (new ShiftedRootFunctor (1E-2)));
+		refiner.SetMesh (mesh_ptr);
+		refiner.Refine (60);
+
+		BinaryTree::PointEvaluator<2> evaluator (refiner, 2);
+		const auto& snapshot = evaluator.Snapshot();
+		EXPECT_GT (snapshot.MaxPLevel(), 1u) << "Tensorial indexes of degree one only";
+
+		size_t n_points (10000);
+		vector<double> points (2 * n_points), values (n_points);
+		for (size_t i = 0; i < n_points; ++i)
+		{
+			points[2 * i] = fmod (0.5 + i * 0.7548776662466927, 1.);
+			points[2 * i + 1] = fmod (0.5 + i * 0.5698402909980532, 1.);
+		}
+
+		evaluator.Evaluate (points.data(), values.data(), n_points);
+		for (size_t i = 0; i < n_points; i += 13)
+		{
+			Geometry::Point<2> p ({points[2 * i], points[2 * i + 1]});
+
+			auto e = evaluator.Locate (p);
+			ASSERT_LT (e, snapshot.Size()) << "Point " << p << " not located";
+			EXPECT_TRUE (snapshot.Contains (e, p)) << "Point " << p << " located in the wrong element";
+
+			double expected = snapshot.Evaluate (e, p);
+			EXPECT_NEAR (values[i], expected, 1E-12)
+					<< "Batched evaluation differs from the snapshot at " << p;
+			EXPECT_NEAR (evaluator (p), expected, 1E-12)
+					<< "Single point evaluation differs from the snapshot at " << p;
+			EXPECT_NEAR (expected, sqrt (p[0] + p[1] + 1E-2), 1E-2)
+					<< "Wrong approximation at " << p;
+		}
+
+		//a batch too small to be grouped by element
+		vector<double> few (5);
+		evaluator.Evaluate (points.data(), few.data(), few.size());
+		for (size_t i = 0; i < few.size(); ++i)
+			EXPECT_DOUBLE_EQ (few[i], values[i]) << "Small batch differs from the large one";
+
+		EXPECT_THROW (evaluator (Geometry::Point<2> ({1.5, 0.5})), out_of_range)
+				<< "Evaluation outside the mesh";
+	}
+
+	clog << "PointEvaluator2DTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, ArchiveTest)
+{
+	clog << endl << "Starting ArchiveTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+	refiner.Refine (20);
+
+	string file_name ("./approximation.bba");
+	//small buffers, so the columns are written in several chunks
+	BinaryTree::ArchiveWriter<1> (true, 64).Write (refiner, file_name);
+
+	BinaryTree::ApproximationSnapshot<1> snapshot (refiner, 0);
+	BinaryTree::MappedArchive<1> archive (file_name);
+
+	ASSERT_EQ (archive.Size(), snapshot.Size()) << "Wrong number of archived elements";
+	EXPECT_EQ (archive.VerticesNumber(), archive.Size() + 1) << "Shared vertices stored more than once";
+	EXPECT_EQ (archive.TreeSize(), refiner.TreeNodesNumber()) << "Wrong number of archived tree nodes";
+	EXPECT_EQ (archive.Iteration(), refiner.Iterations()) << "Wrong archived iteration";
+	EXPECT_DOUBLE_EQ (archive.Error(), refiner.GlobalError()) << "Wrong archived error";
+
+	for (size_t i = 0; i < archive.Size(); ++i)
+	{
+		EXPECT_EQ (archive.NodeIDs()[i], snapshot.NodeID (i)) << "Wrong node id of element " << i;
+		EXPECT_EQ (archive.PLevels()[i], snapshot.PLevel (i)) << "Wrong p level of element " << i;
+		EXPECT_DOUBLE_EQ (archive.LocalErrors()[i], snapshot.LocalError (i)) << "Wrong error of element " << i;
+
+		auto archived = archive.ElementCoefficients (i);
+		auto expected = snapshot.Coefficients (i);
+		ASSERT_EQ (archived.Size(), expected.Size()) << "Wrong number of coefficients of element " << i;
+		for (size_t k = 0; k < archived.Size(); ++k)
+			EXPECT_DOUBLE_EQ (archived[k], expected[k]) << "Wrong coefficient of element " << i;
+	}
+
+	size_t active = 0;
+	for (size_t t = 0; t < archive.TreeSize(); ++t)
+	{
+		auto parent = archive.TreeParents()[t];
+		if (parent != BinaryTree::archive_no_index)
+		{
+			EXPECT_LT (parent, t) << "Tree node stored before its parent";
+		}
+
+		auto element = archive.TreeElements()[t];
+		if (element != BinaryTree::archive_no_index)
+		{
+			++active;
+			EXPECT_EQ (archive.NodeIDs()[element], archive.TreeIDs()[t]) << "Wrong active element of tree node " << t;
+		}
+	}
+	EXPECT_EQ (active, archive.Size()) << "Wrong number of active tree nodes";
+
+	BinaryTree::PointEvaluator<1> evaluator (archive.Snapshot());
+	for (double x = 0.05; x < 1; x += 0.1)
+		EXPECT_NEAR (evaluator (Geometry::Point<1> (x)), snapshot.Evaluate (Geometry::Point<1> (x)), 1E-12)
+				<< "Wrong evaluation of the archive at " << x;
+
+	EXPECT_THROW (BinaryTree::MappedArchive<2> wrong (file_name), runtime_error)
+			<< "Archive read with the wrong dimension";
+
+	remove (file_name.c_str());
+
+	clog << "ArchiveTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, CheckpointTest)
+{
+	clog << endl << "Starting CheckpointTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+	refiner.Refine (15);
+
+	string file_name ("./checkpoint.bba");
+	refiner.Checkpoint (file_name);
+	refiner.Refine (10);
+
+	auto restored_mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*restored_mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> restored;
+	restored.Init ("sqrt_x");
+	restored.SetMesh (restored_mesh_ptr);
+	restored.Restore (file_name);
+	EXPECT_EQ (restored.Iterations(), static_cast<size_t> (15)) << "Wrong restored iteration";
+
+	restored.Refine (10);
+
+	EXPECT_EQ (restored.TreeNodesNumber(), refiner.TreeNodesNumber()) << "Wrong number of tree nodes";
+	EXPECT_EQ (restored.ExtractPLevels(), refiner.ExtractPLevels()) << "Wrong p levels";
+	EXPECT_EQ (restored.GlobalError(), refiner.GlobalError()) << "Wrong error";
+
+	auto vertices = refiner.ExtractVertices();
+	auto restored_vertices = restored.ExtractVertices();
+	ASSERT_EQ (restored_vertices.size(), vertices.size()) << "Wrong number of elements";
+	for (size_t i = 0; i < vertices.size(); ++i)
+		for (size_t v = 0; v < vertices[i].Size(); ++v)
+			EXPECT_EQ (restored_vertices[i][v][0], vertices[i][v][0]) << "Wrong vertex of element " << i;
+
+	EXPECT_THROW (restored.Restore (file_name), logic_error)
+			<< "Restore accepted a refined mesh";
+
+	remove (file_name.c_str());
+
+	clog << "CheckpointTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, ReplayTest)
+{
+	clog << endl << "Starting ReplayTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+
+	string file_name ("./refinement.log");
+	{
+		BinaryTree::RefinementLog<1> log (file_name);
+		refiner.Refine (25, 0, log.Sink (refiner));
+	}
+
+	auto replayed_mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*replayed_mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> replayed;
+	replayed.Init ("sqrt_x");
+	replayed.SetMesh (replayed_mesh_ptr);
+	replayed.Replay (file_name);
+
+	EXPECT_EQ (replayed.Iterations(), refiner.Iterations()) << "Wrong number of replayed iterations";
+	EXPECT_EQ (replayed.TreeNodesNumber(), refiner.TreeNodesNumber()) << "Wrong number of tree nodes";
+	EXPECT_EQ (replayed.ExtractPLevels(), refiner.ExtractPLevels()) << "Wrong p levels";
+
+	auto vertices = refiner.ExtractVertices();
+	auto replayed_vertices = replayed.ExtractVertices();
+	ASSERT_EQ (replayed_vertices.size(), vertices.size()) << "Wrong number of elements";
+	for (size_t i = 0; i < vertices.size(); ++i)
+		for (size_t v = 0; v < vertices[i].Size(); ++v)
+			EXPECT_EQ (replayed_vertices[i][v][0], vertices[i][v][0]) << "Wrong vertex of element " << i;
+
+	EXPECT_DOUBLE_EQ (replayed.GlobalError(), refiner.GlobalError()) << "Wrong error of the replayed mesh";
+
+	EXPECT_THROW (replayed.Replay (file_name), logic_error)
+			<< "Replay accepted a refined mesh";
+
+	remove (file_name.c_str());
+
+	clog << "ReplayTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, MultiResolutionTest)
+{
+	clog << endl << "Starting MultiResolutionTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+
+	vector<double> errors;
+	refiner.Refine (30, 0, std::function<void()> ([&] ()
+	{
+		errors.push_back (refiner.GlobalError());
+	}));
+
+	BinaryTree::MultiResolution<1> resolutions (refiner);
+	ASSERT_EQ (resolutions.Iterations(), static_cast<size_t> (30)) << "Wrong number of bisections";
+
+	for (size_t n = 0; n < errors.size(); ++n)
+		EXPECT_NEAR (resolutions.Error (n), errors[n], 1E-8 * errors[n]) << "Wrong error after " << n << " iterations";
+
+	auto finest = resolutions.Extract (resolutions.Iterations());
+	auto p_levels = refiner.ExtractPLevels();
+	ASSERT_EQ (finest->Size(), p_levels.size()) << "Wrong number of elements of the finest mesh";
+	vector<size_t> extracted_levels;
+	for (size_t i = 0; i < finest->Size(); ++i)
+		extracted_levels.push_back (finest->PLevel (i));
+	sort (p_levels.begin(), p_levels.end());
+	sort (extracted_levels.begin(), extracted_levels.end());
+	EXPECT_EQ (extracted_levels, p_levels) << "Wrong p levels of the finest mesh";
+
+	vector<double> tolerances = {1E-2, 1E-3, 1E-4};
+	auto meshes = resolutions.ExtractErrors (tolerances);
+	for (size_t t = 0; t < tolerances.size(); ++t)
+	{
+		auto n = meshes[t]->Iteration();
+		EXPECT_TRUE (meshes[t]->Error() <= tolerances[t] || n == resolutions.Iterations())
+				<< "Tolerance " << tolerances[t] << " not achieved";
+		if (n > 0)
+		{
+			EXPECT_GT (resolutions.Error (n - 1), tolerances[t]) << "Mesh finer than needed for " << tolerances[t];
+		}
+		if (t > 0)
+		{
+			EXPECT_GE (n, meshes[t - 1]->Iteration()) << "Meshes not sorted by tolerance";
+		}
+	}
+
+	for (auto& mesh : resolutions.ExtractBudgets ({3, 5}))
+		EXPECT_EQ (mesh->Size(), resolutions.Size (mesh->Iteration())) << "Wrong size of the extracted mesh";
+	EXPECT_LE (resolutions.Size (resolutions.BudgetIteration (5)), static_cast<size_t> (5)) << "Budget exceeded";
+
+	EXPECT_THROW (resolutions.Extract (31), out_of_range) << "Extracted a mesh finer than the tree";
+
+	//the coefficients released by the compacted nodes are computed again, then released
+	auto compacted_mesh = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*compacted_mesh, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> compacted;
+	compacted.Init ("sqrt_x");
+	compacted.CompactInactiveNodes (true);
+	compacted.SetMesh (compacted_mesh);
+	compacted.Refine (30, 0, [] () {});
+
+	auto bytes = compacted.TreeResidentBytes();
+	BinaryTree::MultiResolution<1> compacted_resolutions (compacted);
+	auto compacted_finest = compacted_resolutions.Extract (compacted_resolutions.Iterations());
+	EXPECT_EQ (compacted.TreeResidentBytes(), bytes) << "Coefficients of the compacted nodes not released";
+
+	for (size_t n = 0; n <= resolutions.Iterations(); ++n)
+		EXPECT_NEAR (compacted_resolutions.Error (n), resolutions.Error (n), 1E-10 * resolutions.Error (n))
+				<< "Wrong error of the compacted tree after " << n << " iterations";
+	EXPECT_EQ (compacted_finest->Size(), finest->Size()) << "Wrong finest mesh of the compacted tree";
+
+	clog << "MultiResolutionTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, SnapshotStreamTest)
+{
+	clog << endl << "Starting SnapshotStreamTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+
+	string file_name ("./snapshots.stream");
+	map<size_t, shared_ptr<const BinaryTree::ApproximationSnapshot<1>>> snapshots;
+	{
+		BinaryTree::SnapshotStream<1> stream (file_name);
+		refiner.Refine (25, 0, stream.Sink (refiner), std::function<void()> ([&] ()
+		{
+			snapshots[refiner.Iterations()] = make_shared<BinaryTree::ApproximationSnapshot<1>> (refiner, 0);
+		}));
+		stream.Flush (refiner);
+		EXPECT_EQ (stream.Deltas() + stream.MergedIterations(), static_cast<size_t> (26)) << "Iterations not recorded";
+	}
+
+	BinaryTree::SnapshotStreamPlayer<1> player (file_name);
+	size_t last = 0;
+	while (player.Next())
+	{
+		auto snapshot = player.Snapshot();
+		auto& expected = snapshots.at (player.Iteration());
+		ASSERT_EQ (snapshot->Size(), expected->Size()) << "Wrong number of elements at iteration " << player.Iteration();
+		EXPECT_DOUBLE_EQ (snapshot->Error(), expected->Error()) << "Wrong error at iteration " << player.Iteration();
+
+		map<size_t, size_t> p_levels;
+		for (size_t i = 0; i < expected->Size(); ++i)
+			p_levels[expected->NodeID (i)] = expected->PLevel (i);
+		for (size_t i = 0; i < snapshot->Size(); ++i)
+		{
+			EXPECT_EQ (snapshot->PLevel (i), p_levels[snapshot->NodeID (i)])
+					<< "Wrong p level of node " << snapshot->NodeID (i) << " at iteration " << player.Iteration();
+		}
+
+		for (double x = 0.05; x < 1; x += 0.1)
+		{
+			Geometry::Point<1> p (x);
+			EXPECT_DOUBLE_EQ (snapshot->Evaluate (p), expected->Evaluate (p))
+					<< "Wrong projection at iteration " << player.Iteration();
+		}
+		last = player.Iteration();
+	}
+	EXPECT_EQ (last, refiner.Iterations()) << "Last iteration not recorded";
+
+	auto middle = BinaryTree::SnapshotStreamPlayer<1>::Reconstruct (file_name, 12);
+	EXPECT_LE (middle->Iteration(), static_cast<size_t> (12)) << "Reconstructed a later snapshot";
+	EXPECT_EQ (middle->Size(), snapshots.at (middle->Iteration())->Size()) << "Wrong reconstructed snapshot";
+
+	remove (file_name.c_str());
+
+	clog << "SnapshotStreamTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, VtuExportTest)
+{
+	clog << endl << "Starting VtuExportTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_line (*mesh_ptr, 3, 0, 1,
+												LibmeshIntervalType);
+
+	LibmeshBinary::LibmeshRefiner<1> refiner;
+	refiner.Init ("sqrt_x");
+	refiner.SetMesh (mesh_ptr);
+	refiner.Refine (20);
+
+	BinaryTree::ApproximationSnapshot<1> snapshot (refiner, 0);
+	BinaryTree::VtuExporter<1> exporter (2, 2);
+	exporter.Subdivisions (2, 8);
+
+	size_t points = 0;
+	size_t cells = 0;
+	for (size_t i = 0; i < snapshot.Size(); ++i)
+	{
+		cells += exporter.Segments (snapshot.PLevel (i));
+		points += exporter.Segments (snapshot.PLevel (i)) + 1;
+	}
+
+	string file_name ("./projection.vtu");
+	exporter.Write (snapshot, file_name);
+
+	ifstream input (file_name, ios::binary);
+	ASSERT_TRUE (input.is_open()) << "VTU file not written";
+	string content ((istreambuf_iterator<char> (input)), istreambuf_iterator<char>());
+
+	string sizes = "NumberOfPoints=\"" + to_string (points) + "\" NumberOfCells=\"" + to_string (cells) + "\"";
+	EXPECT_NE (content.find (sizes), string::npos) << "Wrong number of points or cells";
+
+	//the projection is the first appended array, its first point the first vertex of the first element
+	auto data = content.find ('_', content.find ("<AppendedData"));
+	ASSERT_NE (data, string::npos) << "Appended data missing";
+	uint64_t bytes;
+	double value;
+	input.clear();
+	input.seekg (data + 1);
+	input.read (reinterpret_cast<char*> (&bytes), sizeof (bytes));
+	input.read (reinterpret_cast<char*> (&value), sizeof (value));
+	EXPECT_EQ (bytes, points * sizeof (double)) << "Wrong size of the projection array";
+	EXPECT_DOUBLE_EQ (value, snapshot.Evaluate (0, snapshot.Vertices (0)[0])) << "Wrong projection value";
+
+	EXPECT_NE (content.rfind ("</VTKFile>"), string::npos) << "VTU file not complete";
+
+	remove (file_name.c_str());
+
+	clog << "VtuExportTest ended" << endl << endl;
+}
+
+TEST_F (LibmeshTest, VtuExport2DTest)
+{
+	clog << endl << "Starting VtuExport2DTest" << endl;
+
+	auto mesh_ptr = make_shared<libMesh::Mesh> (_mesh_init_ptr->comm());
+	libMesh::MeshTools::Generation::build_square (*mesh_ptr, 3, 3, 0., 1., 0., 1.,
+												  LibmeshTriangleType);
+
+	LibmeshBinary::LibmeshRefiner<2> refiner;
+	refiner.Init (unique_ptr<BinaryTree::Functor<2>> (new ShiftedRootFunctor (1E-2)));
+	refiner.SetMesh (mesh_ptr);
+	refiner.Refine (40);
+
+	BinaryTree::ApproximationSnapshot<2> snapshot (refiner, 0);
+	BinaryTree::VtuExporter<2> exporter (2, 4);
+	exporter.Subdivisions (2, 8);
+
+	string file_name ("./projection2d.vtu");
+	exporter.Write (snapshot, file_name);
+
+	ifstream input (file_name, ios::binary);
+	ASSERT_TRUE (input.is_open()) << "VTU file not written";
+	string content ((istreambuf_iterator<char> (input)), istreambuf_iterator<char>());
+
+	size_t n_points = 0;
+	for (size_t i = 0; i < snapshot.Size(); ++i)
+	{
+		auto s = exporter.Segments (snapshot.PLevel (i));
+		n_points += (s + 1) * (s + 2) / 2;
+	}
+	EXPECT_NE (content.find ("NumberOfPoints=\"" + to_string (n_points) + "\""), string::npos)
+			<< "Wrong number of points";
+
+	//each array is preceded by its size in bytes, its offset is given from the character after '_'
+	auto data = content.find ('_', content.find ("<AppendedData"));
+	ASSERT_NE (data, string::npos) << "Appended data missing";
+	auto read_array = [&input, &content, data] (const string & name, size_t size)
+	{
+		auto attribute = content.find ("offset=\"", content.find ("Name=\"" + name + "\""));
+		vector<double> result (size);
+		input.clear();
+		input.seekg (data + 1 + stoul (content.substr (attribute + 8)) + sizeof (uint64_t));
+		input.read (reinterpret_cast<char*> (result.data()), size * sizeof (double));
+		return result;
+	};
+	auto projection = read_array ("projection", n_points);
+	auto points = read_array ("points", 3 * n_points);
+
+	/*	The last point of each triangle is its third vertex, the image of the top vertex of the reference triangle,
+		where the inverse of the map from the square is singular */
+	size_t point = 0;
+	for (size_t i = 0; i < snapshot.Size(); ++i)
+	{
+		auto s = exporter.Segments (snapshot.PLevel (i));
+		point += (s + 1) * (s + 2) / 2;
+
+		auto vertices = snapshot.Vertices (i);
+		Geometry::Point<2> top (vertices[2]);
+		EXPECT_NEAR (points[3 * (point - 1)], top[0], 1E-14) << "Wrong last point of element " << i;
+		EXPECT_NEAR (points[3 * (point - 1) + 1], top[1], 1E-14) << "Wrong last point of element " << i;
+
+		double value = projection[point - 1];
+		ASSERT_TRUE (std::isfinite (value)) << "Projection not finite at the top vertex of element " << i;
+		EXPECT_DOUBLE_EQ (value, snapshot.Evaluate (i, top)) << "Wrong projection value at " << top;
+
+		//the projection is continuous up to the vertex
+		Geometry::Point<2> inside (top);
+		for (size_t d = 0; d < 2; ++d)
+			inside[d] += 1E-6 * ((vertices[0][d] + vertices[1][d]) / 2 - top[d]);
+		EXPECT_NEAR (value, snapshot.Evaluate (i, inside), 1E-4) << "Projection not continuous at " << top;
+	}
+
+	remove (file_name.c_str());
+
+	clog << "VtuExport2DTest ended" << endl << endl;
+}
+
 //TODO: to be automated checks on input/output methods
 TEST_F (LibmeshTest, IOTest)
 {